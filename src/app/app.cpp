@@ -12,6 +12,7 @@
 #include "app/app.h"
 
 #include "app/app_options.h"
+#include "app/cold_images_compressor.h"
 #include "app/color_utils.h"
 #include "app/commands/cmd_save_file.h"
 #include "app/commands/cmd_sprite_size.h"
@@ -37,6 +38,7 @@
 #include "app/resource_finder.h"
 #include "app/script/app_scripting.h"
 #include "app/send_crash.h"
+#include "app/session_recorder.h"
 #include "app/shell.h"
 #include "app/tools/active_tool.h"
 #include "app/tools/tool_box.h"
@@ -60,11 +62,13 @@
 #include "doc/document_observer.h"
 #include "doc/frame_tag.h"
 #include "doc/image.h"
+#include "doc/image_compression.h"
 #include "doc/layer.h"
 #include "doc/layers_range.h"
 #include "doc/palette.h"
 #include "doc/site.h"
 #include "doc/sprite.h"
+#include "doc/swap_file.h"
 #include "render/render.h"
 #include "script/engine.h"
 #include "script/engine_delegate.h"
@@ -99,6 +103,7 @@ public:
   clipboard::ClipboardManager m_clipboardManager;
   // This is a raw pointer because we want to delete this explicitly.
   app::crash::DataRecovery* m_recovery;
+  std::unique_ptr<ColdImagesCompressor> m_coldImagesCompressor;
 
   Modules(bool createLogInDesktop)
     : m_loggerModule(createLogInDesktop)
@@ -172,6 +177,32 @@ void App::initialize(const AppOptions& options)
   if (isGui() && preferences().general.dataRecovery())
     m_modules->createDataRecovery();
 
+  // Store images bigger than the threshold (in MB) in a swap file
+  if (preferences().experimental.outOfCoreThreshold() > 0) {
+    doc::SwapOptions swapOptions;
+    swapOptions.threshold =
+      std::size_t(preferences().experimental.outOfCoreThreshold()) * 1024 * 1024;
+    swapOptions.budget =
+      std::size_t(preferences().experimental.outOfCoreBudget()) * 1024 * 1024;
+    doc::set_swap_options(swapOptions);
+  }
+
+  // Compress images (bigger than the threshold in KB) that are not
+  // used for a while, when the uncompressed ones use more than the
+  // budget (in MB)
+  if (preferences().experimental.coldImagesThreshold() > 0) {
+    doc::CompressionOptions compressionOptions;
+    compressionOptions.threshold =
+      std::size_t(preferences().experimental.coldImagesThreshold()) * 1024;
+    compressionOptions.budget =
+      std::size_t(preferences().experimental.coldImagesBudget()) * 1024 * 1024;
+    doc::set_compression_options(compressionOptions);
+
+    m_modules->m_coldImagesCompressor.reset(
+      new ColdImagesCompressor(
+        std::max(1, preferences().experimental.coldImagesPeriod())));
+  }
+
   // Register well-known image file types.
   FileFormatsManager::instance()->registerAllFormats();
 
@@ -631,12 +662,36 @@ void App::initialize(const AppOptions& options)
     if (trim)
       m_exporter->setTrimCels(true);
 
+    // The generated sheet is not used, so it can be written directly
+    // to the file without keeping the whole texture in memory.
+    m_exporter->setStreamTexture(m_exporter->canStreamTexture());
+
     std::unique_ptr<Document> spriteSheet(m_exporter->exportSheet());
     m_exporter.reset(NULL);
 
     LOG("Export sprite sheet: Done\n");
   }
 
+  // Record or replay a session
+  if (!options.replayFileName().empty()) {
+    m_replayer.reset(new SessionReplayer(options.replayFileName()));
+
+    // Open the documents of the recorded session
+    if (ctx->documents().empty()) {
+      Command* openCommand = CommandsModule::instance()->getCommandByName(CommandId::OpenFile);
+      for (const auto& filename : m_replayer->documents()) {
+        Params params;
+        params.set("filename", filename.c_str());
+        ctx->executeCommand(openCommand, params);
+      }
+    }
+  }
+  else if (!options.recordFileName().empty()) {
+    m_recorder.reset(
+      new SessionRecorder(options.recordFileName(), ctx,
+                          (isGui() ? ui::Manager::getDefault(): nullptr)));
+  }
+
   she::instance()->finishLaunching();
 }
 
@@ -653,9 +708,21 @@ void App::run()
     app::SendCrash sendCrash;
     sendCrash.search();
 
+    if (m_replayer)
+      m_replayer->start(ui::Manager::getDefault());
+
     // Run the GUI main message loop
     ui::Manager::getDefault()->run();
   }
+  else if (m_replayer) {
+    m_replayer->runCommands(UIContext::instance());
+  }
+
+  if (m_replayer) {
+    m_replayer->printReport(std::cout);
+    m_replayer.reset();
+  }
+  m_recorder.reset();
 
   // Start shell to execute scripts.
   if (m_isShell) {
@@ -37,6 +37,8 @@ namespace app {
   class MainWindow;
   class Preferences;
   class RecentFiles;
+  class SessionRecorder;
+  class SessionReplayer;
   class Timeline;
   class Workspace;
 
@@ -108,6 +110,8 @@ namespace app {
     FileList m_files;
     std::unique_ptr<DocumentExporter> m_exporter;
     std::unique_ptr<AppBrushes> m_brushes;
+    std::unique_ptr<SessionRecorder> m_recorder;
+    std::unique_ptr<SessionReplayer> m_replayer;
   };
 
   void app_refresh_screen();
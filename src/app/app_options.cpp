@@ -53,6 +53,8 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_script(m_po.add("script").requiresValue("<filename>").description("Execute a specific script"))
   , m_listLayers(m_po.add("list-layers").description("List layers of the next given sprite\nor include layers in JSON data"))
   , m_listTags(m_po.add("list-tags").description("List tags of the next given sprite sprite\nor include frame tags in JSON data"))
+  , m_record(m_po.add("record").requiresValue("<filename>").description("Record the input events and commands\nof the session in a file"))
+  , m_replay(m_po.add("replay").requiresValue("<filename>").description("Replay a recorded session and report\nthe time spent in each phase"))
   , m_verbose(m_po.add("verbose").mnemonic('v').description("Explain what is being done"))
   , m_debug(m_po.add("debug").description("Extreme verbose mode and\ncopy log to desktop"))
   , m_help(m_po.add("help").mnemonic('?').description("Display this help and exits"))
@@ -67,6 +69,8 @@ AppOptions::AppOptions(int argc, const char* argv[])
       m_verboseLevel = kVerbose;
 
     m_paletteFileName = m_po.value_of(m_palette);
+    m_recordFileName = m_po.value_of(m_record);
+    m_replayFileName = m_po.value_of(m_replay);
     m_startShell = m_po.enabled(m_shell);
 
     if (m_po.enabled(m_help)) {
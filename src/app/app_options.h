@@ -35,6 +35,10 @@ public:
 
   const std::string& paletteFileName() const { return m_paletteFileName; }
 
+  // Files to record/replay a session (input events and commands)
+  const std::string& recordFileName() const { return m_recordFileName; }
+  const std::string& replayFileName() const { return m_replayFileName; }
+
   const ValueList& values() const {
     return m_po.values();
   }
@@ -78,6 +82,8 @@ private:
   bool m_startShell;
   VerboseLevel m_verboseLevel;
   std::string m_paletteFileName;
+  std::string m_recordFileName;
+  std::string m_replayFileName;
 
   Option& m_palette;
   Option& m_shell;
@@ -107,6 +113,8 @@ private:
   Option& m_script;
   Option& m_listLayers;
   Option& m_listTags;
+  Option& m_record;
+  Option& m_replay;
 
   Option& m_verbose;
   Option& m_debug;
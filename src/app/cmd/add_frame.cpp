@@ -57,7 +57,7 @@ void AddFrame::onExecute()
   DocumentEvent ev(doc);
   ev.sprite(sprite);
   ev.frame(m_newFrame);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onAddFrame, ev);
+  doc->notifyEvent(&DocumentObserver::onAddFrame, ev);
 }
 
 void AddFrame::onUndo()
@@ -75,7 +75,7 @@ void AddFrame::onUndo()
   DocumentEvent ev(doc);
   ev.sprite(sprite);
   ev.frame(m_newFrame);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onRemoveFrame, ev);
+  doc->notifyEvent(&DocumentObserver::onRemoveFrame, ev);
 }
 
 } // namespace cmd
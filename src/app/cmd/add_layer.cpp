@@ -74,7 +74,7 @@ void AddLayer::addLayer(Layer* folder, Layer* newLayer, Layer* afterThis)
   DocumentEvent ev(doc);
   ev.sprite(folder->sprite());
   ev.layer(newLayer);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onAddLayer, ev);
+  doc->notifyEvent(&DocumentObserver::onAddLayer, ev);
 }
 
 void AddLayer::removeLayer(Layer* folder, Layer* layer)
@@ -83,12 +83,12 @@ void AddLayer::removeLayer(Layer* folder, Layer* layer)
   DocumentEvent ev(doc);
   ev.sprite(layer->sprite());
   ev.layer(layer);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onBeforeRemoveLayer, ev);
+  doc->notifyEvent(&DocumentObserver::onBeforeRemoveLayer, ev);
 
   static_cast<LayerFolder*>(folder)->removeLayer(layer);
   folder->incrementVersion();
 
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onAfterRemoveLayer, ev);
+  doc->notifyEvent(&DocumentObserver::onAfterRemoveLayer, ev);
 
   delete layer;
 }
@@ -11,15 +11,18 @@
 
 #include "app/cmd/flatten_layers.h"
 
+#include "app/cmd/add_cel.h"
 #include "app/cmd/add_layer.h"
-#include "app/cmd/set_layer_name.h"
 #include "app/cmd/configure_background.h"
-#include "app/cmd/copy_rect.h"
-#include "app/cmd/remove_layer.h"
+#include "app/cmd/remove_cel.h"
 #include "app/cmd/remove_layer.h"
+#include "app/cmd/replace_image.h"
+#include "app/cmd/set_cel_data.h"
 #include "app/cmd/set_layer_flags.h"
+#include "app/cmd/set_layer_name.h"
 #include "app/cmd/unlink_cel.h"
 #include "app/document.h"
+#include "app/util/flatten_frames.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
 #include "doc/primitives.h"
@@ -39,55 +42,80 @@ void FlattenLayers::onExecute()
   Sprite* sprite = this->sprite();
   app::Document* doc = static_cast<app::Document*>(sprite->document());
 
-  // Create a temporary image.
-  std::shared_ptr<Image> image(Image::create(sprite->pixelFormat(),
-      sprite->width(),
-      sprite->height()));
+  // Visible layers are the input of each flattened frame.
+  LayerList visibleLayers;
+  for (Layer* layer : sprite->folder()->getLayersList())
+    if (layer->isVisible())
+      visibleLayers.push_back(layer);
 
   LayerImage* flatLayer;  // The layer onto which everything will be flattened.
   color_t     bgcolor;    // The background color to use for flatLayer.
 
   flatLayer = sprite->backgroundLayer();
-  if (flatLayer && flatLayer->isVisible()) {
+  const bool isBackground = (flatLayer && flatLayer->isVisible());
+  if (isBackground) {
     // There exists a visible background layer, so we will flatten onto that.
     bgcolor = doc->bgColor(flatLayer);
   }
   else {
+    flatLayer = nullptr;
+    bgcolor = sprite->transparentColor();
+  }
+
+  // Render all frames (the background layer keeps full-size cels,
+  // a transparent layer gets cels trimmed to their content).
+  FlatFrames frames;
+  FlattenFrames flatten(sprite, visibleLayers, bgcolor);
+  flatten.setTrim(!isBackground);
+  flatten.setRenderFunc(
+    [sprite](Image* dst, const gfx::Rect& bounds, frame_t frame) {
+      render::Render render;
+      render.setBgType(render::BgType::NONE);
+      render.renderSprite(dst, sprite, frame, gfx::Clip(0, 0, bounds));
+    });
+  flatten.run(frames);
+
+  if (!flatLayer) {
     // Create a new transparent layer to flatten everything onto.
     flatLayer = new LayerImage(sprite);
     ASSERT(flatLayer->isVisible());
     executeAndAdd(new cmd::AddLayer(sprite->folder(), flatLayer, nullptr));
     executeAndAdd(new cmd::SetLayerName(flatLayer, "Flattened"));
-    bgcolor = sprite->transparentColor();
   }
 
-  render::Render render;
-  render.setBgType(render::BgType::NONE);
-
-  // Copy all frames to the background.
+  // Copy all frames to the flat layer, linking cels of frames with
+  // the same content.
   for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
-    // Clear the image and render this frame.
-    clear_image(image.get(), bgcolor);
-    render.renderSprite(image.get(), sprite, frame);
-
-    // TODO Keep cel links when possible
-
-    std::shared_ptr<Image> cel_image;
+    const FlatFrame& flat = frames[frame];
     Cel* cel = flatLayer->cel(frame);
-    if (cel) {
-      if (cel->links())
-        executeAndAdd(new cmd::UnlinkCel(cel));
-
-      cel_image = cel->imageRef();
-      ASSERT(cel_image);
 
-      executeAndAdd(new cmd::CopyRect(cel_image.get(), image.get(),
-          gfx::Clip(0, 0, image->bounds())));
+    if (flat.link >= 0) {
+      Cel* link = flatLayer->cel(flat.link);
+      ASSERT(link);
+
+      if (cel)
+        executeAndAdd(new cmd::SetCelData(cel, link->dataRef()));
+      else {
+        cel = Cel::createLink(link);
+        cel->setFrame(frame);
+        executeAndAdd(new cmd::AddCel(flatLayer, cel));
+      }
+    }
+    else if (flat.image) {
+      if (cel) {
+        if (cel->links())
+          executeAndAdd(new cmd::UnlinkCel(cel));
+
+        executeAndAdd(new cmd::ReplaceImage(sprite, cel->imageRef(), flat.image));
+      }
+      else {
+        cel = new Cel(frame, flat.image);
+        cel->setPosition(flat.bounds.x, flat.bounds.y);
+        executeAndAdd(new cmd::AddCel(flatLayer, cel));
+      }
     }
-    else {
-      cel_image.reset(Image::createCopy(image.get()));
-      cel = new Cel(frame, cel_image);
-      flatLayer->addCel(cel);
+    else if (cel) {
+      executeAndAdd(new cmd::RemoveCel(cel));
     }
   }
 
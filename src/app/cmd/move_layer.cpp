@@ -53,7 +53,7 @@ void MoveLayer::onFireNotifications()
   DocumentEvent ev(doc);
   ev.sprite(layer->sprite());
   ev.layer(layer);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onLayerRestacked, ev);
+  doc->notifyEvent(&DocumentObserver::onLayerRestacked, ev);
 }
 
 } // namespace cmd
@@ -51,7 +51,7 @@ void RemoveFrame::onExecute()
   DocumentEvent ev(doc);
   ev.sprite(sprite);
   ev.frame(m_frame);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onRemoveFrame, ev);
+  doc->notifyEvent(&DocumentObserver::onRemoveFrame, ev);
 }
 
 void RemoveFrame::onUndo()
@@ -68,7 +68,7 @@ void RemoveFrame::onUndo()
   DocumentEvent ev(doc);
   ev.sprite(sprite);
   ev.frame(m_frame);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onAddFrame, ev);
+  doc->notifyEvent(&DocumentObserver::onAddFrame, ev);
 }
 
 } // namespace cmd
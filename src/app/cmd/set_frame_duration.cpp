@@ -45,7 +45,7 @@ void SetFrameDuration::onFireNotifications()
   DocumentEvent ev(doc);
   ev.sprite(sprite);
   ev.frame(m_frame);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onFrameDurationChanged, ev);
+  doc->notifyEvent(&DocumentObserver::onFrameDurationChanged, ev);
 }
 
 } // namespace cmd
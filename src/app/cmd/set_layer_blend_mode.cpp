@@ -45,7 +45,7 @@ void SetLayerBlendMode::onFireNotifications()
   DocumentEvent ev(doc);
   ev.sprite(layer->sprite());
   ev.layer(layer);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onLayerBlendModeChange, ev);
+  doc->notifyEvent(&DocumentObserver::onLayerBlendModeChange, ev);
 }
 
 } // namespace cmd
@@ -45,7 +45,7 @@ void SetLayerName::onFireNotifications()
   DocumentEvent ev(doc);
   ev.sprite(layer->sprite());
   ev.layer(layer);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onLayerNameChange, ev);
+  doc->notifyEvent(&DocumentObserver::onLayerNameChange, ev);
 }
 
 } // namespace cmd
@@ -111,7 +111,7 @@ void SetPixelFormat::setFormat(PixelFormat format)
   // Generate notification
   DocumentEvent ev(sprite->document());
   ev.sprite(sprite);
-  sprite->document()->notifyObservers<DocumentEvent&>(&DocumentObserver::onPixelFormatChanged, ev);
+  sprite->document()->notifyEvent(&DocumentObserver::onPixelFormatChanged, ev);
 }
 
 } // namespace cmd
@@ -48,7 +48,7 @@ void SetSpriteSize::onFireNotifications()
   Sprite* sprite = this->sprite();
   DocumentEvent ev(sprite->document());
   ev.sprite(sprite);
-  sprite->document()->notifyObservers<DocumentEvent&>(&DocumentObserver::onSpriteSizeChanged, ev);
+  sprite->document()->notifyEvent(&DocumentObserver::onSpriteSizeChanged, ev);
 }
 
 } // namespace cmd
@@ -44,7 +44,7 @@ void SetTransparentColor::onFireNotifications()
   Sprite* sprite = this->sprite();
   DocumentEvent ev(sprite->document());
   ev.sprite(sprite);
-  sprite->document()->notifyObservers<DocumentEvent&>(&DocumentObserver::onSpriteTransparentColorChanged, ev);
+  sprite->document()->notifyEvent(&DocumentObserver::onSpriteTransparentColorChanged, ev);
 }
 
 } // namespace cmd
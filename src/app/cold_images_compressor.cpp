@@ -0,0 +1,52 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cold_images_compressor.h"
+
+#include "base/bind.h"
+#include "base/chrono.h"
+#include "base/debug.h"
+#include "doc/image_compression.h"
+
+namespace app {
+
+ColdImagesCompressor::ColdImagesCompressor(int period)
+  : m_period(period)
+  , m_done(false)
+  , m_thread(base::Bind<void>(&ColdImagesCompressor::backgroundThread, this))
+{
+}
+
+ColdImagesCompressor::~ColdImagesCompressor()
+{
+  m_done = true;
+  m_thread.join();
+}
+
+void ColdImagesCompressor::backgroundThread()
+{
+  int seconds = 0;
+
+  while (!m_done) {
+    if (++seconds >= m_period) {
+      base::Chrono chrono;
+      doc::compress_cold_images();
+      TRACE("ColdImages: %d compressed images use %d KB (%.16g)\n",
+            int(doc::get_compression_stats().compressed),
+            int(doc::get_compression_stats().compressedBytes / 1024),
+            chrono.elapsed());
+      seconds = 0;
+    }
+    base::this_thread::sleep_for(1.0);
+  }
+}
+
+} // namespace app
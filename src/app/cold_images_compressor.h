@@ -0,0 +1,32 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "base/thread.h"
+
+#include <atomic>
+
+namespace app {
+
+  // Background thread that compresses the images that are not used
+  // for a while (see doc/image_compression.h).
+  class ColdImagesCompressor {
+  public:
+    // Starts a compression pass each "period" seconds
+    ColdImagesCompressor(int period);
+    ~ColdImagesCompressor();
+
+  private:
+    void backgroundThread();
+
+    int m_period;
+    std::atomic<bool> m_done;
+    base::thread m_thread;
+  };
+
+} // namespace app
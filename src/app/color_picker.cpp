@@ -53,14 +53,29 @@ void ColorPicker::pickColor(const doc::Site& site,
 
   // Get the color from the image
   if (mode == FromComposition) { // Pick from the composed image
+    // Reused between picks to avoid allocations on mouse move
+    static thread_local render::PixelQuery query;
+
     m_color = app::Color::fromImage(
       sprite->pixelFormat(),
-      render::get_sprite_pixel(sprite, pos.x, pos.y, site.frame()));
+      query.pixel(sprite, pos.x, pos.y, site.frame()));
 
-    doc::CelList cels;
-    sprite->pickCels(pos.x, pos.y, site.frame(), 128, cels);
-    if (!cels.empty())
-      m_layer = cels.front()->layer();
+    // Top-most layer with an opaque enough pixel
+    for (const auto& contribution : query.contributions()) {
+      bool isOpaque = true;
+      switch (sprite->pixelFormat()) {
+        case IMAGE_RGB:
+          isOpaque = (doc::rgba_geta(contribution.color) >= 128);
+          break;
+        case IMAGE_GRAYSCALE:
+          isOpaque = (doc::graya_geta(contribution.color) >= 128);
+          break;
+      }
+      if (isOpaque) {
+        m_layer = contribution.cel->layer();
+        break;
+      }
+    }
   }
   else {                        // Pick from the current layer
     int u, v;
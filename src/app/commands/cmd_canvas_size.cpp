@@ -336,7 +336,7 @@ void CanvasSizeCommand::onExecute(Context* context)
     ContextWriter writer(reader);
     Document* document = writer.document();
     Sprite* sprite = writer.sprite();
-    Transaction transaction(writer.context(), "Canvas Size");
+    Transaction transaction(writer.context(), "Canvas Size", ModifyDocument, NotifyOnCommit);
     DocumentApi api = document->getApi(transaction);
 
     api.cropSprite(sprite, gfx::Rect(x1, y1, x2-x1, y2-y1));
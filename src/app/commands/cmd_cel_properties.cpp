@@ -163,7 +163,7 @@ private:
                                  m_userData != m_cel->data()->userData()))) {
       try {
         ContextWriter writer(UIContext::instance());
-        Transaction transaction(writer.context(), "Set Cel Properties");
+        Transaction transaction(writer.context(), "Set Cel Properties", ModifyDocument, NotifyOnCommit);
 
         if (count == 1 && m_cel) {
           if (!m_cel->layer()->isBackground() &&
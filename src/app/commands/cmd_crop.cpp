@@ -74,7 +74,7 @@ void CropSpriteCommand::onExecute(Context* context)
     bounds = m_bounds;
 
   {
-    Transaction transaction(writer.context(), "Sprite Crop");
+    Transaction transaction(writer.context(), "Sprite Crop", ModifyDocument, NotifyOnCommit);
     document->getApi(transaction).cropSprite(sprite, bounds);
     transaction.commit();
   }
@@ -111,7 +111,7 @@ void AutocropSpriteCommand::onExecute(Context* context)
   Document* document(writer.document());
   Sprite* sprite(writer.sprite());
   {
-    Transaction transaction(writer.context(), "Trim Sprite");
+    Transaction transaction(writer.context(), "Trim Sprite", ModifyDocument, NotifyOnCommit);
     document->getApi(transaction).trimSprite(sprite);
     transaction.commit();
   }
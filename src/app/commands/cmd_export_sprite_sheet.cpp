@@ -1041,14 +1041,24 @@ void ExportSpriteSheetCommand::onExecute(Context* context)
     exporter.addDocument(document, layer, frameTag, isTemporalTag);
   }
 
+  // If the generated sheet isn't opened, we don't need the whole
+  // texture in memory, it can be written directly to the file.
+  const bool streamTexture =
+    (!docPref.spriteSheet.openGenerated() &&
+     exporter.canStreamTexture());
+  exporter.setStreamTexture(streamTexture);
+
   std::unique_ptr<Document> newDocument(exporter.exportSheet());
-  if (!newDocument)
+  if (!newDocument && !streamTexture)
     return;
 
   StatusBar* statusbar = StatusBar::instance();
   if (statusbar)
     statusbar->showTip(1000, "Sprite Sheet Generated");
 
+  if (!newDocument)
+    return;
+
   // Copy background and grid preferences
   {
     DocumentPreferences& newDocPref(Preferences::instance().document(newDocument.get()));
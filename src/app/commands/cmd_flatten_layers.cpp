@@ -47,7 +47,7 @@ void FlattenLayersCommand::onExecute(Context* context)
   Document* document = writer.document();
   Sprite* sprite = writer.sprite();
   {
-    Transaction transaction(writer.context(), "Flatten Layers");
+    Transaction transaction(writer.context(), "Flatten Layers", ModifyDocument, NotifyOnCommit);
     document->getApi(transaction).flattenLayers(sprite);
     transaction.commit();
   }
@@ -74,7 +74,8 @@ void FlipCommand::onExecute(Context* context)
         "Flip Vertical"):
       (m_flipType == doc::algorithm::FlipHorizontal ?
         "Flip Canvas Horizontal":
-        "Flip Canvas Vertical"));
+        "Flip Canvas Vertical"),
+      ModifyDocument, NotifyOnCommit);
     DocumentApi api = document->getApi(transaction);
 
     CelList cels;
@@ -121,7 +121,7 @@ void FramePropertiesCommand::onExecute(Context* context)
     int num = window.frlen()->textInt();
 
     ContextWriter writer(reader);
-    Transaction transaction(writer.context(), "Frame Duration");
+    Transaction transaction(writer.context(), "Frame Duration", ModifyDocument, NotifyOnCommit);
     DocumentApi api = writer.document()->getApi(transaction);
     if (firstFrame != lastFrame)
       api.setFrameRangeDuration(writer.sprite(), firstFrame, lastFrame, num);
@@ -29,20 +29,69 @@
 #include "app/ui/editor/standby_state.h"
 #include "app/ui/workspace.h"
 #include "base/bind.h"
+#include "base/parallel_for.h"
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
 #include "doc/primitives.h"
+#include "doc/algorithm/shrink_bounds.h"
 #include "doc/sprite.h"
+#include "render/render.h"
 #include "ui/ui.h"
 
 #include "import_sprite_sheet.xml.h"
 
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
 namespace app {
 
 using namespace ui;
 
+namespace {
+
+// Information of each tile calculated in the slicing step.
+struct TileInfo {
+  gfx::Rect bounds;             // Tile bounds in the sheet
+  gfx::Rect content;            // Bounds of the non-transparent pixels (empty if the tile is empty)
+  uint64_t hash;                // Hash of the content pixels and its position in the tile
+};
+
+// FNV-1a hash of the pixels inside "bounds".
+uint64_t hash_image_area(const Image* image, const gfx::Rect& bounds)
+{
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](const uint8_t* p, std::size_t n) {
+    for (std::size_t i=0; i<n; ++i) {
+      hash ^= p[i];
+      hash *= 1099511628211ull;
+    }
+  };
+
+  const std::size_t rowBytes = image->getRowStrideSize(bounds.w);
+  for (int y=bounds.y; y<bounds.y+bounds.h; ++y)
+    add(image->getPixelAddress(bounds.x, y), rowBytes);
+  return hash;
+}
+
+bool is_same_image_area(const Image* image, const gfx::Rect& a, const gfx::Rect& b)
+{
+  if (a.w != b.w || a.h != b.h)
+    return false;
+
+  const std::size_t rowBytes = image->getRowStrideSize(a.w);
+  for (int y=0; y<a.h; ++y) {
+    if (std::memcmp(image->getPixelAddress(a.x, a.y+y),
+                    image->getPixelAddress(b.x, b.y+y), rowBytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+} // anonymous namespace
+
 class ImportSpriteSheetWindow : public app::gen::ImportSpriteSheet
                               , public SelectBoxDelegate {
 public:
@@ -96,6 +145,14 @@ public:
     return partialTiles()->isSelected();
   }
 
+  bool trimValue() const {
+    return trim()->isSelected();
+  }
+
+  bool ignoreEmptyValue() const {
+    return ignoreEmpty()->isSelected();
+  }
+
   bool ok() const {
     return closer() == import();
   }
@@ -223,6 +280,8 @@ private:
       onChangeRectangle(defBounds);
 
       partialTiles()->setSelected(m_docPref->importSpriteSheet.partialTiles());
+      trim()->setSelected(m_docPref->importSpriteSheet.trim());
+      ignoreEmpty()->setSelected(m_docPref->importSpriteSheet.ignoreEmpty());
       onEntriesChange();
     }
   }
@@ -315,15 +374,14 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
   DocumentPreferences* docPref = window.docPref();
   gfx::Rect frameBounds = window.frameBounds();
   bool partialTiles = window.partialTilesValue();
+  bool trim = window.trimValue();
+  bool ignoreEmpty = window.ignoreEmptyValue();
   auto sheetType = window.sheetTypeValue();
 
   ASSERT(document);
   if (!document)
     return;
 
-  // The list of frames imported from the sheet
-  std::vector<std::shared_ptr<Image>> animation;
-
   try {
     Sprite* sprite = document->sprite();
     frame_t currentFrame = context->activeSite().frame();
@@ -365,21 +423,7 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
         break;
     }
 
-    // As first step, we cut each tile and add them into "animation" list.
-    for (const auto& tileRect : tileRects) {
-      std::shared_ptr<Image> resultImage(
-        Image::create(
-          sprite->pixelFormat(), tileRect.w, tileRect.h));
-
-      // Render the portion of sheet.
-      render.renderSprite(
-        resultImage.get(), sprite, currentFrame,
-        gfx::Clip(0, 0, tileRect));
-
-      animation.push_back(resultImage);
-    }
-
-    if (animation.size() == 0) {
+    if (tileRects.empty()) {
       Alert::show("Import Sprite Sheet"
         "<<The specified rectangle does not create any tile."
         "<<Select a rectangle inside the sprite region."
@@ -387,22 +431,98 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
       return;
     }
 
+    // As first step, we render the whole area covered by the tiles in
+    // one image (partial tiles can be outside the sprite bounds).
+    gfx::Rect sheetBounds;
+    for (const auto& tileRect : tileRects)
+      sheetBounds |= tileRect;
+
+    std::shared_ptr<Image> sheetImage(
+      Image::create(sprite->pixelFormat(), sheetBounds.w, sheetBounds.h));
+    render.renderSprite(
+      sheetImage.get(), sprite, currentFrame,
+      gfx::Clip(0, 0, sheetBounds));
+
+    // Slice the sheet in parallel: each thread calculates the content
+    // bounds and the hash of a tile. Images aren't created here (the
+    // doc::Object creation must be done in the main thread).
+    color_t refpixel = (sprite->pixelFormat() == IMAGE_INDEXED ?
+                        sprite->transparentColor(): 0);
+    std::vector<TileInfo> tiles(tileRects.size());
+    base::parallel_for(
+      int(tiles.size()),
+      [&](int i) {
+        TileInfo& tile = tiles[i];
+        tile.bounds = tileRects[i];
+        tile.bounds.offset(-sheetBounds.origin());
+        tile.content = tile.bounds;
+        tile.hash = 0;
+
+        if (!doc::algorithm::shrink_bounds(sheetImage.get(), tile.bounds,
+                                           tile.content, refpixel)) {
+          tile.content = gfx::Rect();
+          return;
+        }
+
+        if (!trim)
+          tile.content = tile.bounds;
+
+        // Identical tiles share the cel data (image and position), so
+        // the position inside the tile is part of the hash.
+        tile.hash = hash_image_area(sheetImage.get(), tile.content);
+        tile.hash ^= (uint64_t(tile.content.x - tile.bounds.x) << 48) ^
+                     (uint64_t(tile.content.y - tile.bounds.y) << 32);
+      });
+
     // The following steps modify the sprite, so we wrap all
     // operations in a undo-transaction.
     ContextWriter writer(context);
-    Transaction transaction(writer.context(), "Import Sprite Sheet", ModifyDocument);
+    Transaction transaction(writer.context(), "Import Sprite Sheet", ModifyDocument, NotifyOnCommit);
     DocumentApi api = document->getApi(transaction);
 
     // Add the layer in the sprite.
     LayerImage* resultLayer = api.newLayer(sprite, "Sprite Sheet");
 
-    // Add all frames+cels to the new layer
-    for (size_t i=0; i<animation.size(); ++i) {
-      // Create the cel.
-      std::unique_ptr<Cel> resultCel(new Cel(frame_t(i), animation[i]));
+    // Add all frames+cels to the new layer. Empty tiles don't have a
+    // cel, and identical tiles are linked cels.
+    std::unordered_multimap<uint64_t, std::pair<const TileInfo*, Cel*>> uniqueTiles;
+    frame_t frame = 0;
+    for (const TileInfo& tile : tiles) {
+      if (tile.content.isEmpty()) {
+        if (!ignoreEmpty)
+          ++frame;
+        continue;
+      }
+
+      Cel* original = nullptr;
+      auto range = uniqueTiles.equal_range(tile.hash);
+      for (auto it=range.first; it!=range.second; ++it) {
+        const TileInfo* other = it->second.first;
+        if (other->content.x - other->bounds.x == tile.content.x - tile.bounds.x &&
+            other->content.y - other->bounds.y == tile.content.y - tile.bounds.y &&
+            is_same_image_area(sheetImage.get(), other->content, tile.content)) {
+          original = it->second.second;
+          break;
+        }
+      }
+
+      std::unique_ptr<Cel> resultCel;
+      if (original) {
+        resultCel.reset(Cel::createLink(original));
+        resultCel->setFrame(frame);
+      }
+      else {
+        std::shared_ptr<Image> image(crop_image(sheetImage.get(), tile.content, refpixel));
+        resultCel.reset(new Cel(frame, image));
+        resultCel->setPosition(tile.content.x - tile.bounds.x,
+                               tile.content.y - tile.bounds.y);
+        uniqueTiles.insert(
+          std::make_pair(tile.hash, std::make_pair(&tile, resultCel.get())));
+      }
 
       // Add the cel in the layer.
       api.addCel(resultLayer, resultCel.release());
+      ++frame;
     }
 
     // Copy the list of layers (because we will modify it in the iteration).
@@ -415,7 +535,7 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
     }
 
     // Change the number of frames
-    api.setTotalFrames(sprite, frame_t(animation.size()));
+    api.setTotalFrames(sprite, std::max<frame_t>(1, frame));
 
     // Set the size of the sprite to the tile size.
     api.setSpriteSize(sprite, frameBounds.w, frameBounds.h);
@@ -427,6 +547,8 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
       docPref->importSpriteSheet.type(sheetType);
       docPref->importSpriteSheet.bounds(frameBounds);
       docPref->importSpriteSheet.partialTiles(partialTiles);
+      docPref->importSpriteSheet.trim(trim);
+      docPref->importSpriteSheet.ignoreEmpty(ignoreEmpty);
     }
   }
   catch (...) {
@@ -62,7 +62,7 @@ void LinkCelsCommand::onExecute(Context* context)
     if (!range.enabled())
       return;
 
-    Transaction transaction(writer.context(), friendlyName());
+    Transaction transaction(writer.context(), friendlyName(), ModifyDocument, NotifyOnCommit);
     Sprite* sprite = writer.sprite();
     frame_t begin = range.frameBegin();
     frame_t end = range.frameEnd();
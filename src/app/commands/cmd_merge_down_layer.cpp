@@ -11,7 +11,9 @@
 
 #include "app/app.h"
 #include "app/cmd/add_cel.h"
+#include "app/cmd/remove_cel.h"
 #include "app/cmd/replace_image.h"
+#include "app/cmd/set_cel_data.h"
 #include "app/cmd/set_cel_position.h"
 #include "app/cmd/unlink_cel.h"
 #include "app/commands/command.h"
@@ -20,6 +22,7 @@
 #include "app/document_api.h"
 #include "app/modules/gui.h"
 #include "app/transaction.h"
+#include "app/util/flatten_frames.h"
 #include "doc/blend_internals.h"
 #include "doc/cel.h"
 #include "doc/image.h"
@@ -71,85 +74,104 @@ void MergeDownLayerCommand::onExecute(Context* context)
   ContextWriter writer(context);
   Document* document(writer.document());
   Sprite* sprite(writer.sprite());
-  Transaction transaction(writer.context(), "Merge Down Layer", ModifyDocument);
+  Transaction transaction(writer.context(), "Merge Down Layer", ModifyDocument, NotifyOnCommit);
   LayerImage* src_layer = static_cast<LayerImage*>(writer.layer());
   Layer* dst_layer = src_layer->getPrevious();
 
-  for (frame_t frpos = 0; frpos<sprite->totalFrames(); ++frpos) {
-    // Get frames
-    Cel* src_cel = src_layer->cel(frpos);
-    Cel* dst_cel = dst_layer->cel(frpos);
-
-    // Get images
-    Image* src_image;
-    if (src_cel != NULL)
-      src_image = src_cel->image();
-    else
-      src_image = NULL;
-
-    std::shared_ptr<Image> dst_image;
-    if (dst_cel)
-      dst_image = dst_cel->imageRef();
-
-    // With source image?
-    if (src_image) {
+  // Merge down in the background layer uses full-size cels, in a
+  // transparent layer the result of each frame is trimmed.
+  LayerList layers;
+  layers.push_back(dst_layer);
+  layers.push_back(src_layer);
+
+  FlatFrames frames;
+  FlattenFrames merge(sprite, layers, app_get_color_to_clear_layer(dst_layer));
+  merge.setTrim(!dst_layer->isBackground());
+  merge.setBoundsFunc(
+    [sprite, src_layer, dst_layer](frame_t frame) -> gfx::Rect {
+      const Cel* src_cel = src_layer->cel(frame);
+      if (!src_cel)
+        return gfx::Rect();     // Nothing to merge in this frame
+
+      if (dst_layer->isBackground())
+        return sprite->bounds();
+
+      const Cel* dst_cel = dst_layer->cel(frame);
+      if (dst_cel)
+        return src_cel->bounds().createUnion(dst_cel->bounds());
+      else
+        return src_cel->bounds();
+    });
+  merge.setRenderFunc(
+    [sprite, src_layer, dst_layer](Image* dst, const gfx::Rect& bounds, frame_t frame) {
+      const Cel* src_cel = src_layer->cel(frame);
+      const Cel* dst_cel = dst_layer->cel(frame);
+      ASSERT(src_cel);
+
+      if (dst_cel)
+        copy_image(dst, dst_cel->image(),
+                   dst_cel->x()-bounds.x,
+                   dst_cel->y()-bounds.y);
+
+      // Merge src_image in the destination
       int t;
-      int opacity;
-      opacity = MUL_UN8(src_cel->opacity(), src_layer->opacity(), t);
-
-      // No destination image
-      if (!dst_image) {  // Only a transparent layer can have a null cel
-        // Copy this cel to the destination layer...
+      int opacity = MUL_UN8(src_cel->opacity(), src_layer->opacity(), t);
+      render::composite_image(
+        dst, src_cel->image(),
+        sprite->palette(frame),
+        src_cel->x()-bounds.x,
+        src_cel->y()-bounds.y,
+        opacity,
+        src_layer->blendMode());
+    });
+  merge.run(frames);
 
-        // Creating a copy of the image
-        dst_image.reset(Image::createCopy(src_image));
+  for (frame_t frpos = 0; frpos<sprite->totalFrames(); ++frpos) {
+    if (!src_layer->cel(frpos))
+      continue;
 
-        // Creating a copy of the cell
-        dst_cel = new Cel(frpos, dst_image);
-        dst_cel->setPosition(src_cel->x(), src_cel->y());
-        dst_cel->setOpacity(opacity);
+    const FlatFrame& flat = frames[frpos];
+    Cel* dst_cel = dst_layer->cel(frpos);
+    std::shared_ptr<Image> new_image = flat.image;
 
-        transaction.execute(new cmd::AddCel(dst_layer, dst_cel));
-      }
-      // With destination
-      else {
-        gfx::Rect bounds;
+    if (flat.link >= 0) {
+      Cel* link = dst_layer->cel(flat.link);
+      ASSERT(link);
 
-        // Merge down in the background layer
-        if (dst_layer->isBackground()) {
-          bounds = sprite->bounds();
-        }
-        // Merge down in a transparent layer
+      // Link cels only if they have the same opacity too
+      if (link->opacity() == (dst_cel ? dst_cel->opacity(): 255)) {
+        if (dst_cel)
+          transaction.execute(new cmd::SetCelData(dst_cel, link->dataRef()));
         else {
-          bounds = src_cel->bounds().createUnion(dst_cel->bounds());
+          dst_cel = Cel::createLink(link);
+          dst_cel->setFrame(frpos);
+          transaction.execute(new cmd::AddCel(dst_layer, dst_cel));
         }
+        continue;
+      }
 
-        doc::color_t bgcolor = app_get_color_to_clear_layer(dst_layer);
-
-        std::shared_ptr<Image> new_image(doc::crop_image(
-            dst_image.get(),
-            bounds.x-dst_cel->x(),
-            bounds.y-dst_cel->y(),
-            bounds.w, bounds.h, bgcolor));
-
-        // Merge src_image in new_image
-        render::composite_image(
-          new_image.get(), src_image,
-          sprite->palette(src_cel->frame()),
-          src_cel->x()-bounds.x,
-          src_cel->y()-bounds.y,
-          opacity,
-          src_layer->blendMode());
-
-        transaction.execute(new cmd::SetCelPosition(dst_cel,
-            bounds.x, bounds.y));
+      new_image.reset(Image::createCopy(link->image()));
+    }
 
+    if (new_image) {
+      if (dst_cel) {
         if (dst_cel->links())
           transaction.execute(new cmd::UnlinkCel(dst_cel));
 
+        transaction.execute(new cmd::SetCelPosition(dst_cel,
+            flat.bounds.x, flat.bounds.y));
         transaction.execute(new cmd::ReplaceImage(sprite,
             dst_cel->imageRef(), new_image));
       }
+      else {
+        dst_cel = new Cel(frpos, new_image);
+        dst_cel->setPosition(flat.bounds.x, flat.bounds.y);
+        transaction.execute(new cmd::AddCel(dst_layer, dst_cel));
+      }
+    }
+    // The merged cel is completely transparent
+    else if (dst_cel) {
+      transaction.execute(new cmd::RemoveCel(dst_cel));
     }
   }
 
@@ -61,7 +61,7 @@ protected:
   // [working thread]
   virtual void onJob()
   {
-    Transaction transaction(m_writer.context(), "Rotate Canvas");
+    Transaction transaction(m_writer.context(), "Rotate Canvas", ModifyDocument, NotifyOnCommit);
     DocumentApi api = m_document->getApi(transaction);
 
     // 1) Rotate cel positions
@@ -34,24 +34,30 @@ protected:
 
 private:
   std::string m_filename;
+  bool m_background;
 };
 
 RunScriptCommand::RunScriptCommand()
   : Command("RunScript",
             "Run Script",
             CmdRecordableFlag)
+  , m_background(false)
 {
 }
 
 void RunScriptCommand::onLoadParams(const Params& params)
 {
   m_filename = params.get("filename");
+  m_background = (params.get("background") == "true");
 }
 
 void RunScriptCommand::onExecute(Context* context)
 {
   script::EngineDelegate::setDefault("gui");
-  AppScripting::evalFile(m_filename);
+  if (m_background || AppScripting::isBackgroundScript(m_filename))
+    AppScripting::evalFileInBackground(m_filename, context);
+  else
+    AppScripting::evalFile(m_filename);
   ui::Manager::getDefault()->invalidate();
 }
 
@@ -73,7 +73,7 @@ protected:
    */
   virtual void onJob()
   {
-    Transaction transaction(m_writer.context(), "Sprite Size");
+    Transaction transaction(m_writer.context(), "Sprite Size", ModifyDocument, NotifyOnCommit);
     DocumentApi api = m_writer.document()->getApi(transaction);
 
     int cels_count = 0;
@@ -171,11 +171,15 @@ public:
 
     static_assert(doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR == 0 &&
                   doc::algorithm::RESIZE_METHOD_BILINEAR == 1 &&
-                  doc::algorithm::RESIZE_METHOD_ROTSPRITE == 2,
+                  doc::algorithm::RESIZE_METHOD_ROTSPRITE == 2 &&
+                  doc::algorithm::RESIZE_METHOD_BOX == 3 &&
+                  doc::algorithm::RESIZE_METHOD_LANCZOS == 4,
                   "ResizeMethod enum has changed");
     method()->addItem("Nearest-neighbor");
     method()->addItem("Bilinear");
     method()->addItem("RotSprite");
+    method()->addItem("Box (area average)");
+    method()->addItem("Lanczos");
     method()->setSelectedItemIndex(
       get_config_int("SpriteSize", "Method",
                      doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR));
@@ -288,6 +292,10 @@ void SpriteSizeCommand::onLoadParams(const Params& params)
       m_resizeMethod = doc::algorithm::RESIZE_METHOD_BILINEAR;
     else if (resize_method == "rotsprite")
       m_resizeMethod = doc::algorithm::RESIZE_METHOD_ROTSPRITE;
+    else if (resize_method == "box")
+      m_resizeMethod = doc::algorithm::RESIZE_METHOD_BOX;
+    else if (resize_method == "lanczos")
+      m_resizeMethod = doc::algorithm::RESIZE_METHOD_LANCZOS;
     else
       m_resizeMethod = doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR;
   }
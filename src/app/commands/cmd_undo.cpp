@@ -101,11 +101,14 @@ void UndoCommand::onExecute(Context* context)
         undo->nextUndoLabel().c_str():
         undo->nextRedoLabel().c_str()));
 
-  // Effectively undo/redo.
-  if (m_type == Undo)
-    undo->undo();
-  else
-    undo->redo();
+  // Effectively undo/redo (notifying observers only once at the end).
+  {
+    doc::DocumentNotificationBatch batch(document);
+    if (m_type == Undo)
+      undo->undo();
+    else
+      undo->redo();
+  }
 
   // After redo/undo, we retry to change the current SpritePosition
   // (because new frames/layers could be added, positions that we
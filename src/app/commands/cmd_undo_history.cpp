@@ -24,10 +24,13 @@
 #include "doc/context_observer.h"
 #include "doc/documents_observer.h"
 #include "doc/site.h"
+#include "ui/list_model.h"
 #include "undo/undo_state.h"
 
 #include "undo_history.xml.h"
 
+#include <vector>
+
 namespace app {
 
 class UndoHistoryWindow : public app::gen::UndoHistory,
@@ -35,30 +38,41 @@ class UndoHistoryWindow : public app::gen::UndoHistory,
                           public doc::DocumentsObserver,
                           public app::DocumentUndoObserver {
 public:
-  class Item : public ui::ListItem {
+  // Only the visible states have a ListItem, so long histories don't
+  // need thousands of widgets.
+  class StatesModel : public ui::ListModel {
   public:
-    Item(const undo::UndoState* state)
-      : ui::ListItem(
-          (state ?
-           static_cast<Cmd*>(state->cmd())->label()
+    // The first row (nullptr) is the initial state
+    std::vector<const undo::UndoState*>& states() { return m_states; }
+
+    int rowsCount() const override {
+      return int(m_states.size());
+    }
+
+    void updateRowItem(ui::ListItem* item, int row) override {
+      const undo::UndoState* state = m_states[row];
+      item->setText(
+        (state ?
+         static_cast<Cmd*>(state->cmd())->label()
 #if _DEBUG
-           + std::string(" ") + base::get_pretty_memory_size(static_cast<Cmd*>(state->cmd())->memSize())
+         + std::string(" ") + base::get_pretty_memory_size(static_cast<Cmd*>(state->cmd())->memSize())
 #endif
-           : std::string("Initial State"))),
-        m_state(state) {
+         : std::string("Initial State")));
     }
-    const undo::UndoState* state() { return m_state; }
+
   private:
-    const undo::UndoState* m_state;
+    std::vector<const undo::UndoState*> m_states;
   };
 
   UndoHistoryWindow(Context* ctx)
     : m_ctx(ctx),
       m_document(nullptr) {
+    actions()->setModel(&m_model);
     actions()->Change.connect(&UndoHistoryWindow::onChangeAction, this);
   }
 
   ~UndoHistoryWindow() {
+    actions()->setModel(nullptr);
   }
 
 private:
@@ -91,14 +105,16 @@ private:
   }
 
   void onChangeAction() {
-    Item* item = static_cast<Item*>(
-      actions()->getSelectedChild());
+    const int row = actions()->getSelectedIndex();
+    if (row < 0)
+      return;
 
+    const undo::UndoState* state = m_model.states()[row];
     if (m_document &&
-        m_document->undoHistory()->currentState() != item->state()) {
+        m_document->undoHistory()->currentState() != state) {
       try {
         DocumentWriter writer(m_document, 100);
-        m_document->undoHistory()->moveToState(item->state());
+        m_document->undoHistory()->moveToState(state);
         m_document->generateMaskBoundaries();
 
         // TODO this should be an observer of the current document palette
@@ -135,11 +151,9 @@ private:
   // DocumentUndoObserver
   void onAddUndoState(DocumentUndo* history) override {
     ASSERT(history->currentState());
-    Item* item = new Item(history->currentState());
-    actions()->addChild(item);
-    actions()->layout();
-    view()->updateView();
-    actions()->selectChild(item);
+    m_model.states().push_back(history->currentState());
+    actions()->rowsInserted(m_model.rowsCount()-1, 1);
+    actions()->selectIndex(m_model.rowsCount()-1);
   }
 
   void onAfterUndo(DocumentUndo* history) override {
@@ -177,47 +191,43 @@ private:
   }
 
   void clearList() {
-    ui::Widget* child;
-    while ((child = actions()->firstChild()))
-      delete child;
-
-    actions()->layout();
-    view()->updateView();
+    m_model.states().clear();
+    actions()->modelChanged();
   }
 
   void refillList(DocumentUndo* history) {
-    clearList();
+    auto& states = m_model.states();
+    states.clear();
 
-    // Create an item to reference the initial state (undo state == nullptr)
-    Item* current = new Item(nullptr);
-    actions()->addChild(current);
+    // Add a row to reference the initial state (undo state == nullptr)
+    states.push_back(nullptr);
+    int current = 0;
 
     const undo::UndoState* state = history->firstState();
     while (state) {
-      Item* item = new Item(state);
-      actions()->addChild(item);
       if (state == history->currentState())
-        current = item;
+        current = int(states.size());
+      states.push_back(state);
 
       state = state->next();
     }
 
-    actions()->layout();
-    view()->updateView();
-    if (current)
-      actions()->selectChild(current);
+    actions()->modelChanged();
+    actions()->selectIndex(current);
   }
 
   void selectState(const undo::UndoState* state) {
-    for (auto child : actions()->children()) {
-      Item* item = static_cast<Item*>(child);
-      if (item->state() == state) {
-        actions()->selectChild(item);
+    // The current state is usually near the end of the history
+    const auto& states = m_model.states();
+    for (int row=int(states.size())-1; row >= 0; --row) {
+      if (states[row] == state) {
+        actions()->selectIndex(row);
         break;
       }
     }
   }
 
+  StatesModel m_model;
   Context* m_ctx;
   app::Document* m_document;
   doc::frame_t m_frame;
@@ -20,12 +20,17 @@
 #include "app/modules/editors.h"
 #include "app/transaction.h"
 #include "app/ui/editor/editor.h"
+#include "base/base.h"
+#include "base/chrono.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/images_collector.h"
 #include "doc/layer.h"
 #include "doc/mask.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/rgbmap.h"
 #include "doc/site.h"
 #include "doc/sprite.h"
 #include "filters/filter.h"
@@ -33,15 +38,241 @@
 #include "ui/view.h"
 #include "ui/widget.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <set>
+#include <thread>
+#include <vector>
 
 namespace app {
 
 using namespace std;
 using namespace ui;
 
+namespace {
+
+// Maximum number of pixels of the first preview pass, bigger areas
+// are previewed at reduced resolution.
+const int kFastPreviewPixels = 256*256;
+
+// Rows that a background thread refines before it publishes them.
+const int kPreviewRowsPerChunk = 8;
+
+// Time (in seconds) that the UI thread can use in each timer tick to
+// preview filters that cannot be applied from other threads.
+const double kPreviewTimeSlice = 0.010;
+
+inline bool is_selected(const Image* bitmap, const gfx::Rect& maskBounds, int x, int y)
+{
+  x -= maskBounds.x;
+  y -= maskBounds.y;
+  return (x >= 0 && y >= 0 && x < maskBounds.w && y < maskBounds.h &&
+          get_pixel_fast<BitmapTraits>(bitmap, x, y));
+}
+
+template<typename ImageTraits>
+void downsample_area(const Image* src, const gfx::Rect& bounds, int scale, Image* dst)
+{
+  for (int y=0; y<dst->height(); ++y) {
+    auto s = (typename ImageTraits::const_address_t)src->getPixelAddress(bounds.x, bounds.y+y*scale);
+    auto d = (typename ImageTraits::address_t)dst->getPixelAddress(0, y);
+    for (int x=0; x<dst->width(); ++x, s+=scale)
+      *d++ = *s;
+  }
+}
+
+// Copies the "src" image scaled by "scale" to the "bounds" of "dst",
+// only in pixels that are inside the mask.
+template<typename ImageTraits>
+void upsample_area(const Image* src, int scale, const Mask* mask, const gfx::Rect& bounds, Image* dst)
+{
+  const Image* bitmap = (mask ? mask->bitmap(): nullptr);
+
+  for (int y=0; y<bounds.h; ++y) {
+    auto s = (typename ImageTraits::const_address_t)src->getPixelAddress(0, y/scale);
+    auto d = (typename ImageTraits::address_t)dst->getPixelAddress(bounds.x, bounds.y+y);
+    for (int x=0; x<bounds.w; ++x, ++d) {
+      if (!bitmap || is_selected(bitmap, mask->bounds(), bounds.x+x, bounds.y+y))
+        *d = s[x/scale];
+    }
+  }
+}
+
+// Applies a filter row by row to an area of "src", writing the result
+// in "dst" (which is relative to the area origin). Each thread of the
+// preview uses its own instance.
+class AreaFilterManager : public FilterManager
+                        , public FilterIndexedData {
+public:
+  AreaFilterManager(const Image* src, Image* dst,
+                    const gfx::Rect& bounds,
+                    const Mask* mask,
+                    Target target,
+                    Palette* palette,
+                    RgbMap* rgbmap)
+    : m_src(src)
+    , m_dst(dst)
+    , m_bounds(bounds)
+    , m_bitmap(mask ? mask->bitmap(): nullptr)
+    , m_maskBounds(mask ? mask->bounds(): gfx::Rect())
+    , m_target(target)
+    , m_palette(palette)
+    , m_rgbmap(rgbmap)
+    , m_row(0)
+    , m_maskX(0) {
+  }
+
+  void applyToRow(Filter* filter, int row) {
+    m_row = row;
+    m_maskX = m_bounds.x;
+
+    switch (m_src->pixelFormat()) {
+      case IMAGE_RGB:       filter->applyToRgba(this); break;
+      case IMAGE_GRAYSCALE: filter->applyToGrayscale(this); break;
+      case IMAGE_INDEXED:   filter->applyToIndexed(this); break;
+    }
+  }
+
+  // FilterManager implementation
+  const void* getSourceAddress() override { return m_src->getPixelAddress(m_bounds.x, m_bounds.y+m_row); }
+  void* getDestinationAddress() override { return m_dst->getPixelAddress(0, m_row); }
+  int getWidth() override { return m_bounds.w; }
+  Target getTarget() override { return m_target; }
+  FilterIndexedData* getIndexedData() override { return this; }
+  bool skipPixel() override {
+    return (m_bitmap && !is_selected(m_bitmap, m_maskBounds, m_maskX++, m_bounds.y+m_row));
+  }
+  const Image* getSourceImage() override { return m_src; }
+  int x() override { return m_bounds.x; }
+  int y() override { return m_bounds.y+m_row; }
+
+  // FilterIndexedData implementation
+  Palette* getPalette() override { return m_palette; }
+  RgbMap* getRgbMap() override { return m_rgbmap; }
+
+private:
+  const Image* m_src;
+  Image* m_dst;
+  gfx::Rect m_bounds;
+  const Image* m_bitmap;
+  gfx::Rect m_maskBounds;
+  Target m_target;
+  Palette* m_palette;
+  RgbMap* m_rgbmap;
+  int m_row;
+  int m_maskX;
+};
+
+} // anonymous namespace
+
+// Refines the preview at full resolution in background threads. Each
+// thread takes chunks of rows and applies its own copy of the filter,
+// so the original filter can be modified by the UI meanwhile. Finished
+// rows are copied to the preview image from the UI thread.
+class FilterManagerImpl::PreviewJob {
+public:
+  PreviewJob(const Filter* filter,
+             const std::shared_ptr<Image>& src,
+             const gfx::Rect& bounds,
+             const Mask* mask,
+             Target target,
+             Palette* palette,
+             RgbMap* rgbmap)
+    : m_src(src)
+    , m_dst(crop_image(src.get(), bounds, 0))
+    , m_bounds(bounds)
+    , m_mask(mask ? new Mask(*mask): nullptr)
+    , m_target(target)
+    , m_palette(palette)
+    , m_rgbmap(rgbmap)
+    , m_cancel(false)
+    , m_nextRow(0)
+    , m_pendingRows(bounds.h) {
+    int threads = int(std::thread::hardware_concurrency()) - 1;
+    threads = MID(1, threads, (bounds.h+kPreviewRowsPerChunk-1) / kPreviewRowsPerChunk);
+
+    for (int i=0; i<threads; ++i)
+      m_filters.emplace_back(filter->clone());
+
+    for (auto& copy : m_filters) {
+      Filter* f = copy.get();
+      m_threads.push_back(std::thread([this, f]{ run(f); }));
+    }
+  }
+
+  ~PreviewJob() {
+    m_cancel = true;
+    for (auto& thread : m_threads)
+      thread.join();
+  }
+
+  // Copies the rows finished since the last call to "dst", and
+  // returns the range of modified rows in "row0" and "row1". Returns
+  // false when all rows were copied.
+  bool copyFinishedRows(Image* dst, int& row0, int& row1) {
+    std::vector<std::pair<int, int> > finished;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::swap(finished, m_finished);
+    }
+
+    row0 = INT_MAX;
+    row1 = INT_MIN;
+    for (const auto& rows : finished) {
+      dst->copy(m_dst.get(),
+                gfx::Clip(m_bounds.x, m_bounds.y+rows.first,
+                          0, rows.first,
+                          m_bounds.w, rows.second-rows.first));
+      row0 = std::min(row0, rows.first);
+      row1 = std::max(row1, rows.second);
+      m_pendingRows -= rows.second-rows.first;
+    }
+    return (m_pendingRows > 0);
+  }
+
+private:
+  void run(Filter* filter) {
+    AreaFilterManager mgr(m_src.get(), m_dst.get(), m_bounds,
+                          m_mask.get(), m_target, m_palette, m_rgbmap);
+
+    while (!m_cancel) {
+      const int row0 = m_nextRow.fetch_add(kPreviewRowsPerChunk);
+      if (row0 >= m_bounds.h)
+        break;
+
+      const int row1 = std::min(row0+kPreviewRowsPerChunk, m_bounds.h);
+      for (int row=row0; row<row1; ++row) {
+        if (m_cancel)
+          return;
+        mgr.applyToRow(filter, row);
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_finished.push_back(std::make_pair(row0, row1));
+    }
+  }
+
+  std::shared_ptr<Image> m_src;
+  std::unique_ptr<Image> m_dst;
+  gfx::Rect m_bounds;
+  std::unique_ptr<Mask> m_mask;
+  Target m_target;
+  Palette* m_palette;
+  RgbMap* m_rgbmap;
+  std::vector<std::unique_ptr<Filter> > m_filters;
+  std::vector<std::thread> m_threads;
+  std::atomic<bool> m_cancel;
+  std::atomic<int> m_nextRow;
+  std::mutex m_mutex;
+  std::vector<std::pair<int, int> > m_finished;
+  int m_pendingRows;
+};
+
 FilterManagerImpl::FilterManagerImpl(Context* context, Filter* filter)
   : m_context(context)
   , m_site(context->activeSite())
@@ -65,6 +296,10 @@ FilterManagerImpl::FilterManagerImpl(Context* context, Filter* filter)
   init(m_site.cel());
 }
 
+FilterManagerImpl::~FilterManagerImpl()
+{
+}
+
 app::Document* FilterManagerImpl::document()
 {
   return static_cast<app::Document*>(m_site.document());
@@ -102,6 +337,10 @@ void FilterManagerImpl::begin()
 
 void FilterManagerImpl::beginForPreview()
 {
+  // Cancel the refinement of the previous preview, its parameters
+  // are stale now.
+  m_previewJob.reset();
+
   Document* document = static_cast<app::Document*>(m_site.document());
 
   if (document->isMaskVisible())
@@ -135,10 +374,65 @@ void FilterManagerImpl::beginForPreview()
     m_row = -1;
     return;
   }
+
+  // Small areas are filtered completely right now.
+  const int pixels = m_bounds.w * m_bounds.h;
+  if (pixels <= kFastPreviewPixels) {
+    while (applyStep())
+      ;
+    invalidatePreviewRows(0, m_bounds.h);
+    return;
+  }
+
+  // Fast pass at reduced resolution, so the user can see the effect
+  // of the new parameters immediately.
+  applyReducedPreview(int(std::ceil(std::sqrt(double(pixels) / kFastPreviewPixels))));
+  invalidatePreviewRows(0, m_bounds.h);
+
+  // Refine the preview in background threads. Filters that cannot be
+  // copied are refined from updatePreview() in the UI thread.
+  std::unique_ptr<Filter> copy(m_filter->clone());
+  if (copy) {
+    // Initialize lazy tables before we use them from other threads.
+    Palette* palette = getPalette();
+    RgbMap* rgbmap = getRgbMap();
+    palette->findBestfit(0, 0, 0, 255, -1);
+
+    m_previewJob.reset(
+      new PreviewJob(copy.get(), m_src, m_bounds, m_mask,
+                     m_target, palette, rgbmap));
+  }
+}
+
+bool FilterManagerImpl::updatePreview()
+{
+  if (m_previewJob) {
+    int row0, row1;
+    const bool pending = m_previewJob->copyFinishedRows(m_dst.get(), row0, row1);
+    if (row0 < row1)
+      invalidatePreviewRows(row0, row1);
+    if (!pending)
+      m_previewJob.reset();
+    return pending;
+  }
+
+  if (m_row < 0)
+    return false;
+
+  const int row0 = m_row;
+  base::Chrono chrono;
+  bool pending;
+  while ((pending = applyStep()) &&
+         chrono.elapsed() < kPreviewTimeSlice)
+    ;
+  if (row0 < m_row)
+    invalidatePreviewRows(row0, m_row);
+  return pending;
 }
 
 void FilterManagerImpl::end()
 {
+  m_previewJob.reset();
   m_maskBits.unlock();
 }
 
@@ -216,7 +510,7 @@ void FilterManagerImpl::applyToTarget()
   // Initialize writting operation
   ContextReader reader(m_context);
   ContextWriter writer(reader);
-  Transaction transaction(writer.context(), m_filter->getName(), ModifyDocument);
+  Transaction transaction(writer.context(), m_filter->getName(), ModifyDocument, NotifyOnCommit);
 
   m_progressBase = 0.0f;
   m_progressWidth = 1.0f / images.size();
@@ -246,27 +540,46 @@ void FilterManagerImpl::applyToTarget()
   transaction.commit();
 }
 
-void FilterManagerImpl::flush()
+void FilterManagerImpl::applyReducedPreview(int scale)
 {
-  if (m_row >= 0) {
-    Editor* editor = current_editor;
-    gfx::Rect rect(
-      editor->editorToScreen(
-        gfx::Point(
-          m_bounds.x,
-          m_bounds.y+m_row-1)),
-      gfx::Size(
-        editor->zoom().apply(m_bounds.w),
-        (editor->zoom().scale() >= 1 ? editor->zoom().apply(1):
-                                       editor->zoom().remove(1))));
-
-    gfx::Region reg1(rect);
-    gfx::Region reg2;
-    editor->getDrawableRegion(reg2, Widget::kCutTopWindows);
-    reg1.createIntersection(reg1, reg2);
-
-    editor->invalidateRegion(reg1);
+  const PixelFormat format = m_src->pixelFormat();
+  std::unique_ptr<Image> src(
+    Image::create(format,
+                  (m_bounds.w+scale-1) / scale,
+                  (m_bounds.h+scale-1) / scale));
+
+  switch (format) {
+    case IMAGE_RGB:       downsample_area<RgbTraits>(m_src.get(), m_bounds, scale, src.get()); break;
+    case IMAGE_GRAYSCALE: downsample_area<GrayscaleTraits>(m_src.get(), m_bounds, scale, src.get()); break;
+    case IMAGE_INDEXED:   downsample_area<IndexedTraits>(m_src.get(), m_bounds, scale, src.get()); break;
   }
+
+  std::unique_ptr<Image> dst(Image::createCopy(src.get()));
+  AreaFilterManager mgr(src.get(), dst.get(), src->bounds(), nullptr,
+                        m_target, getPalette(), getRgbMap());
+  for (int row=0; row<src->height(); ++row)
+    mgr.applyToRow(m_filter, row);
+
+  switch (format) {
+    case IMAGE_RGB:       upsample_area<RgbTraits>(dst.get(), scale, m_mask, m_bounds, m_dst.get()); break;
+    case IMAGE_GRAYSCALE: upsample_area<GrayscaleTraits>(dst.get(), scale, m_mask, m_bounds, m_dst.get()); break;
+    case IMAGE_INDEXED:   upsample_area<IndexedTraits>(dst.get(), scale, m_mask, m_bounds, m_dst.get()); break;
+  }
+}
+
+void FilterManagerImpl::invalidatePreviewRows(int row0, int row1)
+{
+  Editor* editor = current_editor;
+  gfx::Region reg1(
+    editor->editorToScreen(
+      gfx::Rect(m_bounds.x, m_bounds.y+row0,
+                m_bounds.w, row1-row0)));
+
+  gfx::Region reg2;
+  editor->getDrawableRegion(reg2, Widget::kCutTopWindows);
+  reg1.createIntersection(reg1, reg2);
+
+  editor->invalidateRegion(reg1);
 }
 
 const void* FilterManagerImpl::getSourceAddress()
@@ -68,6 +68,7 @@ namespace app {
     };
 
     FilterManagerImpl(Context* context, Filter* filter);
+    ~FilterManagerImpl();
 
     void setProgressDelegate(IProgressDelegate* progressDelegate);
 
@@ -76,9 +77,20 @@ namespace app {
     void setTarget(Target target);
 
     void begin();
-    void beginForPreview();
     void end();
     bool applyStep();
+
+    // Starts the preview of the filter in the visible area of the
+    // current editor. A fast pass at reduced resolution is done
+    // immediately, and then the area is refined at full resolution in
+    // background threads. Calling it again cancels the previous
+    // preview (e.g. when the filter parameters change).
+    void beginForPreview();
+
+    // Shows in the preview image the rows refined since the last
+    // call. Returns false when the preview is complete.
+    bool updatePreview();
+
     void applyToTarget();
 
     app::Document* document();
@@ -88,9 +100,6 @@ namespace app {
     doc::Image* destinationImage() const { return m_dst.get(); }
     gfx::Point position() const { return gfx::Point(0, 0); }
 
-    // Updates the current editor to show the progress of the preview.
-    void flush();
-
     // FilterManager implementation
     const void* getSourceAddress() override;
     void* getDestinationAddress() override;
@@ -107,10 +116,14 @@ namespace app {
     doc::RgbMap* getRgbMap() override;
 
   private:
+    class PreviewJob;
+
     void init(doc::Cel* cel);
     void apply(Transaction& transaction);
     void applyToCel(Transaction& transaction, doc::Cel* cel);
     bool updateBounds(doc::Mask* mask);
+    void applyReducedPreview(int scale);
+    void invalidatePreviewRows(int row0, int row1);
 
     Context* m_context;
     doc::Site m_site;
@@ -131,6 +144,9 @@ namespace app {
     float m_progressBase;
     float m_progressWidth;
     IProgressDelegate* m_progressDelegate;
+
+    // Background refinement of the preview
+    std::unique_ptr<PreviewJob> m_previewJob;
   };
 
 } // namespace app
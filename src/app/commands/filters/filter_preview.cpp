@@ -72,17 +72,15 @@ bool FilterPreview::onProcessMessage(Message* msg)
     case kCloseMessage:
       current_editor->renderEngine().removePreviewImage();
 
-      // Stop the preview timer.
+      // Stop the preview timer (and the background threads).
+      if (m_timer->isRunning() && m_filterMgr)
+        m_filterMgr->end();
       m_timer->stop();
       break;
 
     case kTimerMessage:
-      if (m_filterMgr) {
-        if (m_filterMgr->applyStep())
-          m_filterMgr->flush();
-        else
-          m_timer->stop();
-      }
+      if (m_filterMgr && !m_filterMgr->updatePreview())
+        m_timer->stop();
       break;
   }
 
@@ -16,6 +16,7 @@
 #include "app/commands/commands.h"
 #include "app/console.h"
 #include "app/document.h"
+#include "base/phase_timer.h"
 
 #include <algorithm>
 #include <stdexcept>
@@ -62,12 +63,13 @@ void Context::executeCommand(Command* command, const Params& params)
   ASSERT(command != NULL);
 
   LOG("Context: Executing command '%s'...\n", command->id().c_str());
+  base::ScopedPhase phase("command");
   try {
     m_flags.update(this);
 
     command->loadParams(params);
 
-    CommandExecutionEvent ev(command);
+    CommandExecutionEvent ev(command, params);
     BeforeCommandExecution(ev);
 
     if (ev.isCanceled()) {
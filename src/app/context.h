@@ -28,11 +28,12 @@ namespace app {
 
   class CommandExecutionEvent {
   public:
-    CommandExecutionEvent(Command* command)
-      : m_command(command), m_canceled(false) {
+    CommandExecutionEvent(Command* command, const Params& params)
+      : m_command(command), m_params(params), m_canceled(false) {
     }
 
     Command* command() const { return m_command; }
+    const Params& params() const { return m_params; }
 
     // True if the command was canceled or simulated by an
     // observer/signal slot.
@@ -43,6 +44,7 @@ namespace app {
 
   private:
     Command* m_command;
+    const Params& m_params;
     bool m_canceled;
   };
 
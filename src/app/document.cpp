@@ -101,7 +101,7 @@ color_t Document::bgColor(Layer* layer) const
 void Document::notifyGeneralUpdate()
 {
   doc::DocumentEvent ev(this);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onGeneralUpdate, ev);
+  notifyEvent(&doc::DocumentObserver::onGeneralUpdate, ev);
 }
 
 void Document::notifySpritePixelsModified(Sprite* sprite, const gfx::Region& region, frame_t frame)
@@ -110,7 +110,7 @@ void Document::notifySpritePixelsModified(Sprite* sprite, const gfx::Region& reg
   ev.sprite(sprite);
   ev.region(region);
   ev.frame(frame);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onSpritePixelsModified, ev);
+  notifyEvent(&doc::DocumentObserver::onSpritePixelsModified, ev);
 }
 
 void Document::notifyExposeSpritePixels(Sprite* sprite, const gfx::Region& region)
@@ -118,7 +118,7 @@ void Document::notifyExposeSpritePixels(Sprite* sprite, const gfx::Region& regio
   doc::DocumentEvent ev(this);
   ev.sprite(sprite);
   ev.region(region);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onExposeSpritePixels, ev);
+  notifyEvent(&doc::DocumentObserver::onExposeSpritePixels, ev);
 }
 
 void Document::notifyLayerMergedDown(Layer* srcLayer, Layer* targetLayer)
@@ -127,7 +127,7 @@ void Document::notifyLayerMergedDown(Layer* srcLayer, Layer* targetLayer)
   ev.sprite(srcLayer->sprite());
   ev.layer(srcLayer);
   ev.targetLayer(targetLayer);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onLayerMergedDown, ev);
+  notifyEvent(&doc::DocumentObserver::onLayerMergedDown, ev);
 }
 
 void Document::notifyCelMoved(Layer* fromLayer, frame_t fromFrame, Layer* toLayer, frame_t toFrame)
@@ -138,7 +138,7 @@ void Document::notifyCelMoved(Layer* fromLayer, frame_t fromFrame, Layer* toLaye
   ev.frame(fromFrame);
   ev.targetLayer(toLayer);
   ev.targetFrame(toFrame);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onCelMoved, ev);
+  notifyEvent(&doc::DocumentObserver::onCelMoved, ev);
 }
 
 void Document::notifyCelCopied(Layer* fromLayer, frame_t fromFrame, Layer* toLayer, frame_t toFrame)
@@ -149,13 +149,13 @@ void Document::notifyCelCopied(Layer* fromLayer, frame_t fromFrame, Layer* toLay
   ev.frame(fromFrame);
   ev.targetLayer(toLayer);
   ev.targetFrame(toFrame);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onCelCopied, ev);
+  notifyEvent(&doc::DocumentObserver::onCelCopied, ev);
 }
 
 void Document::notifySelectionChanged()
 {
   doc::DocumentEvent ev(this);
-  notifyObservers<doc::DocumentEvent&>(&doc::DocumentObserver::onSelectionChanged, ev);
+  notifyEvent(&doc::DocumentObserver::onSelectionChanged, ev);
 }
 
 bool Document::isModified() const
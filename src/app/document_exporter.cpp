@@ -17,6 +17,7 @@
 #include "app/console.h"
 #include "app/document.h"
 #include "app/file/file.h"
+#include "app/file/png_stream_writer.h"
 #include "app/filename_formatter.h"
 #include "app/ui_context.h"
 #include "base/convert_to.h"
@@ -37,6 +38,7 @@
 #include "gfx/size.h"
 #include "render/render.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <iomanip>
@@ -48,6 +50,9 @@ using namespace doc;
 
 namespace {
 
+// Default maximum memory of each band of rows used to stream the texture
+const int kMaxBandBytes = 16*1024*1024;
+
 std::string escape_for_json(const std::string& path)
 {
   std::string res = path;
@@ -449,6 +454,8 @@ DocumentExporter::DocumentExporter()
  , m_trimCels(false)
  , m_listFrameTags(false)
  , m_listLayers(false)
+ , m_streamTexture(false)
+ , m_streamBandBytes(kMaxBandBytes)
 {
 }
 
@@ -505,8 +512,22 @@ Document* DocumentExporter::exportSheet()
   }
 
   // 3) Create and render the texture.
+  PixelFormat pixelFormat;
+  gfx::Size textureSize;
+  Palette* palette;
+  calculateTexture(samples, pixelFormat, textureSize, palette);
+
+  // Stream the texture directly to the file in bands of rows
+  if (m_streamTexture && canStreamTexture()) {
+    streamTexture(samples, pixelFormat, textureSize, palette);
+
+    if (osbuf)
+      createDataFile(samples, os, pixelFormat, textureSize);
+    return nullptr;
+  }
+
   std::unique_ptr<Document> textureDocument(
-    createEmptyTexture(samples));
+    createEmptyTexture(pixelFormat, textureSize, palette));
 
   Sprite* texture = textureDocument->sprite();
   Image* textureImage = texture->folder()->getFirstLayer()
@@ -516,7 +537,7 @@ Document* DocumentExporter::exportSheet()
 
   // Save the metadata.
   if (osbuf)
-    createDataFile(samples, os, textureImage);
+    createDataFile(samples, os, pixelFormat, textureSize);
 
   // Save the image files.
   if (!m_textureFilename.empty()) {
@@ -646,12 +667,20 @@ void DocumentExporter::captureSamples(Samples& samples)
   }
 }
 
-Document* DocumentExporter::createEmptyTexture(const Samples& samples)
+bool DocumentExporter::canStreamTexture() const
+{
+  return (base::string_to_lower(
+            base::get_file_extension(m_textureFilename)) == "png");
+}
+
+void DocumentExporter::calculateTexture(const Samples& samples,
+                                        PixelFormat& pixelFormat,
+                                        gfx::Size& textureSize,
+                                        Palette*& palette)
 {
-  Palette* palette = NULL;
-  PixelFormat pixelFormat = IMAGE_INDEXED;
+  palette = NULL;
+  pixelFormat = IMAGE_INDEXED;
   gfx::Rect fullTextureBounds(0, 0, m_textureWidth, m_textureHeight);
-  int maxColors = 256;
 
   for (Samples::const_iterator
          it = samples.begin(),
@@ -692,11 +721,19 @@ Document* DocumentExporter::createEmptyTexture(const Samples& samples)
   if (m_textureWidth == 0) fullTextureBounds.w += m_borderPadding;
   if (m_textureHeight == 0) fullTextureBounds.h += m_borderPadding;
 
+  textureSize.w = fullTextureBounds.x+fullTextureBounds.w;
+  textureSize.h = fullTextureBounds.y+fullTextureBounds.h;
+}
+
+Document* DocumentExporter::createEmptyTexture(PixelFormat pixelFormat,
+                                               const gfx::Size& textureSize,
+                                               const Palette* palette)
+{
+  int maxColors = 256;
+
   std::unique_ptr<Sprite> sprite(
     Sprite::createBasicSprite(
-      pixelFormat,
-      fullTextureBounds.x+fullTextureBounds.w,
-      fullTextureBounds.y+fullTextureBounds.h, maxColors));
+      pixelFormat, textureSize.w, textureSize.h, maxColors));
 
   if (palette != NULL)
     sprite->setPalette(palette, false);
@@ -712,14 +749,7 @@ void DocumentExporter::renderTexture(const Samples& samples, Image* textureImage
     if (sample.isDuplicated())
       continue;
 
-    // Make the sprite compatible with the texture so the render()
-    // works correctly.
-    if (sample.sprite()->pixelFormat() != textureImage->pixelFormat()) {
-      cmd::SetPixelFormat(
-        sample.sprite(),
-        textureImage->pixelFormat(),
-        DitheringMethod::NONE).execute(UIContext::instance());
-    }
+    makeSampleCompatible(sample, textureImage->pixelFormat());
 
     renderSample(sample, textureImage,
       sample.inTextureBounds().x+m_innerPadding,
@@ -727,7 +757,88 @@ void DocumentExporter::renderTexture(const Samples& samples, Image* textureImage
   }
 }
 
-void DocumentExporter::createDataFile(const Samples& samples, std::ostream& os, Image* textureImage)
+// Renders the texture in bands of rows that are written to the PNG
+// file as soon as they are ready, so the memory used depends on the
+// band height instead of the texture size.
+void DocumentExporter::streamTexture(const Samples& samples,
+                                     PixelFormat pixelFormat,
+                                     const gfx::Size& textureSize,
+                                     const Palette* palette)
+{
+  // Samples sorted by their first row in the texture
+  std::vector<const Sample*> sorted;
+  for (const auto& sample : samples) {
+    if (sample.isDuplicated())
+      continue;
+
+    makeSampleCompatible(sample, pixelFormat);
+    sorted.push_back(&sample);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Sample* a, const Sample* b) {
+              return a->inTextureBounds().y < b->inTextureBounds().y;
+            });
+
+  const int rowBytes = std::max(1, calculate_rowstride_bytes(pixelFormat, textureSize.w));
+  const int bandHeight = MID(1, m_streamBandBytes / rowBytes, std::max(1, textureSize.h));
+  std::unique_ptr<Image> band(Image::create(pixelFormat, textureSize.w, bandHeight));
+
+  // Index 0 is the transparent color (like the texture of createEmptyTexture())
+  PngStreamWriter writer(m_textureFilename, pixelFormat,
+                         textureSize.w, textureSize.h, palette, 0);
+
+  std::vector<const Sample*> active;
+  std::size_t next = 0;
+
+  for (int bandY=0; bandY<textureSize.h; bandY+=bandHeight) {
+    const int rows = std::min(bandHeight, textureSize.h - bandY);
+
+    // Samples that start in this band
+    for (; next < sorted.size(); ++next) {
+      const Sample* sample = sorted[next];
+      if (sample->inTextureBounds().y+m_innerPadding >= bandY+rows)
+        break;
+      active.push_back(sample);
+    }
+
+    // Samples that finished in previous bands
+    active.erase(
+      std::remove_if(
+        active.begin(), active.end(),
+        [this, bandY](const Sample* sample) {
+          return (sample->inTextureBounds().y + m_innerPadding +
+                  sample->trimmedBounds().h <= bandY);
+        }),
+      active.end());
+
+    band->clear(0);
+    for (const Sample* sample : active) {
+      renderSample(*sample, band.get(),
+        sample->inTextureBounds().x+m_innerPadding,
+        sample->inTextureBounds().y+m_innerPadding-bandY);
+    }
+
+    writer.writeRows(band.get(), rows);
+  }
+
+  writer.close();
+}
+
+// Makes the sprite compatible with the texture so the render()
+// works correctly.
+void DocumentExporter::makeSampleCompatible(const Sample& sample, PixelFormat pixelFormat)
+{
+  if (sample.sprite()->pixelFormat() != pixelFormat) {
+    cmd::SetPixelFormat(
+      sample.sprite(),
+      pixelFormat,
+      DitheringMethod::NONE).execute(UIContext::instance());
+  }
+}
+
+void DocumentExporter::createDataFile(const Samples& samples, std::ostream& os,
+                                      PixelFormat textureFormat,
+                                      const gfx::Size& textureSize)
 {
   std::string frames_begin;
   std::string frames_end;
@@ -799,10 +910,10 @@ void DocumentExporter::createDataFile(const Samples& samples, std::ostream& os,
   if (!m_textureFilename.empty())
     os << "  \"image\": \"" << escape_for_json(m_textureFilename).c_str() << "\",\n";
 
-  os << "  \"format\": \"" << (textureImage->pixelFormat() == IMAGE_RGB ? "RGBA8888": "I8") << "\",\n"
+  os << "  \"format\": \"" << (textureFormat == IMAGE_RGB ? "RGBA8888": "I8") << "\",\n"
      << "  \"size\": { "
-     << "\"w\": " << textureImage->width() << ", "
-     << "\"h\": " << textureImage->height() << " },\n"
+     << "\"w\": " << textureSize.w << ", "
+     << "\"h\": " << textureSize.h << " },\n"
      << "  \"scale\": \"" << m_scale << "\"";
 
   // meta.frameTags
@@ -12,6 +12,7 @@
 #include "app/sprite_sheet_type.h"
 #include "base/disable_copying.h"
 #include "doc/image_buffer.h"
+#include "doc/pixel_format.h"
 #include "gfx/fwd.h"
 
 #include <iosfwd>
@@ -22,6 +23,7 @@ namespace doc {
   class FrameTag;
   class Image;
   class Layer;
+  class Palette;
 }
 
 namespace app {
@@ -72,6 +74,14 @@ namespace app {
       m_documents.push_back(Item(document, layer, tag, temporalTag));
     }
 
+    // Writes the texture file in bands of rows (only for PNG files)
+    // instead of rendering the whole texture in memory. In this case
+    // exportSheet() doesn't return the texture document.
+    void setStreamTexture(bool state) { m_streamTexture = state; }
+    // Maximum size of each band of rows when the texture is streamed.
+    void setStreamBandBytes(int bytes) { m_streamBandBytes = bytes; }
+    bool canStreamTexture() const;
+
     Document* exportSheet();
 
   private:
@@ -83,9 +93,22 @@ namespace app {
     class BestFitLayoutSamples;
 
     void captureSamples(Samples& samples);
-    Document* createEmptyTexture(const Samples& samples);
+    void calculateTexture(const Samples& samples,
+                          doc::PixelFormat& pixelFormat,
+                          gfx::Size& textureSize,
+                          doc::Palette*& palette);
+    Document* createEmptyTexture(doc::PixelFormat pixelFormat,
+                                 const gfx::Size& textureSize,
+                                 const doc::Palette* palette);
     void renderTexture(const Samples& samples, doc::Image* textureImage);
-    void createDataFile(const Samples& samples, std::ostream& os, doc::Image* textureImage);
+    void streamTexture(const Samples& samples,
+                       doc::PixelFormat pixelFormat,
+                       const gfx::Size& textureSize,
+                       const doc::Palette* palette);
+    void makeSampleCompatible(const Sample& sample, doc::PixelFormat pixelFormat);
+    void createDataFile(const Samples& samples, std::ostream& os,
+                        doc::PixelFormat textureFormat,
+                        const gfx::Size& textureSize);
     void renderSample(const Sample& sample, doc::Image* dst, int x, int y);
 
     class Item {
@@ -129,6 +152,8 @@ namespace app {
     doc::ImageBufferPtr m_sampleRenderBuf;
     bool m_listFrameTags;
     bool m_listLayers;
+    bool m_streamTexture;
+    int m_streamBandBytes;
 
     DISABLE_COPYING(DocumentExporter);
   };
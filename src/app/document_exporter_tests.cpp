@@ -0,0 +1,153 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/context.h"
+#include "app/document.h"
+#include "app/document_exporter.h"
+#include "app/file/file.h"
+#include "app/file/file_formats_manager.h"
+#include "base/fs.h"
+#include "base/path.h"
+#include "doc/doc.h"
+#include "doc/test_context.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace app;
+using namespace doc;
+
+typedef std::unique_ptr<app::Document> DocumentPtr;
+
+namespace {
+
+  void register_formats() {
+    static bool registered = false;
+    if (!registered) {
+      FileFormatsManager::instance()->registerAllFormats();
+      registered = true;
+    }
+  }
+
+  std::string temp_filename(const char* name) {
+    return base::join_path(base::get_temp_path(), name);
+  }
+
+  // Adds a document with different pixels in each row (each sample
+  // of the texture must be different, or it's exported as duplicated).
+  app::Document* add_document(app::Context& ctx, ColorMode mode,
+                              int w, int h, int seed) {
+    app::Document* doc = static_cast<app::Document*>(
+      ctx.documents().add(w, h, mode, 256));
+    Image* image = doc->sprite()->folder()->getFirstLayer()
+      ->cel(frame_t(0))->image();
+
+    for (int y=0; y<h; ++y) {
+      for (int x=0; x<w; ++x) {
+        const int v = (seed*31 + y*7 + x) % 256;
+        if (mode == ColorMode::INDEXED)
+          put_pixel(image, x, y, (x == y ? 0: v));
+        else
+          put_pixel(image, x, y, rgba(v, y*20, seed*40, (x == y ? 0: 255)));
+      }
+    }
+    return doc;
+  }
+
+  // Exports the sheet of the given documents in memory and streamed
+  // to a PNG file in bands of 3 rows, and compares both textures.
+  void expect_same_texture(app::Context& ctx,
+                           const std::vector<app::Document*>& docs) {
+    const std::string dataFn = temp_filename("_exporter_test_.json");
+    const std::string textureFn = temp_filename("_exporter_test_.png");
+
+    DocumentExporter memExporter;
+    memExporter.setDataFilename(dataFn);
+    memExporter.setSpriteSheetType(SpriteSheetType::Vertical);
+    memExporter.setBorderPadding(1);
+    for (auto doc : docs)
+      memExporter.addDocument(doc);
+    DocumentPtr expected(memExporter.exportSheet());
+    ASSERT_TRUE(expected != nullptr);
+
+    const Image* expectedImage = expected->sprite()->folder()
+      ->getFirstLayer()->cel(frame_t(0))->image();
+
+    DocumentExporter streamExporter;
+    streamExporter.setDataFilename(dataFn);
+    streamExporter.setTextureFilename(textureFn);
+    streamExporter.setSpriteSheetType(SpriteSheetType::Vertical);
+    streamExporter.setBorderPadding(1);
+    streamExporter.setStreamTexture(true);
+    streamExporter.setStreamBandBytes(
+      3*calculate_rowstride_bytes(expectedImage->pixelFormat(),
+                                  expectedImage->width()));
+    for (auto doc : docs)
+      streamExporter.addDocument(doc);
+    EXPECT_TRUE(streamExporter.exportSheet() == nullptr);
+    EXPECT_FALSE(base::is_file(textureFn + ".tmp"));
+
+    DocumentPtr loaded(load_document(&ctx, textureFn.c_str()));
+    ASSERT_TRUE(loaded != nullptr);
+
+    const Sprite* sprite = loaded->sprite();
+    const Image* image = sprite->folder()->getFirstLayer()
+      ->cel(frame_t(0))->image();
+    ASSERT_EQ(expectedImage->pixelFormat(), image->pixelFormat());
+    ASSERT_EQ(expectedImage->width(), image->width());
+    ASSERT_EQ(expectedImage->height(), image->height());
+
+    if (image->pixelFormat() == IMAGE_INDEXED) {
+      EXPECT_EQ(0, sprite->transparentColor());
+    }
+
+    for (int y=0; y<image->height(); ++y)
+      for (int x=0; x<image->width(); ++x)
+        ASSERT_EQ(get_pixel(expectedImage, x, y), get_pixel(image, x, y))
+          << "Pixel " << x << "," << y;
+
+    loaded->close();
+    base::delete_file(textureFn);
+    base::delete_file(dataFn);
+  }
+
+}
+
+TEST(DocumentExporter, StreamTextureInBands)
+{
+  register_formats();
+  TestContextT<app::Context> ctx;
+
+  // Samples of 5 rows in bands of 3 rows, so samples start in the
+  // middle of a band and are rendered with a negative y in the
+  // following bands.
+  DocumentPtr doc1(add_document(ctx, ColorMode::RGB, 4, 5, 1));
+  DocumentPtr doc2(add_document(ctx, ColorMode::RGB, 4, 5, 2));
+  DocumentPtr doc3(add_document(ctx, ColorMode::RGB, 4, 5, 3));
+  expect_same_texture(ctx, { doc1.get(), doc2.get(), doc3.get() });
+
+  doc1->close();
+  doc2->close();
+  doc3->close();
+}
+
+TEST(DocumentExporter, StreamIndexedTexture)
+{
+  register_formats();
+  TestContextT<app::Context> ctx;
+
+  // Index 0 is the transparent color of the texture
+  DocumentPtr doc1(add_document(ctx, ColorMode::INDEXED, 4, 5, 1));
+  DocumentPtr doc2(add_document(ctx, ColorMode::INDEXED, 4, 5, 2));
+  expect_same_texture(ctx, { doc1.get(), doc2.get() });
+
+  doc1->close();
+  doc2->close();
+}
@@ -88,7 +88,7 @@ static DocumentRange drop_range_op(
     const app::Context* context = static_cast<app::Context*>(doc->context());
     const ContextReader reader(context);
     ContextWriter writer(reader, 500);
-    Transaction transaction(writer.context(), undoLabel, ModifyDocument);
+    Transaction transaction(writer.context(), undoLabel, ModifyDocument, NotifyOnCommit);
     DocumentApi api = doc->getApi(transaction);
 
     // TODO Try to add the range with just one call to DocumentApi
@@ -347,7 +347,7 @@ void reverse_frames(Document* doc, const DocumentRange& range)
   const app::Context* context = static_cast<app::Context*>(doc->context());
   const ContextReader reader(context);
   ContextWriter writer(reader, 500);
-  Transaction transaction(writer.context(), "Reverse Frames");
+  Transaction transaction(writer.context(), "Reverse Frames", ModifyDocument, NotifyOnCommit);
   DocumentApi api = doc->getApi(transaction);
   Sprite* sprite = doc->sprite();
   frame_t frameBegin, frameEnd;
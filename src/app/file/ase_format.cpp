@@ -116,7 +116,7 @@ static void ase_file_write_color2_chunk(FILE* f, ASE_FrameHeader* frame_header,
 static void ase_file_write_palette_chunk(FILE* f, ASE_FrameHeader* frame_header, const Palette* pal, int from, int to);
 static Layer* ase_file_read_layer_chunk(FILE* f, ASE_Header* header, Sprite* sprite, Layer** previous_layer, int* current_level);
 static void ase_file_write_layer_chunk(FILE* f, ASE_FrameHeader* frame_header, const Layer* layer);
-static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame, PixelFormat pixelFormat, FileOp* fop, ASE_Header* header, size_t chunk_end);
+static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame, PixelFormat pixelFormat, FileOp* fop, ASE_Header* header, size_t chunk_end, int step);
 static void ase_file_write_cel_chunk(FILE* f, ASE_FrameHeader* frame_header, const Cel* cel, const LayerImage* layer, const Sprite* sprite);
 static Mask* ase_file_read_mask_chunk(FILE* f);
 #if 0
@@ -186,10 +186,16 @@ bool AseFormat::onLoad(FileOp* fop)
     return false;
   }
 
+  // Load a reduced sprite keeping one of each 'step' pixels (e.g. for
+  // thumbnails), cels are reduced as they are decompressed.
+  const int step = fop->reductionFactor(header.width, header.height);
+
   // Create the new sprite
   std::unique_ptr<Sprite> sprite(new Sprite(header.depth == 32 ? IMAGE_RGB:
       header.depth == 16 ? IMAGE_GRAYSCALE: IMAGE_INDEXED,
-      header.width, header.height, header.ncolors));
+      (header.width + step - 1) / step,
+      (header.height + step - 1) / step,
+      header.ncolors));
 
   // Set frames and speed
   sprite->setTotalFrames(frame_t(header.frames));
@@ -267,7 +273,7 @@ bool AseFormat::onLoad(FileOp* fop)
             Cel* cel =
               ase_file_read_cel_chunk(f, sprite.get(), frame,
                                       sprite->pixelFormat(), fop, &header,
-                                      chunk_pos+chunk_size);
+                                      chunk_pos+chunk_size, step);
             if (cel) {
               last_object_with_user_data = cel->data();
             }
@@ -985,15 +991,20 @@ public:
 // Raw Image
 //////////////////////////////////////////////////////////////////////
 
+// Reads a w*h image keeping one of each 'step' rows and columns in
+// 'image' (which is the reduced image when step > 1).
 template<typename ImageTraits>
-static void read_raw_image(FILE* f, Image* image, FileOp* fop, ASE_Header* header)
+static void read_raw_image(FILE* f, Image* image, int w, int h, int step, FileOp* fop, ASE_Header* header)
 {
   PixelIO<ImageTraits> pixel_io;
   int x, y;
 
-  for (y=0; y<image->height(); y++) {
-    for (x=0; x<image->width(); x++)
-      put_pixel_fast<ImageTraits>(image, x, y, pixel_io.read_pixel(f));
+  for (y=0; y<h; y++) {
+    for (x=0; x<w; x++) {
+      typename ImageTraits::pixel_t c = pixel_io.read_pixel(f);
+      if ((x % step) == 0 && (y % step) == 0)
+        put_pixel_fast<ImageTraits>(image, x / step, y / step, c);
+    }
 
     fop->setProgress((float)ftell(f) / (float)header->size);
   }
@@ -1014,8 +1025,10 @@ static void write_raw_image(FILE* f, const Image* image)
 // Compressed Image
 //////////////////////////////////////////////////////////////////////
 
+// Inflates a w*h image row by row keeping one of each 'step' rows
+// and columns in 'image' (which is the reduced image when step > 1).
 template<typename ImageTraits>
-static void read_compressed_image(FILE* f, Image* image, size_t chunk_end, FileOp* fop, ASE_Header* header)
+static void read_compressed_image(FILE* f, Image* image, int w, int h, int step, size_t chunk_end, FileOp* fop, ASE_Header* header)
 {
   PixelIO<ImageTraits> pixel_io;
   z_stream zstream;
@@ -1029,10 +1042,12 @@ static void read_compressed_image(FILE* f, Image* image, size_t chunk_end, FileO
   if (err != Z_OK)
     throw base::Exception("ZLib error %d in inflateInit().", err);
 
-  std::vector<uint8_t> scanline(ImageTraits::getRowStrideBytes(image->width()));
-  std::vector<uint8_t> uncompressed(static_cast<long>(image->height()) * ImageTraits::getRowStrideBytes(image->width()));
+  std::vector<uint8_t> scanline(ImageTraits::getRowStrideBytes(w));
   std::vector<uint8_t> compressed(4096);
-  int uncompressed_offset = 0;
+
+  zstream.next_out = (Bytef*)&scanline[0];
+  zstream.avail_out = scanline.size();
+  y = 0;
 
   while (true) {
     size_t input_bytes;
@@ -1051,38 +1066,43 @@ static void read_compressed_image(FILE* f, Image* image, size_t chunk_end, FileO
     zstream.next_in = (Bytef*)&compressed[0];
     zstream.avail_in = bytes_read;
 
-    do {
-      zstream.next_out = (Bytef*)&scanline[0];
-      zstream.avail_out = scanline.size();
-
+    while (true) {
       err = inflate(&zstream, Z_NO_FLUSH);
       if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
         throw base::Exception("ZLib error %d in inflate().", err);
 
-      size_t uncompressed_bytes = scanline.size() - zstream.avail_out;
-      if (uncompressed_bytes > 0) {
-        if (uncompressed_offset+uncompressed_bytes > uncompressed.size())
-          throw base::Exception("Bad compressed image.");
+      // We need more input to complete the scanline
+      if (zstream.avail_out > 0)
+        break;
+
+      if (y >= h)
+        throw base::Exception("Bad compressed image.");
 
-        std::copy(scanline.begin(), scanline.begin()+uncompressed_bytes,
-                  uncompressed.begin()+uncompressed_offset);
+      if ((y % step) == 0) {
+        typename ImageTraits::address_t address =
+          (typename ImageTraits::address_t)image->getPixelAddress(0, y / step);
 
-        uncompressed_offset += uncompressed_bytes;
+        if (step == 1)
+          pixel_io.read_scanline(address, w, &scanline[0]);
+        else {
+          for (int x=0; x<image->width(); ++x)
+            pixel_io.read_scanline(address+x, 1,
+                                   &scanline[x * step * ImageTraits::bytes_per_pixel]);
+        }
       }
-    } while (zstream.avail_out == 0);
+      ++y;
+
+      zstream.next_out = (Bytef*)&scanline[0];
+      zstream.avail_out = scanline.size();
+    }
 
     fop->setProgress((float)ftell(f) / (float)header->size);
   }
 
-  uncompressed_offset = 0;
-  for (y=0; y<image->height(); y++) {
-    typename ImageTraits::address_t address =
-      (typename ImageTraits::address_t)image->getPixelAddress(0, y);
-
-    pixel_io.read_scanline(address, image->width(), &uncompressed[uncompressed_offset]);
-
-    uncompressed_offset += ImageTraits::getRowStrideBytes(image->width());
-  }
+  // Clear the rows that weren't in the compressed data
+  for (int v=(y + step - 1) / step; v<image->height(); ++v)
+    std::fill(image->getPixelAddress(0, v),
+              image->getPixelAddress(0, v) + image->getRowStrideSize(), 0);
 
   err = inflateEnd(&zstream);
   if (err != Z_OK)
@@ -1145,12 +1165,20 @@ static void write_compressed_image(FILE* f, const Image* image)
 
 static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
                                     PixelFormat pixelFormat,
-                                    FileOp* fop, ASE_Header* header, size_t chunk_end)
+                                    FileOp* fop, ASE_Header* header, size_t chunk_end,
+                                    int step)
 {
   /* read chunk data */
   LayerIndex layer_index = LayerIndex(fgetw(f));
   int x = ((short)fgetw(f));
   int y = ((short)fgetw(f));
+
+  // Position in the reduced sprite (rounded down)
+  if (step > 1) {
+    x = (x >= 0 ? x / step: -((-x + step - 1) / step));
+    y = (y >= 0 ? y / step: -((-y + step - 1) / step));
+  }
+
   int opacity = fgetc(f);
   int cel_type = fgetw(f);
   Layer* layer;
@@ -1180,21 +1208,22 @@ static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
       int h = fgetw(f);
 
       if (w > 0 && h > 0) {
-        std::shared_ptr<Image> image(Image::create(pixelFormat, w, h));
+        std::shared_ptr<Image> image(
+          Image::create(pixelFormat, (w + step - 1) / step, (h + step - 1) / step));
 
         // Read pixel data
         switch (image->pixelFormat()) {
 
           case IMAGE_RGB:
-            read_raw_image<RgbTraits>(f, image.get(), fop, header);
+            read_raw_image<RgbTraits>(f, image.get(), w, h, step, fop, header);
             break;
 
           case IMAGE_GRAYSCALE:
-            read_raw_image<GrayscaleTraits>(f, image.get(), fop, header);
+            read_raw_image<GrayscaleTraits>(f, image.get(), w, h, step, fop, header);
             break;
 
           case IMAGE_INDEXED:
-            read_raw_image<IndexedTraits>(f, image.get(), fop, header);
+            read_raw_image<IndexedTraits>(f, image.get(), w, h, step, fop, header);
             break;
         }
 
@@ -1238,22 +1267,23 @@ static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
       int h = fgetw(f);
 
       if (w > 0 && h > 0) {
-        std::shared_ptr<Image> image(Image::create(pixelFormat, w, h));
+        std::shared_ptr<Image> image(
+          Image::create(pixelFormat, (w + step - 1) / step, (h + step - 1) / step));
 
         // Try to read pixel data
         try {
           switch (image->pixelFormat()) {
 
             case IMAGE_RGB:
-              read_compressed_image<RgbTraits>(f, image.get(), chunk_end, fop, header);
+              read_compressed_image<RgbTraits>(f, image.get(), w, h, step, chunk_end, fop, header);
               break;
 
             case IMAGE_GRAYSCALE:
-              read_compressed_image<GrayscaleTraits>(f, image.get(), chunk_end, fop, header);
+              read_compressed_image<GrayscaleTraits>(f, image.get(), w, h, step, chunk_end, fop, header);
               break;
 
             case IMAGE_INDEXED:
-              read_compressed_image<IndexedTraits>(f, image.get(), chunk_end, fop, header);
+              read_compressed_image<IndexedTraits>(f, image.get(), w, h, step, chunk_end, fop, header);
               break;
           }
         }
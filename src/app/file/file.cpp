@@ -25,8 +25,10 @@
 #include "base/fs.h"
 #include "base/mutex.h"
 #include "base/path.h"
+#include "base/phase_timer.h"
 #include "base/scoped_lock.h"
 #include "base/string.h"
+#include "doc/algorithm/resize_image.h"
 #include "doc/doc.h"
 #include "render/quantization.h"
 #include "render/render.h"
@@ -486,6 +488,7 @@ FileOp* FileOp::createSaveDocumentOperation(const Context* context,
 // FileOp::done() function.
 void FileOp::operate(IFileOpProgress* progress)
 {
+  base::ScopedPhase phase("file op");
   ASSERT(!isDone());
 
   m_progressInterface = progress;
@@ -506,6 +509,8 @@ void FileOp::operate(IFileOpProgress* progress)
 
       // TODO set_palette for each frame???
       auto add_image = [&]() {
+        reduceSequenceImage();
+
         m_seq.last_cel->data()->setImage(m_seq.image);
         m_seq.layer->addCel(m_seq.last_cel);
 
@@ -840,6 +845,46 @@ Image* FileOp::sequenceImage(PixelFormat pixelFormat, int w, int h)
   return m_seq.image.get();
 }
 
+int FileOp::reductionFactor(int w, int h) const
+{
+  if (m_maxSize.w <= 0 || m_maxSize.h <= 0)
+    return 1;
+
+  return MAX(1, MAX(w / m_maxSize.w, h / m_maxSize.h));
+}
+
+// Formats that cannot decode a reduced image (or cannot reduce it
+// enough) load the whole image, which is scaled down here with a box
+// filter before it's added to the sprite.
+void FileOp::reduceSequenceImage()
+{
+  const int w = m_seq.image->width();
+  const int h = m_seq.image->height();
+  const int factor = reductionFactor(w, h);
+  if (factor <= 1)
+    return;
+
+  Sprite* sprite = m_document->sprite();
+  const int reducedW = MAX(1, w / factor);
+  const int reducedH = MAX(1, h / factor);
+
+  std::shared_ptr<Image> reduced(
+    Image::create(m_seq.image->pixelFormat(), reducedW, reducedH));
+  reduced->setMaskColor(m_seq.image->maskColor());
+
+  // Indexed images don't have a RgbMap yet to be filtered
+  algorithm::resize_image(
+    m_seq.image.get(), reduced.get(),
+    (m_seq.image->pixelFormat() == IMAGE_INDEXED ?
+     algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR:
+     algorithm::RESIZE_METHOD_BOX),
+    m_seq.palette, nullptr, m_seq.image->maskColor());
+
+  m_seq.image = reduced;
+  if (sprite->width() == w && sprite->height() == h)
+    sprite->setSize(reducedW, reducedH);
+}
+
 void FileOp::setError(const char *format, ...)
 {
   char buf_error[4096];
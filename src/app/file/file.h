@@ -11,6 +11,7 @@
 #include "doc/frame.h"
 #include "doc/image.h"
 #include "doc/pixel_format.h"
+#include "gfx/size.h"
 
 #include <memory>
 #include <stdio.h>
@@ -67,6 +68,18 @@ namespace app {
     bool isSequence() const { return !m_seq.filename_list.empty(); }
     bool isOneFrame() const { return m_oneframe; }
 
+    // Hint to load a reduced version of the file (e.g. to generate a
+    // thumbnail) when the image is bigger than the given size. An
+    // empty size (the default) loads the file in its original size.
+    const gfx::Size& maxSize() const { return m_maxSize; }
+    void setMaxSize(const gfx::Size& maxSize) { m_maxSize = maxSize; }
+
+    // Returns the integer factor to reduce an image of the given size
+    // to honor the maxSize() hint (1 = load the original size). The
+    // reduced image is never smaller than the image fitted in
+    // maxSize(), so it can be scaled down later with good quality.
+    int reductionFactor(int w, int h) const;
+
     const std::string& filename() const { return m_filename; }
     Context* context() const { return m_context; }
     Document* document() const { return m_document; }
@@ -135,6 +148,7 @@ namespace app {
     bool m_oneframe;            // Load just one frame (in formats
                                 // that support animation like
                                 // GIF/FLI/ASE).
+    gfx::Size m_maxSize;        // Load a reduced version of the file.
 
     // Data for sequences.
     struct {
@@ -153,6 +167,7 @@ namespace app {
     } m_seq;
 
     void prepareForSequence();
+    void reduceSequenceImage();
   };
 
   // Available extensions for each load/save operation.
@@ -16,6 +16,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
 #include <vector>
 
 using namespace app;
@@ -80,3 +81,47 @@ TEST(File, SeveralSizes)
     }
   }
 }
+
+TEST(File, ReducedSize)
+{
+  FileFormatsManager::instance()->registerAllFormats();
+  app::Context ctx;
+  const int w = 1000, h = 600;
+
+  {
+    doc::Document* doc = ctx.documents().add(w, h, doc::ColorMode::INDEXED, 256);
+    doc->setFilename("test.ase");
+
+    Image* image = doc->sprite()->folder()->getFirstLayer()->cel(frame_t(0))->image();
+    for (int y=0; y<h; y++)
+      for (int x=0; x<w; x++)
+        put_pixel_fast<IndexedTraits>(image, x, y, (x+y) & 255);
+
+    save_document(&ctx, doc);
+    doc->close();
+    delete doc;
+  }
+
+  std::unique_ptr<FileOp> fop(
+    FileOp::createLoadDocumentOperation(
+      &ctx, "test.ase", FILE_LOAD_SEQUENCE_NONE | FILE_LOAD_ONE_FRAME));
+  fop->setMaxSize(gfx::Size(100, 100));
+  EXPECT_EQ(10, fop->reductionFactor(w, h));
+
+  fop->operate();
+  fop->done();
+  fop->postLoad();
+
+  std::unique_ptr<app::Document> doc(fop->releaseDocument());
+  ASSERT_TRUE(doc != nullptr);
+  ASSERT_EQ(100, doc->sprite()->width());
+  ASSERT_EQ(60, doc->sprite()->height());
+
+  // One of each 10 pixels is kept
+  Image* image = doc->sprite()->folder()->getFirstLayer()->cel(frame_t(0))->image();
+  for (int y=0; y<60; y++)
+    for (int x=0; x<100; x++)
+      ASSERT_EQ((x*10+y*10) & 255, get_pixel_fast<IndexedTraits>(image, x, y));
+
+  doc->close();
+}
@@ -22,7 +22,9 @@
 #include "app/util/autocrop.h"
 #include "base/file_handle.h"
 #include "base/fs.h"
+#include "base/parallel_for.h"
 #include "doc/doc.h"
+#include "render/ordered_dither.h"
 #include "render/quantization.h"
 #include "render/render.h"
 #include "ui/alert.h"
@@ -31,7 +33,15 @@
 #include "gif_options.xml.h"
 
 #include <gif_lib.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
   #include <io.h>
@@ -154,6 +164,30 @@ static void process_disposal_method(const Image* previous,
   }
 }
 
+// Dithering methods available for GIF files (the values of the
+// dithering combobox in gif_options.xml).
+static DitheringMethod dithering_from_string(const std::string& value) {
+  if (value == "ordered") return DitheringMethod::ORDERED;
+  if (value == "floyd-steinberg") return DitheringMethod::FLOYD_STEINBERG;
+  if (value == "atkinson") return DitheringMethod::ATKINSON;
+  if (value == "sierra-lite") return DitheringMethod::SIERRA_LITE;
+  return DitheringMethod::NONE;
+}
+
+// Converts the dithering saved in the configuration file (invalid
+// values are NONE).
+static DitheringMethod dithering_from_int(int value) {
+  switch (DitheringMethod(value)) {
+    case DitheringMethod::ORDERED:
+    case DitheringMethod::FLOYD_STEINBERG:
+    case DitheringMethod::ATKINSON:
+    case DitheringMethod::SIERRA_LITE:
+      return DitheringMethod(value);
+    default:
+      return DitheringMethod::NONE;
+  }
+}
+
 static inline doc::color_t colormap2rgba(ColorMapObject* colormap, int i) {
   return doc::rgba(
     colormap->Colors[i].Red,
@@ -161,6 +195,75 @@ static inline doc::color_t colormap2rgba(ColorMapObject* colormap, int i) {
     colormap->Colors[i].Blue, 255);
 }
 
+// A frame read from the GIF file that wasn't composited yet: the
+// indexed pixels of the frame rectangle and the values of its
+// graphics control extension.
+struct GifFrame {
+  gfx::Rect bounds;
+  std::unique_ptr<Image> image;
+  std::shared_ptr<ColorMapObject> colormap; // Copy of the local colormap (or nullptr)
+  DisposalMethod disposalMethod = DisposalMethod::NONE;
+  int transparentIndex = -1;
+  int delay = 1;
+};
+
+// Frames decoded by the reader waiting to be composited. The queue
+// is bounded so a reader faster than the compositor doesn't keep the
+// whole file decoded in memory.
+class GifFrameQueue {
+public:
+  GifFrameQueue(std::size_t capacity)
+    : m_capacity(capacity)
+    , m_closed(false) {
+  }
+
+  // Returns false if the queue was closed (e.g. the compositor
+  // failed), so the frame will not be processed.
+  bool push(std::unique_ptr<GifFrame>&& frame) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notFull.wait(lock, [this]{
+        return m_closed || m_frames.size() < m_capacity;
+      });
+    if (m_closed)
+      return false;
+
+    m_frames.push_back(std::move(frame));
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  // Returns nullptr when the queue is closed and there are no more
+  // frames.
+  std::unique_ptr<GifFrame> pop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notEmpty.wait(lock, [this]{
+        return m_closed || !m_frames.empty();
+      });
+    if (m_frames.empty())
+      return nullptr;
+
+    std::unique_ptr<GifFrame> frame(std::move(m_frames.front()));
+    m_frames.pop_front();
+    m_notFull.notify_one();
+    return frame;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+  }
+
+private:
+  std::size_t m_capacity;
+  bool m_closed;
+  std::deque<std::unique_ptr<GifFrame>> m_frames;
+  std::mutex m_mutex;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+};
+
 // Decodes a GIF file trying to keep the image in Indexed format. If
 // it's not possible to handle it as Indexed (e.g. it contains more
 // than 256 colors), the file will be automatically converted to RGB.
@@ -170,21 +273,30 @@ static inline doc::color_t colormap2rgba(ColorMapObject* colormap, int i) {
 // and combinations of local colormaps can output any number of
 // colors, not just 256. So previous RGB colors must be kept and
 // merged with new colormaps.
+//
+// The decoding is a pipeline: the calling thread reads the records
+// and decompresses (LZW) the frame rectangles, while a compositor
+// thread builds the sprite (palettes, composition, disposal and
+// cels) in the same order the frames were read. Passes over all
+// cels (e.g. the conversion to RGB) process cels in parallel.
 class GifDecoder {
+  // Maximum number of decoded frames waiting for the compositor
+  static const int kMaxQueuedFrames = 16;
+
 public:
   GifDecoder(FileOp* fop, GifFileType* gifFile, int fd, int filesize)
     : m_fop(fop)
     , m_gifFile(gifFile)
     , m_fd(fd)
     , m_filesize(filesize)
+    , m_readFrames(0)
     , m_sprite(nullptr)
     , m_spriteBounds(0, 0, m_gifFile->SWidth, m_gifFile->SHeight)
     , m_frameNum(0)
     , m_opaque(false)
-    , m_disposalMethod(DisposalMethod::NONE)
     , m_bgIndex(m_gifFile->SBackGroundColor >= 0 ? m_gifFile->SBackGroundColor: 0)
     , m_localTransparentIndex(-1)
-    , m_frameDelay(1)
+    , m_localColormap(nullptr)
     , m_remap(256)
     , m_hasLocalColormaps(false)
     , m_firstLocalColormap(nullptr) {
@@ -204,24 +316,35 @@ public:
   }
 
   bool decode() {
-    GifRecordType recType;
-
-    // Read record by record
-    while ((recType = readRecordType()) != TERMINATE_RECORD_TYPE) {
-      readRecord(recType);
-
-      // Just one frame?
-      if (m_fop->isOneFrame() && m_frameNum > 0)
-        break;
-
-      if (m_fop->isStop())
-        break;
+    GifFrameQueue queue(kMaxQueuedFrames);
+    std::exception_ptr compositorError;
+
+    std::thread compositor(
+      [this, &queue, &compositorError]{
+        try {
+          while (std::unique_ptr<GifFrame> frame = queue.pop())
+            compositeFrame(*frame);
+        }
+        catch (...) {
+          compositorError = std::current_exception();
+        }
+        // Stop the reader in case of error
+        queue.close();
+      });
 
-      if (m_filesize > 0) {
-        int pos = posix_lseek(m_fd, 0, SEEK_CUR);
-        m_fop->setProgress(double(pos) / double(m_filesize));
-      }
+    try {
+      readFrames(queue);
     }
+    catch (...) {
+      queue.close();
+      compositor.join();
+      throw;
+    }
+    queue.close();
+    compositor.join();
+
+    if (compositorError)
+      std::rethrow_exception(compositorError);
 
     if (m_sprite) {
       // Add entries to include the transparent color
@@ -262,28 +385,48 @@ public:
 
 private:
 
-  GifRecordType readRecordType() {
-    GifRecordType type;
-    if (DGifGetRecordType(m_gifFile, &type) == GIF_ERROR)
-      throw Exception("Invalid GIF record in file.\n");
+  // Reads record by record pushing the frames in the queue
+  void readFrames(GifFrameQueue& queue) {
+    GifRecordType recType;
 
-    return type;
-  }
+    while ((recType = readRecordType()) != TERMINATE_RECORD_TYPE) {
+      switch (recType) {
 
-  void readRecord(GifRecordType recordType) {
-    switch (recordType) {
+        case IMAGE_DESC_RECORD_TYPE:
+          if (!queue.push(readImageDescRecord()))
+            return;
+          break;
 
-      case IMAGE_DESC_RECORD_TYPE:
-        readImageDescRecord();
+        case EXTENSION_RECORD_TYPE:
+          readExtensionRecord();
+          break;
+      }
+
+      // Just one frame?
+      if (m_fop->isOneFrame() && m_readFrames > 0)
         break;
 
-      case EXTENSION_RECORD_TYPE:
-        readExtensionRecord();
+      if (m_fop->isStop())
         break;
+
+      if (m_filesize > 0) {
+        int pos = posix_lseek(m_fd, 0, SEEK_CUR);
+        m_fop->setProgress(double(pos) / double(m_filesize));
+      }
     }
   }
 
-  void readImageDescRecord() {
+  GifRecordType readRecordType() {
+    GifRecordType type;
+    if (DGifGetRecordType(m_gifFile, &type) == GIF_ERROR)
+      throw Exception("Invalid GIF record in file.\n");
+
+    return type;
+  }
+
+  // Reads the pixels of the next frame, the frame keeps a copy of
+  // the local colormap because giflib reuses it for the next image.
+  std::unique_ptr<GifFrame> readImageDescRecord() {
     if (DGifGetImageDesc(m_gifFile) == GIF_ERROR)
       throw Exception("Invalid GIF image descriptor.\n");
 
@@ -295,7 +438,32 @@ private:
       m_gifFile->Image.Height);
 
     if (!m_spriteBounds.contains(frameBounds))
-      throw Exception("Image %d is out of sprite bounds.\n", (int)m_frameNum);
+      throw Exception("Image %d is out of sprite bounds.\n", m_readFrames);
+
+    std::unique_ptr<GifFrame> frame(std::move(m_nextFrame));
+    if (!frame)
+      frame.reset(new GifFrame);
+
+    frame->bounds = frameBounds;
+    frame->image.reset(readFrameIndexedImage(frameBounds));
+
+    if (ColorMapObject* colormap = m_gifFile->Image.ColorMap) {
+      frame->colormap.reset(
+        GifMakeMapObject(colormap->ColorCount, colormap->Colors),
+        GifFreeMapObject);
+    }
+
+    ++m_readFrames;
+    return frame;
+  }
+
+  // Adds the given frame (read by readImageDescRecord()) to the sprite
+  void compositeFrame(GifFrame& frame) {
+    const gfx::Rect& frameBounds = frame.bounds;
+    const Image* frameImage = frame.image.get();
+
+    m_localTransparentIndex = frame.transparentIndex;
+    m_localColormap = frame.colormap.get();
 
     // Create sprite if this is the first frame
     if (!m_sprite)
@@ -305,10 +473,6 @@ private:
     if (m_sprite->lastFrame() < m_frameNum)
       m_sprite->addFrame(m_frameNum);
 
-    // Create a temporary image loading the frame pixels from the GIF file
-    std::unique_ptr<Image> frameImage(
-      readFrameIndexedImage(frameBounds));
-
     TRACE("[GifDecoder] Frame[%d] transparent index = %d\n", (int)m_frameNum, m_localTransparentIndex);
 
     if (m_frameNum == 0) {
@@ -319,7 +483,7 @@ private:
     }
 
     // Merge this frame colors with the current palette
-    updatePalette(frameImage.get());
+    updatePalette(frameImage);
 
     // Convert the sprite to RGB if we have more than 256 colors
     if ((m_sprite->pixelFormat() == IMAGE_INDEXED) &&
@@ -332,10 +496,10 @@ private:
 
     // Composite frame with previous frame
     if (m_sprite->pixelFormat() == IMAGE_INDEXED) {
-      compositeIndexedImageToIndexed(frameBounds, frameImage.get());
+      compositeIndexedImageToIndexed(frameBounds, frameImage);
     }
     else {
-      compositeIndexedImageToRgb(frameBounds, frameImage.get());
+      compositeIndexedImageToRgb(frameBounds, frameImage);
     }
 
     // Create cel
@@ -344,7 +508,7 @@ private:
     // Dispose/clear frame content
     process_disposal_method(m_previousImage.get(),
                             m_currentImage.get(),
-                            m_disposalMethod,
+                            frame.disposalMethod,
                             frameBounds,
                             m_bgIndex);
 
@@ -352,13 +516,8 @@ private:
     copy_image(m_previousImage.get(), m_currentImage.get());
 
     // Set frame delay (1/100th seconds to milliseconds)
-    if (m_frameDelay >= 0)
-      m_sprite->setFrameDuration(m_frameNum, m_frameDelay*10);
-
-    // Reset extension variables
-    m_disposalMethod = DisposalMethod::NONE;
-    m_localTransparentIndex = -1;
-    m_frameDelay = 1;
+    if (frame.delay >= 0)
+      m_sprite->setFrameDuration(m_frameNum, frame.delay*10);
 
     // Next frame
     ++m_frameNum;
@@ -398,7 +557,7 @@ private:
 
   ColorMapObject* getFrameColormap() {
     ColorMapObject* global = m_gifFile->SColorMap;
-    ColorMapObject* colormap = m_gifFile->Image.ColorMap;
+    ColorMapObject* colormap = m_localColormap;
 
     if (!colormap) {
       // Doesn't have local map, use the global one
@@ -441,7 +600,7 @@ private:
   void updatePalette(const Image* frameImage) {
     ColorMapObject* colormap = getFrameColormap();
     int ncolors = colormap->ColorCount;
-    bool isLocalColormap = (m_gifFile->Image.ColorMap ? true: false);
+    bool isLocalColormap = (m_localColormap ? true: false);
 
     TRACE("[GifDecoder] Local colormap=%d, ncolors=%d\n", isLocalColormap, ncolors);
 
@@ -578,15 +737,14 @@ private:
                                       const Image* frameImage) {
     // Compose the frame image with the previous frame
     for (int y=0; y<frameBounds.h; ++y) {
-      for (int x=0; x<frameBounds.w; ++x) {
-        color_t i = get_pixel_fast<IndexedTraits>(frameImage, x, y);
-        if (static_cast<int>(i) == m_localTransparentIndex)
-          continue;
-
-        i = m_remap[i];
-        put_pixel_fast<IndexedTraits>(m_currentImage.get(),
-                                      frameBounds.x + x,
-                                      frameBounds.y + y, i);
+      const uint8_t* src = frameImage->getPixelAddress(0, y);
+      uint8_t* dst = m_currentImage->getPixelAddress(frameBounds.x,
+                                                     frameBounds.y + y);
+
+      for (int x=0; x<frameBounds.w; ++x, ++src, ++dst) {
+        const int i = *src;
+        if (i != m_localTransparentIndex)
+          *dst = m_remap[i];
       }
     }
   }
@@ -595,21 +753,20 @@ private:
                                   const Image* frameImage) {
     ColorMapObject* colormap = getFrameColormap();
 
+    color_t colors[256];
+    for (int i=0; i<256; ++i)
+      colors[i] = (i < colormap->ColorCount ? colormap2rgba(colormap, i): 0);
+
     // Compose the frame image with the previous frame
     for (int y=0; y<frameBounds.h; ++y) {
-      for (int x=0; x<frameBounds.w; ++x) {
-        color_t i = get_pixel_fast<IndexedTraits>(frameImage, x, y);
-        if (static_cast<int>(i) == m_localTransparentIndex)
-          continue;
-
-        i = rgba(
-          colormap->Colors[i].Red,
-          colormap->Colors[i].Green,
-          colormap->Colors[i].Blue, 255);
-
-        put_pixel_fast<RgbTraits>(m_currentImage.get(),
-                                  frameBounds.x + x,
-                                  frameBounds.y + y, i);
+      const uint8_t* src = frameImage->getPixelAddress(0, y);
+      RgbTraits::address_t dst = (RgbTraits::address_t)
+        m_currentImage->getPixelAddress(frameBounds.x, frameBounds.y + y);
+
+      for (int x=0; x<frameBounds.w; ++x, ++src, ++dst) {
+        const int i = *src;
+        if (i != m_localTransparentIndex)
+          *dst = colors[i];
       }
     }
   }
@@ -640,12 +797,18 @@ private:
 
     if (extCode == GRAPHICS_EXT_FUNC_CODE) {
       if (extension[0] >= 4) {
-        m_disposalMethod        = (DisposalMethod)((extension[1] >> 2) & 7);
-        m_localTransparentIndex = (extension[1] & 1) ? extension[4]: -1;
-        m_frameDelay            = (extension[3] << 8) | extension[2];
+        // The extension is applied to the next image
+        if (!m_nextFrame)
+          m_nextFrame.reset(new GifFrame);
+
+        m_nextFrame->disposalMethod   = (DisposalMethod)((extension[1] >> 2) & 7);
+        m_nextFrame->transparentIndex = (extension[1] & 1) ? extension[4]: -1;
+        m_nextFrame->delay            = (extension[3] << 8) | extension[2];
 
         TRACE("[GifDecoder] Disposal method: %d\n  Transparent index: %d\n  Frame delay: %d\n",
-              m_disposalMethod, m_localTransparentIndex, m_frameDelay);
+              m_nextFrame->disposalMethod,
+              m_nextFrame->transparentIndex,
+              m_nextFrame->delay);
       }
     }
 
@@ -660,8 +823,8 @@ private:
     if (m_gifFile->SColorMap) {
       colormap = m_gifFile->SColorMap;
     }
-    else if (m_gifFile->Image.ColorMap) {
-      colormap = m_gifFile->Image.ColorMap;
+    else if (m_localColormap) {
+      colormap = m_localColormap;
     }
     int ncolors = (colormap ? colormap->ColorCount: 1);
     int w = m_spriteBounds.w;
@@ -688,21 +851,32 @@ private:
   }
 
   // Converts the whole sprite read so far because it contains more
-  // than 256 colors at the same time.
+  // than 256 colors at the same time. Cels are converted in
+  // parallel, and replaced in the sprite from this thread.
   void convertIndexedSpriteToRgb() {
+    CelList cels;
+    std::vector<const Palette*> palettes;
     for (Cel* cel : m_sprite->uniqueCels()) {
-      Image* oldImage = cel->image();
-      std::shared_ptr<Image> newImage(
-        render::convert_pixel_format
-        (oldImage, NULL, IMAGE_RGB, DitheringMethod::NONE,
-         nullptr,
-         m_sprite->palette(cel->frame()),
-         m_opaque,
-         m_bgIndex));
-
-      m_sprite->replaceImage(oldImage->id(), newImage);
+      cels.push_back(cel);
+      palettes.push_back(m_sprite->palette(cel->frame()));
     }
 
+    std::vector<std::shared_ptr<Image>> newImages(cels.size());
+    base::parallel_for(
+      int(cels.size()),
+      [&](int i){
+        newImages[i].reset(
+          render::convert_pixel_format
+          (cels[i]->image(), NULL, IMAGE_RGB, DitheringMethod::NONE,
+           nullptr,
+           palettes[i],
+           m_opaque,
+           m_bgIndex));
+      });
+
+    for (std::size_t i=0; i<cels.size(); ++i)
+      m_sprite->replaceImage(cels[i]->image()->id(), newImages[i]);
+
     m_currentImage.reset(
       render::convert_pixel_format
       (m_currentImage.get(), NULL, IMAGE_RGB, DitheringMethod::NONE,
@@ -736,8 +910,15 @@ private:
                  // sprite isn't opaque, because we
                  // cannot write the header again
 
+    CelList cels;
     for (Cel* cel : m_sprite->uniqueCels())
-      doc::remap_image(cel->image(), remap);
+      cels.push_back(cel);
+
+    base::parallel_for(
+      int(cels.size()),
+      [&](int i){
+        doc::remap_image(cels[i]->image(), remap);
+      });
 
     m_sprite->setPalette(&newPalette, false);
   }
@@ -760,15 +941,20 @@ private:
   GifFileType* m_gifFile;
   int m_fd;
   int m_filesize;
+
+  // Reader thread
+  int m_readFrames;
+  std::unique_ptr<GifFrame> m_nextFrame; // Frame with the last graphics control extension
+
+  // Compositor thread
   std::unique_ptr<Sprite> m_sprite;
   gfx::Rect m_spriteBounds;
   LayerImage* m_layer;
   int m_frameNum;
   bool m_opaque;
-  DisposalMethod m_disposalMethod;
   int m_bgIndex;
   int m_localTransparentIndex;
-  int m_frameDelay;
+  ColorMapObject* m_localColormap;
   std::shared_ptr<Image> m_currentImage;
   std::shared_ptr<Image> m_previousImage;
   Remap m_remap;
@@ -870,6 +1056,7 @@ public:
     auto gifOptions = std::static_pointer_cast<GifOptions>(fop->sequenceGetFormatOptions());
     m_interlaced = gifOptions->interlaced();
     m_loop = (gifOptions->loop() ? 0: -1);
+    m_dithering = gifOptions->dithering();
 
     for (int i=0; i<3; ++i)
       m_images[i].reset(Image::create(IMAGE_RGB,
@@ -1092,6 +1279,38 @@ private:
       usedColors[i] = true;
     }
 
+    // Dither the whole frame to the optimized palette, pixels that
+    // are exactly in the palette are still stored with their index.
+    std::unique_ptr<Image> ditheredImage;
+    if (m_quantizeColormaps &&
+        m_dithering != DitheringMethod::NONE) {
+      std::unique_ptr<Image> frameRgbImage(
+        crop_image(m_currentImage, frameBounds, 0));
+      const color_t maskIndex =
+        (m_transparentIndex >= 0 ? m_transparentIndex: m_bgIndex);
+
+      if (m_dithering == DitheringMethod::ORDERED) {
+        // The matrix is aligned with the sprite origin (and not with
+        // the frame bounds), so the pattern doesn't move between
+        // frames with different bounds.
+        ditheredImage.reset(
+          Image::create(IMAGE_INDEXED, frameBounds.w, frameBounds.h));
+        ditheredImage->setMaskColor(maskIndex);
+
+        render::BayerMatrix<8> matrix;
+        render::OrderedDither dither;
+        dither.ditherRgbImageToIndexed(
+          matrix, frameRgbImage.get(), ditheredImage.get(),
+          frameBounds.x, frameBounds.y, rgbmap, framePalette);
+      }
+      else {
+        ditheredImage.reset(
+          render::convert_pixel_format(
+            frameRgbImage.get(), nullptr, IMAGE_INDEXED, m_dithering,
+            rgbmap, framePalette, m_hasBackground, maskIndex));
+      }
+    }
+
     {
       LockImageBits<RgbTraits> bits(m_currentImage, frameBounds);
       auto it = bits.begin();
@@ -1109,11 +1328,15 @@ private:
               rgba_getb(color),
               255,
               m_transparentIndex);
-            if (i < 0)
-              i = rgbmap->mapColor(rgba_getr(color),
-                                   rgba_getg(color),
-                                   rgba_getb(color),
-                                   255);
+            if (i < 0) {
+              if (ditheredImage)
+                i = get_pixel_fast<IndexedTraits>(ditheredImage.get(), x, y);
+              else
+                i = rgbmap->mapColor(rgba_getr(color),
+                                     rgba_getg(color),
+                                     rgba_getb(color),
+                                     255);
+            }
           }
           else {
             ASSERT(m_transparentIndex >= 0);
@@ -1267,6 +1490,7 @@ private:
   int m_bitsPerPixel;
   ColorMapObject* m_globalColormap;
   bool m_quantizeColormaps;
+  DitheringMethod m_dithering;
   bool m_interlaced;
   int m_loop;
   ImageBufferPtr m_frameImageBuf;
@@ -1312,21 +1536,34 @@ std::shared_ptr<FormatOptions> GifFormat::onGetFormatOptions(FileOp* fop)
     // Configuration parameters
     gif_options->setInterlaced(get_config_bool("GIF", "Interlaced", gif_options->interlaced()));
     gif_options->setLoop(get_config_bool("GIF", "Loop", gif_options->loop()));
+    gif_options->setDithering(
+      dithering_from_int(
+        get_config_int("GIF", "Dithering", (int)gif_options->dithering())));
 
     // Load the window to ask to the user the GIF options he wants.
 
     app::gen::GifOptions win;
     win.interlaced()->setSelected(gif_options->interlaced());
     win.loop()->setSelected(gif_options->loop());
+    for (int i=0; i<win.dithering()->getItemCount(); ++i) {
+      if (dithering_from_string(win.dithering()->getItem(i)->getValue())
+          == gif_options->dithering()) {
+        win.dithering()->setSelectedItemIndex(i);
+        break;
+      }
+    }
 
     win.openWindowInForeground();
 
     if (win.closer() == win.ok()) {
       gif_options->setInterlaced(win.interlaced()->isSelected());
       gif_options->setLoop(win.loop()->isSelected());
+      gif_options->setDithering(
+        dithering_from_string(win.dithering()->getValue()));
 
       set_config_bool("GIF", "Interlaced", gif_options->interlaced());
       set_config_bool("GIF", "Loop", gif_options->loop());
+      set_config_int("GIF", "Dithering", (int)gif_options->dithering());
     } else {
       gif_options.reset();
     }
@@ -131,6 +131,14 @@ bool JpegFormat::onLoad(FileOp* fop)
   else
     cinfo.out_color_space = JCS_RGB;
 
+  // Use the DCT scaling of libjpeg to decode a reduced image (1/2,
+  // 1/4 or 1/8) when the FileOp asks for it.
+  const int factor = fop->reductionFactor(cinfo.image_width, cinfo.image_height);
+  if (factor > 1) {
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = (factor >= 8 ? 8: factor >= 4 ? 4: 2);
+  }
+
   // Start decompressor.
   jpeg_start_decompress(&cinfo);
 
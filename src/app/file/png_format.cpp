@@ -14,12 +14,17 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/file/png_stream_writer.h"
 #include "app/ini_file.h"
+#include "base/exception.h"
 #include "base/file_handle.h"
+#include "base/fs.h"
 #include "doc/doc.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #include "png.h"
 
@@ -176,6 +181,20 @@ bool PngFormat::onLoad(FileOp* fop)
 
   int imageWidth = png_get_image_width(png_ptr, info_ptr);
   int imageHeight = png_get_image_height(png_ptr, info_ptr);
+
+  // To load a reduced image we keep one of each 'step' rows and
+  // columns. Interlaced files can be reduced 1/8 reading just the
+  // first Adam7 pass (which contains those pixels).
+  int step = fop->reductionFactor(imageWidth, imageHeight);
+  if (number_passes > 1 && step >= 8) {
+    step = 8;
+    number_passes = 1;
+  }
+  if (step > 1) {
+    imageWidth = (imageWidth + step - 1) / step;
+    imageHeight = (imageHeight + step - 1) / step;
+  }
+
   Image* image = fop->sequenceImage(pixelFormat, imageWidth, imageHeight);
   if (!image) {
     fop->setError("file_sequence_image %dx%d\n", imageWidth, imageHeight);
@@ -224,14 +243,19 @@ bool PngFormat::onLoad(FileOp* fop)
     png_get_tRNS(png_ptr, info_ptr, nullptr, nullptr, &png_trans_color);
   }
 
-  // Allocate the memory to hold the image using the fields of info_ptr.
-  rows_pointer = (png_bytepp)png_malloc(png_ptr, sizeof(png_bytep) * height);
-  for (y = 0; y < height; y++)
+  // Allocate the memory to hold the image using the fields of
+  // info_ptr. Only the rows of the output image are kept, the others
+  // are read in a temporary row.
+  rows_pointer = (png_bytepp)png_malloc(png_ptr, sizeof(png_bytep) * imageHeight);
+  for (y = 0; y < png_uint_32(imageHeight); y++)
     rows_pointer[y] = (png_bytep)png_malloc(png_ptr, png_get_rowbytes(png_ptr, info_ptr));
 
+  std::vector<png_byte> skippedRow(step > 1 ? png_get_rowbytes(png_ptr, info_ptr): 0);
+
   for (pass = 0; pass < number_passes; pass++) {
     for (y = 0; y < height; y++) {
-      png_read_rows(png_ptr, rows_pointer+y, nullptr, 1);
+      png_bytep row = ((y % step) == 0 ? rows_pointer[y / step]: &skippedRow[0]);
+      png_read_rows(png_ptr, &row, nullptr, 1);
 
       fop->setProgress(
         (double)((double)pass + (double)(y+1) / (double)(height))
@@ -243,18 +267,19 @@ bool PngFormat::onLoad(FileOp* fop)
   }
 
   // Convert rows_pointer into the doc::Image
-  for (y = 0; y < height; y++) {
+  width = imageWidth;
+  for (y = 0; y < png_uint_32(imageHeight); y++) {
     // RGB_ALPHA
     if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_RGB_ALPHA) {
       uint8_t* src_address = rows_pointer[y];
       uint32_t* dst_address = (uint32_t*)image->getPixelAddress(0, y);
       unsigned int x, r, g, b, a;
 
-      for (x=0; x<width; x++) {
-        r = *(src_address++);
-        g = *(src_address++);
-        b = *(src_address++);
-        a = *(src_address++);
+      for (x=0; x<width; x++, src_address += 4*step) {
+        r = src_address[0];
+        g = src_address[1];
+        b = src_address[2];
+        a = src_address[3];
         *(dst_address++) = rgba(r, g, b, a);
       }
     }
@@ -264,10 +289,10 @@ bool PngFormat::onLoad(FileOp* fop)
       uint32_t* dst_address = (uint32_t*)image->getPixelAddress(0, y);
       unsigned int x, r, g, b, a;
 
-      for (x=0; x<width; x++) {
-        r = *(src_address++);
-        g = *(src_address++);
-        b = *(src_address++);
+      for (x=0; x<width; x++, src_address += 3*step) {
+        r = src_address[0];
+        g = src_address[1];
+        b = src_address[2];
 
         // Transparent color
         if (png_trans_color &&
@@ -290,9 +315,9 @@ bool PngFormat::onLoad(FileOp* fop)
       uint16_t* dst_address = (uint16_t*)image->getPixelAddress(0, y);
       unsigned int x, k, a;
 
-      for (x=0; x<width; x++) {
-        k = *(src_address++);
-        a = *(src_address++);
+      for (x=0; x<width; x++, src_address += 2*step) {
+        k = src_address[0];
+        a = src_address[1];
         *(dst_address++) = graya(k, a);
       }
     }
@@ -302,8 +327,8 @@ bool PngFormat::onLoad(FileOp* fop)
       uint16_t* dst_address = (uint16_t*)image->getPixelAddress(0, y);
       unsigned int x, k, a;
 
-      for (x=0; x<width; x++) {
-        k = *(src_address++);
+      for (x=0; x<width; x++, src_address += step) {
+        k = *src_address;
 
         // Transparent color
         if (png_trans_color &&
@@ -324,8 +349,8 @@ bool PngFormat::onLoad(FileOp* fop)
       uint8_t* dst_address = (uint8_t*)image->getPixelAddress(0, y);
       unsigned int x;
 
-      for (x=0; x<width; x++)
-        *(dst_address++) = *(src_address++);
+      for (x=0; x<width; x++, src_address += step)
+        *(dst_address++) = *src_address;
     }
     png_free(png_ptr, rows_pointer[y]);
   }
@@ -336,6 +361,65 @@ bool PngFormat::onLoad(FileOp* fop)
   return true;
 }
 
+// Converts the row "y" of the image to the pixels of a PNG row of the
+// given color type.
+static void image_row_to_png(int color_type, const Image* image, int y,
+                             png_bytep dst_address)
+{
+  const int width = image->width();
+
+  switch (color_type) {
+
+    case PNG_COLOR_TYPE_RGB_ALPHA: {
+      const uint32_t* src_address = (const uint32_t*)image->getPixelAddress(0, y);
+      for (int x=0; x<width; x++) {
+        uint32_t c = *(src_address++);
+        *(dst_address++) = rgba_getr(c);
+        *(dst_address++) = rgba_getg(c);
+        *(dst_address++) = rgba_getb(c);
+        *(dst_address++) = rgba_geta(c);
+      }
+      break;
+    }
+
+    case PNG_COLOR_TYPE_RGB: {
+      const uint32_t* src_address = (const uint32_t*)image->getPixelAddress(0, y);
+      for (int x=0; x<width; x++) {
+        uint32_t c = *(src_address++);
+        *(dst_address++) = rgba_getr(c);
+        *(dst_address++) = rgba_getg(c);
+        *(dst_address++) = rgba_getb(c);
+      }
+      break;
+    }
+
+    case PNG_COLOR_TYPE_GRAY_ALPHA: {
+      const uint16_t* src_address = (const uint16_t*)image->getPixelAddress(0, y);
+      for (int x=0; x<width; x++) {
+        uint16_t c = *(src_address++);
+        *(dst_address++) = graya_getv(c);
+        *(dst_address++) = graya_geta(c);
+      }
+      break;
+    }
+
+    case PNG_COLOR_TYPE_GRAY: {
+      const uint16_t* src_address = (const uint16_t*)image->getPixelAddress(0, y);
+      for (int x=0; x<width; x++) {
+        uint16_t c = *(src_address++);
+        *(dst_address++) = graya_getv(c);
+      }
+      break;
+    }
+
+    case PNG_COLOR_TYPE_PALETTE: {
+      const uint8_t* src_address = (const uint8_t*)image->getPixelAddress(0, y);
+      std::copy(src_address, src_address+width, dst_address);
+      break;
+    }
+  }
+}
+
 bool PngFormat::onSave(FileOp* fop)
 {
   const Image* image = fop->sequenceImage();
@@ -470,65 +554,8 @@ bool PngFormat::onSave(FileOp* fop)
   for (pass = 0; pass < number_passes; pass++) {
     /* If you are only writing one row at a time, this works */
     for (y = 0; y < height; y++) {
-      /* RGB_ALPHA */
-      if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_RGB_ALPHA) {
-        uint32_t* src_address = (uint32_t*)image->getPixelAddress(0, y);
-        uint8_t* dst_address = row_pointer;
-        unsigned int x, c;
-
-        for (x=0; x<width; x++) {
-          c = *(src_address++);
-          *(dst_address++) = rgba_getr(c);
-          *(dst_address++) = rgba_getg(c);
-          *(dst_address++) = rgba_getb(c);
-          *(dst_address++) = rgba_geta(c);
-        }
-      }
-      /* RGB */
-      else if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_RGB) {
-        uint32_t* src_address = (uint32_t*)image->getPixelAddress(0, y);
-        uint8_t* dst_address = row_pointer;
-        unsigned int x, c;
-
-        for (x=0; x<width; x++) {
-          c = *(src_address++);
-          *(dst_address++) = rgba_getr(c);
-          *(dst_address++) = rgba_getg(c);
-          *(dst_address++) = rgba_getb(c);
-        }
-      }
-      /* GRAY_ALPHA */
-      else if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_GRAY_ALPHA) {
-        uint16_t* src_address = (uint16_t*)image->getPixelAddress(0, y);
-        uint8_t* dst_address = row_pointer;
-        unsigned int x, c;
-
-        for (x=0; x<width; x++) {
-          c = *(src_address++);
-          *(dst_address++) = graya_getv(c);
-          *(dst_address++) = graya_geta(c);
-        }
-      }
-      /* GRAY */
-      else if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_GRAY) {
-        uint16_t* src_address = (uint16_t*)image->getPixelAddress(0, y);
-        uint8_t* dst_address = row_pointer;
-        unsigned int x, c;
-
-        for (x=0; x<width; x++) {
-          c = *(src_address++);
-          *(dst_address++) = graya_getv(c);
-        }
-      }
-      /* PALETTE */
-      else if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_PALETTE) {
-        uint8_t* src_address = (uint8_t*)image->getPixelAddress(0, y);
-        uint8_t* dst_address = row_pointer;
-        unsigned int x;
-
-        for (x=0; x<width; x++)
-          *(dst_address++) = *(src_address++);
-      }
+      image_row_to_png(png_get_color_type(png_ptr, info_ptr),
+                       image, y, row_pointer);
 
       /* write the line */
       png_write_rows(png_ptr, &row_pointer, 1);
@@ -561,4 +588,142 @@ bool PngFormat::onSave(FileOp* fop)
   return true;
 }
 
+//////////////////////////////////////////////////////////////////////
+// PngStreamWriter
+
+struct PngStreamWriter::Data {
+  std::string filename;
+  std::string tmpFilename;
+  FileHandle handle;
+  png_structp png_ptr = nullptr;
+  png_infop info_ptr = nullptr;
+  int color_type = 0;
+  int height = 0;
+  int y = 0;
+  std::vector<png_byte> row;
+  std::string error;
+  bool closed = false;
+
+  ~Data() {
+    if (png_ptr)
+      png_destroy_write_struct(&png_ptr, info_ptr ? &info_ptr: nullptr);
+
+    // Remove the incomplete file
+    if (!closed) {
+      handle.reset();
+      try {
+        if (is_file(tmpFilename))
+          delete_file(tmpFilename);
+      }
+      catch (...) {
+        // Ignore errors
+      }
+    }
+  }
+};
+
+static void report_png_stream_error(png_structp png_ptr, png_const_charp error)
+{
+  ((std::string*)png_get_error_ptr(png_ptr))->assign(error);
+}
+
+PngStreamWriter::PngStreamWriter(const std::string& filename,
+                                 PixelFormat pixelFormat,
+                                 int width, int height,
+                                 const Palette* palette,
+                                 int transparentIndex)
+  : m_data(new Data)
+{
+  Data* d = m_data.get();
+  d->filename = filename;
+  d->tmpFilename = filename + ".tmp";
+  d->handle = open_file_with_exception(d->tmpFilename, "wb");
+  d->height = height;
+
+  d->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, &d->error,
+                                       report_png_stream_error,
+                                       report_png_stream_error);
+  if (d->png_ptr)
+    d->info_ptr = png_create_info_struct(d->png_ptr);
+  if (!d->png_ptr || !d->info_ptr)
+    throw Exception("Error creating the PNG file %s", filename.c_str());
+
+  switch (pixelFormat) {
+    case IMAGE_RGB:       d->color_type = PNG_COLOR_TYPE_RGB_ALPHA; break;
+    case IMAGE_GRAYSCALE: d->color_type = PNG_COLOR_TYPE_GRAY_ALPHA; break;
+    case IMAGE_INDEXED:   d->color_type = PNG_COLOR_TYPE_PALETTE; break;
+    default:
+      throw Exception("Unsupported pixel format to save a PNG file");
+  }
+
+  if (setjmp(png_jmpbuf(d->png_ptr)))
+    throw Exception("libpng: %s", d->error.c_str());
+
+  png_init_io(d->png_ptr, d->handle.get());
+  png_set_IHDR(d->png_ptr, d->info_ptr, width, height, 8, d->color_type,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+  if (pixelFormat == IMAGE_INDEXED) {
+    png_color pngPalette[PNG_MAX_PALETTE_LENGTH];
+    png_byte trans[PNG_MAX_PALETTE_LENGTH];
+    const int pal_size = MID(1, palette->size(), PNG_MAX_PALETTE_LENGTH);
+
+    for (int c=0; c<pal_size; ++c) {
+      color_t color = palette->getEntry(c);
+      pngPalette[c].red   = rgba_getr(color);
+      pngPalette[c].green = rgba_getg(color);
+      pngPalette[c].blue  = rgba_getb(color);
+      trans[c] = (c == transparentIndex ? 0: rgba_geta(color));
+    }
+
+    png_set_PLTE(d->png_ptr, d->info_ptr, pngPalette, pal_size);
+    png_set_tRNS(d->png_ptr, d->info_ptr, trans, pal_size, NULL);
+  }
+
+  png_write_info(d->png_ptr, d->info_ptr);
+  png_set_packing(d->png_ptr);
+
+  d->row.resize(png_get_rowbytes(d->png_ptr, d->info_ptr));
+}
+
+PngStreamWriter::~PngStreamWriter()
+{
+}
+
+void PngStreamWriter::writeRows(const Image* image, int rows)
+{
+  Data* d = m_data.get();
+  png_bytep row_pointer = &d->row[0];
+
+  ASSERT(rows <= image->height());
+  ASSERT(d->y + rows <= d->height);
+
+  if (setjmp(png_jmpbuf(d->png_ptr)))
+    throw Exception("libpng: %s", d->error.c_str());
+
+  for (int y=0; y<rows; ++y) {
+    image_row_to_png(d->color_type, image, y, row_pointer);
+    png_write_rows(d->png_ptr, &row_pointer, 1);
+  }
+  d->y += rows;
+}
+
+void PngStreamWriter::close()
+{
+  Data* d = m_data.get();
+  ASSERT(d->y == d->height);
+
+  if (setjmp(png_jmpbuf(d->png_ptr)))
+    throw Exception("libpng: %s", d->error.c_str());
+
+  png_write_end(d->png_ptr, d->info_ptr);
+  d->handle.reset();
+
+  // Replace the file only when it was completely written
+  if (is_file(d->filename))
+    delete_file(d->filename);
+  move_file(d->tmpFilename, d->filename);
+  d->closed = true;
+}
+
 } // namespace app
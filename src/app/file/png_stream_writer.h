@@ -0,0 +1,57 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "base/disable_copying.h"
+#include "doc/pixel_format.h"
+
+#include <memory>
+#include <string>
+
+namespace doc {
+  class Image;
+  class Palette;
+}
+
+namespace app {
+
+  // Writes a PNG file row by row, so big images (e.g. sprite sheet
+  // textures) can be saved without having all their pixels in
+  // memory. Throws base::Exception in case of error.
+  //
+  // The rows are written in a temporary file that replaces the
+  // specified file in close(). If the writer is destroyed before
+  // close() (e.g. because of an error), the temporary file is deleted.
+  class PngStreamWriter {
+  public:
+    // Writes the header of the file. Indexed images use the given
+    // palette with a transparent entry at "transparentIndex" (or -1
+    // if there is no transparent entry).
+    PngStreamWriter(const std::string& filename,
+                    doc::PixelFormat pixelFormat,
+                    int width, int height,
+                    const doc::Palette* palette,
+                    int transparentIndex);
+    ~PngStreamWriter();
+
+    // Writes "rows" rows of the image (from its first row). The image
+    // must have the same pixel format and width of the file.
+    void writeRows(const doc::Image* image, int rows);
+
+    // Writes the end of the file, it must be called after all rows
+    // were written.
+    void close();
+
+  private:
+    struct Data;
+    std::unique_ptr<Data> m_data;
+
+    DISABLE_COPYING(PngStreamWriter);
+  };
+
+} // namespace app
@@ -19,20 +19,27 @@
 #include "app/file/format_options.h"
 #include "app/file/webp_options.h"
 #include "app/ini_file.h"
+#include "app/loop_tag.h"
 #include "base/file_handle.h"
 #include "base/convert_to.h"
+#include "base/parallel_for.h"
 #include "doc/doc.h"
+#include "render/render.h"
 
 #include "webp_options.xml.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <map>
+#include <vector>
 
 // Include webp libraries
 #include <webp/decode.h>
+#include <webp/demux.h>
 #include <webp/encode.h>
+#include <webp/mux.h>
 
 namespace app {
 
@@ -48,7 +55,10 @@ class WebPFormat : public FileFormat {
       FILE_SUPPORT_SAVE |
       FILE_SUPPORT_RGB |
       FILE_SUPPORT_RGBA |
-      FILE_SUPPORT_SEQUENCES |
+      FILE_SUPPORT_GRAY |
+      FILE_SUPPORT_GRAYA |
+      FILE_SUPPORT_INDEXED |
+      FILE_SUPPORT_FRAMES |
       FILE_SUPPORT_GET_FORMAT_OPTIONS;
   }
 
@@ -102,72 +112,111 @@ bool WebPFormat::onLoad(FileOp* fop)
     return false;
   }
 
-  WebPDecoderConfig config;
-  if (!WebPInitDecoderConfig(&config)) {
-    fop->setError("WebP decoder cannot load this webp file version\n");
+  WebPBitstreamFeatures features;
+  VP8StatusCode status = WebPGetFeatures(data, len, &features);
+  if (status != VP8_STATUS_OK) {
+    fop->setError("Bad bitstream in WebP file: %s\n", getDecoderErrorMessage(status));
     return false;
   }
 
-  if (WebPGetFeatures(data, len, &config.input) != VP8_STATUS_OK) {
-    fop->setError("Bad bitstream in WebP file\n");
+  // The animation decoder is used for still images too (they are
+  // decoded as an animation of one frame).
+  WebPAnimDecoderOptions decOptions;
+  if (!WebPAnimDecoderOptionsInit(&decOptions)) {
+    fop->setError("WebP decoder cannot load this webp file version\n");
     return false;
   }
+  decOptions.color_mode = MODE_RGBA;
+  decOptions.use_threads = 1;
 
-  fop->sequenceSetHasAlpha(config.input.has_alpha != 0);
-
-  Image* image = fop->sequenceImage(IMAGE_RGB, config.input.width, config.input.height);
+  WebPData webpData;
+  WebPDataInit(&webpData);
+  webpData.bytes = data;
+  webpData.size = len;
 
-  config.output.colorspace = MODE_RGBA;
-  config.output.u.RGBA.rgba = (uint8_t*)image->getPixelAddress(0, 0);
-  config.output.u.RGBA.stride = config.input.width * sizeof(uint32_t);
-  config.output.u.RGBA.size = config.input.width * config.input.height * sizeof(uint32_t);
-  config.output.is_external_memory = 1;
-
-  WebPIDecoder* idec = WebPIDecode(NULL, 0, &config);
-  if (idec == NULL) {
+  std::unique_ptr<WebPAnimDecoder, decltype(&WebPAnimDecoderDelete)>
+    decoder(WebPAnimDecoderNew(&webpData, &decOptions), &WebPAnimDecoderDelete);
+  if (!decoder) {
     fop->setError("Error creating WebP decoder\n");
     return false;
   }
 
-  long bytes_remaining = len;
-  long bytes_read = std::max(4l, len/100l);
-
-  while (bytes_remaining > 0) {
-    VP8StatusCode status = WebPIAppend(idec, data, bytes_read);
-    if (status == VP8_STATUS_OK ||
-        status == VP8_STATUS_SUSPENDED) {
-      bytes_remaining -= bytes_read;
-      data += bytes_read;
-      if (bytes_remaining < bytes_read)
-        bytes_read = bytes_remaining;
-      fop->setProgress(1.0f - ((float)std::max(bytes_remaining, 0l)/(float)len));
-    }
-    else {
-      fop->setError("Error decoding WebP data: %s\n", getDecoderErrorMessage(status));
-      WebPIDelete(idec);
-      WebPFreeDecBuffer(&config.output);
-      return false;
+  WebPAnimInfo info;
+  if (!WebPAnimDecoderGetInfo(decoder.get(), &info)) {
+    fop->setError("Error reading WebP animation info\n");
+    return false;
+  }
+
+  const int w = info.canvas_width;
+  const int h = info.canvas_height;
+  const int nframes = std::max<int>(1, info.frame_count);
+
+  std::unique_ptr<Sprite> sprite(new Sprite(IMAGE_RGB, w, h, 256));
+  LayerImage* layer = new LayerImage(sprite.get());
+  sprite->folder()->addLayer(layer);
+  if (!features.has_alpha)
+    layer->configureAsBackground();
+
+  sprite->setTotalFrames(frame_t(nframes));
+
+  Cel* prevCel = nullptr;
+  frame_t frame = 0;
+  int prevTimestamp = 0;
+
+  while (WebPAnimDecoderHasMoreFrames(decoder.get())) {
+    uint8_t* pixels;
+    int timestamp;
+    if (!WebPAnimDecoderGetNext(decoder.get(), &pixels, &timestamp)) {
+      fop->setError("Error decoding WebP frame %d\n", int(frame));
+      break;
     }
-    if (fop->isStop())
+
+    // The canvas is in RGBA byte order, the same as RgbTraits
+    std::shared_ptr<Image> image(Image::create(IMAGE_RGB, w, h));
+    for (int y=0; y<h; ++y)
+      std::copy(pixels + y*w*4,
+                pixels + (y+1)*w*4,
+                image->getPixelAddress(0, y));
+
+    const int duration = std::max(1, timestamp - prevTimestamp);
+    prevTimestamp = timestamp;
+
+    // Frames with the same pixels are added as linked cels
+    Cel* cel;
+    if (prevCel && count_diff_between_images(prevCel->image(), image.get()) == 0)
+      cel = Cel::createLink(prevCel);
+    else
+      cel = new Cel(frame, image);
+    cel->setFrame(frame);
+    layer->addCel(cel);
+    sprite->setFrameDuration(frame, duration);
+
+    prevCel = cel;
+    ++frame;
+
+    fop->setProgress(double(frame) / double(nframes));
+
+    if (fop->isStop() || fop->isOneFrame())
       break;
   }
 
-  if (!fop->sequenceGetFormatOptions()) {
-    std::shared_ptr<WebPOptions> webPOptions(new WebPOptions());
-    webPOptions->setLossless(std::min(config.input.format - 1, 1));
-    fop->sequenceSetFormatOptions(webPOptions);
+  if (frame == 0) {
+    fop->setError("Error decoding WebP frames\n");
+    return false;
   }
 
-  WebPIDelete(idec);
-  WebPFreeDecBuffer(&config.output);
+  if (frame < sprite->totalFrames())
+    sprite->setTotalFrames(frame);
+
+  std::shared_ptr<WebPOptions> webPOptions(new WebPOptions());
+  webPOptions->setLossless(std::min(features.format - 1, 1));
+  webPOptions->setLoop(info.loop_count != 1);
+
+  fop->createDocument(sprite.release());
+  fop->document()->setFormatOptions(webPOptions);
   return true;
 }
 
-struct WriterData {
-  FILE* fp;
-  FileOp* fop;
-};
-
 class ScopedWebPPicture {
 public:
   ScopedWebPPicture(WebPPicture& pic) : m_pic(pic) {
@@ -216,33 +265,195 @@ int WebPConfigLosslessPreset(WebPConfig* config, int level) {
 }
 #endif
 
-static int ProgressReport(int percent, const WebPPicture* const pic)
-{
-  FileOp* fop = ((WriterData*)pic->custom_ptr)->fop;
-  fop->setProgress((double)percent/(double)100);
-  if (fop->isStop())
-    return false;
-  else
+// Encodes the sprite frames as a WebP animation. Frames are rendered
+// and compared with the previous frame in worker threads (a chunk of
+// frames at a time to limit the memory usage), and the changed ones
+// are added in order to the libwebp animation encoder, which can use
+// its own threads to encode each frame (WebPConfig::thread_level).
+class WebPAnimationEncoder {
+public:
+  WebPAnimationEncoder(FileOp* fop, const WebPConfig& config, const WebPOptions& options)
+    : m_fop(fop)
+    , m_sprite(fop->document()->sprite())
+    , m_config(config)
+    , m_loop(options.loop())
+    , m_loopTagFrames(options.loopTagFrames())
+    , m_minimizeSize(options.minimizeSize()) {
+  }
+
+  bool encode(std::vector<uint8_t>& output) {
+    WebPAnimEncoderOptions animOptions;
+    if (!WebPAnimEncoderOptionsInit(&animOptions)) {
+      m_fop->setError("Error encoding WebP animation, version mismatch\n");
+      return false;
+    }
+    // 0 = infinite loop
+    animOptions.anim_params.loop_count = (m_loop ? 0: 1);
+    animOptions.minimize_size = (m_minimizeSize ? 1: 0);
+
+    std::unique_ptr<WebPAnimEncoder, decltype(&WebPAnimEncoderDelete)>
+      encoder(WebPAnimEncoderNew(m_sprite->width(), m_sprite->height(), &animOptions),
+              &WebPAnimEncoderDelete);
+    if (!encoder) {
+      m_fop->setError("Not enough memory to create the WebP encoder\n");
+      return false;
+    }
+
+    const std::vector<frame_t> frames = framesToEncode();
+    const int nframes = int(frames.size());
+    const int nthreads = base::parallel_threads(nframes);
+
+    // One image for each frame of the chunk plus the last frame of
+    // the previous chunk (the first image).
+    std::vector<std::unique_ptr<Image>> images(nthreads+1);
+    for (auto& image : images)
+      image.reset(Image::create(IMAGE_RGB, m_sprite->width(), m_sprite->height()));
+    std::vector<char> changed(nthreads);
+
+    // One renderer for each thread
+    std::vector<render::Render> renders(nthreads);
+    for (auto& render : renders)
+      render.setBgType(render::BgType::NONE);
+
+    int timestamp = 0;
+    for (int chunk=0; chunk<nframes; chunk+=nthreads) {
+      const int n = std::min(nthreads, nframes-chunk);
+
+      // Render and compare frames in parallel
+      base::parallel_for_threads(
+        n, n,
+        [&](int i, int t){
+          Image* image = images[i+1].get();
+          clear_image(image, 0);
+          renders[t].renderSprite(image, m_sprite, frames[chunk+i]);
+        });
+
+      base::parallel_for_threads(
+        n, n,
+        [&](int i, int){
+          changed[i] = (chunk+i == 0 ||
+                        !equalPixels(images[i].get(), images[i+1].get()));
+        });
+
+      // Add the changed frames to the encoder (unchanged frames
+      // extend the duration of the previous one)
+      for (int i=0; i<n; ++i) {
+        if (changed[i] && !addFrame(encoder.get(), images[i+1].get(), timestamp))
+          return false;
+
+        timestamp += m_sprite->frameDuration(frames[chunk+i]);
+        m_fop->setProgress(double(chunk+i+1) / double(nframes));
+        if (m_fop->isStop())
+          return false;
+      }
+
+      std::swap(images[0], images[n]);
+    }
+
+    // The last timestamp is the duration of the last frame
+    WebPData webpData;
+    WebPDataInit(&webpData);
+    if (!WebPAnimEncoderAdd(encoder.get(), nullptr, timestamp, nullptr) ||
+        !WebPAnimEncoderAssemble(encoder.get(), &webpData)) {
+      m_fop->setError("Error encoding WebP animation: %s\n",
+                      WebPAnimEncoderGetError(encoder.get()));
+      return false;
+    }
+
+    output.assign(webpData.bytes, webpData.bytes + webpData.size);
+    WebPDataClear(&webpData);
     return true;
-}
+  }
 
-static int FileWriter(const uint8_t* data, size_t data_size, const WebPPicture* const pic)
-{
-  return (data_size ? (fwrite(data, data_size, 1, ((WriterData*)pic->custom_ptr)->fp) == 1) : 1);
-}
+private:
+  // All frames in order (as other formats with frames save them, so
+  // the file can be loaded again without losing frames), or if the
+  // user asked for it, the frames of the "Loop" tag in the tag
+  // animation direction (the same frames played in the editor).
+  std::vector<frame_t> framesToEncode() const {
+    frame_t first = 0;
+    frame_t last = m_sprite->lastFrame();
+    AniDir aniDir = AniDir::FORWARD;
+
+    const FrameTag* tag = (m_loopTagFrames ? get_loop_tag(m_sprite): nullptr);
+    if (tag) {
+      first = MID(frame_t(0), tag->fromFrame(), last);
+      last = MID(first, tag->toFrame(), last);
+      aniDir = tag->aniDir();
+    }
 
-bool WebPFormat::onSave(FileOp* fop)
-{
-  FileHandle handle(open_file_with_exception(fop->filename(), "wb"));
-  FILE* fp = handle.get();
+    std::vector<frame_t> frames;
+    switch (aniDir) {
+      case AniDir::FORWARD:
+        for (frame_t frame=first; frame<=last; ++frame)
+          frames.push_back(frame);
+        break;
+      case AniDir::REVERSE:
+        for (frame_t frame=last; frame>=first; --frame)
+          frames.push_back(frame);
+        break;
+      case AniDir::PING_PONG:
+        for (frame_t frame=first; frame<=last; ++frame)
+          frames.push_back(frame);
+        for (frame_t frame=last-1; frame>first; --frame)
+          frames.push_back(frame);
+        break;
+    }
+    return frames;
+  }
+
+  bool addFrame(WebPAnimEncoder* encoder, const Image* image, int timestamp) {
+    WebPPicture pic;
+    if (!WebPPictureInit(&pic)) {
+      m_fop->setError("Error encoding WebP picture, version mismatch\n");
+      return false;
+    }
 
-  WriterData wd = { fp, fop };
+    pic.width = image->width();
+    pic.height = image->height();
+    pic.use_argb = true;
 
-  const Image* image = fop->sequenceImage();
-  if (image->width() > WEBP_MAX_DIMENSION ||
-      image->height() > WEBP_MAX_DIMENSION) {
+    ScopedWebPPicture scopedPic(pic); // Calls WebPPictureFree automatically
+
+    if (!WebPPictureImportRGBA(&pic, image->getPixelAddress(0, 0),
+                               image->getRowStrideSize())) {
+      m_fop->setError("Error converting RGBA data into a WebP picture\n");
+      return false;
+    }
+
+    if (!WebPAnimEncoderAdd(encoder, &pic, timestamp, &m_config)) {
+      m_fop->setError("Error encoding image into WebP: %s\n",
+                      getEncoderErrorMessage(pic.error_code));
+      return false;
+    }
+    return true;
+  }
+
+  static bool equalPixels(const Image* a, const Image* b) {
+    for (int y=0; y<a->height(); ++y) {
+      if (std::memcmp(a->getPixelAddress(0, y),
+                      b->getPixelAddress(0, y),
+                      a->getRowStrideSize()) != 0)
+        return false;
+    }
+    return true;
+  }
+
+  FileOp* m_fop;
+  const Sprite* m_sprite;
+  WebPConfig m_config;
+  bool m_loop;
+  bool m_loopTagFrames;
+  bool m_minimizeSize;
+};
+
+bool WebPFormat::onSave(FileOp* fop)
+{
+  const Sprite* sprite = fop->document()->sprite();
+  if (sprite->width() > WEBP_MAX_DIMENSION ||
+      sprite->height() > WEBP_MAX_DIMENSION) {
     fop->setError("WebP format cannot store %dx%d images. The maximum allowed size is %dx%d\n",
-                  image->width(), image->height(),
+                  sprite->width(), sprite->height(),
                   WEBP_MAX_DIMENSION, WEBP_MAX_DIMENSION);
     return false;
   }
@@ -266,42 +477,22 @@ bool WebPFormat::onSave(FileOp* fop)
     }
   }
 
+  config.thread_level = (webp_options->multithreaded() ? 1: 0);
+
   if (!WebPValidateConfig(&config)) {
     fop->setError("Error validating WebP encoder configuration\n");
     return false;
   }
 
-  WebPPicture pic;
-  if (!WebPPictureInit(&pic)) {
-    fop->setError("Error encoding WebP picture, version mismatch\n");
-    return false;
-  }
-
-  pic.width = image->width();
-  pic.height = image->height();
-  if (webp_options->lossless()) {
-    pic.use_argb = true;
-  }
-
-  if (!WebPPictureAlloc(&pic)) {
-    fop->setError("Not enough memory to allocate a WebP picture\n");
-    return false;
-  }
-
-  ScopedWebPPicture scopedPic(pic); // Calls WebPPictureFree automatically
-
-  if (!WebPPictureImportRGBA(&pic, (uint8_t*)image->getPixelAddress(0, 0), image->width() * sizeof(uint32_t))) {
-    fop->setError("Error converting RGBA data into a WebP picture\n");
+  std::vector<uint8_t> output;
+  WebPAnimationEncoder encoder(fop, config, *webp_options);
+  if (!encoder.encode(output))
     return false;
-  }
-
-  pic.writer = FileWriter;
-  pic.custom_ptr = &wd;
-  pic.progress_hook = ProgressReport;
 
-  if (!WebPEncode(&config, &pic)) {
-    fop->setError("Error encoding image into WebP: %s\n",
-                  getEncoderErrorMessage(pic.error_code));
+  FileHandle handle(open_file_with_exception(fop->filename(), "wb"));
+  FILE* fp = handle.get();
+  if (fwrite(&output[0], output.size(), 1, fp) != 1) {
+    fop->setError("Error writing WebP file\n");
     return false;
   }
 
@@ -329,6 +520,10 @@ bool WebPFormat::onSave(FileOp* fop)
     webp_options->setMethod(get_config_int("WEBP", "Compression", webp_options->getMethod()));
     webp_options->setImageHint(get_config_int("WEBP", "ImageHint", webp_options->getImageHint()));
     webp_options->setImagePreset(get_config_int("WEBP", "ImagePreset", webp_options->getImagePreset()));
+    webp_options->setLoop(get_config_bool("WEBP", "Loop", webp_options->loop()));
+    webp_options->setLoopTagFrames(get_config_bool("WEBP", "LoopTagFrames", webp_options->loopTagFrames()));
+    webp_options->setMinimizeSize(get_config_bool("WEBP", "MinimizeSize", webp_options->minimizeSize()));
+    webp_options->setMultithreaded(get_config_bool("WEBP", "Multithreaded", webp_options->multithreaded()));
 
     // Load the window to ask to the user the WebP options he wants.
 
@@ -339,6 +534,9 @@ bool WebPFormat::onSave(FileOp* fop)
     win.compression()->setValue(webp_options->getMethod());
     win.imageHint()->setSelectedItemIndex(webp_options->getImageHint());
     win.imagePreset()->setSelectedItemIndex(webp_options->getImagePreset());
+    win.loop()->setSelected(webp_options->loop());
+    win.loopTagFrames()->setSelected(webp_options->loopTagFrames());
+    win.minimizeSize()->setSelected(webp_options->minimizeSize());
 
     win.openWindowInForeground();
 
@@ -348,11 +546,17 @@ bool WebPFormat::onSave(FileOp* fop)
       webp_options->setLossless(win.lossless()->isSelected());
       webp_options->setImageHint(base::convert_to<int>(win.imageHint()->getValue()));
       webp_options->setImagePreset(base::convert_to<int>(win.imagePreset()->getValue()));
+      webp_options->setLoop(win.loop()->isSelected());
+      webp_options->setLoopTagFrames(win.loopTagFrames()->isSelected());
+      webp_options->setMinimizeSize(win.minimizeSize()->isSelected());
 
       set_config_int("WEBP", "Quality", webp_options->getQuality());
       set_config_int("WEBP", "Compression", webp_options->getMethod());
       set_config_int("WEBP", "ImageHint", webp_options->getImageHint());
       set_config_int("WEBP", "ImagePreset", webp_options->getImagePreset());
+      set_config_bool("WEBP", "Loop", webp_options->loop());
+      set_config_bool("WEBP", "LoopTagFrames", webp_options->loopTagFrames());
+      set_config_bool("WEBP", "MinimizeSize", webp_options->minimizeSize());
     }
     else {
       webp_options.reset();
@@ -16,13 +16,17 @@ namespace app {
   // Data for WebP files
   class WebPOptions : public FormatOptions {
   public:
-    WebPOptions(): m_lossless(1), m_quality(75), m_method(6), m_image_hint(WEBP_HINT_DEFAULT), m_image_preset(WEBP_PRESET_DEFAULT) {};
+    WebPOptions(): m_lossless(1), m_quality(75), m_method(6), m_image_hint(WEBP_HINT_DEFAULT), m_image_preset(WEBP_PRESET_DEFAULT), m_loop(true), m_loop_tag_frames(false), m_minimize_size(false), m_multithreaded(true) {};
 
     bool lossless() { return m_lossless; }
     int getQuality() { return m_quality; }
     int getMethod() { return m_method; }
     WebPImageHint getImageHint() { return m_image_hint; }
     WebPPreset getImagePreset() { return m_image_preset; }
+    bool loop() const { return m_loop; }
+    bool loopTagFrames() const { return m_loop_tag_frames; }
+    bool minimizeSize() const { return m_minimize_size; }
+    bool multithreaded() const { return m_multithreaded; }
 
     void setLossless(int lossless) { m_lossless = (lossless != 0); }
     void setLossless(bool lossless) { m_lossless = lossless; }
@@ -32,6 +36,10 @@ namespace app {
     void setImageHint(WebPImageHint imageHint) { m_image_hint = imageHint; }
     void setImagePreset(int imagePreset) { m_image_preset = static_cast<WebPPreset>(imagePreset); };
     void setImagePreset(WebPPreset imagePreset) { m_image_preset = imagePreset ; }
+    void setLoop(bool loop) { m_loop = loop; }
+    void setLoopTagFrames(bool loopTagFrames) { m_loop_tag_frames = loopTagFrames; }
+    void setMinimizeSize(bool minimizeSize) { m_minimize_size = minimizeSize; }
+    void setMultithreaded(bool multithreaded) { m_multithreaded = multithreaded; }
 
   private:
     bool m_lossless;           // Lossless encoding (0=lossy(default), 1=lossless).
@@ -39,6 +47,10 @@ namespace app {
     int m_method;             // quality/speed trade-off (0=fast, 9=slower-better)
     WebPImageHint m_image_hint;  // Hint for image type (lossless only for now).
     WebPPreset m_image_preset;  // Image Preset for lossy webp.
+    bool m_loop;                // Infinite loop of the animation (or play it once).
+    bool m_loop_tag_frames;     // Save only the frames of the "Loop" tag in its direction.
+    bool m_minimize_size;       // Try all the ways to encode frames to get the smallest file (slower).
+    bool m_multithreaded;       // Use threads in libwebp to encode each frame.
   };
 
 } // namespace app
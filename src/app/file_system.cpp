@@ -20,14 +20,18 @@
 #include "base/fs.h"
 #include "base/path.h"
 #include "base/string.h"
+#include "base/time.h"
 #include "she/display.h"
 #include "she/surface.h"
 #include "she/system.h"
 
 #include <algorithm>
 #include <cstdio>
+#include <limits>
 #include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #ifdef _WIN32
   #include <windows.h>
@@ -50,6 +54,42 @@
 
 namespace app {
 
+#ifndef _WIN32
+
+// An entry read from a directory. It's used to transfer entries from
+// the background thread that reads the directory to the main thread.
+struct DirEntry {
+  std::string name;
+  bool is_folder;
+};
+
+typedef std::vector<DirEntry> DirEntries;
+
+// Reads a directory in groups of entries. It doesn't touch any
+// FileItem so it can be used from a background thread.
+class DirReader {
+public:
+  DirReader(const std::string& path)
+    : m_path(path)
+    , m_dir(opendir(path.c_str())) {
+  }
+
+  ~DirReader() {
+    if (m_dir)
+      closedir(m_dir);
+  }
+
+  // Appends up to "max" entries to "entries". Returns false when the
+  // whole directory was read.
+  bool read(DirEntries& entries, std::size_t max);
+
+private:
+  std::string m_path;
+  DIR* m_dir;
+};
+
+#endif
+
 // a position in the file-system
 class FileItem : public IFileItem {
 public:
@@ -61,6 +101,12 @@ public:
   unsigned int m_version;
   bool m_removed;
   bool m_is_folder;
+  bool m_listed;                  // true if it's in m_parent->m_children
+  bool m_children_loaded;         // true if m_children was read completely
+  bool m_loading;                 // true while loadChildren() is running
+  unsigned int m_load_id;         // incremented on each new read of m_children
+  base::Time m_mtime;             // modification time of the folder when m_children was read
+  TaskHandle m_load_task;
 #ifdef _WIN32
   LPITEMIDLIST m_pidl;            // relative to parent
   LPITEMIDLIST m_fullpidl;        // relative to the Desktop folder
@@ -71,7 +117,13 @@ public:
   FileItem(FileItem* parent);
   ~FileItem();
 
-  void insertChildSorted(FileItem* child);
+  bool isChildrenListUpdated();
+  void beginChildrenUpdate();
+  void insertChildren(FileItemList& newChildren);
+  void endChildrenUpdate();
+#ifndef _WIN32
+  void insertEntries(const DirEntries& entries);
+#endif
   int compare(const FileItem& that) const;
 
   bool operator<(const FileItem& that) const { return compare(that) < 0; }
@@ -91,6 +143,7 @@ public:
 
   IFileItem* parent() const;
   const FileItemList& children();
+  TaskHandle loadChildren(LoadChildrenCallback&& onProgress);
   void createDirectory(const std::string& dirname);
 
   bool hasExtension(const std::string& csv_extensions);
@@ -359,24 +412,19 @@ const FileItemList& FileItem::children()
 {
   // Is the file-item a folder?
   if (isFolder() &&
-      // if the children list is empty, or the file-system version
-      // change (it's like to say: the current m_children list
-      // is outdated)...
-      (m_children.empty() ||
-       current_file_system_version > m_version)) {
-    FileItemList::iterator it;
-    FileItem* child;
-
-    // we have to mark current items as deprecated
-    for (it=m_children.begin();
-         it!=m_children.end(); ++it) {
-      child = static_cast<FileItem*>(*it);
-      child->m_removed = true;
-    }
+      // if the children list wasn't read completely yet, or it's
+      // outdated...
+      (m_loading || !isChildrenListUpdated())) {
+    // Cancel any background read of this same list, we're going to
+    // read it right now.
+    m_load_task.abort();
+
+    beginChildrenUpdate();
 
     //LOG("FS: Loading files for %p (%s)\n", fileitem, fileitem->displayname);
 #ifdef _WIN32
     {
+      FileItemList newChildren;
       IShellFolder* pFolder = NULL;
       HRESULT hr;
 
@@ -416,7 +464,7 @@ const FileItemList& FileItem::children()
               LPITEMIDLIST fullpidl = concat_pidl(m_fullpidl,
                                                   itempidl[c]);
 
-              child = get_fileitem_by_fullpidl(fullpidl, false);
+              FileItem* child = get_fileitem_by_fullpidl(fullpidl, false);
               if (!child) {
                 child = new FileItem(this);
 
@@ -432,7 +480,7 @@ const FileItemList& FileItem::children()
                 free_pidl(itempidl[c]);
               }
 
-              insertChildSorted(child);
+              newChildren.push_back(child);
             }
           }
 
@@ -442,78 +490,255 @@ const FileItemList& FileItem::children()
         if (pFolder != shl_idesktop)
           pFolder->Release();
       }
+
+      insertChildren(newChildren);
     }
 #else
     {
-      DIR* dir = opendir(m_filename.c_str());
-      if (dir) {
-        dirent* entry;
-        while ((entry = readdir(dir)) != NULL) {
-          FileItem* child;
-          std::string fn = entry->d_name;
-          std::string fullfn = base::join_path(m_filename, fn);
-
-          if (fn == "." || fn == "..")
-            continue;
-
-          child = get_fileitem_by_path(fullfn, false);
-          if (!child) {
-            child = new FileItem(this);
-
-            bool is_folder;
-            if (entry->d_type == DT_LNK) {
-              is_folder = base::is_directory(fullfn);
-            }
-            else {
-              is_folder = (entry->d_type == DT_DIR);
-            }
+      DirReader reader(m_filename);
+      DirEntries entries;
+      while (reader.read(entries, std::numeric_limits<std::size_t>::max()))
+        ;
+      insertEntries(entries);
+    }
+#endif
 
-            child->m_filename = fullfn;
-            child->m_displayname = fn;
-            child->m_is_folder = is_folder;
+    endChildrenUpdate();
+  }
 
-            put_fileitem(child);
-          }
-          else {
-            ASSERT(child->m_parent == this);
-          }
+  return m_children;
+}
 
-          insertChildSorted(child);
-        }
-        closedir(dir);
+TaskHandle FileItem::loadChildren(LoadChildrenCallback&& onProgress)
+{
+#ifdef _WIN32
+  // Shell folders (PIDLs) are enumerated in the main thread.
+  onProgress(children(), true);
+  return TaskHandle();
+#else
+  if (!isFolder() || (!m_loading && isChildrenListUpdated())) {
+    onProgress(m_children, true);
+    return TaskHandle();
+  }
+
+  // Restart any previous background read
+  m_load_task.abort();
+
+  beginChildrenUpdate();
+  m_loading = true;
+
+  struct Batch {
+    DirEntries entries;
+    bool done;
+  };
+
+  auto reader = std::make_shared<DirReader>(m_filename);
+  std::size_t batchSize = 256;
+  std::string keyname = m_keyname;
+  unsigned int loadId = m_load_id;
+
+  m_load_task = TaskManager::instance().addTask<Batch>(
+    [reader, batchSize](std::atomic_bool& isAlive) mutable -> Batch {
+      Batch batch;
+      batch.done = !reader->read(batch.entries, batchSize);
+      if (batch.done)
+        isAlive = false;
+
+      // Each batch is twice the size of the previous one, so the
+      // sorted merges in insertChildren() are O(n log n) in total.
+      batchSize *= 2;
+      return batch;
+    },
+    [keyname, loadId, onProgress](Batch&& batch) {
+      // The folder could be deleted (or re-read with children())
+      // while we were reading it in the background.
+      if (!fileitems_map)
+        return;
+      auto it = fileitems_map->find(keyname);
+      if (it == fileitems_map->end())
+        return;
+
+      FileItem* folder = it->second;
+      if (folder->m_load_id != loadId || !folder->m_loading)
+        return;
+
+      folder->insertEntries(batch.entries);
+      if (batch.done) {
+        folder->m_loading = false;
+        folder->endChildrenUpdate();
       }
+      onProgress(folder->m_children, batch.done);
+    });
+
+  return m_load_task;
+#endif
+}
+
+// Returns true if m_children doesn't need to be read again from disk.
+bool FileItem::isChildrenListUpdated()
+{
+  if (!m_children_loaded)
+    return false;
+
+  if (m_version == current_file_system_version)
+    return true;
+
+#ifndef _WIN32
+  // The file-system version changed (e.g. FileSystemModule::refresh()
+  // was called), but if the folder wasn't modified since the last
+  // time we read it, the cached list is still valid.
+  if (m_mtime.valid() &&
+      m_mtime == base::get_modification_time(m_filename)) {
+    m_version = current_file_system_version;
+    return true;
   }
 #endif
 
-    // check old file-items (maybe removed directories or file-items)
-    for (it=m_children.begin();
-         it!=m_children.end(); ) {
-      child = static_cast<FileItem*>(*it);
-      ASSERT(child != NULL);
+  return false;
+}
 
-      if (child && child->m_removed) {
-        it = m_children.erase(it);
+void FileItem::beginChildrenUpdate()
+{
+  // Invalidate any other read in progress
+  ++m_load_id;
+  m_loading = false;
+
+#ifndef _WIN32
+  // Get the folder modification time before reading it, so any
+  // change while we read it is detected the next time. If the folder
+  // was modified in this same second we cannot trust the time (it
+  // has a resolution of one second).
+  m_mtime = base::get_modification_time(m_filename);
+  if (m_mtime == base::current_time())
+    m_mtime = base::Time();
+#endif
 
+  // we have to mark current items as deprecated
+  for (auto item : m_children)
+    static_cast<FileItem*>(item)->m_removed = true;
+}
+
+// Adds the given items to m_children keeping the list sorted. Items
+// that are already in the list are just marked as not removed.
+void FileItem::insertChildren(FileItemList& newChildren)
+{
+  auto end = std::remove_if(
+    newChildren.begin(), newChildren.end(),
+    [](IFileItem* item) {
+      FileItem* child = static_cast<FileItem*>(item);
+
+      // this file-item wasn't removed from the last lookup
+      child->m_removed = false;
+
+      if (child->m_listed)
+        return true;
+
+      child->m_listed = true;
+      return false;
+    });
+  newChildren.erase(end, newChildren.end());
+  if (newChildren.empty())
+    return;
+
+  auto less = [](IFileItem* a, IFileItem* b) {
+    return (static_cast<FileItem*>(a)->compare(*static_cast<FileItem*>(b)) < 0);
+  };
+
+  std::sort(newChildren.begin(), newChildren.end(), less);
+
+  std::size_t oldSize = m_children.size();
+  m_children.insert(m_children.end(), newChildren.begin(), newChildren.end());
+  std::inplace_merge(m_children.begin(),
+                     m_children.begin()+oldSize,
+                     m_children.end(), less);
+}
+
+void FileItem::endChildrenUpdate()
+{
+  // check old file-items (maybe removed directories or file-items)
+  auto end = std::remove_if(
+    m_children.begin(), m_children.end(),
+    [](IFileItem* item) {
+      FileItem* child = static_cast<FileItem*>(item);
+      ASSERT(child != NULL);
+
+      if (child->m_removed) {
         fileitems_map->erase(fileitems_map->find(child->m_keyname));
         delete child;
+        return true;
       }
-      else
-        ++it;
+      return false;
+    });
+  m_children.erase(end, m_children.end());
+
+  // now this file-item is updated
+  m_version = current_file_system_version;
+  m_children_loaded = true;
+}
+
+#ifndef _WIN32
+
+void FileItem::insertEntries(const DirEntries& entries)
+{
+  FileItemList newChildren;
+  newChildren.reserve(entries.size());
+
+  for (const DirEntry& entry : entries) {
+    std::string fullfn = base::join_path(m_filename, entry.name);
+
+    FileItem* child = get_fileitem_by_path(fullfn, false);
+    if (!child) {
+      child = new FileItem(this);
+      child->m_filename = fullfn;
+      child->m_displayname = entry.name;
+      child->m_is_folder = entry.is_folder;
+
+      put_fileitem(child);
+    }
+    else {
+      ASSERT(child->m_parent == this);
     }
 
-    // now this file-item is updated
-    m_version = current_file_system_version;
+    newChildren.push_back(child);
   }
 
-  return m_children;
+  insertChildren(newChildren);
+}
+
+bool DirReader::read(DirEntries& entries, std::size_t max)
+{
+  if (!m_dir)
+    return false;
+
+  for (std::size_t i=0; i<max; ++i) {
+    dirent* entry = readdir(m_dir);
+    if (!entry)
+      return false;
+
+    std::string fn = entry->d_name;
+    if (fn == "." || fn == "..")
+      continue;
+
+    bool is_folder;
+    if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+      is_folder = base::is_directory(base::join_path(m_path, fn));
+    else
+      is_folder = (entry->d_type == DT_DIR);
+
+    entries.push_back(DirEntry{fn, is_folder});
+  }
+  return true;
 }
 
+#endif
+
 void FileItem::createDirectory(const std::string& dirname)
 {
   base::make_directory(base::join_path(m_filename, dirname));
 
   // Invalidate the children list.
   m_version = 0;
+  m_mtime = base::Time();
 }
 
 bool FileItem::hasExtension(const std::string& csv_extensions)
@@ -556,6 +781,10 @@ FileItem::FileItem(FileItem* parent)
   m_version = current_file_system_version;
   m_removed = false;
   m_is_folder = false;
+  m_listed = false;
+  m_children_loaded = false;
+  m_loading = false;
+  m_load_id = 0;
 #ifdef _WIN32
   m_pidl = NULL;
   m_fullpidl = NULL;
@@ -579,25 +808,6 @@ FileItem::~FileItem()
 #endif
 }
 
-void FileItem::insertChildSorted(FileItem* child)
-{
-  // this file-item wasn't removed from the last lookup
-  child->m_removed = false;
-
-  // if the fileitem is already in the list we can go back
-  if (std::find(m_children.begin(), m_children.end(), child) != m_children.end())
-    return;
-
-  for (auto it=m_children.begin(), end=m_children.end(); it!=end; ++it) {
-    if (*child < *static_cast<FileItem*>(*it)) {
-      m_children.insert(it, child);
-      return;
-    }
-  }
-
-  m_children.push_back(child);
-}
-
 int FileItem::compare(const FileItem& that) const
 {
   if (isFolder()) {
@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include "app/task_manager.h"
 #include "base/mutex.h"
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -74,6 +76,16 @@ namespace app {
 
     virtual IFileItem* parent() const = 0;
     virtual const FileItemList& children() = 0;
+
+    // Reads the children list in a background thread. "onProgress"
+    // is called from the main thread each time a new group of
+    // entries is added to the list (sorted), and with done=true after
+    // the last group. If the cached list is still valid, or the
+    // platform doesn't support background enumeration, onProgress()
+    // is called immediately and an empty TaskHandle is returned.
+    typedef std::function<void(const FileItemList& children, bool done)> LoadChildrenCallback;
+    virtual TaskHandle loadChildren(LoadChildrenCallback&& onProgress) = 0;
+
     virtual void createDirectory(const std::string& dirname) = 0;
 
     virtual bool hasExtension(const std::string& csv_extensions) = 0;
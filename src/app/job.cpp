@@ -16,6 +16,7 @@
 #include "base/mutex.h"
 #include "base/scoped_lock.h"
 #include "base/thread.h"
+#include "she/event_queue.h"
 #include "ui/widget.h"
 #include "ui/window.h"
 
@@ -123,8 +124,13 @@ void Job::onMonitoringTick()
 
 void Job::done()
 {
-  base::scoped_lock hold(*m_mutex);
-  m_done_flag = true;
+  {
+    base::scoped_lock hold(*m_mutex);
+    m_done_flag = true;
+  }
+
+  // Wake up the UI thread in case it's blocked waiting for events.
+  she::wake_up_event_queue();
 }
 
 // Called to start the worker thread.
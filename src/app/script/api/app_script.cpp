@@ -12,6 +12,7 @@
 
 #include "app/document.h"
 #include "app/document_api.h"
+#include "app/script/background_script.h"
 #include "app/commands/commands.h"
 #include "app/commands/params.h"
 #include "app/ui_context.h"
@@ -65,6 +66,24 @@ public:
     addMethod("documentation", &AppScriptObject::documentation)
       .doc("prints this text.");
 
+    addProperty("isBackground", []{return BackgroundScript::current() != nullptr;})
+      .doc("read-only. Returns true if the script is running in the background against a copy of the document.");
+
+    addProperty("isCanceled", []{
+        auto script = BackgroundScript::current();
+        return script && script->isCanceled();
+      })
+      .doc("read-only. Returns true if the user canceled the background script, which should stop as soon as possible.");
+
+    addMethod("reportProgress", &AppScriptObject::reportProgress)
+      .doc("shows the progress of a background script.")
+      .docArg("fraction", "A number from 0.0 to 1.0 (completed).");
+
+    addMethod("parallelFrames", &AppScriptObject::parallelFrames)
+      .doc("runs the given code for each frame in parallel threads (only in background scripts). Each run has its own global objects, and app.activeFrameNumber is the frame to process. The code can modify the cels of its frame but not the sprite.")
+      .docArg("code", "String. The code to run (in the language of the script).")
+      .docReturns("true if the code ran successfully for all frames.");
+
     makeGlobal("app");
     init();
   }
@@ -147,7 +166,26 @@ public:
     internalRegistry[""] = originalDefault;
   }
 
+  void reportProgress(double fraction) {
+    if (auto script = BackgroundScript::current())
+      script->jobProgress(fraction);
+  }
+
+  bool parallelFrames(const std::string& code) {
+    auto script = BackgroundScript::current();
+    if (!script || BackgroundScript::currentFrame() >= 0) {
+      inject<script::EngineDelegate>{}->onConsolePrint("app.parallelFrames() can only be used in background scripts.");
+      return false;
+    }
+    return script->parallelFrames(code);
+  }
+
   bool updateSite() {
+    if (auto script = BackgroundScript::current()) {
+      m_site = script->context()->activeSite();
+      return true;
+    }
+
     app::Document* doc = UIContext::instance()->activeDocument();
     app::DocumentView* m_view = UIContext::instance()->getFirstDocumentView(doc);
     if (!m_view)
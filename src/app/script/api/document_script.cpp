@@ -7,6 +7,7 @@
 
 #include "script/engine.h"
 #include "app/document.h"
+#include "app/script/background_script.h"
 #include "app/ui_context.h"
 
 class DocumentScriptObject : public script::ScriptObject {
@@ -18,7 +19,9 @@ public:
   void* getWrapped() override {return m_doc;}
 
   Provides provides{this, "activeDocument"};
-  doc::Document* m_doc{app::UIContext::instance()->activeDocument()};
+  doc::Document* m_doc{app::BackgroundScript::current() ?
+                       app::BackgroundScript::current()->document():
+                       app::UIContext::instance()->activeDocument()};
   inject<ScriptObject> m_sprite{"SpriteScriptObject"};
 };
 
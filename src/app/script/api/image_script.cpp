@@ -7,6 +7,7 @@
 
 #include "script/script_object.h"
 #include "doc/image.h"
+#include "doc/image_hash.h"
 #include <cstring>
 
 class ImageScriptObject : public script::ScriptObject {
@@ -24,6 +25,9 @@ public:
     addProperty("format", [this]{return (int) m_image->pixelFormat();})
       .doc("read-only. The PixelFormat of the image.");
 
+    addProperty("hash", [this]{return doc::get_image_hash(m_image).toString();})
+      .doc("read-only. A 128-bit hash of the image content (32 hexadecimal digits). Images with the same hash have the same pixels.");
+
     addFunction("getPixel", [this](int x, int y){return m_image->getPixel(x, y);})
       .doc("reads a color from the given coordinate of the image.")
       .docArg("x", "integer")
@@ -55,6 +59,7 @@ public:
       return;
     }
     std::memcpy(m_image->getPixelAddress(0, 0), data.data(), data.size());
+    m_image->incrementVersion();
   }
 
   script::Value getImageData() {
@@ -66,12 +71,15 @@ public:
   }
 
   void putPixel(int x, int y, int color) {
-    if (unsigned(x) < unsigned(m_image->width()) && unsigned(y) < unsigned(m_image->height()))
+    if (unsigned(x) < unsigned(m_image->width()) && unsigned(y) < unsigned(m_image->height())) {
       m_image->putPixel(x, y, color);
+      m_image->incrementVersion();
+    }
   }
 
   void clear(int color) {
     m_image->clear(color);
+    m_image->incrementVersion();
   }
 
   void* getWrapped() override {return m_image;}
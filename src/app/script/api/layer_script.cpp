@@ -5,6 +5,7 @@
 // it under the terms of the GNU General Public License version 2 as
 // published by the Free Software Foundation.
 
+#include "app/script/background_script.h"
 #include "script/script_object.h"
 #include "doc/layer.h"
 
@@ -14,7 +15,8 @@ public:
     addProperty("name",
                 [this]{return m_layer->name();},
                 [this](const std::string& name){
-                  m_layer->setName(name);
+                  if (app::BackgroundScript::canModifySprite())
+                    m_layer->setName(name);
                   return name;
                 })
       .doc("read+write. The name of the layer.");
@@ -31,7 +33,8 @@ public:
     addProperty("isVisible",
                 [this]{return m_layer->isVisible();},
                 [this](bool i){
-                  m_layer->setVisible(i);
+                  if (app::BackgroundScript::canModifySprite())
+                    m_layer->setVisible(i);
                   return i;
                 })
       .doc("read+write. Gets/sets whether the layer is visible or not.");
@@ -39,7 +42,8 @@ public:
     addProperty("isEditable",
                 [this]{return m_layer->isEditable();},
                 [this](bool i){
-                  m_layer->setEditable(i);
+                  if (app::BackgroundScript::canModifySprite())
+                    m_layer->setEditable(i);
                   return i;
                 })
       .doc("read+write. Gets/sets whether the layer is editable (unlocked) or not (locked).");
@@ -6,6 +6,7 @@
 // published by the Free Software Foundation.
 
 #include "app/modules/palettes.h"
+#include "app/script/background_script.h"
 #include "doc/palette.h"
 #include "doc/image.h"
 #include "doc/sprite.h"
@@ -18,7 +19,13 @@ public:
   PaletteScriptObject() {
     addProperty("length",
                 [this]{return m_pal->size();},
-                [this](int s){m_pal->resize(s); modify(); return s;});
+                [this](int s){
+                  if (app::BackgroundScript::canModifySprite()) {
+                    m_pal->resize(s);
+                    modify();
+                  }
+                  return s;
+                });
 
     addFunction("get", [this](int i){return m_pal->getEntry(i);});
 
@@ -31,14 +38,19 @@ public:
       needIncrement = true;
       m_engine->afterEval([=](bool success){
           m_pal->incrementVersion();
-          app::set_current_palette(m_pal, true);
-          ui::Manager::getDefault()->invalidate();
+          // Background scripts modify a copy of the palette in a
+          // worker thread, the UI is updated when their changes are
+          // applied.
+          if (!app::BackgroundScript::current()) {
+              app::set_current_palette(m_pal, true);
+              ui::Manager::getDefault()->invalidate();
+          }
           needIncrement = false;
       });
   }
 
   void set(int i){
-      if (i >= m_pal->size())
+      if (i >= m_pal->size() || !app::BackgroundScript::canModifySprite())
           return;
       auto& args = script::Function::varArgs();
       int c;
@@ -10,11 +10,14 @@
 #include "app/document.h"
 #include "app/document_api.h"
 #include "app/file/palette_file.h"
+#include "app/script/background_script.h"
 #include "app/transaction.h"
 #include "app/ui_context.h"
 #include "doc/document_observer.h"
+#include "doc/image_hash.h"
 #include "doc/mask.h"
 #include "doc/palette.h"
+#include "script/engine_delegate.h"
 #include "script/script_object.h"
 
 #include <memory>
@@ -44,7 +47,8 @@ public:
     addProperty("width",
                 [this]{return m_sprite->width();},
                 [this](int width){
-                  transaction().execute(new app::cmd::SetSpriteSize(m_sprite, width, m_sprite->height()));
+                  if (canModifySprite())
+                    transaction().execute(new app::cmd::SetSpriteSize(m_sprite, width, m_sprite->height()));
                   return 0;
                 })
       .doc("read+write. Returns and sets the width of the sprite.");
@@ -52,7 +56,8 @@ public:
     addProperty("height",
                 [this]{return m_sprite->height();},
                 [this](int height){
-                  transaction().execute(new app::cmd::SetSpriteSize(m_sprite, m_sprite->width(), height));
+                  if (canModifySprite())
+                    transaction().execute(new app::cmd::SetSpriteSize(m_sprite, m_sprite->width(), height));
                   return 0;
                 })
       .doc("read+write. Returns and sets the height of the sprite.");
@@ -96,6 +101,10 @@ public:
     addMethod("loadPalette", &SpriteScriptObject::loadPalette)
       .doc("loads a palette file.")
       .docArg("fileName", "The name of the palette file to load");
+
+    addMethod("hashImages", &SpriteScriptObject::hashImages)
+      .doc("calculates in parallel the content hash of all images in the sprite, so image.hash returns the cached value.")
+      .docReturns("the number of hashed images.");
   }
 
   ~SpriteScriptObject() {
@@ -108,9 +117,30 @@ public:
     return m_document->getWrapped<app::Document>();
   }
 
+  // Background scripts work with a copy of the document, in its own context
+  app::Context* context() {
+    if (auto script = app::BackgroundScript::current())
+      return script->context();
+    return app::UIContext::instance();
+  }
+
+  // The sprite is shared between the threads of app.parallelFrames()
+  bool canModifySprite() {
+    return app::BackgroundScript::canModifySprite();
+  }
+
+  // The background script is saved when its changes are applied
+  bool canSave() {
+    if (app::BackgroundScript::current()) {
+      inject<script::EngineDelegate>{}->onConsolePrint("Sprites cannot be saved from background scripts.");
+      return false;
+    }
+    return true;
+  }
+
   app::Transaction& transaction() {
     if (!m_transaction) {
-      m_transaction.reset(new app::Transaction(app::UIContext::instance(),
+      m_transaction.reset(new app::Transaction(context(),
                                                "Script Execution",
                                                app::ModifyDocument));
     }
@@ -127,6 +157,13 @@ public:
     }
   }
 
+  int hashImages() {
+    std::vector<doc::Image*> images;
+    m_sprite->getImages(images);
+    doc::get_image_hashes(std::vector<const doc::Image*>(images.begin(), images.end()));
+    return images.size();
+  }
+
   script::ScriptObject* layer(int i) {
     auto layer = m_sprite->indexToLayer(doc::LayerIndex(i));
     if (!layer)
@@ -140,11 +177,16 @@ public:
   }
 
   void resize(int w, int h) {
+    if (!canModifySprite())
+      return;
     app::DocumentApi api(doc(), transaction());
     api.setSpriteSize(m_sprite, w, h);
   }
 
   void crop(script::Value x, script::Value y, script::Value w, script::Value h){
+    if (!canModifySprite())
+      return;
+
     gfx::Rect bounds;
     commit();
 
@@ -164,6 +206,8 @@ public:
   }
 
   void save() {
+    if (!canSave())
+      return;
     commit();
     auto uiCtx = app::UIContext::instance();
     uiCtx->setActiveDocument(doc());
@@ -172,6 +216,8 @@ public:
   }
 
   void saveAs(const std::string& fileName, bool asCopy) {
+    if (!canSave())
+      return;
     commit();
     if (fileName.empty()) asCopy = false;
     auto uiCtx = app::UIContext::instance();
@@ -185,6 +231,8 @@ public:
   }
 
   void loadPalette(const std::string& fileName){
+    if (!canModifySprite())
+      return;
     std::unique_ptr<doc::Palette> palette(app::load_palette(fileName.c_str()));
     if (palette) {
       // TODO Merge this with the code in LoadPaletteCommand
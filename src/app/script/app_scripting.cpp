@@ -12,6 +12,8 @@
 
 #include "app/document.h"
 #include "app/script/app_scripting.h"
+#include "app/context.h"
+#include "app/script/background_script.h"
 #include "base/file_handle.h"
 #include "base/path.h"
 #include "base/string.h"
@@ -79,6 +81,34 @@ namespace app {
     return true;
   }
 
+  bool AppScripting::evalFileInBackground(const std::string& fileName, Context* context) {
+    // Without a document there is nothing to copy
+    if (!context->activeDocument())
+      return evalFile(fileName);
+
+    std::ifstream ifs(fileName);
+    if (!ifs) {
+      std::cout << "Could not open " << fileName << std::endl;
+      return false;
+    }
+
+    // The default engine must be set before starting the worker thread
+    auto extension = base::string_to_lower(base::get_file_extension(fileName));
+    script::Engine::setDefault(extension, {extension});
+
+    BackgroundScript script(fileName,
+                            {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()},
+                            context);
+    return script.run();
+  }
+
+  bool AppScripting::isBackgroundScript(const std::string& fileName) {
+    std::ifstream ifs(fileName);
+    std::string line;
+    return (std::getline(ifs, line) &&
+            line.find("@background") != std::string::npos);
+  }
+
   void AppScripting::printLastResult() {
     if(engine)
       engine->printLastResult();
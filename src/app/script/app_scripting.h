@@ -15,6 +15,7 @@ namespace script {
 };
 
 namespace app {
+  class Context;
 
   class AppScripting {
     void initEngine();
@@ -23,6 +24,12 @@ namespace app {
   public:
     static const std::string& getFileName() {return m_fileName;}
     static bool evalFile(const std::string& fileName);
+
+    // Runs the script in a worker thread against a copy of the active
+    // document (see BackgroundScript). Scripts that must run in this
+    // way can contain "@background" in their first line.
+    static bool evalFileInBackground(const std::string& fileName, Context* context);
+    static bool isBackgroundScript(const std::string& fileName);
     static void raiseEvent(const std::string& fileName, const std::string& event);
 
     bool eval(const std::string& code);
@@ -0,0 +1,376 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/background_script.h"
+
+#include "app/cmd/add_cel.h"
+#include "app/cmd/remove_cel.h"
+#include "app/cmd/replace_image.h"
+#include "app/cmd/set_cel_position.h"
+#include "app/cmd/set_layer_flags.h"
+#include "app/cmd/set_layer_name.h"
+#include "app/cmd/set_mask.h"
+#include "app/cmd/set_palette.h"
+#include "app/cmd/set_sprite_size.h"
+#include "app/context.h"
+#include "app/context_access.h"
+#include "app/document.h"
+#include "app/modules/gui.h"
+#include "app/modules/palettes.h"
+#include "app/transaction.h"
+#include "base/parallel_for.h"
+#include "base/path.h"
+#include "base/scoped_lock.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/image_hash.h"
+#include "doc/layer.h"
+#include "doc/mask.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/site.h"
+#include "doc/sprite.h"
+#include "script/engine.h"
+#include "script/engine_delegate.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace app {
+
+// Context of the snapshot in the worker threads
+class SnapshotContext : public Context {
+public:
+  SnapshotContext(Document* document, doc::LayerIndex layerIndex, doc::frame_t frame)
+    : m_document(document)
+    , m_layerIndex(layerIndex)
+    , m_frame(frame) {
+    m_document->setContext(this);
+  }
+
+  Document* document() const { return m_document; }
+
+protected:
+  void onGetActiveSite(doc::Site* site) const override {
+    doc::frame_t frame = BackgroundScript::currentFrame();
+    if (frame < 0)
+      frame = m_frame;
+
+    site->document(m_document);
+    site->sprite(m_document->sprite());
+    site->layer(m_document->sprite()->indexToLayer(m_layerIndex));
+    site->frame(frame);
+  }
+
+private:
+  Document* m_document;
+  doc::LayerIndex m_layerIndex;
+  doc::frame_t m_frame;
+};
+
+namespace {
+
+thread_local BackgroundScript* current_script = nullptr;
+thread_local doc::frame_t current_frame = -1;
+
+// Sets the background script of the current thread
+class ScopedScriptThread {
+public:
+  ScopedScriptThread(BackgroundScript* script) {
+    current_script = script;
+  }
+  ~ScopedScriptThread() {
+    current_script = nullptr;
+    current_frame = -1;
+  }
+};
+
+// Collects the console.log() output of the worker threads (the
+// console is a UI element)
+class OutputDelegate : public script::EngineDelegate {
+public:
+  OutputDelegate(BackgroundScript* script) : m_script(script) { }
+
+  void onConsolePrint(const char* text) override {
+    m_script->print(text);
+  }
+
+private:
+  BackgroundScript* m_script;
+  script::EngineDelegate::Provides m_provides{this};
+};
+
+} // anonymous namespace
+
+BackgroundScript::BackgroundScript(const std::string& fileName,
+                                   const std::string& code,
+                                   Context* context)
+  : Job(base::get_file_name(fileName).c_str())
+  , m_fileName(fileName)
+  , m_code(code)
+  , m_context(context)
+  , m_document(context->activeDocument())
+  , m_frame(0)
+  , m_success(false)
+{
+  doc::Site site = context->activeSite();
+  m_layerIndex = site.layerIndex();
+  m_frame = site.frame();
+
+  if (m_document) {
+    Document* copy = m_document->duplicate(DuplicateExactCopy);
+    copy->setMask(m_document->mask());
+    copy->setMaskVisible(m_document->isMaskVisible());
+    m_snapshot.reset(new SnapshotContext(copy, m_layerIndex, m_frame));
+  }
+}
+
+BackgroundScript::~BackgroundScript()
+{
+  // The SnapshotContext deletes the copy of the document
+}
+
+bool BackgroundScript::run()
+{
+  if (!m_snapshot)
+    return false;
+
+  startJob();
+  waitJob();
+  flushOutput();
+
+  if (isCanceled() || !m_success)
+    return false;
+
+  applyChanges();
+  return true;
+}
+
+// static
+BackgroundScript* BackgroundScript::current()
+{
+  return current_script;
+}
+
+// static
+doc::frame_t BackgroundScript::currentFrame()
+{
+  return current_frame;
+}
+
+// static
+bool BackgroundScript::canModifySprite()
+{
+  if (current_frame >= 0) {
+    inject<script::EngineDelegate> delegate;
+    if (delegate)
+      delegate->onConsolePrint("The sprite cannot be modified in app.parallelFrames().");
+    return false;
+  }
+  return true;
+}
+
+Document* BackgroundScript::document() const
+{
+  return (m_snapshot ? m_snapshot->document(): nullptr);
+}
+
+Context* BackgroundScript::context() const
+{
+  return m_snapshot.get();
+}
+
+void BackgroundScript::print(const std::string& text)
+{
+  base::scoped_lock lock(m_outputMutex);
+  m_output.push_back(text);
+}
+
+bool BackgroundScript::parallelFrames(const std::string& code)
+{
+  const int nframes = document()->sprite()->totalFrames();
+  const int nthreads = base::parallel_threads(nframes);
+  std::atomic<int> next(0);
+  std::atomic<int> done(0);
+  std::atomic<bool> success(true);
+
+  // Each thread has its own engine (with its own script objects)
+  // and evaluates frames until all of them are processed. The calling
+  // thread is running its own engine, so frames are processed only in
+  // new threads.
+  base::parallel_for_threads(
+    nthreads, nthreads,
+    [&](int, int){
+      ScopedScriptThread scoped(this);
+      OutputDelegate output(this);
+      inject<script::Engine> engine;
+      if (!engine) {
+        success = false;
+        return;
+      }
+
+      for (int frame; (frame = next++) < nframes; ) {
+        if (!success || isCanceled())
+          break;
+
+        current_frame = frame;
+        if (!engine->eval(code))
+          success = false;
+        current_frame = -1;
+
+        jobProgress(double(++done) / nframes);
+      }
+    }, false);
+
+  return success && !isCanceled();
+}
+
+void BackgroundScript::onJob()
+{
+  ScopedScriptThread scoped(this);
+  OutputDelegate output(this);
+  inject<script::Engine> engine;
+  if (!engine) {
+    print("No compatible scripting engine.");
+    return;
+  }
+
+  if (engine->eval(m_code) && !isCanceled()) {
+    engine->raiseEvent("init");
+    m_success = !isCanceled();
+  }
+}
+
+void BackgroundScript::onMonitoringTick()
+{
+  flushOutput();
+  Job::onMonitoringTick();
+}
+
+void BackgroundScript::flushOutput()
+{
+  std::vector<std::string> output;
+  {
+    base::scoped_lock lock(m_outputMutex);
+    std::swap(output, m_output);
+  }
+  if (output.empty())
+    return;
+
+  inject<script::EngineDelegate> delegate;
+  if (delegate) {
+    for (const auto& text : output)
+      delegate->onConsolePrint(text.c_str());
+  }
+}
+
+// Converts the differences between the snapshot and the original
+// document in commands.
+void BackgroundScript::applyChanges()
+{
+  ContextWriter writer(m_context);
+  if (writer.document() != m_document)
+    return;
+
+  const doc::Sprite* src = document()->sprite();
+  doc::Sprite* dst = m_document->sprite();
+
+  // Scripts cannot add or remove layers/frames
+  if (src->countLayers() != dst->countLayers() ||
+      src->totalFrames() != dst->totalFrames()) {
+    print("The script changed the layers or frames of the sprite, its changes were discarded.");
+    flushOutput();
+    return;
+  }
+
+  Transaction transaction(writer.context(),
+                          "Script " + base::get_file_title(m_fileName),
+                          ModifyDocument, NotifyOnCommit);
+  int changes = 0;
+  auto execute =
+    [&](Cmd* cmd) {
+      transaction.execute(cmd);
+      ++changes;
+    };
+
+  if (src->width() != dst->width() || src->height() != dst->height())
+    execute(new cmd::SetSpriteSize(dst, src->width(), src->height()));
+
+  const bool paletteChanged = (*src->palette(0) != *dst->palette(0));
+  if (paletteChanged)
+    execute(new cmd::SetPalette(dst, 0, src->palette(0)));
+
+  const Document* srcDoc = document();
+  const bool maskChanged =
+    (srcDoc->isMaskVisible() != m_document->isMaskVisible() ||
+     (srcDoc->isMaskVisible() &&
+      (srcDoc->mask()->bounds() != m_document->mask()->bounds() ||
+       doc::count_diff_between_images(srcDoc->mask()->bitmap(),
+                                      m_document->mask()->bitmap()) != 0)));
+  if (maskChanged)
+    execute(new cmd::SetMask(m_document,
+                             srcDoc->isMaskVisible() ? srcDoc->mask(): nullptr));
+
+  for (int i=0; i<src->countLayers(); ++i) {
+    const doc::Layer* srcLayer = src->indexToLayer(doc::LayerIndex(i));
+    doc::Layer* dstLayer = dst->indexToLayer(doc::LayerIndex(i));
+
+    if (srcLayer->name() != dstLayer->name())
+      execute(new cmd::SetLayerName(dstLayer, srcLayer->name()));
+    if (srcLayer->flags() != dstLayer->flags())
+      execute(new cmd::SetLayerFlags(dstLayer, srcLayer->flags()));
+
+    if (!srcLayer->isImage() || !dstLayer->isImage())
+      continue;
+
+    for (doc::frame_t frame=0; frame<src->totalFrames(); ++frame) {
+      const doc::Cel* srcCel = srcLayer->cel(frame);
+      doc::Cel* dstCel = dstLayer->cel(frame);
+
+      if (!srcCel) {
+        if (dstCel)
+          execute(new cmd::RemoveCel(dstCel));
+        continue;
+      }
+      if (!dstCel) {
+        execute(new cmd::AddCel(dstLayer, doc::Cel::createCopy(srcCel)));
+        continue;
+      }
+
+      if (srcCel->position() != dstCel->position())
+        execute(new cmd::SetCelPosition(dstCel, srcCel->x(), srcCel->y()));
+
+      // Linked cels share the image, so once the image is replaced
+      // the next cels of the link have the same content.
+      if (doc::calculate_image_hash(srcCel->image()) !=
+          doc::get_image_hash(dstCel->image())) {
+        std::shared_ptr<doc::Image> newImage(doc::Image::createCopy(srcCel->image()));
+        execute(new cmd::ReplaceImage(dst, dstCel->imageRef(), newImage));
+      }
+    }
+  }
+
+  if (changes == 0)
+    return;
+
+  transaction.commit();
+
+  // The palette and the selection of the snapshot were modified in
+  // the worker thread, the UI is updated here.
+  if (paletteChanged)
+    set_current_palette(dst->palette(m_frame), true);
+  if (maskChanged)
+    m_document->generateMaskBoundaries();
+  update_screen_for_document(m_document);
+}
+
+} // namespace app
@@ -0,0 +1,91 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "app/job.h"
+#include "base/mutex.h"
+#include "doc/frame.h"
+#include "doc/layer_index.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace app {
+  class Context;
+  class Document;
+  class SnapshotContext;
+
+  // Runs a script in a worker thread against a copy (snapshot) of the
+  // active document, so the UI is not blocked and the document isn't
+  // modified while the script is running. When the script finishes,
+  // the differences between the snapshot and the document are applied
+  // as commands in one transaction (undoable in one step).
+  //
+  // Scripts can report progress with app.reportProgress(), check if
+  // the user canceled the script with app.isCanceled, and process
+  // frames in parallel with app.parallelFrames(code).
+  class BackgroundScript : public Job {
+  public:
+    BackgroundScript(const std::string& fileName, const std::string& code,
+                     Context* context);
+    ~BackgroundScript();
+
+    // Runs the script showing a progress window. Returns true if the
+    // script finished successfully and its changes were applied.
+    bool run();
+
+    // Returns the background script running in the current thread
+    // (nullptr in the UI thread).
+    static BackgroundScript* current();
+
+    // Frame processed by the current thread in parallelFrames(), or
+    // -1 if the current thread isn't processing one frame.
+    static doc::frame_t currentFrame();
+
+    // Returns false (and prints a message in the console) if the
+    // current thread is processing a frame in parallelFrames(), where
+    // the sprite, its layers and palettes are shared between threads.
+    static bool canModifySprite();
+
+    Document* document() const;
+    Context* context() const;
+    doc::LayerIndex layerIndex() const { return m_layerIndex; }
+    doc::frame_t frame() const { return m_frame; }
+
+    // Output of console.log(), it's shown when the UI thread is free.
+    void print(const std::string& text);
+
+    // Evaluates the given code in one engine per thread for each frame
+    // of the snapshot. Frames are processed concurrently, so the code
+    // can modify the cels of its frame (app.activeFrameNumber) but not
+    // the sprite (e.g. resize it). Cels linked between frames share
+    // their image and must not be modified.
+    bool parallelFrames(const std::string& code);
+
+  protected:
+    void onJob() override;
+    void onMonitoringTick() override;
+
+  private:
+    void flushOutput();
+    void applyChanges();
+
+    std::string m_fileName;
+    std::string m_code;
+    Context* m_context;                 // Context of the original document
+    Document* m_document;               // Original document
+    std::unique_ptr<SnapshotContext> m_snapshot;
+    doc::LayerIndex m_layerIndex;
+    doc::frame_t m_frame;
+    bool m_success;
+    base::mutex m_outputMutex;
+    std::vector<std::string> m_output;
+  };
+
+} // namespace app
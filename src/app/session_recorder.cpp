@@ -0,0 +1,480 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/session_recorder.h"
+
+#include "app/commands/command.h"
+#include "app/commands/commands.h"
+#include "app/context.h"
+#include "app/document.h"
+#include "base/fstream_path.h"
+#include "base/log.h"
+#include "base/phase_timer.h"
+#include "she/display.h"
+#include "ui/manager.h"
+#include "ui/timer.h"
+#include "ui/window.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace app {
+
+namespace {
+
+const char* kHeader = "# LibreSprite session log";
+
+std::string escape(const std::string& str)
+{
+  std::string result;
+  for (unsigned char chr : str) {
+    if (chr <= ' ' || chr == '%' || chr == '=' || chr >= 127) {
+      char buf[4];
+      std::sprintf(buf, "%%%02X", chr);
+      result += buf;
+    }
+    else
+      result.push_back(chr);
+  }
+  return result;
+}
+
+std::string unescape(const std::string& str)
+{
+  std::string result;
+  for (size_t i=0; i<str.size(); ++i) {
+    if (str[i] == '%' && i+2 < str.size()) {
+      result.push_back(char(std::strtol(str.substr(i+1, 2).c_str(), nullptr, 16)));
+      i += 2;
+    }
+    else
+      result.push_back(str[i]);
+  }
+  return result;
+}
+
+void write_event(std::ostream& os, const she::Event& ev)
+{
+  os << int(ev.type()) << ' '
+     << ev.position().x << ' ' << ev.position().y << ' '
+     << int(ev.button()) << ' '
+     << int(ev.modifiers()) << ' '
+     << int(ev.scancode()) << ' '
+     << ev.unicodeChar() << ' '
+     << ev.repeat() << ' '
+     << ev.wheelDelta().x << ' ' << ev.wheelDelta().y << ' '
+     << (ev.preciseWheel() ? 1: 0) << ' '
+     << int(ev.pointerType()) << ' '
+     << ev.magnification() << ' '
+     << ev.pressure();
+
+  for (const auto& file : ev.files())
+    os << ' ' << escape(file);
+}
+
+bool read_event(std::istream& is, she::Event& ev)
+{
+  int type, x, y, button, modifiers, scancode, unicodeChar, repeat;
+  int wheelX, wheelY, preciseWheel, pointerType;
+  double magnification, pressure;
+
+  if (!(is >> type >> x >> y >> button >> modifiers >> scancode
+           >> unicodeChar >> repeat >> wheelX >> wheelY
+           >> preciseWheel >> pointerType >> magnification >> pressure))
+    return false;
+
+  ev.setType(she::Event::Type(type));
+  ev.setPosition(gfx::Point(x, y));
+  ev.setButton(she::Event::MouseButton(button));
+  ev.setModifiers(she::KeyModifiers(modifiers));
+  ev.setScancode(she::KeyScancode(scancode));
+  ev.setUnicodeChar(unicodeChar);
+  ev.setRepeat(repeat);
+  ev.setWheelDelta(gfx::Point(wheelX, wheelY));
+  ev.setPreciseWheel(preciseWheel ? true: false);
+  ev.setPointerType(she::PointerType(pointerType));
+  ev.setMagnification(magnification);
+  ev.setPressure(pressure);
+
+  she::Event::Files files;
+  std::string file;
+  while (is >> file)
+    files.push_back(unescape(file));
+  ev.setFiles(files);
+  return true;
+}
+
+} // anonymous namespace
+
+//////////////////////////////////////////////////////////////////////
+// SessionRecorder
+
+SessionRecorder::SessionRecorder(const std::string& filename,
+                                 Context* context,
+                                 ui::Manager* manager)
+  : m_file(FSTREAM_PATH(filename))
+  , m_manager(manager)
+  , m_queue(manager ? manager->eventQueue(): nullptr)
+  , m_start(base::current_tick())
+  , m_batch(false)
+  , m_commandLevel(0)
+{
+  if (!m_file)
+    throw std::runtime_error("Cannot create the session file " + filename);
+
+  m_file << kHeader << "\n";
+
+  for (auto doc : context->documents()) {
+    if (static_cast<app::Document*>(doc)->isAssociatedToFile())
+      m_file << "document " << escape(doc->filename()) << "\n";
+  }
+
+  if (m_manager) {
+    if (she::Display* display = m_manager->getDisplay())
+      m_file << "display "
+             << display->width() << ' '
+             << display->height() << ' '
+             << display->scale() << "\n";
+    m_manager->setEventQueue(this);
+  }
+
+  m_beforeConn = context->BeforeCommandExecution.connect(
+    &SessionRecorder::onBeforeCommandExecution, this);
+  m_afterConn = context->AfterCommandExecution.connect(
+    &SessionRecorder::onAfterCommandExecution, this);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+  if (m_manager)
+    m_manager->setEventQueue(m_queue);
+}
+
+void SessionRecorder::getEvent(she::Event& ev, bool canWait)
+{
+  m_queue->getEvent(ev, canWait);
+
+  if (ev.type() != she::Event::None) {
+    m_file << "event " << msecs() << ' ';
+    write_event(m_file, ev);
+    m_file << "\n";
+    m_batch = true;
+  }
+  // The manager takes events until the queue is empty, this is the
+  // end of a group of events.
+  else if (m_batch) {
+    m_file << "sync " << msecs() << "\n";
+    m_file.flush();
+    m_batch = false;
+  }
+}
+
+void SessionRecorder::queueEvent(const she::Event& ev)
+{
+  m_queue->queueEvent(ev);
+}
+
+bool SessionRecorder::canWaitEvents() const
+{
+  return m_queue->canWaitEvents();
+}
+
+void SessionRecorder::waitEvents(int timeoutMsecs)
+{
+  m_queue->waitEvents(timeoutMsecs);
+}
+
+void SessionRecorder::wakeUp()
+{
+  m_queue->wakeUp();
+}
+
+void SessionRecorder::onBeforeCommandExecution(CommandExecutionEvent& ev)
+{
+  // Commands executed by other commands are not recorded, they will
+  // be executed again by the top-level command.
+  if (m_commandLevel++ > 0)
+    return;
+
+  m_file << "command " << msecs() << ' ' << escape(ev.command()->id());
+  for (const auto& param : ev.params())
+    m_file << ' ' << escape(param.first) << '=' << escape(param.second);
+  m_file << "\n";
+  m_file.flush();
+}
+
+void SessionRecorder::onAfterCommandExecution(CommandExecutionEvent& ev)
+{
+  if (m_commandLevel > 0)
+    --m_commandLevel;
+}
+
+base::tick_t SessionRecorder::msecs() const
+{
+  return base::current_tick() - m_start;
+}
+
+//////////////////////////////////////////////////////////////////////
+// SessionReplayer
+
+SessionReplayer::SessionReplayer(const std::string& filename)
+  : m_filename(filename)
+  , m_pos(0)
+  , m_finished(false)
+  , m_manager(nullptr)
+  , m_queue(nullptr)
+  , m_start(0)
+  , m_end(0)
+{
+  load(filename);
+}
+
+SessionReplayer::~SessionReplayer()
+{
+  if (m_manager)
+    m_manager->setEventQueue(m_queue);
+
+  base::enable_phase_timing(false);
+}
+
+void SessionReplayer::load(const std::string& filename)
+{
+  std::ifstream file(FSTREAM_PATH(filename));
+  if (!file)
+    throw std::runtime_error("Cannot open the session file " + filename);
+
+  std::string line;
+  int lineNum = 0;
+  while (std::getline(file, line)) {
+    ++lineNum;
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::istringstream is(line);
+    std::string type;
+    is >> type;
+
+    if (type == "document") {
+      std::string fn;
+      is >> fn;
+      m_documents.push_back(unescape(fn));
+    }
+    else if (type == "display") {
+      is >> m_displaySize.w >> m_displaySize.h;
+    }
+    else {
+      Entry entry;
+      if (!(is >> entry.msecs))
+        type.clear();
+
+      if (type == "event") {
+        entry.type = Entry::Event;
+        if (!read_event(is, entry.event))
+          type.clear();
+      }
+      else if (type == "sync") {
+        entry.type = Entry::Sync;
+      }
+      else if (type == "command") {
+        entry.type = Entry::Command;
+        is >> entry.commandId;
+        entry.commandId = unescape(entry.commandId);
+
+        std::string param;
+        while (is >> param) {
+          size_t i = param.find('=');
+          if (i != std::string::npos)
+            entry.params.set(unescape(param.substr(0, i)),
+                             unescape(param.substr(i+1)));
+        }
+      }
+      else
+        type.clear();
+
+      if (type.empty()) {
+        LOG("Invalid entry in %s:%d\n", filename.c_str(), lineNum);
+        continue;
+      }
+
+      m_entries.push_back(entry);
+    }
+  }
+}
+
+void SessionReplayer::start(ui::Manager* manager)
+{
+  ASSERT(!m_manager);
+
+  if (she::Display* display = manager->getDisplay()) {
+    if (m_displaySize.w > 0 && m_displaySize.h > 0 &&
+        (display->width() != m_displaySize.w ||
+         display->height() != m_displaySize.h)) {
+      std::cerr << "The session was recorded with a "
+                << m_displaySize.w << "x" << m_displaySize.h
+                << " display, mouse positions will not match\n";
+    }
+  }
+
+  m_manager = manager;
+  m_queue = manager->eventQueue();
+  m_manager->setEventQueue(this);
+
+  m_timer = ui::Timer::create(100, *manager);
+  m_timer->Tick.connect(&SessionReplayer::onTick, this);
+  m_timer->start();
+
+  base::reset_phase_stats();
+  base::enable_phase_timing(true);
+  m_start = base::current_tick();
+}
+
+void SessionReplayer::runCommands(Context* context)
+{
+  base::reset_phase_stats();
+  base::enable_phase_timing(true);
+  m_start = base::current_tick();
+
+  for (const Entry& entry : m_entries) {
+    if (entry.type != Entry::Command)
+      continue;
+
+    Command* command = CommandsModule::instance()->getCommandByName(entry.commandId.c_str());
+    if (!command) {
+      LOG("Command '%s' not found replaying the session\n", entry.commandId.c_str());
+      continue;
+    }
+
+    context->executeCommand(command, entry.params);
+  }
+
+  m_end = base::current_tick();
+  m_pos = m_entries.size();
+  m_finished = true;
+  base::enable_phase_timing(false);
+}
+
+void SessionReplayer::printReport(std::ostream& os) const
+{
+  int events = 0, commands = 0;
+  for (const Entry& entry : m_entries) {
+    if (entry.type == Entry::Event)
+      ++events;
+    else if (entry.type == Entry::Command)
+      ++commands;
+  }
+
+  const int recorded = (m_entries.empty() ? 0: m_entries.back().msecs);
+  const base::tick_t end = (m_finished ? m_end: base::current_tick());
+
+  os << "Replayed " << m_filename << ": "
+     << events << " events, " << commands << " commands in "
+     << (end - m_start) << " ms (recorded in " << recorded << " ms)"
+     << (m_finished ? "": ", not finished") << "\n";
+
+  std::vector<base::PhaseStats> stats = base::get_phase_stats();
+  std::sort(stats.begin(), stats.end(),
+            [](const base::PhaseStats& a, const base::PhaseStats& b) {
+              return a.total > b.total;
+            });
+
+  os << std::left << std::setw(16) << "Phase" << std::right
+     << std::setw(10) << "Count"
+     << std::setw(14) << "Total (ms)"
+     << std::setw(12) << "Avg (ms)"
+     << std::setw(12) << "Max (ms)" << "\n";
+
+  os << std::fixed << std::setprecision(3);
+  for (const auto& s : stats) {
+    os << std::left << std::setw(16) << s.name << std::right
+       << std::setw(10) << s.count
+       << std::setw(14) << s.total*1000.0
+       << std::setw(12) << (s.count > 0 ? s.total*1000.0/s.count: 0.0)
+       << std::setw(12) << s.max*1000.0 << "\n";
+  }
+}
+
+void SessionReplayer::getEvent(she::Event& ev, bool canWait)
+{
+  // Events from the user are discarded while the session is being
+  // replayed, except the ones to close/resize the display.
+  if (!m_finished) {
+    for (;;) {
+      m_queue->getEvent(ev, false);
+      if (ev.type() == she::Event::None)
+        break;
+      if (ev.type() == she::Event::CloseDisplay ||
+          ev.type() == she::Event::ResizeDisplay)
+        return;
+    }
+  }
+  else {
+    m_queue->getEvent(ev, canWait);
+    return;
+  }
+
+  ev = she::Event();
+
+  while (m_pos < m_entries.size()) {
+    const Entry& entry = m_entries[m_pos++];
+    if (entry.type == Entry::Event) {
+      ev = entry.event;
+      return;
+    }
+    // End of this group of events, the next group is given in the
+    // next Manager::generateMessages() call.
+    else if (entry.type == Entry::Sync) {
+      return;
+    }
+  }
+
+  if (!m_finished) {
+    m_finished = true;
+    m_end = base::current_tick();
+    base::enable_phase_timing(false);
+  }
+}
+
+void SessionReplayer::queueEvent(const she::Event& ev)
+{
+  m_queue->queueEvent(ev);
+}
+
+void SessionReplayer::waitEvents(int timeoutMsecs)
+{
+  // Don't wait while we have recorded events to give.
+  if (m_finished && m_queue->canWaitEvents())
+    m_queue->waitEvents(timeoutMsecs);
+}
+
+void SessionReplayer::wakeUp()
+{
+  m_queue->wakeUp();
+}
+
+void SessionReplayer::onTick()
+{
+  if (!m_finished)
+    return;
+
+  // Close the windows (one each tick, so nested message loops can
+  // finish) until the main window is closed.
+  if (ui::Window* window = m_manager->getTopWindow())
+    window->closeWindow(nullptr);
+  else
+    m_timer->stop();
+}
+
+} // namespace app
@@ -0,0 +1,138 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "app/commands/params.h"
+#include "base/connection.h"
+#include "base/disable_copying.h"
+#include "base/injection.h"
+#include "base/time.h"
+#include "she/event.h"
+#include "she/event_queue.h"
+
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace ui {
+  class Manager;
+  class Timer;
+}
+
+namespace app {
+  class CommandExecutionEvent;
+  class Context;
+
+  // Session logs are text files with one entry per line:
+  //
+  //   document <filename>       Documents opened when the session started
+  //   display <w> <h> <scale>   Size of the display
+  //   event <msecs> <fields...> A she::Event
+  //   sync <msecs>              End of a group of events received together
+  //   command <msecs> <id> [<param>=<value>...]
+  //
+  // Strings are escaped with %XX so they don't contain spaces or "=".
+
+  // Records the she events received by the UI manager and the
+  // commands executed in the context.
+  class SessionRecorder : public she::EventQueue {
+  public:
+    // The "manager" can be nullptr to record only commands (batch mode).
+    SessionRecorder(const std::string& filename,
+                    Context* context,
+                    ui::Manager* manager);
+    ~SessionRecorder();
+
+    // she::EventQueue implementation (we wrap the original queue)
+    void getEvent(she::Event& ev, bool canWait) override;
+    void queueEvent(const she::Event& ev) override;
+    bool canWaitEvents() const override;
+    void waitEvents(int timeoutMsecs) override;
+    void wakeUp() override;
+
+  private:
+    void onBeforeCommandExecution(CommandExecutionEvent& ev);
+    void onAfterCommandExecution(CommandExecutionEvent& ev);
+    base::tick_t msecs() const;
+
+    std::ofstream m_file;
+    ui::Manager* m_manager;
+    she::EventQueue* m_queue;
+    base::tick_t m_start;
+    bool m_batch;               // Events received since the last sync
+    int m_commandLevel;         // To record only top-level commands
+    base::ScopedConnection m_beforeConn;
+    base::ScopedConnection m_afterConn;
+
+    DISABLE_COPYING(SessionRecorder);
+  };
+
+  // Replays a session log. With UI, the recorded events are given to
+  // the UI manager one group at a time (each group is processed
+  // completely before the next one), so the replay doesn't depend on
+  // the timing of the machine. In batch mode the recorded commands
+  // are executed. Phase timing (base::ScopedPhase) is enabled while
+  // the session is replayed.
+  class SessionReplayer : public she::EventQueue {
+  public:
+    SessionReplayer(const std::string& filename);
+    ~SessionReplayer();
+
+    // Documents that were opened when the session was recorded
+    const std::vector<std::string>& documents() const { return m_documents; }
+
+    // Starts to give the recorded events to the manager, when all
+    // events are processed the windows are closed to finish the
+    // message loop.
+    void start(ui::Manager* manager);
+
+    // Executes the recorded commands (for batch mode).
+    void runCommands(Context* context);
+
+    bool isFinished() const { return m_finished; }
+
+    // Prints the time spent replaying the session in each phase.
+    void printReport(std::ostream& os) const;
+
+    // she::EventQueue implementation
+    void getEvent(she::Event& ev, bool canWait) override;
+    void queueEvent(const she::Event& ev) override;
+    bool canWaitEvents() const override { return true; }
+    void waitEvents(int timeoutMsecs) override;
+    void wakeUp() override;
+
+  private:
+    struct Entry {
+      enum Type { Event, Sync, Command };
+      Type type;
+      int msecs;
+      she::Event event;
+      std::string commandId;
+      Params params;
+    };
+
+    void load(const std::string& filename);
+    void onTick();
+
+    std::string m_filename;
+    std::vector<Entry> m_entries;
+    std::vector<std::string> m_documents;
+    gfx::Size m_displaySize;
+    size_t m_pos;
+    bool m_finished;
+    ui::Manager* m_manager;
+    she::EventQueue* m_queue;
+    inject<ui::Timer> m_timer{nullptr};
+    base::tick_t m_start;
+    base::tick_t m_end;
+
+    DISABLE_COPYING(SessionReplayer);
+  };
+
+} // namespace app
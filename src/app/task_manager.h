@@ -45,11 +45,13 @@ TaskManager::instance().addTask<Data>(
 
 #pragma once
 
+#include "she/event_queue.h"
 #include "ui/timer.h"
 
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
 #include <mutex>
@@ -111,6 +113,7 @@ namespace app {
 
     std::deque<std::shared_ptr<detail::Task>> pending;
     std::mutex pendingMutex;
+    std::condition_variable pendingCondition;
 
     std::deque<std::shared_ptr<detail::Task>> ready;
     std::recursive_mutex readyMutex;
@@ -126,7 +129,11 @@ namespace app {
     }
 
     ~TaskManager() {
-      isAlive = false;
+      {
+        std::lock_guard<std::mutex> guard(pendingMutex);
+        isAlive = false;
+      }
+      pendingCondition.notify_all();
       m_timer->stop();
 
       {
@@ -145,23 +152,25 @@ namespace app {
       std::shared_ptr<detail::Task> task;
 
       while (isAlive) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
         {
-          std::lock_guard<std::mutex> guard(pendingMutex);
+          // Sleep until there is a new task (or we're being destroyed)
+          std::unique_lock<std::mutex> lock(pendingMutex);
+          pendingCondition.wait(lock, [this]{
+              return !isAlive || !pending.empty();
+            });
           if (pending.empty()) {
             continue;
           }
           task = pending.front();
           pending.pop_front();
+
+          // Mark the task as processing before releasing the pending
+          // lock so isIdle() cannot miss it.
+          std::lock_guard<std::mutex> guard(processingMutex);
+          processing[id] = task;
         }
 
         if (task->isAlive) {
-          {
-            std::lock_guard<std::mutex> guard(processingMutex);
-            processing[id] = task;
-          }
-
           do {
             try {
               auto data = task->funcTask(task->isAlive);
@@ -173,17 +182,18 @@ namespace app {
                 std::lock_guard<std::recursive_mutex> guard(readyMutex);
                 ready.push_back(task);
               }
+              // Wake up the main thread in case it's waiting for events
+              she::wake_up_event_queue();
             } catch (...) {
               task->isAlive = false;
             }
           } while (task->isAlive);
           task->isDone = true;
+        }
 
-          {
-            std::lock_guard<std::mutex> guard(processingMutex);
-            processing[id].reset();
-          }
-
+        {
+          std::lock_guard<std::mutex> guard(processingMutex);
+          processing[id].reset();
         }
 
       }
@@ -219,6 +229,29 @@ namespace app {
         }
         task->funcCallback(data);
       }
+
+      // Stop polling when there is nothing else to do so the UI loop
+      // can sleep. The timer is restarted when a new task is added.
+      if (isIdle())
+        m_timer->stop();
+    }
+
+    // Workers push their results to "ready" before leaving the
+    // "processing" list, so we check "ready" at the end.
+    bool isIdle() {
+      {
+        std::lock_guard<std::mutex> guard(pendingMutex);
+        if (!pending.empty())
+          return false;
+
+        std::lock_guard<std::mutex> processingGuard(processingMutex);
+        for (auto& task : processing) {
+          if (task)
+            return false;
+        }
+      }
+      std::lock_guard<std::recursive_mutex> guard(readyMutex);
+      return ready.empty();
     }
 
   public:
@@ -248,6 +281,7 @@ namespace app {
           },
           [](detail::Task& task){task.isAlive = false;}
         });
+      pendingCondition.notify_one();
       return pending.back();
     }
 
@@ -270,6 +304,7 @@ namespace app {
             aborter();
           }
         });
+      pendingCondition.notify_one();
       return pending.back();
     }
 
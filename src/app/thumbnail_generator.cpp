@@ -197,6 +197,10 @@ void ThumbnailGenerator::addWorkerToGenerateThumbnail(IFileItem* fileitem)
   if (fop->hasError())
     return;
 
+  // Formats can decode a reduced image, so big files don't need
+  // full size buffers to create the thumbnail.
+  fop->setMaxSize(gfx::Size(MAX_THUMBNAIL_SIZE, MAX_THUMBNAIL_SIZE));
+
   Worker* worker = new Worker(fop.release(), fileitem);
   try {
     base::scoped_lock hold(m_workersAccess);
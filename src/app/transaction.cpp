@@ -21,7 +21,9 @@ namespace app {
 
 using namespace doc;
 
-Transaction::Transaction(Context* ctx, const std::string& label, Modification modification)
+Transaction::Transaction(Context* ctx, const std::string& label,
+                         Modification modification,
+                         Notifications notifications)
   : m_ctx(ctx)
   , m_cmds(NULL)
 {
@@ -34,6 +36,9 @@ Transaction::Transaction(Context* ctx, const std::string& label, Modification mo
   // SpritePosition. Sub-cmds are executed then one by one, in
   // Transaction::execute()
   m_cmds->execute(m_ctx);
+
+  if (notifications == NotifyOnCommit)
+    m_batch.reset(new DocumentNotificationBatch(m_ctx->activeDocument()));
 }
 
 Transaction::~Transaction()
@@ -58,16 +63,25 @@ void Transaction::commit()
   m_cmds->commit();
   m_undo->add(m_cmds);
   m_cmds = NULL;
+
+  // Deliver all notifications of the transaction
+  m_batch.reset();
 }
 
 void Transaction::rollback()
 {
   ASSERT(m_cmds);
 
-  m_cmds->undo();
+  // Undo all cmds notifying observers only once at the end
+  {
+    DocumentNotificationBatch batch(m_ctx->activeDocument());
+    m_cmds->undo();
+  }
 
   delete m_cmds;
   m_cmds = NULL;
+
+  m_batch.reset();
 }
 
 void Transaction::execute(Cmd* cmd)
@@ -7,8 +7,13 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
+namespace doc {
+  class DocumentNotificationBatch;
+}
+
 namespace app {
 
   class Cmd;
@@ -21,11 +26,25 @@ namespace app {
     DoesntModifyDocument // This item doesn't modify the document.
   };
 
+  enum Notifications {
+    NotifyEachCmd,       // Observers are notified while the transaction is open.
+    NotifyOnCommit       // Notifications are merged until the transaction ends.
+  };
+
   // High-level class to group a set of commands to modify the
   // document atomically, with enough information to rollback the
   // whole operation if something fails (e.g. an exceptions is thrown)
   // in the middle of the procedure.
   //
+  // By default notifications of the document are delivered
+  // immediately while the transaction is open (e.g. the editor must
+  // show each step of a brush stroke). Transactions that execute many
+  // cmds at once (e.g. moving frames, applying a filter to all cels)
+  // can use NotifyOnCommit to merge them (see
+  // doc::Document::notifyEvent()) and deliver them when the
+  // transaction is committed or rollbacked. The rollback merges them
+  // in both cases.
+  //
   // You have to wrap every call to an transaction with a
   // ContextWriter. The preferred usage is as follows:
   //
@@ -41,7 +60,9 @@ namespace app {
     // Starts a undoable sequence of operations in a transaction that
     // can be committed or rollbacked.  All the operations will be
     // grouped in the sprite's undo as an atomic operation.
-    Transaction(Context* ctx, const std::string& label, Modification mod = ModifyDocument);
+    Transaction(Context* ctx, const std::string& label,
+                Modification mod = ModifyDocument,
+                Notifications notifications = NotifyEachCmd);
     virtual ~Transaction();
 
     // This must be called to commit all the changes, so the undo will
@@ -60,6 +81,7 @@ namespace app {
     Context* m_ctx;
     DocumentUndo* m_undo;
     CmdTransaction* m_cmds;
+    std::unique_ptr<doc::DocumentNotificationBatch> m_batch;
   };
 
 } // namespace app
@@ -0,0 +1,113 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/cmd/set_cel_opacity.h"
+#include "app/cmd/set_cel_position.h"
+#include "app/context.h"
+#include "app/document.h"
+#include "app/transaction.h"
+#include "doc/cel.h"
+#include "doc/document_event.h"
+#include "doc/document_observer.h"
+#include "doc/layer.h"
+#include "doc/sprite.h"
+#include "doc/test_context.h"
+#include "gfx/region.h"
+
+#include <memory>
+
+using namespace app;
+using namespace doc;
+
+typedef std::unique_ptr<app::Document> DocumentPtr;
+
+namespace {
+
+  class PixelsObserver : public DocumentObserver {
+  public:
+    PixelsObserver() : pixels(0) { }
+    void onSpritePixelsModified(DocumentEvent&) override { ++pixels; }
+    int pixels;
+  };
+
+  class CelsObserver : public DocumentObserver {
+  public:
+    CelsObserver() : opacity(0), position(0) { }
+    void onCelOpacityChange(DocumentEvent&) override { ++opacity; }
+    void onCelPositionChanged(DocumentEvent&) override { ++position; }
+    int opacity;
+    int position;
+  };
+
+}
+
+// The editor must repaint each step of a brush stroke (the tool loop
+// notifies the modified pixels while its transaction is open).
+TEST(Transaction, NotifyPixelsWhileOpen)
+{
+  TestContextT<app::Context> ctx;
+  DocumentPtr doc(static_cast<app::Document*>(ctx.documents().add(32, 16)));
+  PixelsObserver obs;
+  doc->addObserver(&obs);
+
+  {
+    Transaction transaction(&ctx, "Stroke");
+    doc->notifySpritePixelsModified(
+      doc->sprite(), gfx::Region(gfx::Rect(0, 0, 2, 2)), frame_t(0));
+    EXPECT_EQ(1, obs.pixels);
+
+    doc->notifySpritePixelsModified(
+      doc->sprite(), gfx::Region(gfx::Rect(4, 4, 2, 2)), frame_t(0));
+    EXPECT_EQ(2, obs.pixels);
+
+    transaction.commit();
+  }
+  EXPECT_EQ(2, obs.pixels);
+
+  doc->removeObserver(&obs);
+  doc->close();
+}
+
+// Transactions with NotifyOnCommit merge the notifications of all
+// their cmds and deliver them when they are committed.
+TEST(Transaction, NotifyOnCommit)
+{
+  TestContextT<app::Context> ctx;
+  DocumentPtr doc(static_cast<app::Document*>(ctx.documents().add(32, 16)));
+  Cel* cel = doc->sprite()->folder()->getFirstLayer()->cel(frame_t(0));
+  CelsObserver obs;
+  doc->addObserver(&obs);
+
+  {
+    Transaction transaction(&ctx, "Bulk", ModifyDocument, NotifyOnCommit);
+    for (int i=0; i<10; ++i) {
+      transaction.execute(new cmd::SetCelOpacity(cel, 100+i));
+      transaction.execute(new cmd::SetCelPosition(cel, i, i));
+    }
+    EXPECT_EQ(0, obs.opacity);
+    EXPECT_EQ(0, obs.position);
+
+    transaction.commit();
+  }
+  EXPECT_EQ(1, obs.opacity);
+  EXPECT_EQ(1, obs.position);
+
+  // Each cmd is notified with the default mode
+  {
+    Transaction transaction(&ctx, "Steps");
+    for (int i=0; i<10; ++i)
+      transaction.execute(new cmd::SetCelOpacity(cel, 200+i));
+    EXPECT_EQ(11, obs.opacity);
+    transaction.commit();
+  }
+  EXPECT_EQ(11, obs.opacity);
+
+  doc->removeObserver(&obs);
+  doc->close();
+}
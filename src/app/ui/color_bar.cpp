@@ -568,14 +568,19 @@ void ColorBar::onRemapButtonClick()
       bool remapPixels = true;
 
       if (remap.isFor8bit()) {
-        PalettePicks usedEntries(256);
-
-        for (const Cel* cel : sprite->uniqueCels()) {
-          for (const auto& i : LockImageBits<IndexedTraits>(cel->image()))
-            usedEntries[i] = true;
+        // Reordering entries doesn't need to check the used entries
+        bool invertible = remap.isPermutation();
+        if (!invertible) {
+          PalettePicks usedEntries(256);
+
+          for (const Cel* cel : sprite->uniqueCels()) {
+            for (const auto& i : LockImageBits<IndexedTraits>(cel->image()))
+              usedEntries[i] = true;
+          }
+          invertible = remap.isInvertible(usedEntries);
         }
 
-        if (remap.isInvertible(usedEntries)) {
+        if (invertible) {
           transaction.execute(new cmd::RemapColors(sprite, remap));
           remapPixels = false;
         }
@@ -583,14 +588,21 @@ void ColorBar::onRemapButtonClick()
 
       // Special remap saving original images in undo history
       if (remapPixels) {
+        std::vector<std::shared_ptr<doc::Image> > celImages, newImages;
+        std::vector<doc::Image*> images;
         for (Cel* cel : sprite->uniqueCels()) {
           std::shared_ptr<doc::Image> celImage = cel->imageRef();
           std::shared_ptr<doc::Image> newImage(Image::createCopy(celImage.get()));
-          doc::remap_image(newImage.get(), remap);
+          celImages.push_back(celImage);
+          newImages.push_back(newImage);
+          images.push_back(newImage.get());
+        }
 
+        doc::remap_images(images, remap);
+
+        for (std::size_t i=0; i<celImages.size(); ++i)
           transaction.execute(new cmd::ReplaceImage(
-                                sprite, celImage, newImage));
-        }
+                                sprite, celImages[i], newImages[i]));
       }
 
       color_t oldTransparent = sprite->transparentColor();
@@ -26,18 +26,93 @@
 #include "app/ui/editor/tool_loop_impl.h"
 #include "app/ui_context.h"
 #include "doc/algo.h"
+#include "doc/algorithm/resize_image.h"
 #include "doc/blend_internals.h"
 #include "doc/brush.h"
 #include "doc/cel.h"
+#include "doc/conversion_she.h"
 #include "doc/image_impl.h"
 #include "doc/layer.h"
+#include "doc/palette.h"
 #include "doc/primitives.h"
 #include "doc/site.h"
+#include "she/surface.h"
+#include "she/system.h"
+#include "ui/overlay.h"
+#include "ui/overlay_manager.h"
 
 namespace app {
 
 using namespace doc;
 
+// Bigger previews (e.g. huge brushes with a lot of zoom) use the
+// extra cel path instead of a screen overlay.
+static const int kMaxOverlaySize = 2048;
+
+namespace {
+
+// Converts a color of the given pixel format to RGBA.
+color_t color_to_rgba(color_t c, PixelFormat format, const Palette* palette)
+{
+  switch (format) {
+    case IMAGE_RGB:
+      return c;
+    case IMAGE_GRAYSCALE:
+      return rgba(graya_getv(c), graya_getv(c), graya_getv(c), graya_geta(c));
+    case IMAGE_INDEXED:
+      return palette->getEntry(c);
+  }
+  return 0;
+}
+
+// Returns true if the layer (or one of its children) has a visible
+// cel in the given frame.
+bool has_visible_cels(Layer* layer, frame_t frame)
+{
+  if (!layer->isVisible())
+    return false;
+
+  if (layer->isFolder()) {
+    for (Layer* child : static_cast<LayerFolder*>(layer)->getLayersList())
+      if (has_visible_cels(child, frame))
+        return true;
+    return false;
+  }
+
+  return (layer->cel(frame) != nullptr);
+}
+
+// Returns true if the layer is visible and it isn't covered by other
+// visible layers in the given frame.
+bool is_top_visible_layer(Layer* layer, frame_t frame)
+{
+  for (; layer && layer->parent(); layer = layer->parent()) {
+    if (!layer->isVisible())
+      return false;
+
+    for (Layer* above=layer->getNext(); above; above=above->getNext())
+      if (has_visible_cels(above, frame))
+        return false;
+  }
+  return true;
+}
+
+// Destroys an overlay without invalidating the area where it was
+// displayed: overlapped areas are restored after each flip, so the
+// screen doesn't need a repaint.
+void destroy_overlay(std::unique_ptr<ui::Overlay>& overlay)
+{
+  if (!overlay)
+    return;
+
+  she::Surface* surface = overlay->setSurface(nullptr);
+  if (surface)
+    surface->dispose();
+  overlay.reset();
+}
+
+} // anonymous namespace
+
 BrushPreview::BrushPreview(Editor* editor)
   : m_editor(editor)
   , m_type(CROSS)
@@ -45,11 +120,17 @@ BrushPreview::BrushPreview(Editor* editor)
   , m_withRealPreview(false)
   , m_screenPosition(0, 0)
   , m_editorPosition(0, 0)
+  , m_withOverlays(false)
+  , m_cursorOverlayColor(gfx::ColorNone)
+  , m_cursorOverlayDot(false)
 {
 }
 
 BrushPreview::~BrushPreview()
 {
+  hideOverlays();
+  destroy_overlay(m_previewOverlay);
+  destroy_overlay(m_cursorOverlay);
 }
 
 BrushRef BrushPreview::getCurrentBrush()
@@ -174,6 +255,22 @@ void BrushPreview::show(const gfx::Point& screenPos)
     if (cel) opacity = MUL_UN8(opacity, cel->opacity(), t);
     if (layer) opacity = MUL_UN8(opacity, static_cast<LayerImage*>(layer)->opacity(), t);
 
+    // Fast path: move the cached brush preview and cursor as screen
+    // overlays (without rendering the sprite again).
+    bool onePixel =
+      (isFloodfill ||
+       m_editor->getCurrentEditorTool()->getPointShape(0)->isPixel());
+
+    if (canUseOverlays(sprite, layer, brush.get(), brush_color) &&
+        showOverlays((onePixel ? gfx::Rect(spritePos, gfx::Size(1, 1)): brushBounds),
+                     onePixel, brush.get(), brush_color,
+                     opacity, ui_cursor_color)) {
+      m_onScreen = true;
+      m_editorPosition = spritePos;
+      m_oldClippingRegion = m_clippingRegion;
+      return;
+    }
+
     if (!m_extraCel)
       m_extraCel.reset(new ExtraCel);
     m_extraCel->create(document->sprite(), brushBounds, site.frame(), opacity);
@@ -249,6 +346,14 @@ void BrushPreview::hide()
   if (!m_onScreen)
     return;
 
+  if (m_withOverlays) {
+    hideOverlays();
+    m_onScreen = false;
+    m_clippingRegion.clear();
+    m_oldClippingRegion.clear();
+    return;
+  }
+
   app::Document* document = m_editor->document();
   Sprite* sprite = m_editor->sprite();
   ASSERT(sprite);
@@ -297,6 +402,277 @@ void BrushPreview::invalidateRegion(const gfx::Region& region)
   m_clippingRegion.createSubtraction(m_clippingRegion, region);
 }
 
+// Returns true if the full brush preview can be displayed as a screen
+// overlay, i.e. painting with the brush would produce the brush
+// color over the layer without depending on the layer pixels.
+bool BrushPreview::canUseOverlays(Sprite* sprite, Layer* layer,
+                                  Brush* brush, color_t brushColor)
+{
+  if (!layer || !layer->isImage())
+    return false;
+
+  // The overlay is displayed over the whole sprite, so the layer must
+  // be visible and the top-most one.
+  if (!is_top_visible_layer(layer, m_editor->frame()))
+    return false;
+
+  tools::Tool* tool = m_editor->getCurrentEditorTool();
+  tools::Ink* ink = m_editor->getCurrentEditorInk().get();
+  if (!ink->isPaint() || ink->isShading() || ink->isEffect() ||
+      tool->getPointShape(0)->isSpray())
+    return false;
+
+  if (Preferences::instance().tool(tool).ink() == tools::InkType::LOCK_ALPHA)
+    return false;
+
+  // Blend modes, tiled mode and selections (which clip the brush)
+  // need the real preview.
+  if (static_cast<LayerImage*>(layer)->blendMode() != BlendMode::NORMAL ||
+      m_editor->docPref().tiled.mode() != filters::TiledMode::NONE ||
+      m_editor->document()->isMaskVisible())
+    return false;
+
+  // The brush color must be opaque, so all paint inks produce the
+  // same result.
+  color_t c = color_to_rgba(brushColor, sprite->pixelFormat(),
+                            sprite->palette(m_editor->frame()));
+  if (rgba_geta(c) < 255)
+    return false;
+
+  // Image brushes aligned to the source depend on the brush position
+  if (brush->type() == kImageBrushType &&
+      brush->pattern() == BrushPattern::ALIGNED_TO_SRC)
+    return false;
+
+  return true;
+}
+
+bool BrushPreview::showOverlays(const gfx::Rect& brushBounds,
+                                bool onePixel,
+                                Brush* brush, color_t brushColor,
+                                int opacity, gfx::Color cursorColor)
+{
+  Sprite* sprite = m_editor->sprite();
+  color_t rgbaColor = color_to_rgba(brushColor, sprite->pixelFormat(),
+                                    sprite->palette(m_editor->frame()));
+
+  gfx::Rect previewBounds(
+    m_editor->editorToScreen(brushBounds.origin()),
+    m_editor->editorToScreen(brushBounds.point2()));
+  if (previewBounds.w > kMaxOverlaySize ||
+      previewBounds.h > kMaxOverlaySize)
+    return false;
+
+  // Overlays aren't clipped, so they must be completely inside the
+  // visible area of the editor.
+  gfx::Rect cursorBounds(m_screenPosition.x-3, m_screenPosition.y-3, 7, 7);
+  gfx::Region drawable;
+  m_editor->getDrawableRegion(drawable, ui::Widget::kCutTopWindows);
+  if (drawable.contains(previewBounds) != gfx::Region::In ||
+      drawable.contains(cursorBounds) != gfx::Region::In)
+    return false;
+
+  updatePreviewSurface(onePixel, brush, rgbaColor, opacity);
+  if (!m_previewOverlay)
+    return false;
+  m_previewOverlay->moveOverlay(previewBounds.origin());
+
+  updateCursorSurface(cursorColor, m_editor->zoom().scale() >= 4.0);
+  m_cursorOverlay->moveOverlay(cursorBounds.origin());
+
+  // The cursor is drawn in negative mode over the screen pixels or
+  // over the brush preview.
+  if (m_blackAndWhiteNegative) {
+    static int cross[7*7] = {
+      0, 0, 0, 1, 0, 0, 0,
+      0, 0, 0, 1, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0,
+      1, 1, 0, 1, 0, 1, 1,
+      0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 1, 0, 0, 0,
+      0, 0, 0, 1, 0, 0, 0,
+    };
+    ui::ScreenGraphics g;
+    she::Surface* preview = m_previewOverlay->setSurface(nullptr);
+    she::Surface* cursor = m_cursorOverlay->setSurface(nullptr);
+    {
+      she::SurfaceLock lockPreview(preview);
+      she::SurfaceLock lockCursor(cursor);
+      cursor->clear();
+
+      for (int v=0; v<7; ++v) {
+        for (int u=0; u<7; ++u) {
+          // The center pixel is the subpixel dot
+          if (!cross[v*7+u] || (u == 3 && v == 3 && !m_cursorOverlayDot))
+            continue;
+
+          gfx::Point pt(cursorBounds.x+u, cursorBounds.y+v);
+          gfx::Color c = gfx::ColorNone;
+          if (previewBounds.contains(pt))
+            c = preview->getPixel(pt.x-previewBounds.x, pt.y-previewBounds.y);
+          if (gfx::geta(c) < 255)
+            c = g.getPixel(pt.x, pt.y);
+
+          cursor->putPixel(
+            color_utils::blackandwhite_neg(
+              gfx::rgba(gfx::getr(c), gfx::getg(c), gfx::getb(c))), u, v);
+        }
+      }
+    }
+    m_previewOverlay->setSurface(preview);
+    m_cursorOverlay->setSurface(cursor);
+
+    // Redraw the cursor surface if the negative mode is disabled
+    m_cursorOverlayColor = gfx::ColorNone;
+  }
+
+  if (!m_withOverlays) {
+    ui::OverlayManager::instance()->addOverlay(m_previewOverlay.get());
+    ui::OverlayManager::instance()->addOverlay(m_cursorOverlay.get());
+    m_withOverlays = true;
+  }
+  return true;
+}
+
+void BrushPreview::hideOverlays()
+{
+  if (!m_withOverlays)
+    return;
+
+  ui::OverlayManager::instance()->removeOverlay(m_previewOverlay.get());
+  ui::OverlayManager::instance()->removeOverlay(m_cursorOverlay.get());
+  m_withOverlays = false;
+}
+
+// Re-creates the surface with the brush stamped at the current zoom
+// level only if some of its inputs has changed.
+void BrushPreview::updatePreviewSurface(bool onePixel, Brush* brush,
+                                        color_t rgbaColor, int opacity)
+{
+  const Palette* palette = m_editor->sprite()->palette(m_editor->frame());
+  const render::Zoom& zoom = m_editor->zoom();
+
+  PreviewKey key;
+  key.brush = brush;
+  key.brushGen = brush->gen();
+  key.onePixel = onePixel;
+  key.rgbaColor = rgbaColor;
+  key.opacity = opacity;
+  key.palette = palette;
+  key.paletteModifications = palette->getModifications();
+  key.scale = zoom.scale();
+
+  if (m_previewOverlay && m_previewKey == key)
+    return;
+
+  // The overlay is re-created because it caches the overlapped area
+  // with the size of the previous surface.
+  bool wasVisible = m_withOverlays;
+  if (wasVisible)
+    hideOverlays();
+  destroy_overlay(m_previewOverlay);
+  m_previewKey = key;
+
+  // Stamp the brush in a RGBA image
+  const Image* brushImage = brush->image();
+  int w = (onePixel ? 1: brushImage->width());
+  int h = (onePixel ? 1: brushImage->height());
+  std::unique_ptr<Image> image(Image::create(IMAGE_RGB, w, h));
+  {
+    int t;
+    LockImageBits<RgbTraits> bits(image.get());
+    auto it = bits.begin();
+    for (int v=0; v<h; ++v) {
+      for (int u=0; u<w; ++u, ++it) {
+        color_t c = rgbaColor;
+        if (!onePixel) {
+          c = get_pixel(brushImage, u, v);
+          switch (brushImage->pixelFormat()) {
+            case IMAGE_BITMAP:
+              c = (c ? rgbaColor: 0);
+              break;
+            case IMAGE_INDEXED:
+              if (c == brushImage->maskColor()) {
+                c = 0;
+                break;
+              }
+              // Continue...
+            default:
+              c = color_to_rgba(c, brushImage->pixelFormat(), palette);
+              break;
+          }
+        }
+        *it = rgba(rgba_getr(c), rgba_getg(c), rgba_getb(c),
+                   MUL_UN8(rgba_geta(c), opacity, t));
+      }
+    }
+  }
+
+  // Scale it to the editor zoom
+  int sw = MAX(1, zoom.apply(w));
+  int sh = MAX(1, zoom.apply(h));
+  if (sw != w || sh != h) {
+    std::unique_ptr<Image> scaled(Image::create(IMAGE_RGB, sw, sh));
+    algorithm::resize_image(image.get(), scaled.get(),
+                            algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
+                            palette, nullptr, 0);
+    image.swap(scaled);
+  }
+
+  she::Surface* surface = she::instance()->createRgbaSurface(sw, sh);
+  {
+    she::SurfaceLock lock(surface);
+    convert_image_to_surface(image.get(), palette, surface,
+                             0, 0, 0, 0, sw, sh);
+  }
+
+  m_previewOverlay.reset(
+    new ui::Overlay(surface, gfx::Point(0, 0), ui::Overlay::MouseZOrder-2));
+
+  if (wasVisible) {
+    ui::OverlayManager::instance()->addOverlay(m_previewOverlay.get());
+    ui::OverlayManager::instance()->addOverlay(m_cursorOverlay.get());
+    m_withOverlays = true;
+  }
+}
+
+void BrushPreview::updateCursorSurface(gfx::Color cursorColor, bool withDot)
+{
+  if (m_cursorOverlay &&
+      m_cursorOverlayColor == cursorColor &&
+      m_cursorOverlayDot == withDot)
+    return;
+
+  m_cursorOverlayColor = cursorColor;
+  m_cursorOverlayDot = withDot;
+
+  she::Surface* surface;
+  if (m_cursorOverlay) {
+    surface = m_cursorOverlay->setSurface(nullptr);
+  }
+  else {
+    surface = she::instance()->createRgbaSurface(7, 7);
+    m_cursorOverlay.reset(
+      new ui::Overlay(nullptr, gfx::Point(0, 0), ui::Overlay::MouseZOrder-1));
+  }
+
+  // Same shape as traceCrossPixels() (plus the subpixel dot)
+  {
+    she::SurfaceLock lock(surface);
+    surface->clear();
+    for (int i=0; i<2; ++i) {
+      surface->putPixel(cursorColor, 3, i);
+      surface->putPixel(cursorColor, 3, 5+i);
+      surface->putPixel(cursorColor, i, 3);
+      surface->putPixel(cursorColor, 5+i, 3);
+    }
+    if (withDot)
+      surface->putPixel(cursorColor, 3, 3);
+  }
+
+  m_cursorOverlay->setSurface(surface);
+}
+
 void BrushPreview::generateBoundaries()
 {
   BrushRef brush = getCurrentBrush();
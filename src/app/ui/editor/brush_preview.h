@@ -22,11 +22,17 @@
 
 namespace doc {
   class Layer;
+  class Palette;
   class Sprite;
 }
 
+namespace she {
+  class Surface;
+}
+
 namespace ui {
   class Graphics;
+  class Overlay;
 }
 
 namespace app {
@@ -60,6 +66,16 @@ namespace app {
     static doc::color_t getBrushColor(doc::Sprite* sprite, doc::Layer* layer);
 
     void generateBoundaries();
+
+    bool canUseOverlays(doc::Sprite* sprite, doc::Layer* layer,
+                        doc::Brush* brush, doc::color_t brushColor);
+    bool showOverlays(const gfx::Rect& brushBounds, bool onePixel,
+                      doc::Brush* brush, doc::color_t brushColor,
+                      int opacity, gfx::Color cursorColor);
+    void hideOverlays();
+    void updatePreviewSurface(bool onePixel, doc::Brush* brush,
+                              doc::color_t rgbaColor, int opacity);
+    void updateCursorSurface(gfx::Color cursorColor, bool withDot);
     void forEachBrushPixel(
       ui::Graphics* g,
       const gfx::Point& screenPos,
@@ -107,6 +123,40 @@ namespace app {
     doc::frame_t m_lastFrame;
 
     ExtraCelRef m_extraCel;
+
+    // The full brush preview (and the cursor over it) can be shown as
+    // screen overlays. In this way we don't need to re-render the
+    // sprite each time the mouse is moved, we just move the overlays.
+    // The preview surface is re-created only when the brush, color,
+    // opacity, or zoom change.
+    struct PreviewKey {
+      const doc::Brush* brush = nullptr;
+      int brushGen = 0;
+      bool onePixel = false;
+      doc::color_t rgbaColor = 0;
+      int opacity = 0;
+      const doc::Palette* palette = nullptr;
+      int paletteModifications = 0;
+      double scale = 0.0;
+
+      bool operator==(const PreviewKey& other) const {
+        return (brush == other.brush &&
+                brushGen == other.brushGen &&
+                onePixel == other.onePixel &&
+                rgbaColor == other.rgbaColor &&
+                opacity == other.opacity &&
+                palette == other.palette &&
+                paletteModifications == other.paletteModifications &&
+                scale == other.scale);
+      }
+    };
+
+    bool m_withOverlays;
+    PreviewKey m_previewKey;
+    std::unique_ptr<ui::Overlay> m_previewOverlay;
+    std::unique_ptr<ui::Overlay> m_cursorOverlay;
+    gfx::Color m_cursorOverlayColor;
+    bool m_cursorOverlayDot;
   };
 
   class HideBrushPreview {
@@ -403,37 +403,82 @@ void Editor::updateEditor()
   View::getView(this)->updateView();
 }
 
-void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& spriteRectToDraw, int dx, int dy)
+// Surface with the last area of the sprite rendered by an editor (in
+// zoomed sprite coordinates). The same surface is blitted to all
+// tiles in tiled mode, and it's reused by other calls in the same
+// paint pass (e.g. when the editor is partially covered by windows
+// and drawSpriteClipped() draws the same rectangle several times).
+static she::Surface* rendered_surface = nullptr;
+static struct {
+  const Editor* editor;
+  int pass;
+  frame_t frame;
+  double zoom;
+  gfx::Rect area;
+} rendered_key = { nullptr, 0, 0, 0.0, gfx::Rect() };
+
+// Incremented each time the editors are painted, anything in the
+// sprite could be modified between two passes (cel images aren't
+// versioned when they are modified by tools).
+static int paint_pass = 0;
+
+void Editor::drawSpriteTiles(ui::Graphics* g, const gfx::Rect& spriteRectToDraw,
+                             const std::vector<gfx::Point>& offsets)
 {
   // Clip from sprite and apply zoom
   gfx::Rect rc = m_sprite->bounds().createIntersection(spriteRectToDraw);
   rc = m_zoom.apply(rc);
+  if (rc.isEmpty())
+    return;
 
-  int dest_x = dx + m_padding.x + rc.x;
-  int dest_y = dy + m_padding.y + rc.y;
-
-  // Clip from graphics/screen
+  // Clip each tile from graphics/screen, the area to render is the
+  // union of the visible part of all tiles.
   const gfx::Rect& clip = g->getClipBounds();
-  if (dest_x < clip.x) {
-    rc.x += clip.x - dest_x;
-    rc.w -= clip.x - dest_x;
-    dest_x = clip.x;
-  }
-  if (dest_y < clip.y) {
-    rc.y += clip.y - dest_y;
-    rc.h -= clip.y - dest_y;
-    dest_y = clip.y;
+  gfx::Rect area;
+  for (const gfx::Point& offset : offsets) {
+    gfx::Point origin = m_padding + offset;
+    gfx::Rect visible = clip.createIntersection(gfx::Rect(rc).offset(origin));
+    if (!visible.isEmpty())
+      area |= visible.offset(-origin);
   }
-  if (dest_x+rc.w > clip.x+clip.w) {
-    rc.w = clip.x+clip.w-dest_x;
-  }
-  if (dest_y+rc.h > clip.y+clip.h) {
-    rc.h = clip.y+clip.h-dest_y;
+  if (area.isEmpty())
+    return;
+
+  if (rendered_key.editor != this ||
+      rendered_key.pass != paint_pass ||
+      rendered_key.frame != m_frame ||
+      rendered_key.zoom != m_zoom.scale() ||
+      !rendered_key.area.contains(area)) {
+    rendered_key.editor = nullptr;
+    if (!renderSpriteArea(area))
+      return;
+
+    rendered_key.editor = this;
+    rendered_key.pass = paint_pass;
+    rendered_key.frame = m_frame;
+    rendered_key.zoom = m_zoom.scale();
+    rendered_key.area = area;
   }
 
-  if (rc.isEmpty())
-    return;
+  // Blit the rendered area in each tile
+  const gfx::Rect& rendered = rendered_key.area;
+  for (const gfx::Point& offset : offsets) {
+    gfx::Point origin = m_padding + offset;
+    gfx::Rect visible = clip.createIntersection(gfx::Rect(area).offset(origin));
+    if (visible.isEmpty())
+      continue;
+
+    g->blit(rendered_surface,
+            visible.x - origin.x - rendered.x,
+            visible.y - origin.y - rendered.y,
+            visible.x, visible.y, visible.w, visible.h);
+
+    m_brushPreview.invalidateRegion(gfx::Region(visible));
+  }
+}
 
+bool Editor::renderSpriteArea(const gfx::Rect& rc)
+{
   // Generate the rendered image
   if (!m_renderBuffer)
     m_renderBuffer.reset(new doc::ImageBuffer());
@@ -461,7 +506,6 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
       }
       m_document->notifyExposeSpritePixels(m_sprite, gfx::Region(expose));
     }
-
     // Create a temporary RGB bitmap to draw all to it
     rendered.reset(Image::create(IMAGE_RGB, rc.w, rc.h, m_renderBuffer));
     m_renderEngine.setupBackground(m_document, rendered->pixelFormat());
@@ -511,34 +555,32 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
     Console::showException(e);
   }
 
-  if (rendered) {
-    // Pre-render decorator.
-    if ((m_flags & kShowDecorators) && m_decorator) {
-      EditorPreRenderImpl preRender(this, rendered.get(),
-        Point(-rc.x, -rc.y), m_zoom);
-      m_decorator->preRenderDecorator(&preRender);
-    }
+  if (!rendered)
+    return false;
 
-    // Convert the render to a she::Surface
-    static she::Surface* tmp;
-    if (!tmp || tmp->width() < rc.w || tmp->height() < rc.h) {
-      if (tmp)
-        tmp->dispose();
+  // Pre-render decorator.
+  if ((m_flags & kShowDecorators) && m_decorator) {
+    EditorPreRenderImpl preRender(this, rendered.get(),
+      Point(-rc.x, -rc.y), m_zoom);
+    m_decorator->preRenderDecorator(&preRender);
+  }
 
-      tmp = she::instance()->createRgbaSurface(rc.w, rc.h);
-    }
+  // Convert the render to a she::Surface
+  if (!rendered_surface ||
+      rendered_surface->width() < rc.w ||
+      rendered_surface->height() < rc.h) {
+    if (rendered_surface)
+      rendered_surface->dispose();
 
-    if (tmp->nativeHandle()) {
-      convert_image_to_surface(rendered.get(), m_sprite->palette(m_frame),
-        tmp, 0, 0, 0, 0, rc.w, rc.h);
+    rendered_surface = she::instance()->createRgbaSurface(rc.w, rc.h);
+  }
 
-      g->blit(tmp, 0, 0, dest_x, dest_y, rc.w, rc.h);
+  if (!rendered_surface->nativeHandle())
+    return false;
 
-      m_brushPreview.invalidateRegion(
-        gfx::Region(
-          gfx::Rect(dest_x, dest_y, rc.w, rc.h)));
-    }
-  }
+  convert_image_to_surface(rendered.get(), m_sprite->palette(m_frame),
+    rendered_surface, 0, 0, 0, 0, rc.w, rc.h);
+  return true;
 }
 
 void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
@@ -557,34 +599,35 @@ void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
     m_zoom.apply(m_sprite->height()));
   gfx::Rect enclosingRect = spriteRect;
 
-  // Draw the main sprite at the center.
-  drawOneSpriteUnclippedRect(g, rc, 0, 0);
+  // Offsets of the sprite tiles to draw (the main sprite at the center)
+  std::vector<gfx::Point> offsets;
+  offsets.push_back(gfx::Point(0, 0));
 
   gfx::Region outside(client);
   outside.createSubtraction(outside, gfx::Region(spriteRect));
 
   // Document preferences
   if (int(m_docPref.tiled.mode()) & int(filters::TiledMode::X_AXIS)) {
-    drawOneSpriteUnclippedRect(g, rc, -spriteRect.w, 0);
-    drawOneSpriteUnclippedRect(g, rc, +spriteRect.w, 0);
+    offsets.push_back(gfx::Point(-spriteRect.w, 0));
+    offsets.push_back(gfx::Point(+spriteRect.w, 0));
 
     enclosingRect = gfx::Rect(spriteRect.x-spriteRect.w, spriteRect.y, spriteRect.w*3, spriteRect.h);
     outside.createSubtraction(outside, gfx::Region(enclosingRect));
   }
 
   if (int(m_docPref.tiled.mode()) & int(filters::TiledMode::Y_AXIS)) {
-    drawOneSpriteUnclippedRect(g, rc, 0, -spriteRect.h);
-    drawOneSpriteUnclippedRect(g, rc, 0, +spriteRect.h);
+    offsets.push_back(gfx::Point(0, -spriteRect.h));
+    offsets.push_back(gfx::Point(0, +spriteRect.h));
 
     enclosingRect = gfx::Rect(spriteRect.x, spriteRect.y-spriteRect.h, spriteRect.w, spriteRect.h*3);
     outside.createSubtraction(outside, gfx::Region(enclosingRect));
   }
 
   if (m_docPref.tiled.mode() == filters::TiledMode::BOTH) {
-    drawOneSpriteUnclippedRect(g, rc, -spriteRect.w, -spriteRect.h);
-    drawOneSpriteUnclippedRect(g, rc, +spriteRect.w, -spriteRect.h);
-    drawOneSpriteUnclippedRect(g, rc, -spriteRect.w, +spriteRect.h);
-    drawOneSpriteUnclippedRect(g, rc, +spriteRect.w, +spriteRect.h);
+    offsets.push_back(gfx::Point(-spriteRect.w, -spriteRect.h));
+    offsets.push_back(gfx::Point(+spriteRect.w, -spriteRect.h));
+    offsets.push_back(gfx::Point(-spriteRect.w, +spriteRect.h));
+    offsets.push_back(gfx::Point(+spriteRect.w, +spriteRect.h));
 
     enclosingRect = gfx::Rect(
       spriteRect.x-spriteRect.w,
@@ -592,6 +635,9 @@ void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
     outside.createSubtraction(outside, gfx::Region(enclosingRect));
   }
 
+  // Render the sprite once and copy it to all tiles.
+  drawSpriteTiles(g, rc, offsets);
+
   // Fill the outside (parts of the editor that aren't covered by the
   // sprite).
   SkinTheme* theme = static_cast<SkinTheme*>(this->theme());
@@ -704,6 +750,8 @@ void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
 
 void Editor::drawSpriteClipped(const gfx::Region& updateRegion)
 {
+  ++paint_pass;
+
   Region screenRegion;
   getDrawableRegion(screenRegion, kCutTopWindows);
 
@@ -1343,6 +1391,7 @@ void Editor::onPaint(ui::PaintEvent& ev)
       DocumentReader documentReader(m_document, 0);
 
       // Draw the sprite in the editor
+      ++paint_pass;
       drawSpriteUnclippedRect(g, gfx::Rect(0, 0, m_sprite->width(), m_sprite->height()));
 
       // Draw the mask boundaries
@@ -31,6 +31,8 @@
 #include "ui/timer.h"
 #include "ui/widget.h"
 
+#include <vector>
+
 namespace doc {
   class Layer;
   class Site;
@@ -253,10 +255,16 @@ namespace app {
 
     void setCursor(const gfx::Point& mouseScreenPos);
 
-    // Draws the specified portion of sprite in the editor.  Warning:
+    // Draws the specified portion of sprite in the editor, once for
+    // each tile offset (the sprite is rendered only once).  Warning:
     // You should setup the clip of the screen before calling this
     // routine.
-    void drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& rc, int dx, int dy);
+    void drawSpriteTiles(ui::Graphics* g, const gfx::Rect& rc,
+                         const std::vector<gfx::Point>& offsets);
+
+    // Renders the given area of the sprite (in zoomed sprite
+    // coordinates) in the surface used by drawSpriteTiles().
+    bool renderSpriteArea(const gfx::Rect& rc);
 
     gfx::Point calcExtraPadding(const render::Zoom& zoom);
 
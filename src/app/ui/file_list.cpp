@@ -46,7 +46,7 @@ FileList::FileList() : Widget(kGenericWidget) {
   m_monitoringTimer->Tick.connect(&FileList::onMonitoringTick, this);
   m_monitoringTimer->start();
 
-  regenerateList();
+  loadCurrentFolder();
 }
 
 FileList::~FileList()
@@ -55,6 +55,9 @@ FileList::~FileList()
   m_generateThumbnailTimer->stop();
   m_monitoringTimer->stop();
 
+  // Stop reading the current folder.
+  m_loadTask.abort();
+
   // Stop workers creating thumbnails.
   ThumbnailGenerator::instance()->stopAllWorkers();
 }
@@ -77,11 +80,9 @@ void FileList::setCurrentFolder(IFileItem* folder)
   m_req_valid = false;
   m_selected = NULL;
 
-  regenerateList();
-
-  // select first folder
-  if (!m_list.empty() && m_list.front()->isBrowsable())
-    selectIndex(0);
+  // The list is filled in the background (see onChildrenLoaded())
+  m_list.clear();
+  loadCurrentFolder();
 
   // Emit "CurrentFolderChanged" event.
   onCurrentFolderChanged();
@@ -505,26 +506,68 @@ void FileList::makeSelectedFileitemVisible()
   }
 }
 
-void FileList::regenerateList()
+void FileList::loadCurrentFolder()
+{
+  m_loadTask.abort();
+
+  auto token = std::make_shared<int>(0);
+  std::weak_ptr<int> weakToken = token;
+  m_loadToken = token;
+
+  // Note: onChildrenLoaded() can be called immediately (if the
+  // folder is cached), before loadChildren() returns.
+  m_loadTask = m_currentFolder->loadChildren(
+    [this, weakToken](const FileItemList& children, bool done) {
+      if (weakToken.lock())
+        onChildrenLoaded(children, done);
+    });
+}
+
+void FileList::onChildrenLoaded(const FileItemList& children, bool done)
+{
+  regenerateList(children);
+  m_req_valid = false;
+
+  if (done) {
+    // Items from the previous read of the folder that don't exist
+    // anymore were deleted.
+    if (m_selected &&
+        std::find(m_list.begin(), m_list.end(), m_selected) == m_list.end())
+      m_selected = NULL;
+    if (m_itemToGenerateThumbnail &&
+        std::find(m_list.begin(), m_list.end(), m_itemToGenerateThumbnail) == m_list.end())
+      m_itemToGenerateThumbnail = NULL;
+
+    // select first folder
+    if (!m_selected) {
+      if (!m_list.empty() && m_list.front()->isBrowsable())
+        selectIndex(0);
+    }
+    else
+      makeSelectedFileitemVisible();
+  }
+
+  invalidate();
+  if (View* view = View::getView(this))
+    view->updateView();
+}
+
+void FileList::regenerateList(const FileItemList& children)
 {
   // get the children of the current folder
-  m_list = m_currentFolder->children();
+  m_list = children;
 
   // filter the list by the available extensions
   if (!m_exts.empty()) {
-    for (FileItemList::iterator
-           it=m_list.begin();
-         it!=m_list.end(); ) {
-      IFileItem* fileitem = *it;
-      if (fileitem->isHidden())
-        it = m_list.erase(it);
-      else if (!fileitem->isFolder() &&
-          !fileitem->hasExtension(m_exts.c_str())) {
-        it = m_list.erase(it);
-      }
-      else
-        ++it;
-    }
+    m_list.erase(
+      std::remove_if(
+        m_list.begin(), m_list.end(),
+        [this](IFileItem* fileitem) {
+          return (fileitem->isHidden() ||
+                  (!fileitem->isFolder() &&
+                   !fileitem->hasExtension(m_exts)));
+        }),
+      m_list.end());
   }
 }
 
@@ -13,6 +13,7 @@
 #include "ui/timer.h"
 #include "ui/widget.h"
 
+#include <memory>
 #include <string>
 
 namespace she {
@@ -56,7 +57,9 @@ namespace app {
     void onMonitoringTick();
     gfx::Size getFileItemSize(IFileItem* fi) const;
     void makeSelectedFileitemVisible();
-    void regenerateList();
+    void loadCurrentFolder();
+    void onChildrenLoaded(const FileItemList& children, bool done);
+    void regenerateList(const FileItemList& children);
     int getSelectedIndex();
     void selectIndex(int index);
     void generatePreviewOfSelectedItem();
@@ -64,6 +67,12 @@ namespace app {
 
     IFileItem* m_currentFolder;
     FileItemList m_list;
+
+    // Background read of the current folder. The token is used to
+    // ignore groups of entries that arrive after the FileList is
+    // destroyed or the current folder is changed.
+    TaskHandle m_loadTask;
+    std::shared_ptr<int> m_loadToken;
     bool m_req_valid;
     int m_req_w, m_req_h;
     IFileItem* m_selected;
@@ -24,8 +24,10 @@
 #include "she/system.h"
 #include "ui/alert.h"
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
+#include <streambuf>
 #include <vector>
 
 namespace app {
@@ -41,6 +43,133 @@ namespace {
     return she::instance()->defaultDisplay()->nativeHandle();
   }
 
+  // Output stream buffer that writes to a std::vector (with seek
+  // support because doc::write_image() updates the size of the
+  // compressed data after writing it).
+  class VectorStreamBuf : public std::streambuf {
+  public:
+    const std::vector<char>& data() const { return m_data; }
+
+  protected:
+    int_type overflow(int_type c) override {
+      if (c != traits_type::eof()) {
+        char ch = traits_type::to_char_type(c);
+        xsputn(&ch, 1);
+      }
+      return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+      if (m_pos+n > m_data.size())
+        m_data.resize(m_pos+n);
+      std::copy(s, s+n, m_data.begin()+m_pos);
+      m_pos += n;
+      return n;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which) override {
+      off_type base = (dir == std::ios_base::beg ? 0:
+                       dir == std::ios_base::cur ? off_type(m_pos):
+                                                   off_type(m_data.size()));
+      return seekpos(pos_type(base + off), which);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+      if (!(which & std::ios_base::out) ||
+          off_type(pos) < 0 || std::size_t(pos) > m_data.size())
+        return pos_type(off_type(-1));
+      m_pos = std::size_t(pos);
+      return pos;
+    }
+
+  private:
+    std::vector<char> m_data;
+    std::size_t m_pos = 0;
+  };
+
+  // Bulk converters between rows of pixels. They work with plain
+  // pointers to rows, so the compiler can vectorize them.
+
+  void gray_to_rgba(const uint16_t* src, uint32_t* dst, int w) {
+    for (int x=0; x<w; ++x) {
+      const uint32_t v = doc::graya_getv(src[x]);
+      const uint32_t a = doc::graya_geta(src[x]);
+      dst[x] = ((v << doc::rgba_r_shift) |
+                (v << doc::rgba_g_shift) |
+                (v << doc::rgba_b_shift) |
+                (a << doc::rgba_a_shift));
+    }
+  }
+
+  void convert_64bpp_row(const clip::image_spec& spec, const uint64_t* src, uint32_t* dst) {
+    for (unsigned long x=0; x<spec.width; ++x) {
+      const uint64_t c = src[x];
+      dst[x] = doc::rgba(
+        uint8_t((c & spec.red_mask) >> spec.red_shift >> 8),
+        uint8_t((c & spec.green_mask) >> spec.green_shift >> 8),
+        uint8_t((c & spec.blue_mask) >> spec.blue_shift >> 8),
+        uint8_t((c & spec.alpha_mask) >> spec.alpha_shift >> 8));
+    }
+  }
+
+  void convert_32bpp_row(const clip::image_spec& spec, const uint32_t* src, uint32_t* dst) {
+    // Same layout as doc::RgbTraits
+    if (spec.red_mask   == doc::rgba_r_mask && spec.red_shift   == doc::rgba_r_shift &&
+        spec.green_mask == doc::rgba_g_mask && spec.green_shift == doc::rgba_g_shift &&
+        spec.blue_mask  == doc::rgba_b_mask && spec.blue_shift  == doc::rgba_b_shift &&
+        spec.alpha_mask == doc::rgba_a_mask && spec.alpha_shift == doc::rgba_a_shift) {
+      std::copy(src, src+spec.width, dst);
+      return;
+    }
+
+    // On Windows, 32bpp images are used for performance only, the
+    // alpha mask is always zero (which means that the image is only
+    // RGB, without alpha information).
+    const uint32_t alphaMask = uint32_t(spec.alpha_mask);
+    const uint32_t alphaShift = uint32_t(spec.alpha_shift);
+    const uint32_t opaque = (alphaMask ? 0: doc::rgba_a_mask);
+    const uint32_t rm = uint32_t(spec.red_mask),   rs = uint32_t(spec.red_shift);
+    const uint32_t gm = uint32_t(spec.green_mask), gs = uint32_t(spec.green_shift);
+    const uint32_t bm = uint32_t(spec.blue_mask),  bs = uint32_t(spec.blue_shift);
+
+    for (unsigned long x=0; x<spec.width; ++x) {
+      const uint32_t c = src[x];
+      dst[x] =
+        (((c & rm) >> rs) << doc::rgba_r_shift) |
+        (((c & gm) >> gs) << doc::rgba_g_shift) |
+        (((c & bm) >> bs) << doc::rgba_b_shift) |
+        (((c & alphaMask) >> alphaShift) << doc::rgba_a_shift) |
+        opaque;
+    }
+  }
+
+  void convert_24bpp_row(const clip::image_spec& spec, const uint8_t* src, uint32_t* dst) {
+    // Read each pixel byte by byte (reading 4 bytes at the same time
+    // could read outside the clipboard buffer in the last pixel).
+    for (unsigned long x=0; x<spec.width; ++x, src+=3) {
+      const uint32_t c = (uint32_t(src[0]) |
+                          (uint32_t(src[1]) << 8) |
+                          (uint32_t(src[2]) << 16));
+      dst[x] = doc::rgba(
+        uint8_t((c & spec.red_mask) >> spec.red_shift),
+        uint8_t((c & spec.green_mask) >> spec.green_shift),
+        uint8_t((c & spec.blue_mask) >> spec.blue_shift),
+        255);
+    }
+  }
+
+  void convert_16bpp_row(const clip::image_spec& spec, const uint16_t* src, uint32_t* dst) {
+    for (unsigned long x=0; x<spec.width; ++x) {
+      const uint16_t c = src[x];
+      dst[x] = doc::rgba(
+        doc::scale_5bits_to_8bits((c & spec.red_mask  ) >> spec.red_shift  ),
+        doc::scale_6bits_to_8bits((c & spec.green_mask) >> spec.green_shift),
+        doc::scale_5bits_to_8bits((c & spec.blue_mask ) >> spec.blue_shift ),
+        255);
+    }
+  }
+
   void custom_error_handler(clip::ErrorCode code) {
     switch (code) {
       case clip::ErrorCode::CannotLock:
@@ -80,7 +209,10 @@ bool set_native_clipboard_bitmap(const doc::Image* image,
 
   // Set custom clipboard formats
   if (custom_image_format) {
-    std::stringstream os;
+    // Serialize directly to one buffer (a std::stringstream would
+    // need an extra copy of the whole data).
+    VectorStreamBuf buf;
+    std::ostream os(&buf);
     write32(os,
             (image   ? 1: 0) |
             (mask    ? 2: 0) |
@@ -89,18 +221,14 @@ bool set_native_clipboard_bitmap(const doc::Image* image,
     if (mask) doc::write_mask(os, mask);
     if (palette) doc::write_palette(os, palette);
 
-    if (os.good()) {
-      size_t size = (size_t)os.tellp();
-      if (size > 0) {
-        std::vector<char> data(size);
-        os.seekp(0);
-        os.read(&data[0], size);
-
-        l.set_data(custom_image_format, &data[0], size);
-      }
-    }
+    if (os.good() && !buf.data().empty())
+      l.set_data(custom_image_format, &buf.data()[0], buf.data().size());
   }
 
+  // clip::lock::set_image() needs the whole image in one buffer (it
+  // converts the image to the platform format), so it cannot be
+  // streamed in parts. RGB images are given without a copy, and
+  // grayscale/indexed images are converted in one 32bpp buffer.
   clip::image_spec spec;
   spec.width = image->width();
   spec.height = image->height();
@@ -125,36 +253,31 @@ bool set_native_clipboard_bitmap(const doc::Image* image,
     }
     case doc::IMAGE_GRAYSCALE: {
       clip::image img(spec);
-      const doc::LockImageBits<doc::GrayscaleTraits> bits(image);
-      auto it = bits.begin();
-      uint32_t* dst = (uint32_t*)img.data();
       for (int y=0; y<image->height(); ++y) {
-        for (int x=0; x<image->width(); ++x, ++it) {
-          doc::color_t c = *it;
-          *(dst++) = doc::rgba(doc::graya_getv(c),
-                               doc::graya_getv(c),
-                               doc::graya_getv(c),
-                               doc::graya_geta(c));
-        }
+        auto src = (const doc::GrayscaleTraits::pixel_t*)image->getPixelAddress(0, y);
+        auto dst = (uint32_t*)(img.data()+spec.bytes_per_row*y);
+        gray_to_rgba(src, dst, image->width());
       }
       l.set_image(img);
       break;
     }
     case doc::IMAGE_INDEXED: {
+      // Table of colors for each index
+      uint32_t colors[256];
+      for (int i=0; i<256; ++i) {
+        colors[i] = (i < palette->size() ? palette->getEntry(i): 0);
+
+        // Use alpha=0 for mask color
+        if (doc::color_t(i) == image->maskColor())
+          colors[i] &= doc::rgba_rgb_mask;
+      }
+
       clip::image img(spec);
-      const doc::LockImageBits<doc::IndexedTraits> bits(image);
-      auto it = bits.begin();
-      uint32_t* dst = (uint32_t*)img.data();
       for (int y=0; y<image->height(); ++y) {
-        for (int x=0; x<image->width(); ++x, ++it) {
-          doc::color_t c = palette->getEntry(*it);
-
-          // Use alpha=0 for mask color
-          if (*it == image->maskColor())
-            c &= doc::rgba_rgb_mask;
-
-          *(dst++) = c;
-        }
+        auto src = (const doc::IndexedTraits::pixel_t*)image->getPixelAddress(0, y);
+        auto dst = (uint32_t*)(img.data()+spec.bytes_per_row*y);
+        for (int x=0; x<image->width(); ++x)
+          dst[x] = colors[src[x]];
       }
       l.set_image(img);
       break;
@@ -209,78 +332,15 @@ bool get_native_clipboard_bitmap(doc::Image** image,
     doc::Image::create(doc::IMAGE_RGB,
                        spec.width, spec.height));
 
-  switch (spec.bits_per_pixel) {
-    case 64: {
-      doc::LockImageBits<doc::RgbTraits> bits(dst.get(), doc::Image::WriteLock);
-      auto it = bits.begin();
-      for (unsigned long y=0; y<spec.height; ++y) {
-        const uint64_t* src = (const uint64_t*)(img.data()+spec.bytes_per_row*y);
-        for (unsigned long x=0; x<spec.width; ++x, ++it, ++src) {
-          uint64_t c = *((const uint64_t*)src);
-          *it = doc::rgba(
-            uint8_t((c & spec.red_mask) >> spec.red_shift >> 8),
-            uint8_t((c & spec.green_mask) >> spec.green_shift >> 8),
-            uint8_t((c & spec.blue_mask) >> spec.blue_shift >> 8),
-            uint8_t((c & spec.alpha_mask) >> spec.alpha_shift >> 8));
-        }
-      }
-      break;
-    }
-    case 32: {
-      doc::LockImageBits<doc::RgbTraits> bits(dst.get(), doc::Image::WriteLock);
-      auto it = bits.begin();
-      for (unsigned long y=0; y<spec.height; ++y) {
-        const uint32_t* src = (const uint32_t*)(img.data()+spec.bytes_per_row*y);
-        for (unsigned long x=0; x<spec.width; ++x, ++it, ++src) {
-          const uint32_t c = *((const uint32_t*)src);
-
-          // On Windows, 32bpp images are used for performance only,
-          // the alpha mask is always zero (which means that the image
-          // is only RGB, without alpha information).
-          int alpha =
-            (spec.alpha_mask ?
-             uint8_t((c & spec.alpha_mask) >> spec.alpha_shift): 255);
-
-          *it = doc::rgba(
-            uint8_t((c & spec.red_mask  ) >> spec.red_shift  ),
-            uint8_t((c & spec.green_mask) >> spec.green_shift),
-            uint8_t((c & spec.blue_mask ) >> spec.blue_shift ),
-            alpha);
-        }
-      }
-      break;
-    }
-    case 24: {
-      doc::LockImageBits<doc::RgbTraits> bits(dst.get(), doc::Image::WriteLock);
-      auto it = bits.begin();
-      for (unsigned long y=0; y<spec.height; ++y) {
-        const char* src = (const char*)(img.data()+spec.bytes_per_row*y);
-        for (unsigned long x=0; x<spec.width; ++x, ++it, src+=3) {
-          unsigned long c = *((const unsigned long*)src);
-          *it = doc::rgba(
-            uint8_t((c & spec.red_mask) >> spec.red_shift),
-            uint8_t((c & spec.green_mask) >> spec.green_shift),
-            uint8_t((c & spec.blue_mask) >> spec.blue_shift),
-            255);
-        }
-      }
-      break;
-    }
-    case 16: {
-      doc::LockImageBits<doc::RgbTraits> bits(dst.get(), doc::Image::WriteLock);
-      auto it = bits.begin();
-      for (unsigned long y=0; y<spec.height; ++y) {
-        const uint16_t* src = (const uint16_t*)(img.data()+spec.bytes_per_row*y);
-        for (unsigned long x=0; x<spec.width; ++x, ++it, ++src) {
-          const uint16_t c = *((const uint16_t*)src);
-          *it = doc::rgba(
-            doc::scale_5bits_to_8bits((c & spec.red_mask  ) >> spec.red_shift  ),
-            doc::scale_6bits_to_8bits((c & spec.green_mask) >> spec.green_shift),
-            doc::scale_5bits_to_8bits((c & spec.blue_mask ) >> spec.blue_shift ),
-            255);
-        }
-      }
-      break;
+  for (unsigned long y=0; y<spec.height; ++y) {
+    const char* src = (const char*)(img.data()+spec.bytes_per_row*y);
+    auto dstRow = (doc::RgbTraits::address_t)dst->getPixelAddress(0, y);
+
+    switch (spec.bits_per_pixel) {
+      case 64: convert_64bpp_row(spec, (const uint64_t*)src, dstRow); break;
+      case 32: convert_32bpp_row(spec, (const uint32_t*)src, dstRow); break;
+      case 24: convert_24bpp_row(spec, (const uint8_t*)src, dstRow); break;
+      case 16: convert_16bpp_row(spec, (const uint16_t*)src, dstRow); break;
     }
   }
 
@@ -0,0 +1,226 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/flatten_frames.h"
+
+#include "base/parallel_for.h"
+#include "doc/algorithm/shrink_bounds.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace app {
+
+using namespace doc;
+
+namespace {
+
+// Pixels of a rendered frame, trimmed to its content.
+struct RenderedFrame {
+  gfx::Rect content;            // Relative to the rendered bounds (empty if there is nothing)
+  uint64_t hash;
+  std::vector<uint8_t> pixels;  // Rows of "content" (without padding)
+
+  RenderedFrame() : hash(0) { }
+};
+
+// FNV-1a
+uint64_t hash_bytes(const std::vector<uint8_t>& bytes)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (uint8_t b : bytes) {
+    hash ^= b;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Adds the cels of the given layer (or of the visible layers inside
+// a folder) in "frame" to the input key of the frame.
+void add_layer_input(const Layer* layer, frame_t frame,
+                     std::vector<const void*>& key)
+{
+  if (layer->isImage()) {
+    const Cel* cel = layer->cel(frame);
+    key.push_back(cel ? cel->data(): nullptr);
+  }
+  else if (layer->isFolder()) {
+    const LayerFolder* folder = static_cast<const LayerFolder*>(layer);
+    for (auto it=folder->getLayerBegin(), end=folder->getLayerEnd();
+         it!=end; ++it) {
+      if ((*it)->isVisible())
+        add_layer_input(*it, frame, key);
+    }
+  }
+}
+
+} // anonymous namespace
+
+FlattenFrames::FlattenFrames(const Sprite* sprite,
+                             const LayerList& layers,
+                             color_t bgcolor)
+  : m_sprite(sprite)
+  , m_layers(layers)
+  , m_bgcolor(bgcolor)
+  , m_trim(false)
+{
+}
+
+void FlattenFrames::run(FlatFrames& frames)
+{
+  ASSERT(m_renderFunc);
+
+  const frame_t nframes = m_sprite->totalFrames();
+  const PixelFormat format = m_sprite->pixelFormat();
+
+  frames.clear();
+  frames.resize(nframes);
+
+  // Frames with the same cels in all layers (and the same palette)
+  // give the same result, so we render only the first one.
+  std::vector<gfx::Rect> bounds(nframes);
+  std::vector<frame_t> toRender;
+  std::map<std::vector<const void*>, frame_t> inputs;
+  gfx::Size maxSize(0, 0);
+
+  for (frame_t frame(0); frame<nframes; ++frame) {
+    bounds[frame] = (m_boundsFunc ? m_boundsFunc(frame): m_sprite->bounds());
+    if (bounds[frame].isEmpty())
+      continue;
+
+    std::vector<const void*> key;
+    key.reserve(m_layers.size()+1);
+    key.push_back(m_sprite->palette(frame));
+    for (const Layer* layer : m_layers)
+      add_layer_input(layer, frame, key);
+
+    auto it = inputs.find(key);
+    if (it != inputs.end() && bounds[it->second] == bounds[frame]) {
+      frames[frame].link = it->second;
+    }
+    else {
+      inputs[key] = frame;
+      toRender.push_back(frame);
+      maxSize.w = std::max(maxSize.w, bounds[frame].w);
+      maxSize.h = std::max(maxSize.h, bounds[frame].h);
+    }
+  }
+
+  // Render frames in parallel. Images cannot be created from other
+  // threads, so each thread has its own image (created here) and
+  // keeps a copy of the trimmed pixels.
+  std::vector<RenderedFrame> rendered(toRender.size());
+  if (!toRender.empty()) {
+    const int nthreads = base::parallel_threads(int(toRender.size()));
+
+    std::vector<std::unique_ptr<Image>> scratch;
+    for (int t=0; t<nthreads; ++t)
+      scratch.emplace_back(Image::create(format, maxSize.w, maxSize.h));
+
+    base::parallel_for_threads(
+      int(toRender.size()), nthreads,
+      [&](int i, int t) {
+        Image* image = scratch[t].get();
+        const frame_t frame = toRender[i];
+        const gfx::Rect& rc = bounds[frame];
+        RenderedFrame& result = rendered[i];
+
+        fill_rect(image, gfx::Rect(0, 0, rc.w, rc.h), m_bgcolor);
+        m_renderFunc(image, rc, frame);
+
+        result.content = gfx::Rect(0, 0, rc.w, rc.h);
+        if (m_trim &&
+            !algorithm::shrink_bounds(image, gfx::Rect(result.content),
+                                      result.content, m_bgcolor)) {
+          result.content = gfx::Rect();
+          return;
+        }
+
+        const int rowBytes = image->getRowStrideSize(result.content.w);
+        result.pixels.resize(rowBytes * result.content.h);
+        for (int y=0; y<result.content.h; ++y)
+          std::memcpy(&result.pixels[y*rowBytes],
+                      image->getPixelAddress(result.content.x,
+                                             result.content.y+y),
+                      rowBytes);
+        result.hash = hash_bytes(result.pixels);
+      });
+  }
+
+  // Create images for unique results, frames with the same pixels in
+  // the same position are linked to the first one (linked cels share
+  // the position too).
+  std::unordered_multimap<uint64_t, int> hashes;
+  for (int i=0; i<int(toRender.size()); ++i) {
+    const frame_t frame = toRender[i];
+    const RenderedFrame& result = rendered[i];
+    if (result.content.isEmpty())
+      continue;
+
+    gfx::Rect rc = result.content;
+    rc.offset(bounds[frame].origin());
+    bool found = false;
+    auto range = hashes.equal_range(result.hash);
+    for (auto it=range.first; it!=range.second; ++it) {
+      const frame_t otherFrame = toRender[it->second];
+      if (frames[otherFrame].bounds == rc &&
+          rendered[it->second].pixels == result.pixels) {
+        frames[frame].link = otherFrame;
+        frames[frame].bounds = rc;
+        found = true;
+        break;
+      }
+    }
+    if (found)
+      continue;
+
+    hashes.insert(std::make_pair(result.hash, i));
+
+    std::shared_ptr<Image> image(Image::create(format, rc.w, rc.h));
+    image->setMaskColor(m_sprite->transparentColor());
+    const int rowBytes = image->getRowStrideSize(rc.w);
+    for (int y=0; y<rc.h; ++y)
+      std::memcpy(image->getPixelAddress(0, y),
+                  &result.pixels[y*rowBytes], rowBytes);
+
+    frames[frame].bounds = rc;
+    frames[frame].image = image;
+  }
+
+  // Frames with the same input use the result of the first frame
+  // (which can be a link to another frame or nothing at all).
+  for (frame_t frame(0); frame<nframes; ++frame) {
+    FlatFrame& flat = frames[frame];
+    if (flat.link < 0 || flat.image)
+      continue;
+
+    const FlatFrame& first = frames[flat.link];
+    if (first.bounds.isEmpty()) {
+      flat.link = -1;
+      flat.bounds = gfx::Rect();
+    }
+    else {
+      if (first.link >= 0)
+        flat.link = first.link;
+      flat.bounds = first.bounds;
+    }
+  }
+}
+
+} // namespace app
@@ -0,0 +1,85 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "doc/color.h"
+#include "doc/frame.h"
+#include "doc/layer_list.h"
+#include "gfx/rect.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace doc {
+  class Image;
+  class Sprite;
+}
+
+namespace app {
+
+  // Result of flattening one frame.
+  struct FlatFrame {
+    // Previous frame with exactly the same result (so both frames can
+    // use linked cels), or -1 if this frame has its own image.
+    doc::frame_t link;
+
+    // Bounds of the image in sprite coordinates. It's empty if the
+    // frame wasn't rendered or it's completely transparent.
+    gfx::Rect bounds;
+
+    std::shared_ptr<doc::Image> image;
+
+    FlatFrame() : link(-1) { }
+  };
+
+  typedef std::vector<FlatFrame> FlatFrames;
+
+  // Renders all frames of a sprite in parallel, trims each result to
+  // its content and finds frames with the same result. Frames where
+  // all input layers have the same cels (linked cels) are rendered
+  // only once, the rest are compared by the hash of their pixels.
+  class FlattenFrames {
+  public:
+    // Returns the area of the sprite to render in the given frame (an
+    // empty rectangle to skip the frame).
+    typedef std::function<gfx::Rect(doc::frame_t frame)> BoundsFunc;
+
+    // Renders the given frame/bounds in "dst". The pixel (0, 0) of
+    // "dst" is "bounds.origin()" in sprite coordinates, and it's
+    // already cleared with the background color. It's called from
+    // several threads at the same time, so it cannot modify the
+    // sprite.
+    typedef std::function<void(doc::Image* dst,
+                               const gfx::Rect& bounds,
+                               doc::frame_t frame)> RenderFunc;
+
+    // The "layers" are the input of each frame (for folders, their
+    // visible children). Two frames with the same cels in all these
+    // layers are expected to produce the same result.
+    FlattenFrames(const doc::Sprite* sprite,
+                  const doc::LayerList& layers,
+                  doc::color_t bgcolor);
+
+    void setTrim(bool state) { m_trim = state; }
+    void setBoundsFunc(const BoundsFunc& func) { m_boundsFunc = func; }
+    void setRenderFunc(const RenderFunc& func) { m_renderFunc = func; }
+
+    // Must be called from the main thread (it creates images).
+    void run(FlatFrames& frames);
+
+  private:
+    const doc::Sprite* m_sprite;
+    doc::LayerList m_layers;
+    doc::color_t m_bgcolor;
+    bool m_trim;
+    BoundsFunc m_boundsFunc;
+    RenderFunc m_renderFunc;
+  };
+
+} // namespace app
@@ -0,0 +1,118 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/util/flatten_frames.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+#include "render/render.h"
+
+#include <memory>
+
+using namespace app;
+using namespace doc;
+
+namespace {
+
+  Cel* add_cel(LayerImage* layer, frame_t frame, int x, int y, color_t color) {
+    std::shared_ptr<Image> image(Image::create(IMAGE_RGB, 4, 4));
+    clear_image(image.get(), color);
+    Cel* cel = new Cel(frame, image);
+    cel->setPosition(x, y);
+    layer->addCel(cel);
+    return cel;
+  }
+
+  void flatten(const Sprite* sprite, FlatFrames& frames) {
+    LayerList layers;
+    for (Layer* layer : sprite->folder()->getLayersList())
+      layers.push_back(layer);
+
+    FlattenFrames flatten(sprite, layers, sprite->transparentColor());
+    flatten.setTrim(true);
+    flatten.setRenderFunc(
+      [sprite](Image* dst, const gfx::Rect& bounds, frame_t frame) {
+        render::Render render;
+        render.setBgType(render::BgType::NONE);
+        render.renderSprite(dst, sprite, frame, gfx::Clip(0, 0, bounds));
+      });
+    flatten.run(frames);
+  }
+
+}
+
+// Linked cels share the position, so the same pixels in a different
+// position cannot be linked.
+TEST(FlattenFrames, SamePixelsInOtherPosition)
+{
+  std::unique_ptr<Sprite> sprite(new Sprite(IMAGE_RGB, 32, 32, 256));
+  sprite->setTotalFrames(3);
+  LayerImage* layer = new LayerImage(sprite.get());
+  sprite->folder()->addLayer(layer);
+
+  const color_t red = rgba(255, 0, 0, 255);
+  add_cel(layer, frame_t(0), 2, 2, red);
+  add_cel(layer, frame_t(1), 10, 12, red);
+  add_cel(layer, frame_t(2), 2, 2, red);
+
+  FlatFrames frames;
+  flatten(sprite.get(), frames);
+  ASSERT_EQ(3, int(frames.size()));
+
+  EXPECT_EQ(-1, frames[0].link);
+  EXPECT_EQ(gfx::Rect(2, 2, 4, 4), frames[0].bounds);
+
+  EXPECT_EQ(-1, frames[1].link);
+  EXPECT_EQ(gfx::Rect(10, 12, 4, 4), frames[1].bounds);
+  EXPECT_TRUE(frames[1].image != nullptr);
+
+  EXPECT_EQ(0, frames[2].link);
+  EXPECT_EQ(gfx::Rect(2, 2, 4, 4), frames[2].bounds);
+}
+
+// Frames with the same cels in all top-level layers but different
+// cels inside a folder must be rendered.
+TEST(FlattenFrames, CelsInsideFolders)
+{
+  std::unique_ptr<Sprite> sprite(new Sprite(IMAGE_RGB, 32, 32, 256));
+  sprite->setTotalFrames(2);
+  LayerFolder* folder = new LayerFolder(sprite.get());
+  LayerImage* child = new LayerImage(sprite.get());
+  LayerImage* hidden = new LayerImage(sprite.get());
+  hidden->setVisible(false);
+  sprite->folder()->addLayer(folder);
+  folder->addLayer(child);
+  folder->addLayer(hidden);
+
+  Cel* cel = add_cel(child, frame_t(0), 2, 2, rgba(255, 0, 0, 255));
+  Cel* link = Cel::createLink(cel);
+  link->setFrame(frame_t(1));
+  child->addCel(link);
+
+  // Only the hidden layer is different in frame 1
+  add_cel(hidden, frame_t(1), 0, 0, rgba(0, 0, 255, 255));
+
+  FlatFrames frames;
+  flatten(sprite.get(), frames);
+  EXPECT_EQ(0, frames[1].link);
+  EXPECT_EQ(gfx::Rect(2, 2, 4, 4), frames[1].bounds);
+
+  // Now the visible child is different in frame 1
+  child->removeCel(link);
+  delete link;
+  add_cel(child, frame_t(1), 2, 2, rgba(0, 255, 0, 255));
+
+  flatten(sprite.get(), frames);
+  EXPECT_EQ(-1, frames[1].link);
+  EXPECT_EQ(gfx::Rect(2, 2, 4, 4), frames[1].bounds);
+  ASSERT_TRUE(frames[1].image != nullptr);
+  EXPECT_EQ(rgba(0, 255, 0, 255), get_pixel(frames[1].image.get(), 0, 0));
+}
@@ -146,6 +146,11 @@ Note that injections through Provides are also non-owning. When "am" goes out of
 it will be deleted and that will cause the deletion of Person. Person will not try
 to delete AccountManager. Perfectly balanced...
 
+Instances registered with Provides are only visible in the thread that created them, so
+each thread can provide its own objects (e.g. two threads running scripts, each one with
+its own engine). The other policies are global, and classes should be registered before
+other threads start to inject them.
+
 */
 
 #pragma once
@@ -277,6 +282,13 @@ public:
     return *registry;
   }
 
+  // Instances registered with Provides are visible only in the thread
+  // that created them (they have priority over the global registry).
+  static Registry& getThreadRegistry() {
+    static thread_local Registry registry;
+    return registry;
+  }
+
   static std::vector<inject<BaseClass>> getAllWithFlag(const std::string& flag) {
     std::vector<std::string> temp;
     std::vector<inject<BaseClass>> all;
@@ -398,7 +410,7 @@ public:
     std::string m_name;
 
     ~Provides(){
-      auto& registry = Injectable<BaseClass>::getRegistry();
+      auto& registry = Injectable<BaseClass>::getThreadRegistry();
       auto iterator = registry.find(m_name);
       if (iterator != registry.end() && iterator->second.data == this) {
         registry.erase(iterator);
@@ -408,7 +420,7 @@ public:
     template<typename DerivedClass>
     Provides(DerivedClass* instance, const std::string& name = "", const std::unordered_set<std::string>& flags = {}) {
       m_name = name;
-      Injectable<BaseClass>::getRegistry()[name] = {
+      Injectable<BaseClass>::getThreadRegistry()[name] = {
         [=] {return instance;},
         [](BaseClass* ptr) {},
         matchType<DerivedClass>,
@@ -421,9 +433,13 @@ public:
 
 template<typename BaseClass_>
 void inject<BaseClass_>::doInjection(const std::string& name) {
-  auto& registry = Injectable<BaseClass>::getRegistry();
-  auto it = registry.find(name);
-  if (it != registry.end()) {
+  auto* registry = &Injectable<BaseClass>::getThreadRegistry();
+  auto it = registry->find(name);
+  if (it == registry->end()) {
+    registry = &Injectable<BaseClass>::getRegistry();
+    it = registry->find(name);
+  }
+  if (it != registry->end()) {
     auto& registryEntry = it->second;
     onDetach = registryEntry.detach;
     m_ptr = registryEntry.attach();
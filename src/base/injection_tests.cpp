@@ -0,0 +1,77 @@
+// Aseprite Base Library
+// Copyright (c) 2021 LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <gtest/gtest.h>
+
+#include "base/injection.h"
+
+#include <thread>
+
+namespace {
+
+  class Service : public Injectable<Service> {
+  public:
+    virtual int value() const = 0;
+  };
+
+  class DefaultService : public Service {
+  public:
+    int value() const override { return 1; }
+  };
+
+  class LocalService : public Service {
+  public:
+    LocalService(int value) : m_value(value) { }
+    int value() const override { return m_value; }
+  private:
+    int m_value;
+    Provides m_provides{this, "local"};
+  };
+
+  Service::Regular<DefaultService> reg("local");
+
+} // anonymous namespace
+
+TEST(Injection, Regular)
+{
+  inject<Service> service{"local"};
+  ASSERT_TRUE(service);
+  EXPECT_EQ(1, service->value());
+}
+
+TEST(Injection, ProvidesIsLocalToThread)
+{
+  LocalService local(2);
+  EXPECT_EQ(2, inject<Service>{"local"}->value());
+
+  int other = 0;
+  std::thread thread(
+    [&other]{
+      EXPECT_EQ(1, inject<Service>{"local"}->value());
+
+      LocalService local(3);
+      other = inject<Service>{"local"}->value();
+    });
+  thread.join();
+
+  EXPECT_EQ(3, other);
+  EXPECT_EQ(2, inject<Service>{"local"}->value());
+}
+
+TEST(Injection, ProvidesIsRemoved)
+{
+  {
+    LocalService local(4);
+    EXPECT_EQ(4, inject<Service>{"local"}->value());
+  }
+  EXPECT_EQ(1, inject<Service>{"local"}->value());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
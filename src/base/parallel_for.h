@@ -0,0 +1,74 @@
+// Aseprite Base Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace base {
+
+  // Returns the number of threads to process "n" work items in
+  // parallel (one thread per core, and never more threads than items).
+  inline int parallel_threads(int n, int maxThreads = 0) {
+    int threads = std::max<int>(1, std::thread::hardware_concurrency());
+    if (maxThreads > 0)
+      threads = std::min(threads, maxThreads);
+    return std::max(1, std::min(threads, n));
+  }
+
+  // Calls func(i, t) for each i in [0, n) using "nthreads" threads
+  // (the calling thread and nthreads-1 extra threads), where "t" is
+  // the index in [0, nthreads) of the thread that processes the item
+  // (e.g. to use scratch data for each thread). The function returns
+  // when all items were processed.
+  //
+  // If "useCallingThread" is false, all items are processed in new
+  // threads (e.g. when the calling thread has thread-local state that
+  // cannot be used by "func").
+  //
+  // "func" can be called from several threads at the same time, so it
+  // must not modify shared state without synchronization.
+  template<typename Func>
+  void parallel_for_threads(int n, int nthreads, Func&& func,
+                            bool useCallingThread = true) {
+    if (n <= 0)
+      return;
+
+    if (nthreads <= 1 && useCallingThread) {
+      for (int i=0; i<n; ++i)
+        func(i, 0);
+      return;
+    }
+
+    std::atomic<int> next(0);
+    auto worker =
+      [&](int t){
+        for (int i; (i = next++) < n; )
+          func(i, t);
+      };
+
+    std::vector<std::thread> threads;
+    for (int t=(useCallingThread ? 1: 0); t<std::max(1, nthreads); ++t)
+      threads.push_back(std::thread(worker, t));
+    if (useCallingThread)
+      worker(0);
+    for (auto& thread : threads)
+      thread.join();
+  }
+
+  // Calls func(i) for each i in [0, n) in parallel_threads(n, maxThreads)
+  // threads.
+  template<typename Func>
+  void parallel_for(int n, Func&& func, int maxThreads = 0) {
+    parallel_for_threads(
+      n, parallel_threads(n, maxThreads),
+      [&func](int i, int){ func(i); });
+  }
+
+} // namespace base
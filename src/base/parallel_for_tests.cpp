@@ -0,0 +1,76 @@
+// Aseprite Base Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <gtest/gtest.h>
+
+#include "base/parallel_for.h"
+
+#include <atomic>
+#include <vector>
+
+TEST(ParallelFor, EachItemOnce)
+{
+  for (int n : { 0, 1, 7, 1000 }) {
+    std::vector<std::atomic<int> > calls(n);
+    for (auto& c : calls)
+      c = 0;
+
+    base::parallel_for(n, [&](int i){ ++calls[i]; });
+
+    for (int i=0; i<n; ++i)
+      EXPECT_EQ(1, calls[i].load());
+  }
+}
+
+TEST(ParallelFor, MaxThreads)
+{
+  EXPECT_EQ(1, base::parallel_threads(0));
+  EXPECT_EQ(1, base::parallel_threads(1));
+  EXPECT_EQ(1, base::parallel_threads(100, 1));
+  EXPECT_GE(2, base::parallel_threads(100, 2));
+
+  int sum = 0;                  // Not synchronized, only one thread
+  base::parallel_for(100, [&](int i){ sum += i; }, 1);
+  EXPECT_EQ(4950, sum);
+}
+
+TEST(ParallelFor, ThreadIndex)
+{
+  const int nthreads = base::parallel_threads(1000);
+  std::vector<int> sums(nthreads, 0); // Each thread modifies its sum
+  base::parallel_for_threads(
+    1000, nthreads,
+    [&](int i, int t){
+      ASSERT_TRUE(t >= 0 && t < nthreads);
+      sums[t] += i;
+    });
+
+  int sum = 0;
+  for (int s : sums)
+    sum += s;
+  EXPECT_EQ(499500, sum);
+}
+
+TEST(ParallelFor, OnlyNewThreads)
+{
+  const std::thread::id caller = std::this_thread::get_id();
+  std::atomic<int> inCaller(0), calls(0);
+  base::parallel_for_threads(
+    50, 3,
+    [&](int i, int t){
+      if (std::this_thread::get_id() == caller)
+        ++inCaller;
+      ++calls;
+    }, false);
+  EXPECT_EQ(0, inCaller.load());
+  EXPECT_EQ(50, calls.load());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,61 @@
+// Aseprite Base Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "base/phase_timer.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace base {
+
+namespace details {
+  std::atomic<bool> phase_timing_enabled(false);
+}
+
+static std::mutex stats_mutex;
+static std::vector<PhaseStats> stats;
+
+void enable_phase_timing(bool state)
+{
+  details::phase_timing_enabled = state;
+}
+
+void reset_phase_stats()
+{
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  stats.clear();
+}
+
+std::vector<PhaseStats> get_phase_stats()
+{
+  std::lock_guard<std::mutex> lock(stats_mutex);
+  return stats;
+}
+
+void details::add_phase_time(const char* name, double seconds)
+{
+  std::lock_guard<std::mutex> lock(stats_mutex);
+
+  // There are just a few phases, a linear search is enough.
+  auto it = std::find_if(
+    stats.begin(), stats.end(),
+    [name](const PhaseStats& s){ return s.name == name; });
+  if (it == stats.end()) {
+    stats.push_back(PhaseStats());
+    it = stats.end()-1;
+    it->name = name;
+  }
+
+  ++it->count;
+  it->total += seconds;
+  it->max = std::max(it->max, seconds);
+}
+
+} // namespace base
@@ -0,0 +1,67 @@
+// Aseprite Base Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace base {
+
+  // Accumulated time of one phase of the program (e.g. "render",
+  // "paint", etc.).
+  struct PhaseStats {
+    std::string name;
+    int count = 0;
+    double total = 0.0;         // In seconds
+    double max = 0.0;
+  };
+
+  // Phase timing is disabled by default, ScopedPhase does nothing
+  // until it's enabled (e.g. when a recorded session is replayed).
+  void enable_phase_timing(bool state);
+  void reset_phase_stats();
+  std::vector<PhaseStats> get_phase_stats();
+
+  namespace details {
+    extern std::atomic<bool> phase_timing_enabled;
+    void add_phase_time(const char* name, double seconds);
+  }
+
+  inline bool is_phase_timing_enabled() {
+    return details::phase_timing_enabled.load(std::memory_order_relaxed);
+  }
+
+  // Adds the time of its scope to the given phase. Nested scopes of
+  // the same phase are counted in each one. The name must be a string
+  // literal (phases are identified by name).
+  class ScopedPhase {
+  public:
+    ScopedPhase(const char* name)
+      : m_name(is_phase_timing_enabled() ? name: nullptr) {
+      if (m_name)
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedPhase() {
+      if (m_name) {
+        std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - m_start;
+        details::add_phase_time(m_name, elapsed.count());
+      }
+    }
+
+  private:
+    const char* m_name;
+    std::chrono::steady_clock::time_point m_start;
+
+    ScopedPhase(const ScopedPhase&);
+    ScopedPhase& operator=(const ScopedPhase&);
+  };
+
+} // namespace base
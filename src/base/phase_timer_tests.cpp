@@ -0,0 +1,59 @@
+// Aseprite Base Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "base/phase_timer.h"
+
+using namespace base;
+
+TEST(PhaseTimer, DisabledByDefault)
+{
+  reset_phase_stats();
+  {
+    ScopedPhase phase("a");
+  }
+  EXPECT_TRUE(get_phase_stats().empty());
+}
+
+TEST(PhaseTimer, CountPhases)
+{
+  reset_phase_stats();
+  enable_phase_timing(true);
+  for (int i=0; i<3; ++i) {
+    ScopedPhase a("a");
+    ScopedPhase b("b");
+  }
+  {
+    ScopedPhase b("b");
+  }
+  enable_phase_timing(false);
+  {
+    ScopedPhase a("a");
+  }
+
+  std::vector<PhaseStats> stats = get_phase_stats();
+  ASSERT_EQ(2, int(stats.size()));
+  for (const auto& s : stats) {
+    if (s.name == "a")
+      EXPECT_EQ(3, s.count);
+    else {
+      EXPECT_EQ("b", s.name);
+      EXPECT_EQ(4, s.count);
+    }
+    EXPECT_LE(s.max, s.total);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -10,6 +10,8 @@
 
 #include "doc/algorithm/resize_image.h"
 
+#include "base/base.h"
+#include "base/pi.h"
 #include "doc/algorithm/rotsprite.h"
 #include "doc/image_impl.h"
 #include "doc/palette.h"
@@ -17,33 +19,379 @@
 #include "doc/rgbmap.h"
 #include "gfx/point.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
 namespace doc {
 namespace algorithm {
 
+namespace {
+
+// Fixed-point precision of filter weights (1.0 = kWeightOne).
+const int kWeightBits = 14;
+const int kWeightOne = (1 << kWeightBits);
+
+// Fractional bits kept between the horizontal and the vertical pass.
+const int kExtraBits = 7;
+
+const double kLanczosRadius = 3.0;
+
+// Source pixels (and their weights) used to calculate each
+// destination pixel in one axis. All destination pixels use the same
+// number of taps so the inner loops don't have variable bounds,
+// unused taps have a weight of zero.
+struct FilterTable {
+  int taps;
+  std::vector<int> start;       // First source pixel for each destination pixel
+  std::vector<int> weights;     // "taps" weights for each destination pixel
+};
+
+double sinc(double x)
+{
+  if (x == 0.0)
+    return 1.0;
+  x *= PI;
+  return std::sin(x) / x;
+}
+
+// Calculates the contribution of each source pixel in [lo, hi] to
+// destination pixel "x" with floating point weights, which are
+// normalized and converted to fixed-point by create_filter_table().
+void calc_weights(ResizeMethod method, int x, int srcSize, int dstSize,
+                  int& lo, std::vector<double>& weights)
+{
+  weights.clear();
+
+  switch (method) {
+
+    // Same mapping as the old floating point implementation: the first
+    // and last pixels of both images are aligned.
+    case RESIZE_METHOD_BILINEAR: {
+      double du = (dstSize > 1 ? double(srcSize-1) / double(dstSize-1): 0.0);
+      double u = x * du;
+      lo = int(std::floor(u));
+      double f = u - lo;
+      weights.push_back(1.0 - f);
+      weights.push_back(f);
+      break;
+    }
+
+    case RESIZE_METHOD_BOX: {
+      double scale = double(srcSize) / double(dstSize);
+      double a = x * scale;
+      double b = (x+1) * scale;
+      lo = int(std::floor(a));
+      int hi = int(std::ceil(b));
+      for (int j=lo; j<hi; ++j)
+        weights.push_back(std::min(b, j+1.0) - std::max(a, double(j)));
+      break;
+    }
+
+    case RESIZE_METHOD_LANCZOS: {
+      double scale = double(srcSize) / double(dstSize);
+      double fscale = std::max(scale, 1.0);
+      double center = (x+0.5) * scale;
+      double support = kLanczosRadius * fscale;
+      lo = int(std::floor(center - support));
+      int hi = int(std::ceil(center + support));
+      for (int j=lo; j<=hi; ++j) {
+        double d = (j+0.5 - center) / fscale;
+        if (std::fabs(d) < kLanczosRadius)
+          weights.push_back(sinc(d) * sinc(d / kLanczosRadius));
+        else
+          weights.push_back(0.0);
+      }
+      break;
+    }
+
+    default:
+      ASSERT(false);
+      lo = 0;
+      weights.push_back(1.0);
+      break;
+  }
+}
+
+void create_filter_table(ResizeMethod method, int srcSize, int dstSize,
+                         FilterTable& table)
+{
+  std::vector<std::vector<double> > fweights(dstSize);
+  std::vector<int> lo(dstSize);
+
+  // Source pixels outside the image are clamped to the edges, so the
+  // range of each destination pixel is [lo, lo+size) after clamping.
+  table.taps = 1;
+  for (int x=0; x<dstSize; ++x) {
+    calc_weights(method, x, srcSize, dstSize, lo[x], fweights[x]);
+
+    int a = MID(0, lo[x], srcSize-1);
+    int b = MID(0, lo[x]+int(fweights[x].size())-1, srcSize-1);
+    table.taps = std::max(table.taps, b-a+1);
+  }
+
+  table.start.resize(dstSize);
+  table.weights.resize(dstSize * table.taps);
+
+  std::vector<double> w(table.taps);
+  for (int x=0; x<dstSize; ++x) {
+    int start = MID(0, lo[x], srcSize-1);
+    start = std::min(start, srcSize-table.taps);
+    table.start[x] = start;
+
+    std::fill(w.begin(), w.end(), 0.0);
+    double sum = 0.0;
+    for (int i=0; i<int(fweights[x].size()); ++i) {
+      int j = MID(0, lo[x]+i, srcSize-1) - start;
+      w[j] += fweights[x][i];
+      sum += fweights[x][i];
+    }
+    if (sum == 0.0) {
+      w[0] = sum = 1.0;
+    }
+
+    // Round the normalized weights, and give the rounding error to the
+    // biggest one so they sum exactly kWeightOne.
+    int* iw = &table.weights[x * table.taps];
+    int isum = 0, biggest = 0;
+    for (int j=0; j<table.taps; ++j) {
+      iw[j] = int(std::floor(w[j] / sum * kWeightOne + 0.5));
+      isum += iw[j];
+      if (std::abs(iw[j]) > std::abs(iw[biggest]))
+        biggest = j;
+    }
+    iw[biggest] += kWeightOne - isum;
+  }
+}
+
+// Converts source rows to N 8-bit channels (RGBA or gray+alpha), and
+// destination rows from channels to pixels.
+template<typename ImageTraits>
+struct ChannelConverter;
+
+template<>
+struct ChannelConverter<RgbTraits> {
+  enum { N = 4 };
+  ChannelConverter(const Palette*, const RgbMap*, color_t) { }
+
+  void toChannels(const RgbTraits::pixel_t* src, int w, uint8_t* dst) const {
+    for (int x=0; x<w; ++x, dst+=4) {
+      color_t c = src[x];
+      dst[0] = rgba_getr(c);
+      dst[1] = rgba_getg(c);
+      dst[2] = rgba_getb(c);
+      dst[3] = rgba_geta(c);
+    }
+  }
+
+  void fromChannels(const uint8_t* src, int w, RgbTraits::pixel_t* dst) const {
+    for (int x=0; x<w; ++x, src+=4)
+      dst[x] = rgba(src[0], src[1], src[2], src[3]);
+  }
+};
+
+template<>
+struct ChannelConverter<GrayscaleTraits> {
+  enum { N = 2 };
+  ChannelConverter(const Palette*, const RgbMap*, color_t) { }
+
+  void toChannels(const GrayscaleTraits::pixel_t* src, int w, uint8_t* dst) const {
+    for (int x=0; x<w; ++x, dst+=2) {
+      dst[0] = graya_getv(src[x]);
+      dst[1] = graya_geta(src[x]);
+    }
+  }
+
+  void fromChannels(const uint8_t* src, int w, GrayscaleTraits::pixel_t* dst) const {
+    for (int x=0; x<w; ++x, src+=2)
+      dst[x] = graya(src[0], src[1]);
+  }
+};
+
+template<>
+struct ChannelConverter<IndexedTraits> {
+  enum { N = 4 };
+
+  ChannelConverter(const Palette* palette, const RgbMap* rgbmap, color_t maskColor)
+    : m_rgbmap(rgbmap) {
+    ASSERT(palette);
+    ASSERT(rgbmap);
+    for (int i=0; i<256; ++i) {
+      color_t c = (i < palette->size() ? palette->getEntry(i): rgba(0, 0, 0, 255));
+      if (color_t(i) == maskColor)
+        c &= rgba_rgb_mask;     // Set alpha = 0
+      m_lut[i] = c;
+    }
+  }
+
+  void toChannels(const IndexedTraits::pixel_t* src, int w, uint8_t* dst) const {
+    for (int x=0; x<w; ++x, dst+=4) {
+      color_t c = m_lut[src[x]];
+      dst[0] = rgba_getr(c);
+      dst[1] = rgba_getg(c);
+      dst[2] = rgba_getb(c);
+      dst[3] = rgba_geta(c);
+    }
+  }
+
+  void fromChannels(const uint8_t* src, int w, IndexedTraits::pixel_t* dst) const {
+    for (int x=0; x<w; ++x, src+=4)
+      dst[x] = m_rgbmap->mapColor(src[0], src[1], src[2], src[3]);
+  }
+
+private:
+  const RgbMap* m_rgbmap;
+  color_t m_lut[256];
+};
+
+// Horizontal pass: filters one row of channels to the destination
+// width. The result keeps kExtraBits of fractional precision.
+template<int N>
+void filter_row(const uint8_t* src, const FilterTable& table, int dstWidth, int* dst)
+{
+  const int taps = table.taps;
+  const int shift = kWeightBits - kExtraBits;
+  const int round = 1 << (shift-1);
+
+  for (int x=0; x<dstWidth; ++x, dst+=N) {
+    const uint8_t* s = src + table.start[x]*N;
+    const int* w = &table.weights[x*taps];
+    int acc[N];
+    for (int c=0; c<N; ++c)
+      acc[c] = round;
+    for (int t=0; t<taps; ++t, s+=N)
+      for (int c=0; c<N; ++c)
+        acc[c] += s[c] * w[t];
+    for (int c=0; c<N; ++c)
+      dst[c] = acc[c] >> shift;
+  }
+}
+
+template<typename ImageTraits>
+void resize_image_filter(const Image* src, Image* dst, ResizeMethod method,
+                         const Palette* palette, const RgbMap* rgbmap,
+                         color_t maskColor)
+{
+  typedef ChannelConverter<ImageTraits> Converter;
+  const int N = Converter::N;
+  const int sw = src->width();
+  const int sh = src->height();
+  const int dw = dst->width();
+  const int dh = dst->height();
+  const int shift = kWeightBits + kExtraBits;
+  const int round = 1 << (shift-1);
+
+  Converter converter(palette, rgbmap, maskColor);
+  FilterTable xtable, ytable;
+  create_filter_table(method, sw, dw, xtable);
+  create_filter_table(method, sh, dh, ytable);
+
+  // Horizontally filtered source rows. Vertical windows only move
+  // forward, so a ring of "ytable.taps" rows is enough and each source
+  // row is filtered only once.
+  const int rowSize = dw*N;
+  const int nrows = ytable.taps;
+  std::vector<int> rows(rowSize * nrows);
+  std::vector<int> rowIndex(nrows, -1);
+
+  std::vector<uint8_t> srcChannels(sw*N);
+  std::vector<int> acc(rowSize);
+  std::vector<uint8_t> dstChannels(rowSize);
+
+  for (int y=0; y<dh; ++y) {
+    const int start = ytable.start[y];
+    const int* w = &ytable.weights[y*ytable.taps];
+
+    std::fill(acc.begin(), acc.end(), round);
+
+    for (int t=0; t<ytable.taps; ++t) {
+      const int sy = start+t;
+      const int slot = sy % nrows;
+      int* row = &rows[slot*rowSize];
+
+      if (rowIndex[slot] != sy) {
+        converter.toChannels(
+          (const typename ImageTraits::pixel_t*)src->getPixelAddress(0, sy),
+          sw, &srcChannels[0]);
+        filter_row<N>(&srcChannels[0], xtable, dw, row);
+        rowIndex[slot] = sy;
+      }
+
+      const int wt = w[t];
+      if (wt == 0)
+        continue;
+
+      int* a = &acc[0];
+      for (int i=0; i<rowSize; ++i)
+        a[i] += row[i] * wt;
+    }
+
+    for (int i=0; i<rowSize; ++i) {
+      int v = acc[i] >> shift;
+      dstChannels[i] = MID(0, v, 255);
+    }
+
+    converter.fromChannels(
+      &dstChannels[0], dw,
+      (typename ImageTraits::pixel_t*)dst->getPixelAddress(0, y));
+  }
+}
+
+// Source column/row for each destination column/row.
+void create_nearest_table(int srcSize, int dstSize, std::vector<int>& table)
+{
+  table.resize(dstSize);
+  for (int x=0; x<dstSize; ++x)
+    table[x] = int(int64_t(x) * srcSize / dstSize);
+}
+
 template<typename ImageTraits>
 void resize_image_nearest(const Image* src, Image* dst)
 {
-  double x_ratio = double(src->width()) / double(dst->width());
-  double y_ratio = double(src->height()) / double(dst->height());
-  double px, py;
+  std::vector<int> xtable, ytable;
+  create_nearest_table(src->width(), dst->width(), xtable);
+  create_nearest_table(src->height(), dst->height(), ytable);
 
-  LockImageBits<ImageTraits> dstBits(dst);
-  auto dstIt = dstBits.begin();
+  const int dw = dst->width();
+  const int* xs = &xtable[0];
 
   for (int y=0; y<dst->height(); ++y) {
-    py = floor(y * y_ratio);
-    for (int x=0; x<dst->width(); ++x, ++dstIt) {
-      px = floor(x * x_ratio);
-      *dstIt = get_pixel_fast<ImageTraits>(src, px, py);
-    }
+    auto s = (const typename ImageTraits::pixel_t*)src->getPixelAddress(0, ytable[y]);
+    auto d = (typename ImageTraits::pixel_t*)dst->getPixelAddress(0, y);
+    for (int x=0; x<dw; ++x)
+      d[x] = s[xs[x]];
   }
 }
 
+// Bitmap pixels are not addressable, so here we use the slow path.
+template<>
+void resize_image_nearest<BitmapTraits>(const Image* src, Image* dst)
+{
+  std::vector<int> xtable, ytable;
+  create_nearest_table(src->width(), dst->width(), xtable);
+  create_nearest_table(src->height(), dst->height(), ytable);
+
+  for (int y=0; y<dst->height(); ++y)
+    for (int x=0; x<dst->width(); ++x)
+      put_pixel_fast<BitmapTraits>(
+        dst, x, y, get_pixel_fast<BitmapTraits>(src, xtable[x], ytable[y]));
+}
+
+} // anonymous namespace
+
 void resize_image(const Image* src, Image* dst, ResizeMethod method, const Palette* pal, const RgbMap* rgbmap, color_t maskColor)
 {
+  if (src->width() <= 0 || src->height() <= 0 ||
+      dst->width() <= 0 || dst->height() <= 0)
+    return;
+
+  if (method != RESIZE_METHOD_ROTSPRITE &&
+      src->pixelFormat() == IMAGE_BITMAP)
+    method = RESIZE_METHOD_NEAREST_NEIGHBOR;
+
   switch (method) {
 
-    // TODO optimize this
     case RESIZE_METHOD_NEAREST_NEIGHBOR: {
       ASSERT(src->pixelFormat() == dst->pixelFormat());
 
@@ -56,100 +404,15 @@ void resize_image(const Image* src, Image* dst, ResizeMethod method, const Palet
       break;
     }
 
-    // TODO optimize this
-    case RESIZE_METHOD_BILINEAR: {
-      uint32_t color[4], dst_color = 0;
-      double u, v, du, dv;
-      int u_floor, u_floor2;
-      int v_floor, v_floor2;
-      int x, y;
-
-      u = v = 0.0;
-      du = (src->width()-1) * 1.0 / (dst->width()-1);
-      dv = (src->height()-1) * 1.0 / (dst->height()-1);
-      for (y=0; y<dst->height(); ++y) {
-        for (x=0; x<dst->width(); ++x) {
-          u_floor = (int)floor(u);
-          v_floor = (int)floor(v);
-
-          if (u_floor > src->width()-1) {
-            u_floor = src->width()-1;
-            u_floor2 = src->width()-1;
-          }
-          else if (u_floor == src->width()-1)
-            u_floor2 = u_floor;
-          else
-            u_floor2 = u_floor+1;
-
-          if (v_floor > src->height()-1) {
-            v_floor = src->height()-1;
-            v_floor2 = src->height()-1;
-          }
-          else if (v_floor == src->height()-1)
-            v_floor2 = v_floor;
-          else
-            v_floor2 = v_floor+1;
-
-          // get the four colors
-          color[0] = src->getPixel(u_floor,  v_floor);
-          color[1] = src->getPixel(u_floor2, v_floor);
-          color[2] = src->getPixel(u_floor,  v_floor2);
-          color[3] = src->getPixel(u_floor2, v_floor2);
-
-          // calculate the interpolated color
-          double u1 = u - u_floor;
-          double v1 = v - v_floor;
-          double u2 = 1 - u1;
-          double v2 = 1 - v1;
-
-          switch (dst->pixelFormat()) {
-            case IMAGE_RGB: {
-              int r = int((rgba_getr(color[0])*u2 + rgba_getr(color[1])*u1)*v2 +
-                          (rgba_getr(color[2])*u2 + rgba_getr(color[3])*u1)*v1);
-              int g = int((rgba_getg(color[0])*u2 + rgba_getg(color[1])*u1)*v2 +
-                          (rgba_getg(color[2])*u2 + rgba_getg(color[3])*u1)*v1);
-              int b = int((rgba_getb(color[0])*u2 + rgba_getb(color[1])*u1)*v2 +
-                          (rgba_getb(color[2])*u2 + rgba_getb(color[3])*u1)*v1);
-              int a = int((rgba_geta(color[0])*u2 + rgba_geta(color[1])*u1)*v2 +
-                          (rgba_geta(color[2])*u2 + rgba_geta(color[3])*u1)*v1);
-              dst_color = rgba(r, g, b, a);
-              break;
-            }
-            case IMAGE_GRAYSCALE: {
-              int v = int((graya_getv(color[0])*u2 + graya_getv(color[1])*u1)*v2 +
-                          (graya_getv(color[2])*u2 + graya_getv(color[3])*u1)*v1);
-              int a = int((graya_geta(color[0])*u2 + graya_geta(color[1])*u1)*v2 +
-                          (graya_geta(color[2])*u2 + graya_geta(color[3])*u1)*v1);
-              dst_color = graya(v, a);
-              break;
-            }
-            case IMAGE_INDEXED: {
-              // Convert index to RGBA values
-              for (int i=0; i<4; ++i) {
-                if (color[i] == maskColor)
-                  color[i] = pal->getEntry(color[i]) & rgba_rgb_mask; // Set alpha = 0
-                else
-                  color[i] = pal->getEntry(color[i]);
-              }
-
-              int r = int((rgba_getr(color[0])*u2 + rgba_getr(color[1])*u1)*v2 +
-                          (rgba_getr(color[2])*u2 + rgba_getr(color[3])*u1)*v1);
-              int g = int((rgba_getg(color[0])*u2 + rgba_getg(color[1])*u1)*v2 +
-                          (rgba_getg(color[2])*u2 + rgba_getg(color[3])*u1)*v1);
-              int b = int((rgba_getb(color[0])*u2 + rgba_getb(color[1])*u1)*v2 +
-                          (rgba_getb(color[2])*u2 + rgba_getb(color[3])*u1)*v1);
-              int a = int((rgba_geta(color[0])*u2 + rgba_geta(color[1])*u1)*v2 +
-                          (rgba_geta(color[2])*u2 + rgba_geta(color[3])*u1)*v1);
-              dst_color = rgbmap->mapColor(r, g, b, a);
-              break;
-            }
-          }
+    case RESIZE_METHOD_BILINEAR:
+    case RESIZE_METHOD_BOX:
+    case RESIZE_METHOD_LANCZOS: {
+      ASSERT(src->pixelFormat() == dst->pixelFormat());
 
-          dst->putPixel(x, y, dst_color);
-          u += du;
-        }
-        u = 0.0;
-        v += dv;
+      switch (src->pixelFormat()) {
+        case IMAGE_RGB: resize_image_filter<RgbTraits>(src, dst, method, pal, rgbmap, maskColor); break;
+        case IMAGE_GRAYSCALE: resize_image_filter<GrayscaleTraits>(src, dst, method, pal, rgbmap, maskColor); break;
+        case IMAGE_INDEXED: resize_image_filter<IndexedTraits>(src, dst, method, pal, rgbmap, maskColor); break;
       }
       break;
     }
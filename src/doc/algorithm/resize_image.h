@@ -20,11 +20,20 @@ namespace doc {
       RESIZE_METHOD_NEAREST_NEIGHBOR,
       RESIZE_METHOD_BILINEAR,
       RESIZE_METHOD_ROTSPRITE,
+      RESIZE_METHOD_BOX,        // Area average, for downscaling
+      RESIZE_METHOD_LANCZOS,    // Lanczos-3
     };
 
     // Resizes the source image 'src' to the destination image 'dst'.
     //
-    // Warning: If you are using the RESIZE_METHOD_BILINEAR, it is
+    // RESIZE_METHOD_BILINEAR, RESIZE_METHOD_BOX and
+    // RESIZE_METHOD_LANCZOS are separable filters: the source image is
+    // resampled horizontally and then vertically using fixed-point
+    // weights precomputed for each column and row. Indexed images are
+    // resampled in RGBA (using 'palette') and converted back with
+    // 'rgbmap'. Bitmap images are always resized with nearest neighbor.
+    //
+    // Warning: If you are using a filter (bilinear, box or Lanczos), it is
     // recommended to use 'fixup_image_transparent_colors' function
     // over the source image 'src' BEFORE using this routine.
     void resize_image(const Image* src, Image* dst, ResizeMethod method, const Palette* palette, const RgbMap* rgbmap,
@@ -12,6 +12,9 @@ namespace doc {
   enum class DitheringMethod {
     NONE,
     ORDERED,
+    FLOYD_STEINBERG,
+    ATKINSON,
+    SIERRA_LITE,
   };
 
 } // namespace doc
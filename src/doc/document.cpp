@@ -11,15 +11,20 @@
 #include "doc/document.h"
 
 #include "base/path.h"
+#include "doc/cel.h"
 #include "doc/context.h"
+#include "doc/layer.h"
 #include "doc/sprite.h"
 
+#include <algorithm>
+
 namespace doc {
 
 Document::Document()
   : Object(ObjectType::Document)
   , m_sprites(this)
   , m_ctx(NULL)
+  , m_batchLevel(0)
 {
 }
 
@@ -78,6 +83,144 @@ void Document::close()
   removeFromContext();
 }
 
+namespace {
+
+enum class MergeBy {
+  None,                         // Delivered immediately
+  Region,                       // Unioned by sprite/frame
+  Object,                       // Delivered once by layer/cel
+  Sprite,                       // Delivered once by sprite
+};
+
+MergeBy get_merge_type(void (DocumentObserver::*method)(DocumentEvent&))
+{
+  if (method == &DocumentObserver::onSpritePixelsModified ||
+      method == &DocumentObserver::onExposeSpritePixels)
+    return MergeBy::Region;
+
+  if (method == &DocumentObserver::onLayerNameChange ||
+      method == &DocumentObserver::onLayerOpacityChange ||
+      method == &DocumentObserver::onLayerBlendModeChange ||
+      method == &DocumentObserver::onCelOpacityChange)
+    return MergeBy::Object;
+
+  if (method == &DocumentObserver::onAddCel ||
+      method == &DocumentObserver::onRemoveCel ||
+      method == &DocumentObserver::onCelFrameChanged ||
+      method == &DocumentObserver::onCelPositionChanged ||
+      method == &DocumentObserver::onFrameDurationChanged ||
+      method == &DocumentObserver::onLayerRestacked ||
+      method == &DocumentObserver::onSpriteTransparentColorChanged)
+    return MergeBy::Sprite;
+
+  return MergeBy::None;
+}
+
+bool is_layer_inside(const Layer* layer, const Layer* parent)
+{
+  for (; layer; layer=layer->parent())
+    if (layer == parent)
+      return true;
+  return false;
+}
+
+} // anonymous namespace
+
+void Document::beginNotificationBatch()
+{
+  ++m_batchLevel;
+}
+
+void Document::endNotificationBatch()
+{
+  ASSERT(m_batchLevel > 0);
+  if (--m_batchLevel > 0)
+    return;
+
+  // Observers could open new batches, so we deliver a copy.
+  std::vector<PendingEvent> events;
+  std::swap(events, m_pendingEvents);
+
+  for (PendingEvent& pending : events)
+    notifyObservers<DocumentEvent&>(pending.method, pending.ev);
+}
+
+void Document::notifyEvent(void (DocumentObserver::*method)(DocumentEvent&),
+                           DocumentEvent& ev)
+{
+  if (m_batchLevel > 0) {
+    // Events of a removed layer/cel cannot be delivered later.
+    if (method == &DocumentObserver::onBeforeRemoveLayer)
+      removePendingEventsOf(ev.layer(), nullptr);
+    else if (method == &DocumentObserver::onRemoveCel && ev.cel())
+      removePendingEventsOf(nullptr, ev.cel());
+
+    if (get_merge_type(method) != MergeBy::None) {
+      addPendingEvent(method, ev);
+      return;
+    }
+  }
+
+  notifyObservers<DocumentEvent&>(method, ev);
+}
+
+void Document::addPendingEvent(EventMethod method, const DocumentEvent& ev)
+{
+  const MergeBy mergeBy = get_merge_type(method);
+
+  for (PendingEvent& pending : m_pendingEvents) {
+    if (pending.method != method ||
+        pending.ev.sprite() != ev.sprite())
+      continue;
+
+    switch (mergeBy) {
+      case MergeBy::Region:
+        if (method == &DocumentObserver::onExposeSpritePixels ||
+            pending.ev.frame() == ev.frame()) {
+          gfx::Region rgn(pending.ev.region());
+          rgn |= ev.region();
+          pending.ev.region(rgn);
+          return;
+        }
+        break;
+      case MergeBy::Object:
+        if (pending.ev.layer() == ev.layer() &&
+            pending.ev.cel() == ev.cel())
+          return;
+        break;
+      case MergeBy::Sprite:
+        return;
+      default:
+        ASSERT(false);
+        break;
+    }
+  }
+
+  if (mergeBy == MergeBy::Sprite) {
+    DocumentEvent spriteEv(this);
+    spriteEv.sprite(ev.sprite());
+    m_pendingEvents.push_back(PendingEvent(method, spriteEv));
+  }
+  else
+    m_pendingEvents.push_back(PendingEvent(method, ev));
+}
+
+void Document::removePendingEventsOf(const Layer* layer, const Cel* cel)
+{
+  m_pendingEvents.erase(
+    std::remove_if(
+      m_pendingEvents.begin(), m_pendingEvents.end(),
+      [layer, cel](const PendingEvent& pending) -> bool {
+        const DocumentEvent& ev = pending.ev;
+        if (cel)
+          return (ev.cel() == cel);
+        else
+          return (is_layer_inside(ev.layer(), layer) ||
+                  (ev.cel() && is_layer_inside(ev.cel()->layer(), layer)));
+      }),
+    m_pendingEvents.end());
+}
+
 void Document::onContextChanged()
 {
   // Do nothing
@@ -7,8 +7,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "base/observable.h"
+#include "doc/document_event.h"
 #include "doc/document_observer.h"
 #include "doc/object.h"
 #include "doc/sprites.h"
@@ -42,17 +44,61 @@ namespace doc {
 
     void close();
 
+    // Notification batches (they can be nested). While a batch is
+    // open, events that only make observers refresh something are
+    // merged and delivered when the last batch is closed: pixel
+    // regions are unioned by sprite/frame, changes of layer/cel
+    // properties are delivered once by object, and cels
+    // added/removed/moved are delivered once by sprite (without the
+    // cel). Structural changes (layers/frames added or removed, etc.)
+    // are always delivered immediately because observers depend on
+    // their exact sequence.
+    void beginNotificationBatch();
+    void endNotificationBatch();
+
+    // Notifies the event to all observers, or keeps it until the end
+    // of the current batch.
+    void notifyEvent(void (DocumentObserver::*method)(DocumentEvent&),
+                     DocumentEvent& ev);
+
   protected:
     virtual void onContextChanged();
 
   private:
+    typedef void (DocumentObserver::*EventMethod)(DocumentEvent&);
+
+    struct PendingEvent {
+      EventMethod method;
+      DocumentEvent ev;
+      PendingEvent(EventMethod method, const DocumentEvent& ev)
+        : method(method), ev(ev) { }
+    };
+
     void removeFromContext();
+    void addPendingEvent(EventMethod method, const DocumentEvent& ev);
+    void removePendingEventsOf(const Layer* layer, const Cel* cel);
 
     // Document's file name. From where it was loaded, where it is
     // saved.
     std::string m_filename;
     Sprites m_sprites;
     Context* m_ctx;
+
+    int m_batchLevel;
+    std::vector<PendingEvent> m_pendingEvents;
+  };
+
+  // Keeps a notification batch open in the document while it's alive.
+  class DocumentNotificationBatch {
+  public:
+    DocumentNotificationBatch(Document* doc) : m_doc(doc) {
+      m_doc->beginNotificationBatch();
+    }
+    ~DocumentNotificationBatch() {
+      m_doc->endNotificationBatch();
+    }
+  private:
+    Document* m_doc;
   };
 
 } // namespace doc
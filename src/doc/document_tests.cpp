@@ -0,0 +1,133 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/document.h"
+#include "doc/layer.h"
+#include "doc/sprite.h"
+
+using namespace doc;
+
+namespace {
+
+  class CountEvents : public DocumentObserver {
+  public:
+    int pixels = 0;
+    int addCel = 0;
+    int layerName = 0;
+    int addLayer = 0;
+    gfx::Region region;
+    Layer* lastLayer = nullptr;
+
+    void onSpritePixelsModified(DocumentEvent& ev) override {
+      ++pixels;
+      region |= ev.region();
+    }
+    void onAddCel(DocumentEvent& ev) override { ++addCel; }
+    void onLayerNameChange(DocumentEvent& ev) override {
+      ++layerName;
+      lastLayer = ev.layer();
+    }
+    void onAddLayer(DocumentEvent& ev) override { ++addLayer; }
+  };
+
+  void notify_pixels(Document* doc, Sprite* spr, const gfx::Rect& rc) {
+    DocumentEvent ev(doc);
+    ev.sprite(spr);
+    ev.region(gfx::Region(rc));
+    doc->notifyEvent(&DocumentObserver::onSpritePixelsModified, ev);
+  }
+
+} // anonymous namespace
+
+TEST(Document, NotificationsWithoutBatch)
+{
+  Document doc;
+  CountEvents obs;
+  doc.addObserver(&obs);
+
+  notify_pixels(&doc, nullptr, gfx::Rect(0, 0, 2, 2));
+  notify_pixels(&doc, nullptr, gfx::Rect(4, 4, 2, 2));
+  EXPECT_EQ(2, obs.pixels);
+
+  doc.removeObserver(&obs);
+}
+
+TEST(Document, BatchMergesEvents)
+{
+  Document doc;
+  CountEvents obs;
+  doc.addObserver(&obs);
+
+  doc.beginNotificationBatch();
+  doc.beginNotificationBatch();
+  for (int i=0; i<100; ++i) {
+    notify_pixels(&doc, nullptr, gfx::Rect(i, 0, 1, 1));
+
+    DocumentEvent ev(&doc);
+    doc.notifyEvent(&DocumentObserver::onAddCel, ev);
+  }
+
+  // Structural changes are not delayed
+  DocumentEvent ev(&doc);
+  doc.notifyEvent(&DocumentObserver::onAddLayer, ev);
+  EXPECT_EQ(1, obs.addLayer);
+
+  doc.endNotificationBatch();
+  EXPECT_EQ(0, obs.pixels);
+  EXPECT_EQ(0, obs.addCel);
+
+  doc.endNotificationBatch();
+  EXPECT_EQ(1, obs.pixels);
+  EXPECT_EQ(1, obs.addCel);
+  EXPECT_EQ(gfx::Rect(0, 0, 100, 1), obs.region.bounds());
+
+  doc.removeObserver(&obs);
+}
+
+TEST(Document, BatchDropsEventsOfRemovedLayers)
+{
+  Document doc;
+  Sprite* spr = new Sprite(IMAGE_RGB, 32, 32, 256);
+  LayerImage* lay1 = new LayerImage(spr);
+  LayerImage* lay2 = new LayerImage(spr);
+  spr->folder()->addLayer(lay1);
+  spr->folder()->addLayer(lay2);
+  doc.sprites().add(spr);
+
+  CountEvents obs;
+  doc.addObserver(&obs);
+  {
+    DocumentNotificationBatch batch(&doc);
+
+    for (Layer* layer : { lay1, lay1, lay2 }) {
+      DocumentEvent ev(&doc);
+      ev.sprite(spr);
+      ev.layer(layer);
+      doc.notifyEvent(&DocumentObserver::onLayerNameChange, ev);
+    }
+
+    DocumentEvent ev(&doc);
+    ev.sprite(spr);
+    ev.layer(lay2);
+    doc.notifyEvent(&DocumentObserver::onBeforeRemoveLayer, ev);
+  }
+  EXPECT_EQ(1, obs.layerName);
+  EXPECT_EQ(lay1, obs.lastLayer);
+
+  doc.removeObserver(&obs);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -22,6 +22,12 @@ namespace doc {
 Image::Image(PixelFormat format, int width, int height)
   : Object(ObjectType::Image)
   , m_format(format)
+  , m_hashVersion(0)
+  , m_hashValid(false)
+  , m_lastUse(compression_pass.load())
+  , m_compressed(false)
+  , m_pins(0)
+  , m_pixelBytes(0)
 {
   m_width = width;
   m_height = height;
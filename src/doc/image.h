@@ -8,12 +8,17 @@
 
 #include "doc/color.h"
 #include "doc/image_buffer.h"
+#include "doc/image_compression.h"
+#include "doc/image_hash.h"
 #include "doc/object.h"
 #include "doc/pixel_format.h"
 #include "gfx/clip.h"
 #include "gfx/rect.h"
 #include "gfx/size.h"
 
+#include <atomic>
+#include <vector>
+
 namespace doc {
 
   template<typename ImageTraits> class ImageBits;
@@ -50,11 +55,13 @@ namespace doc {
 
     template<typename ImageTraits>
     ImageBits<ImageTraits> lockBits(LockType lockType, const gfx::Rect& bounds) {
+      touchBits(bounds);
       return ImageBits<ImageTraits>(this, bounds);
     }
 
     template<typename ImageTraits>
     ImageBits<ImageTraits> lockBits(LockType lockType, const gfx::Rect& bounds) const {
+      touchBits(bounds);
       return ImageBits<ImageTraits>(const_cast<Image*>(this), bounds);
     }
 
@@ -75,14 +82,79 @@ namespace doc {
     virtual void fillRect(int x1, int y1, int x2, int y2, color_t color) = 0;
     virtual void blendRect(int x1, int y1, int x2, int y2, color_t color, int opacity) = 0;
 
+    // Called when the given area is locked, so images stored in the
+    // swap file (see doc/swap_file.h) know which parts are in use.
+    virtual void touchBits(const gfx::Rect& bounds) const { }
+
   protected:
     Image(PixelFormat format, int width, int height);
 
+    // Marks the pixels as used in the current compression pass and
+    // decompresses them if they were compressed (see
+    // doc/image_compression.h). It must be called before accessing
+    // the pixel buffer. Images that cannot be compressed (e.g. when
+    // compression is disabled) are not registered, so for them it's
+    // only a test of a member.
+    void usePixels() const {
+      if (!m_pixelBytes)
+        return;
+
+      const uint32_t pass = compression_pass.load(std::memory_order_relaxed);
+      if (m_lastUse.load(std::memory_order_relaxed) != pass)
+        m_lastUse.store(pass);
+      if (m_compressed.load())
+        decompress_image(this);
+    }
+
+    // Pinned pixels are never compressed. ImageBits (and therefore
+    // LockImageBits) pin the pixels while they are alive, so
+    // iterators can be used for any time.
+    void pinPixels() const {
+      if (m_pixelBytes) {
+        ++m_pins;
+        usePixels();
+      }
+    }
+    void unpinPixels() const {
+      if (m_pixelBytes)
+        --m_pins;
+    }
+
+    // Encodes the pixels in "output". Returns false if the pixel
+    // buffer cannot be released (e.g. it's shared with other images).
+    // These functions must not call usePixels().
+    virtual bool onCompressPixels(std::vector<uint8_t>& output) const { return false; }
+    virtual void onReleasePixels() { }
+
+    // Allocates the pixel buffer again and decodes the pixels.
+    virtual void onDecompressPixels(const std::vector<uint8_t>& input) { }
+
   private:
     PixelFormat m_format;
     int m_width;
     int m_height;
     color_t m_maskColor;  // Skipped color in merge process.
+
+    // Cached by get_image_hash()
+    mutable ImageHash m_hash;
+    mutable ObjectVersion m_hashVersion;
+    mutable bool m_hashValid;
+
+    // Compression state (see doc/image_compression.h)
+    mutable std::atomic<uint32_t> m_lastUse;
+    mutable std::atomic<bool> m_compressed;
+    mutable std::atomic<int> m_pins;
+    std::vector<uint8_t> m_compressedPixels;
+    std::size_t m_pixelBytes;   // Size of the pixels if the image is registered
+
+    template<typename ImageTraits> friend class ImageBits;
+    friend ImageHash get_image_hash(const Image* image);
+    friend std::vector<ImageHash> get_image_hashes(const std::vector<const Image*>& images);
+    friend int compress_cold_images();
+    friend bool compress_image(Image* image, uint32_t lastUse);
+    friend bool register_compressible_image(Image* image, std::size_t bytes);
+    friend void unregister_compressible_image(Image* image);
+    friend void decompress_image(const Image* image);
   };
 
 } // namespace doc
@@ -27,6 +27,7 @@ namespace doc {
     ImageBits(const ImageBits& other) :
       m_image(other.m_image),
       m_bounds(other.m_bounds) {
+      pin();
     }
 
     ImageBits(Image* image, const gfx::Rect& bounds) :
@@ -34,11 +35,20 @@ namespace doc {
       m_bounds(bounds) {
       ASSERT(bounds.x >= 0 && bounds.x+bounds.w <= image->width() &&
              bounds.y >= 0 && bounds.y+bounds.h <= image->height());
+      pin();
+    }
+
+    ~ImageBits() {
+      unpin();
     }
 
     ImageBits& operator=(const ImageBits& other) {
-      m_image = other.m_image;
-      m_bounds = other.m_bounds;
+      if (this != &other) {
+        unpin();
+        m_image = other.m_image;
+        m_bounds = other.m_bounds;
+        pin();
+      }
       return *this;
     }
 
@@ -92,11 +102,23 @@ namespace doc {
     void unlock() {
       if (m_image) {
         m_image->unlockBits(*this);
+        unpin();
         m_image = NULL;
       }
     }
 
   private:
+    // The pixels cannot be compressed while they are locked (see
+    // doc/image_compression.h).
+    void pin() {
+      if (m_image)
+        m_image->pinPixels();
+    }
+    void unpin() {
+      if (m_image)
+        m_image->unpinPixels();
+    }
+
     Image* m_image;
     gfx::Rect m_bounds;
   };
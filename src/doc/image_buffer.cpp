@@ -0,0 +1,41 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/image_buffer.h"
+
+#include <algorithm>
+
+namespace doc {
+
+void ImageBuffer::resizeIfNecessary(std::size_t size)
+{
+  const std::size_t oldSize = this->size();
+  if (size <= oldSize)
+    return;
+
+  // The buffer can be moved to (or from) the swap file depending on
+  // its new size.
+  std::unique_ptr<SwapRegion> swap(SwapRegion::create(size));
+  if (swap) {
+    std::copy(buffer(), buffer()+oldSize, swap->data());
+    m_swap = std::move(swap);
+    std::vector<uint8_t>().swap(m_buffer);
+  }
+  else if (m_swap) {
+    std::vector<uint8_t> newBuffer(size);
+    std::copy(m_swap->data(), m_swap->data()+oldSize, newBuffer.begin());
+    m_swap.reset();
+    m_buffer.swap(newBuffer);
+  }
+  else
+    m_buffer.resize(size);
+}
+
+} // namespace doc
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "base/ints.h"
+#include "doc/swap_file.h"
 
 #include <memory>
 #include <cstddef>
@@ -14,21 +15,31 @@
 
 namespace doc {
 
+  // Memory of an image. Big buffers can be stored in the swap file
+  // (see doc/swap_file.h) instead of the heap.
   class ImageBuffer {
   public:
-    ImageBuffer(std::size_t size = 1) : m_buffer(size) {
+    ImageBuffer(std::size_t size = 1) : m_swap(SwapRegion::create(size)) {
+      if (!m_swap)
+        m_buffer.resize(size);
     }
 
-    std::size_t size() const { return m_buffer.size(); }
-    uint8_t* buffer() { return &m_buffer[0]; }
+    std::size_t size() const { return (m_swap ? m_swap->size(): m_buffer.size()); }
+    uint8_t* buffer() { return (m_swap ? m_swap->data(): &m_buffer[0]); }
 
-    void resizeIfNecessary(std::size_t size) {
-      if (size > m_buffer.size())
-        m_buffer.resize(size);
+    bool isSwapped() const { return (m_swap != nullptr); }
+
+    // Marks a range of bytes as used (for swapped buffers).
+    void touch(std::size_t offset, std::size_t size) {
+      if (m_swap)
+        m_swap->touch(offset, size);
     }
 
+    void resizeIfNecessary(std::size_t size);
+
   private:
     std::vector<uint8_t> m_buffer;
+    std::unique_ptr<SwapRegion> m_swap;
   };
 
   typedef std::shared_ptr<ImageBuffer> ImageBufferPtr;
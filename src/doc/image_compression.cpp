@@ -0,0 +1,346 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/image_compression.h"
+
+#include "base/debug.h"
+#include "base/mutex.h"
+#include "base/scoped_lock.h"
+#include "doc/image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace doc {
+
+std::atomic<uint32_t> compression_pass(0);
+
+bool compress_image(Image* image, uint32_t lastUse);
+
+namespace {
+
+// Mutexes to compress/decompress images (selected by image address)
+const int kImageMutexes = 16;
+
+// Packets of the run-length encoding: a control byte with the number
+// of pixels, followed by the pixels of a literal run or one pixel
+// repeated.
+const int kMaxLiteral = 128;    // Control bytes 0..127 (n-1 pixels)
+const int kMinRepeat = 2;
+const int kMaxRepeat = 129;     // Control bytes 128..255 (n-2 pixels)
+
+// Compressed images must use less memory than this fraction of the
+// original size (in 1/256 units), in other case they are kept.
+const std::size_t kMinSaving = 192;
+
+struct Registry {
+  base::mutex mutex;
+  CompressionOptions options;
+  std::unordered_set<Image*> images;
+  std::size_t rawBytes = 0;
+
+  // Modified when images are compressed/decompressed
+  std::atomic<std::size_t> compressed{0};
+  std::atomic<std::size_t> compressedBytes{0};
+  std::atomic<std::size_t> decompressions{0};
+};
+
+// Never deleted, so images destroyed after main() can be unregistered
+Registry& registry()
+{
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+base::mutex& image_mutex(const Image* image)
+{
+  static base::mutex mutexes[kImageMutexes];
+  return mutexes[(uintptr_t(image) / sizeof(void*)) % kImageMutexes];
+}
+
+template<typename T>
+inline T load_pixel(const uint8_t* data, std::size_t i)
+{
+  T value;
+  std::memcpy(&value, data + i*sizeof(T), sizeof(T));
+  return value;
+}
+
+template<typename T>
+void encode_rle(const uint8_t* data, std::size_t n, std::vector<uint8_t>& output)
+{
+  std::size_t i = 0;
+  while (i < n) {
+    const T value = load_pixel<T>(data, i);
+    std::size_t run = 1;
+    while (i+run < n && run < kMaxRepeat && load_pixel<T>(data, i+run) == value)
+      ++run;
+
+    if (run >= kMinRepeat) {
+      output.push_back(uint8_t(128 + run - kMinRepeat));
+      output.insert(output.end(),
+                    data + i*sizeof(T),
+                    data + (i+1)*sizeof(T));
+      i += run;
+      continue;
+    }
+
+    // Literal run until the next pair of equal pixels
+    const std::size_t start = i;
+    std::size_t len = 0;
+    while (i < n && len < kMaxLiteral) {
+      if (i+1 < n && load_pixel<T>(data, i) == load_pixel<T>(data, i+1))
+        break;
+      ++i;
+      ++len;
+    }
+    output.push_back(uint8_t(len - 1));
+    output.insert(output.end(),
+                  data + start*sizeof(T),
+                  data + i*sizeof(T));
+  }
+}
+
+template<typename T>
+bool decode_rle(const std::vector<uint8_t>& input, uint8_t* data, std::size_t n)
+{
+  const uint8_t* p = input.data();
+  const uint8_t* end = p + input.size();
+  std::size_t i = 0;
+
+  while (p < end && i < n) {
+    const int c = *(p++);
+    if (c >= 128) {
+      if (end - p < std::ptrdiff_t(sizeof(T)))
+        return false;
+
+      const std::size_t run = std::min<std::size_t>(c - 128 + kMinRepeat, n - i);
+      for (std::size_t j=0; j<run; ++j, ++i)
+        std::memcpy(data + i*sizeof(T), p, sizeof(T));
+      p += sizeof(T);
+    }
+    else {
+      const std::size_t len = std::min<std::size_t>(c + 1, n - i);
+      if (end - p < std::ptrdiff_t(len*sizeof(T)))
+        return false;
+
+      std::memcpy(data + i*sizeof(T), p, len*sizeof(T));
+      p += len*sizeof(T);
+      i += len;
+    }
+  }
+  return (i == n);
+}
+
+} // anonymous namespace
+
+void set_compression_options(const CompressionOptions& options)
+{
+  Registry& reg = registry();
+  base::scoped_lock lock(reg.mutex);
+  reg.options = options;
+}
+
+CompressionOptions get_compression_options()
+{
+  Registry& reg = registry();
+  base::scoped_lock lock(reg.mutex);
+  return reg.options;
+}
+
+CompressionStats get_compression_stats()
+{
+  Registry& reg = registry();
+  base::scoped_lock lock(reg.mutex);
+
+  CompressionStats stats;
+  stats.images = reg.images.size();
+  stats.compressed = reg.compressed;
+  stats.rawBytes = reg.rawBytes;
+  stats.compressedBytes = reg.compressedBytes;
+  stats.decompressions = reg.decompressions;
+  return stats;
+}
+
+int compress_cold_images()
+{
+  Registry& reg = registry();
+  base::scoped_lock lock(reg.mutex);
+
+  const uint32_t pass = ++compression_pass;
+  if (reg.options.threshold == 0)
+    return 0;
+
+  const uint32_t coldPasses = uint32_t(std::max(2, reg.options.coldPasses));
+
+  struct Candidate {
+    Image* image;
+    uint32_t age;
+    uint32_t lastUse;
+  };
+  std::vector<Candidate> candidates;
+  std::size_t resident = 0;
+
+  // Images are only compressed here (with the registry locked), so
+  // the compressed flag cannot change from false to true meanwhile.
+  for (Image* image : reg.images) {
+    if (image->m_compressed)
+      continue;
+
+    resident += image->m_pixelBytes;
+
+    const uint32_t lastUse = image->m_lastUse.load(std::memory_order_relaxed);
+    const uint32_t age = pass - lastUse;
+    if (age >= coldPasses)
+      candidates.push_back(Candidate{ image, age, lastUse });
+  }
+
+  // Least recently used images first
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) {
+              return a.age > b.age;
+            });
+
+  int count = 0;
+  for (const Candidate& candidate : candidates) {
+    if (resident <= reg.options.budget)
+      break;
+
+    if (compress_image(candidate.image, candidate.lastUse)) {
+      resident -= candidate.image->m_pixelBytes;
+      ++count;
+    }
+    // Don't try to compress it again until it's cold again
+    else
+      candidate.image->m_lastUse = pass;
+  }
+  return count;
+}
+
+// Must be called with the registry locked
+bool compress_image(Image* image, uint32_t lastUse)
+{
+  Registry& reg = registry();
+  base::scoped_lock lock(image_mutex(image));
+
+  // Readers mark the image as used (or pin it) before checking the
+  // compressed flag, and here the flag is set before checking if the
+  // image was used or pinned, so a reader either waits the
+  // compression (and decompress the image) or the compression is
+  // canceled.
+  image->m_compressed.store(true);
+  if (image->m_lastUse.load() != lastUse ||
+      image->m_pins.load() > 0) {
+    image->m_compressed.store(false);
+    return false;
+  }
+
+  std::vector<uint8_t> output;
+  output.reserve(image->m_pixelBytes / 16);
+
+  if (!image->onCompressPixels(output) ||
+      output.size() > image->m_pixelBytes * kMinSaving / 256) {
+    image->m_compressed.store(false);
+    return false;
+  }
+
+  image->onReleasePixels();
+  output.shrink_to_fit();
+  reg.compressed += 1;
+  reg.compressedBytes += output.size();
+  image->m_compressedPixels.swap(output);
+  return true;
+}
+
+void decompress_image(const Image* constImage)
+{
+  Image* image = const_cast<Image*>(constImage);
+  Registry& reg = registry();
+  base::scoped_lock lock(image_mutex(image));
+
+  // Decompressed by other thread
+  if (!image->m_compressed.load())
+    return;
+
+  image->onDecompressPixels(image->m_compressedPixels);
+
+  reg.compressed -= 1;
+  reg.compressedBytes -= image->m_compressedPixels.size();
+  reg.decompressions += 1;
+  std::vector<uint8_t>().swap(image->m_compressedPixels);
+
+  image->m_compressed.store(false);
+}
+
+bool register_compressible_image(Image* image, std::size_t bytes)
+{
+  Registry& reg = registry();
+  base::scoped_lock lock(reg.mutex);
+
+  if (reg.options.threshold == 0 ||
+      bytes < reg.options.threshold)
+    return false;
+
+  reg.images.insert(image);
+  reg.rawBytes += bytes;
+  image->m_pixelBytes = bytes;
+  return true;
+}
+
+void unregister_compressible_image(Image* image)
+{
+  if (image->m_pixelBytes == 0)
+    return;
+
+  Registry& reg = registry();
+  {
+    base::scoped_lock lock(reg.mutex);
+    reg.images.erase(image);
+    reg.rawBytes -= image->m_pixelBytes;
+  }
+
+  // Wait the compression of this image (it was selected before it was
+  // removed from the registry)
+  base::scoped_lock lock(image_mutex(image));
+  if (image->m_compressed) {
+    reg.compressed -= 1;
+    reg.compressedBytes -= image->m_compressedPixels.size();
+    image->m_compressed = false;
+  }
+  image->m_pixelBytes = 0;
+}
+
+void compress_pixels(const uint8_t* data, std::size_t size, int pixelSize,
+                     std::vector<uint8_t>& output)
+{
+  switch (pixelSize) {
+    case 1: encode_rle<uint8_t>(data, size, output); break;
+    case 2: encode_rle<uint16_t>(data, size/2, output); break;
+    case 4: encode_rle<uint32_t>(data, size/4, output); break;
+    default:
+      ASSERT(false);
+      break;
+  }
+}
+
+bool decompress_pixels(const std::vector<uint8_t>& input,
+                       uint8_t* data, std::size_t size, int pixelSize)
+{
+  switch (pixelSize) {
+    case 1: return decode_rle<uint8_t>(input, data, size);
+    case 2: return decode_rle<uint16_t>(input, data, size/2);
+    case 4: return decode_rle<uint32_t>(input, data, size/4);
+  }
+  ASSERT(false);
+  return false;
+}
+
+} // namespace doc
@@ -0,0 +1,70 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "base/ints.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace doc {
+
+  class Image;
+
+  // In-memory compression of cold images. Images with buffers bigger
+  // than the threshold are registered, and each call to
+  // compress_cold_images() (a "pass", usually done periodically from
+  // a background thread) compresses the images that weren't used in
+  // the last passes, starting with the least recently used ones,
+  // until the uncompressed bytes are below the budget. The pixels are
+  // decompressed automatically in the next access (all accesses to
+  // the pixels of an ImageImpl go through Image::usePixels()).
+  //
+  // Pixel art is mostly flat colors and transparent areas, so pixels
+  // are compressed with a fast run-length encoding.
+  //
+  // Pointers returned by getPixelAddress() must not be kept between
+  // passes, because the image can be compressed if it's not used in
+  // the meantime. Locked bits (ImageBits/LockImageBits) pin the
+  // image, so their iterators are valid while the lock is alive.
+  struct CompressionOptions {
+    std::size_t threshold = 0;  // Minimum size of compressed images (0 = disabled)
+    std::size_t budget = 0;     // Max uncompressed bytes of registered images
+    int coldPasses = 3;         // Passes without use to consider an image cold (min 2)
+  };
+
+  struct CompressionStats {
+    std::size_t images = 0;     // Registered images
+    std::size_t compressed = 0; // Compressed images
+    std::size_t rawBytes = 0;   // Uncompressed size of the registered images
+    std::size_t compressedBytes = 0; // Memory used by the compressed pixels
+    std::size_t decompressions = 0;  // Images decompressed on access
+  };
+
+  void set_compression_options(const CompressionOptions& options);
+  CompressionOptions get_compression_options();
+  CompressionStats get_compression_stats();
+
+  // Starts a new pass compressing the cold images. Returns the number
+  // of images that were compressed.
+  int compress_cold_images();
+
+  // Run-length encoding of pixels of the given size (1, 2, or 4 bytes).
+  // "size" is in bytes and must be a multiple of the pixel size.
+  void compress_pixels(const uint8_t* data, std::size_t size, int pixelSize,
+                       std::vector<uint8_t>& output);
+  bool decompress_pixels(const std::vector<uint8_t>& input,
+                         uint8_t* data, std::size_t size, int pixelSize);
+
+  // Used by Image and ImageImpl
+  extern std::atomic<uint32_t> compression_pass;
+  bool register_compressible_image(Image* image, std::size_t bytes);
+  void unregister_compressible_image(Image* image);
+  void decompress_image(const Image* image);
+
+} // namespace doc
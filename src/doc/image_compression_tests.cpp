@@ -0,0 +1,180 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_compression.h"
+#include "doc/image_impl.h"
+#include "doc/primitives.h"
+
+#include <memory>
+
+using namespace doc;
+
+namespace {
+
+  class ImageCompressionTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+      CompressionOptions options;
+      options.threshold = 1024;
+      options.budget = 0;
+      options.coldPasses = 2;
+      set_compression_options(options);
+    }
+
+    void TearDown() override {
+      set_compression_options(CompressionOptions());
+    }
+  };
+
+} // anonymous namespace
+
+TEST(ImageCompression, Codec)
+{
+  for (int pixelSize : { 1, 2, 4 }) {
+    std::vector<uint8_t> data(4000);
+    for (std::size_t i=0; i<data.size(); ++i)
+      data[i] = (i < 1000 ? 0: (i < 2000 ? uint8_t(i): uint8_t(i / 300)));
+
+    std::vector<uint8_t> output;
+    compress_pixels(&data[0], data.size(), pixelSize, output);
+    EXPECT_GT(data.size(), output.size());
+
+    std::vector<uint8_t> result(data.size());
+    EXPECT_TRUE(decompress_pixels(output, &result[0], result.size(), pixelSize));
+    EXPECT_EQ(data, result);
+  }
+}
+
+TEST_F(ImageCompressionTest, SmallImagesAreNotRegistered)
+{
+  std::unique_ptr<Image> img(Image::create(IMAGE_RGB, 8, 8));
+  EXPECT_EQ(0, get_compression_stats().images);
+}
+
+TEST_F(ImageCompressionTest, ColdImagesAreCompressed)
+{
+  const int w = 300, h = 200;
+  std::unique_ptr<Image> cold(Image::create(IMAGE_RGB, w, h));
+  std::unique_ptr<Image> hot(Image::create(IMAGE_INDEXED, w, h));
+  clear_image(cold.get(), rgba(0, 0, 0, 0));
+  fill_rect(cold.get(), 10, 20, 99, 149, rgba(255, 0, 0, 255));
+  clear_image(hot.get(), 4);
+
+  CompressionStats stats = get_compression_stats();
+  EXPECT_EQ(2, stats.images);
+  EXPECT_EQ(std::size_t(w*h*5), stats.rawBytes);
+
+  // Images are cold after two passes without use
+  EXPECT_EQ(0, compress_cold_images());
+  get_pixel(hot.get(), 0, 0);
+  EXPECT_EQ(1, compress_cold_images());
+  get_pixel(hot.get(), 0, 0);
+
+  stats = get_compression_stats();
+  EXPECT_EQ(1, stats.compressed);
+  EXPECT_LT(0, stats.compressedBytes);
+  EXPECT_GT(std::size_t(w*h*4/20), stats.compressedBytes);
+
+  // First access decompresses the image
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(cold.get(), 10, 20));
+  EXPECT_EQ(rgba(0, 0, 0, 0), get_pixel(cold.get(), 9, 20));
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(cold.get(), 99, 149));
+  EXPECT_EQ(rgba(0, 0, 0, 0), get_pixel(cold.get(), 100, 149));
+
+  stats = get_compression_stats();
+  EXPECT_EQ(0, stats.compressed);
+  EXPECT_EQ(0, stats.compressedBytes);
+  EXPECT_EQ(1, stats.decompressions);
+
+  // Destroy a compressed image
+  EXPECT_EQ(0, compress_cold_images());
+  EXPECT_EQ(2, compress_cold_images());
+  cold.reset();
+  stats = get_compression_stats();
+  EXPECT_EQ(1, stats.images);
+  EXPECT_EQ(1, stats.compressed);
+
+  // Locking the bits decompresses the image too
+  {
+    LockImageBits<IndexedTraits> bits(hot.get(), gfx::Rect(0, 0, w, h));
+    for (auto it=bits.begin(), end=bits.end(); it!=end; ++it)
+      ASSERT_EQ(4, *it);
+  }
+  EXPECT_EQ(0, get_compression_stats().compressed);
+}
+
+TEST_F(ImageCompressionTest, Budget)
+{
+  CompressionOptions options = get_compression_options();
+  options.budget = 100*100*4;
+  set_compression_options(options);
+
+  std::unique_ptr<Image> a(Image::create(IMAGE_RGB, 100, 100));
+  std::unique_ptr<Image> b(Image::create(IMAGE_RGB, 100, 100));
+  clear_image(a.get(), 0);
+  clear_image(b.get(), 0);
+
+  EXPECT_EQ(0, compress_cold_images());
+  get_pixel(b.get(), 0, 0);
+
+  // Only the least recently used image is compressed
+  EXPECT_EQ(1, compress_cold_images());
+  EXPECT_EQ(1, get_compression_stats().compressed);
+  EXPECT_EQ(0, compress_cold_images());
+  EXPECT_EQ(0, compress_cold_images());
+}
+
+TEST_F(ImageCompressionTest, SharedBuffersAreKept)
+{
+  ImageBufferPtr buffer(new ImageBuffer);
+  std::unique_ptr<Image> img(Image::create(IMAGE_RGB, 100, 100, buffer));
+  clear_image(img.get(), 0);
+
+  compress_cold_images();
+  compress_cold_images();
+  EXPECT_EQ(0, compress_cold_images());
+  EXPECT_EQ(0, get_compression_stats().compressed);
+}
+
+TEST_F(ImageCompressionTest, LockedImagesAreKept)
+{
+  std::unique_ptr<Image> img(Image::create(IMAGE_RGB, 100, 100));
+  clear_image(img.get(), rgba(0, 0, 255, 255));
+
+  {
+    const LockImageBits<RgbTraits> bits(img.get());
+    auto it = bits.begin();
+
+    // Copies of the bits pin the image too
+    ImageBits<RgbTraits> copy;
+    copy = img->lockBits<RgbTraits>(Image::ReadLock, img->bounds());
+    copy.unlock();
+
+    // The iterator is valid even if the image isn't used in several
+    // passes (e.g. a long operation)
+    for (int i=0; i<4; ++i)
+      EXPECT_EQ(0, compress_cold_images());
+    EXPECT_EQ(0, get_compression_stats().compressed);
+    EXPECT_EQ(rgba(0, 0, 255, 255), *it);
+  }
+
+  // Pinned images are tried again when they are cold again
+  EXPECT_EQ(0, compress_cold_images());
+  EXPECT_EQ(1, compress_cold_images());
+  EXPECT_EQ(1, get_compression_stats().compressed);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
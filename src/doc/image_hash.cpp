@@ -0,0 +1,276 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/image_hash.h"
+
+#include "base/mutex.h"
+#include "base/parallel_for.h"
+#include "base/scoped_lock.h"
+#include "doc/image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace doc {
+
+namespace {
+
+// Images are hashed in blocks of rows of this size, each block can
+// be hashed in a different thread. Images with only one block are
+// hashed in the calling thread.
+const int kBlockBytes = 256*1024;
+
+// Mutexes to access the cached hashes (selected by image address)
+const int kCacheMutexes = 16;
+
+const uint64_t P1 = 0x9E3779B185EBCA87ull;
+const uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t P3 = 0x165667B19E3779F9ull;
+const uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+  acc += input * P2;
+  acc = rotl(acc, 31);
+  return acc * P1;
+}
+
+inline uint64_t merge(uint64_t acc, uint64_t value) {
+  acc ^= hash_round(0, value);
+  return acc * P1 + P4;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+// Streaming hash based on xxHash64: four independent lanes consume
+// stripes of 32 bytes, so the CPU can process the lanes in parallel.
+// The 128-bit result is obtained from two finalizations of the lanes.
+class Hasher {
+public:
+  Hasher(uint64_t seed) : m_total(0), m_pending(0) {
+    m_v[0] = seed + P1 + P2;
+    m_v[1] = seed + P2;
+    m_v[2] = seed;
+    m_v[3] = seed - P1;
+  }
+
+  void update(const uint8_t* p, std::size_t n) {
+    m_total += n;
+
+    if (m_pending) {
+      const std::size_t m = std::min(n, 32 - m_pending);
+      std::memcpy(m_buf + m_pending, p, m);
+      m_pending += m;
+      p += m;
+      n -= m;
+      if (m_pending < 32)
+        return;
+      stripe(m_buf);
+      m_pending = 0;
+    }
+
+    for (; n >= 32; p += 32, n -= 32)
+      stripe(p);
+
+    if (n) {
+      std::memcpy(m_buf, p, n);
+      m_pending = n;
+    }
+  }
+
+  void update(uint64_t value) {
+    uint8_t buf[8];
+    std::memcpy(buf, &value, 8);
+    update(buf, 8);
+  }
+
+  void update(const ImageHash& hash) {
+    update(hash.low);
+    update(hash.high);
+  }
+
+  ImageHash finish() const {
+    uint64_t h =
+      rotl(m_v[0], 1) + rotl(m_v[1], 7) + rotl(m_v[2], 12) + rotl(m_v[3], 18);
+    for (int i=0; i<4; ++i)
+      h = merge(h, m_v[i]);
+    h += m_total;
+
+    const uint8_t* p = m_buf;
+    std::size_t n = m_pending;
+    for (; n >= 8; p += 8, n -= 8) {
+      h ^= hash_round(0, read64(p));
+      h = rotl(h, 27) * P1 + P4;
+    }
+    for (; n > 0; ++p, --n) {
+      h ^= (*p) * P5;
+      h = rotl(h, 11) * P1;
+    }
+
+    ImageHash result;
+    result.low = avalanche(h);
+    result.high = avalanche((m_v[0] ^ rotl(m_v[2], 17)) * P3 +
+                            (m_v[1] ^ rotl(m_v[3], 43)) * P5 +
+                            h * P4);
+    return result;
+  }
+
+private:
+  void stripe(const uint8_t* p) {
+    m_v[0] = hash_round(m_v[0], read64(p));
+    m_v[1] = hash_round(m_v[1], read64(p+8));
+    m_v[2] = hash_round(m_v[2], read64(p+16));
+    m_v[3] = hash_round(m_v[3], read64(p+24));
+  }
+
+  uint64_t m_v[4];
+  uint64_t m_total;
+  uint8_t m_buf[32];
+  std::size_t m_pending;
+};
+
+void hash_rows(Hasher& hasher, const Image* image, int y1, int y2)
+{
+  const std::size_t rowBytes = image->getRowStrideSize();
+  for (int y=y1; y<y2; ++y)
+    hasher.update(image->getPixelAddress(0, y), rowBytes);
+}
+
+int rows_per_block(const Image* image)
+{
+  return std::max(1, kBlockBytes / std::max(1, image->getRowStrideSize()));
+}
+
+base::mutex& cache_mutex(const Image* image)
+{
+  static base::mutex mutexes[kCacheMutexes];
+  return mutexes[(uintptr_t(image) / sizeof(void*)) % kCacheMutexes];
+}
+
+} // anonymous namespace
+
+std::string ImageHash::toString() const
+{
+  char buf[33];
+  std::sprintf(buf, "%016llx%016llx",
+               (unsigned long long)high,
+               (unsigned long long)low);
+  return buf;
+}
+
+ImageHash calculate_image_hash(const Image* image)
+{
+  Hasher hasher(0);
+  hasher.update(uint64_t(image->pixelFormat()));
+  hasher.update(uint64_t(image->width()));
+  hasher.update(uint64_t(image->height()));
+
+  if (image->width() <= 0 || image->height() <= 0)
+    return hasher.finish();
+
+  // The blocks depend only on the image size, so the hash is the same
+  // with any number of threads.
+  const int h = image->height();
+  const int blockRows = rows_per_block(image);
+  const int nblocks = (h + blockRows - 1) / blockRows;
+
+  if (nblocks == 1) {
+    hash_rows(hasher, image, 0, h);
+    return hasher.finish();
+  }
+
+  std::vector<ImageHash> blocks(nblocks);
+  base::parallel_for(
+    nblocks,
+    [&](int i){
+      Hasher blockHasher(i);
+      hash_rows(blockHasher, image,
+                i*blockRows, std::min(h, (i+1)*blockRows));
+      blocks[i] = blockHasher.finish();
+    });
+
+  for (const ImageHash& block : blocks)
+    hasher.update(block);
+  return hasher.finish();
+}
+
+ImageHash get_image_hash(const Image* image)
+{
+  const ObjectVersion version = image->version();
+  {
+    base::scoped_lock lock(cache_mutex(image));
+    if (image->m_hashValid && image->m_hashVersion == version)
+      return image->m_hash;
+  }
+
+  const ImageHash hash = calculate_image_hash(image);
+  {
+    base::scoped_lock lock(cache_mutex(image));
+    image->m_hash = hash;
+    image->m_hashVersion = version;
+    image->m_hashValid = true;
+  }
+  return hash;
+}
+
+std::vector<ImageHash> get_image_hashes(const std::vector<const Image*>& images)
+{
+  std::vector<ImageHash> hashes(images.size());
+  std::vector<int> small;
+
+  for (int i=0; i<int(images.size()); ++i) {
+    const Image* image = images[i];
+    bool cached;
+    {
+      base::scoped_lock lock(cache_mutex(image));
+      cached = (image->m_hashValid &&
+                image->m_hashVersion == image->version());
+      if (cached)
+        hashes[i] = image->m_hash;
+    }
+    if (cached)
+      continue;
+
+    // Big images are already hashed with several threads
+    if (image->height() > rows_per_block(image))
+      hashes[i] = get_image_hash(image);
+    else
+      small.push_back(i);
+  }
+
+  // Small images are distributed between threads
+  base::parallel_for(
+    int(small.size()),
+    [&](int i){
+      hashes[small[i]] = get_image_hash(images[small[i]]);
+    });
+
+  return hashes;
+}
+
+} // namespace doc
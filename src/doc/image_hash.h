@@ -0,0 +1,48 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "base/ints.h"
+
+#include <string>
+#include <vector>
+
+namespace doc {
+
+  class Image;
+
+  // 128-bit hash of the pixels of an image (and its format and size).
+  struct ImageHash {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const ImageHash& other) const {
+      return low == other.low && high == other.high;
+    }
+    bool operator!=(const ImageHash& other) const {
+      return !operator==(other);
+    }
+
+    // Hexadecimal representation (32 characters)
+    std::string toString() const;
+  };
+
+  // Calculates the hash of the image pixels. Big images are hashed
+  // with several threads (the result is the same in any case).
+  ImageHash calculate_image_hash(const Image* image);
+
+  // Returns the hash of the image, it's cached in the image and
+  // calculated again only when the image version changes, so the
+  // code that modifies the pixels of an image must call
+  // Image::incrementVersion().
+  ImageHash get_image_hash(const Image* image);
+
+  // Returns the hashes of several images (in the same order),
+  // calculating in parallel the ones that are not cached.
+  std::vector<ImageHash> get_image_hashes(const std::vector<const Image*>& images);
+
+} // namespace doc
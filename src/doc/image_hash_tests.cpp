@@ -0,0 +1,109 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_hash.h"
+#include "doc/image_impl.h"
+#include "doc/primitives.h"
+
+#include <memory>
+
+using namespace doc;
+
+namespace {
+
+  std::unique_ptr<Image> create_pattern(PixelFormat format, int w, int h) {
+    std::unique_ptr<Image> img(Image::create(format, w, h));
+    for (int y=0; y<h; ++y)
+      for (int x=0; x<w; ++x)
+        put_pixel(img.get(), x, y, (x*7 + y*13) & 0xff);
+    return img;
+  }
+
+} // anonymous namespace
+
+TEST(ImageHash, SameContentSameHash)
+{
+  for (auto format : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED }) {
+    std::unique_ptr<Image> a(create_pattern(format, 31, 17));
+    std::unique_ptr<Image> b(Image::createCopy(a.get()));
+    EXPECT_EQ(calculate_image_hash(a.get()), calculate_image_hash(b.get()));
+
+    put_pixel(b.get(), 30, 16, get_pixel(b.get(), 30, 16) ^ 1);
+    EXPECT_NE(calculate_image_hash(a.get()), calculate_image_hash(b.get()));
+  }
+}
+
+TEST(ImageHash, FormatAndSizeAreHashed)
+{
+  std::unique_ptr<Image> a(Image::create(IMAGE_INDEXED, 8, 2));
+  std::unique_ptr<Image> b(Image::create(IMAGE_INDEXED, 2, 8));
+  std::unique_ptr<Image> c(Image::create(IMAGE_GRAYSCALE, 4, 2));
+  clear_image(a.get(), 0);
+  clear_image(b.get(), 0);
+  clear_image(c.get(), 0);
+  EXPECT_NE(calculate_image_hash(a.get()), calculate_image_hash(b.get()));
+  EXPECT_NE(calculate_image_hash(a.get()), calculate_image_hash(c.get()));
+}
+
+// Big images are hashed in blocks (with threads)
+TEST(ImageHash, BigImages)
+{
+  std::unique_ptr<Image> a(create_pattern(IMAGE_RGB, 700, 500));
+  std::unique_ptr<Image> b(Image::createCopy(a.get()));
+  EXPECT_EQ(calculate_image_hash(a.get()), calculate_image_hash(b.get()));
+
+  put_pixel(b.get(), 350, 499, 0);
+  EXPECT_NE(calculate_image_hash(a.get()), calculate_image_hash(b.get()));
+}
+
+TEST(ImageHash, CachedUntilVersionChanges)
+{
+  std::unique_ptr<Image> a(create_pattern(IMAGE_RGB, 16, 16));
+  const ImageHash hash = get_image_hash(a.get());
+
+  // Without a new version the cached hash is returned
+  put_pixel(a.get(), 0, 0, rgba(1, 2, 3, 4));
+  EXPECT_EQ(hash, get_image_hash(a.get()));
+
+  a->incrementVersion();
+  EXPECT_NE(hash, get_image_hash(a.get()));
+  EXPECT_EQ(calculate_image_hash(a.get()), get_image_hash(a.get()));
+}
+
+TEST(ImageHash, Batch)
+{
+  std::vector<std::unique_ptr<Image>> images;
+  std::vector<const Image*> ptrs;
+  for (int i=0; i<20; ++i) {
+    images.push_back(create_pattern(IMAGE_RGB, 10+i, i == 5 ? 600: 10));
+    ptrs.push_back(images.back().get());
+  }
+
+  std::vector<ImageHash> hashes = get_image_hashes(ptrs);
+  ASSERT_EQ(ptrs.size(), hashes.size());
+  for (std::size_t i=0; i<ptrs.size(); ++i)
+    EXPECT_EQ(calculate_image_hash(ptrs[i]), hashes[i]);
+}
+
+TEST(ImageHash, ToString)
+{
+  ImageHash hash;
+  hash.high = 0x0123456789abcdefull;
+  hash.low = 0xfedcba9876543210ull;
+  EXPECT_EQ("0123456789abcdeffedcba9876543210", hash.toString());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
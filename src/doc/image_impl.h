@@ -31,25 +31,49 @@ namespace doc {
     address_t* m_rows;
 
     inline address_t getBitsAddress() {
+      usePixels();
       return m_bits;
     }
 
     inline const_address_t getBitsAddress() const {
+      usePixels();
       return m_bits;
     }
 
     inline address_t getLineAddress(int y) {
       ASSERT(y >= 0 && y < height());
+      usePixels();
       return m_rows[y];
     }
 
     inline const_address_t getLineAddress(int y) const {
       ASSERT(y >= 0 && y < height());
+      usePixels();
       return m_rows[y];
     }
 
+    std::size_t pixelsSize() const {
+      return Traits::getRowStrideBytes(width()) * height();
+    }
+
+    // Points m_rows/m_bits to the current buffer
+    void setupRows() {
+      std::size_t for_rows = sizeof(address_t) * height();
+      std::size_t rowstride_bytes = Traits::getRowStrideBytes(width());
+
+      m_rows = (address_t*)m_buffer->buffer();
+      m_bits = (address_t)(m_buffer->buffer() + for_rows);
+
+      address_t addr = m_bits;
+      for (int y=0; y<height(); ++y) {
+        m_rows[y] = addr;
+        addr = (address_t)(((uint8_t*)addr) + rowstride_bytes);
+      }
+    }
+
   public:
     inline address_t address(int x, int y) const {
+      usePixels();
       return (address_t)(m_rows[y] + x / (Traits::pixels_per_byte == 0 ? 1 : Traits::pixels_per_byte));
     }
 
@@ -59,22 +83,22 @@ namespace doc {
       , m_buffer(buffer)
     {
       std::size_t for_rows = sizeof(address_t) * height;
-      std::size_t rowstride_bytes = Traits::getRowStrideBytes(width);
-      std::size_t required_size = for_rows + rowstride_bytes*height;
+      std::size_t required_size = for_rows + pixelsSize();
 
       if (!m_buffer)
         m_buffer.reset(new ImageBuffer(required_size));
       else
         m_buffer->resizeIfNecessary(required_size);
 
-      m_rows = (address_t*)m_buffer->buffer();
-      m_bits = (address_t)(m_buffer->buffer() + for_rows);
+      setupRows();
 
-      address_t addr = m_bits;
-      for (int y=0; y<height; ++y) {
-        m_rows[y] = addr;
-        addr = (address_t)(((uint8_t*)addr) + rowstride_bytes);
-      }
+      // Swapped buffers are already out of RAM
+      if (!m_buffer->isSwapped())
+        register_compressible_image(this, pixelsSize());
+    }
+
+    ~ImageImpl() {
+      unregister_compressible_image(this);
     }
 
     uint8_t* getPixelAddress(int x, int y) const override {
@@ -111,6 +135,20 @@ namespace doc {
         std::copy(first, first+w, address(0, y));
     }
 
+    void touchBits(const gfx::Rect& bounds) const override {
+      usePixels();
+      if (!m_buffer->isSwapped())
+        return;
+
+      const int y1 = std::max(0, bounds.y);
+      const int y2 = std::min(height(), bounds.y2());
+      if (y1 < y2) {
+        const std::size_t rowstride_bytes = Traits::getRowStrideBytes(width());
+        m_buffer->touch((uint8_t*)m_rows[y1] - m_buffer->buffer(),
+                        rowstride_bytes * (y2 - y1));
+      }
+    }
+
     void copy(const Image* _src, gfx::Clip area) override {
       const ImageImpl<Traits>* src = (const ImageImpl<Traits>*)_src;
       address_t src_address;
@@ -155,6 +193,31 @@ namespace doc {
       fillRect(x1, y1, x2, y2, color);
     }
 
+  protected:
+    bool onCompressPixels(std::vector<uint8_t>& output) const override {
+      // Buffers shared with other images (e.g. temporary render
+      // buffers) are kept
+      if (m_buffer.use_count() > 1 || m_buffer->isSwapped())
+        return false;
+
+      compress_pixels((const uint8_t*)m_bits, pixelsSize(),
+                      Traits::bytes_per_pixel, output);
+      return true;
+    }
+
+    void onReleasePixels() override {
+      m_buffer.reset();
+      m_rows = nullptr;
+      m_bits = nullptr;
+    }
+
+    void onDecompressPixels(const std::vector<uint8_t>& input) override {
+      m_buffer.reset(new ImageBuffer(sizeof(address_t) * height() + pixelsSize()));
+      setupRows();
+      decompress_pixels(input, (uint8_t*)m_bits, pixelsSize(),
+                        Traits::bytes_per_pixel);
+    }
+
   private:
     bool clip_rects(const Image* src, int& dst_x, int& dst_y, int& src_x, int& src_y, int& w, int& h) const {
       // Clip with destionation image
@@ -217,6 +280,7 @@ namespace doc {
 
   template<>
   inline void ImageImpl<IndexedTraits>::clear(color_t color) {
+    usePixels();
     std::fill(m_bits,
               m_bits + width()*height(),
               color);
@@ -224,6 +288,7 @@ namespace doc {
 
   template<>
   inline void ImageImpl<BitmapTraits>::clear(color_t color) {
+    usePixels();
     std::fill(m_bits,
               m_bits + BitmapTraits::getRowStrideBytes(width()) * height(),
               (color ? 0xff: 0x00));
@@ -234,6 +299,7 @@ namespace doc {
     ASSERT(x >= 0 && x < width());
     ASSERT(y >= 0 && y < height());
 
+    usePixels();
     std::div_t d = std::div(x, 8);
     return ((*(m_rows[y] + d.quot)) & (1<<d.rem)) ? 1: 0;
   }
@@ -243,6 +309,7 @@ namespace doc {
     ASSERT(x >= 0 && x < width());
     ASSERT(y >= 0 && y < height());
 
+    usePixels();
     std::div_t d = std::div(x, 8);
     if (color)
       (*(m_rows[y] + d.quot)) |= (1 << d.rem);
@@ -12,16 +12,175 @@
 
 #include "base/debug.h"
 #include "base/mutex.h"
-#include "base/scoped_lock.h"
 
-#include <map>
+#include <vector>
 
 namespace doc {
 
-static base::mutex mutex;
-static ObjectId newId = 0;
-// TODO Profile this and see if an unordered_map is better
-static std::map<ObjectId, Object*> objects;
+namespace {
+
+// Number of shards of the registry (a power of two). IDs are
+// consecutive, so objects are distributed uniformly between shards
+// and threads creating objects at the same time use different ones.
+const ObjectId kShardBits = 6;
+const ObjectId kShards = (1 << kShardBits);
+
+// Open addressing hash table (linear probing) from IDs to objects.
+// A slot with id == 0 is empty, and a slot with an ID but without an
+// object is a deleted entry (it's reused by the next insertion or
+// discarded in the next rehash).
+class ObjectTable {
+public:
+  ObjectTable() : m_size(0), m_used(0) { }
+
+  size_t size() const { return m_size; }
+
+  Object* find(ObjectId id) const {
+    if (m_slots.empty())
+      return nullptr;
+
+    const size_t mask = m_slots.size()-1;
+    for (size_t i=hash(id) & mask; m_slots[i].id; i=(i+1) & mask) {
+      if (m_slots[i].id == id)
+        return m_slots[i].object;
+    }
+    return nullptr;
+  }
+
+  void insert(ObjectId id, Object* object) {
+    ASSERT(id != 0);
+    ASSERT(object);
+
+    if ((m_used+1)*4 > m_slots.size()*3)
+      rehash();
+
+    const size_t mask = m_slots.size()-1;
+    size_t i = hash(id) & mask;
+    for (; m_slots[i].id; i=(i+1) & mask) {
+      if (!m_slots[i].object) {
+        m_slots[i].id = id;
+        m_slots[i].object = object;
+        ++m_size;
+        return;
+      }
+      ASSERT(m_slots[i].id != id);
+    }
+    m_slots[i].id = id;
+    m_slots[i].object = object;
+    ++m_size;
+    ++m_used;
+  }
+
+  bool erase(ObjectId id) {
+    if (m_slots.empty())
+      return false;
+
+    const size_t mask = m_slots.size()-1;
+    for (size_t i=hash(id) & mask; m_slots[i].id; i=(i+1) & mask) {
+      if (m_slots[i].id == id && m_slots[i].object) {
+        m_slots[i].object = nullptr;
+        --m_size;
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct Slot {
+    ObjectId id;
+    Object* object;
+  };
+
+  static size_t hash(ObjectId id) {
+    // The lower bits select the shard, so they are equal for all
+    // the IDs of this table.
+    return size_t((id >> kShardBits) * 2654435769u);
+  }
+
+  void rehash() {
+    size_t capacity = 16;
+    while (m_size*2 >= capacity)
+      capacity *= 2;
+
+    std::vector<Slot> old(capacity, Slot{ 0, nullptr });
+    std::swap(old, m_slots);
+    m_size = m_used = 0;
+
+    for (const Slot& slot : old) {
+      if (slot.object)
+        insert(slot.id, slot.object);
+    }
+  }
+
+  std::vector<Slot> m_slots;
+  size_t m_size;                // Objects in the table
+  size_t m_used;                // Slots with an ID (objects + deleted)
+};
+
+struct Shard {
+  base::mutex mutex;
+  ObjectTable objects;
+  std::atomic<uint64_t> lookups;
+  std::atomic<uint64_t> changes;
+  std::atomic<uint64_t> contentions;
+  // Avoid false sharing of counters between shards
+  char padding[64];
+
+  Shard() : lookups(0), changes(0), contentions(0) { }
+};
+
+class ShardLock {
+public:
+  ShardLock(Shard& shard) : m_shard(shard) {
+    if (!shard.mutex.try_lock()) {
+      ++shard.contentions;
+      shard.mutex.lock();
+    }
+  }
+
+  ~ShardLock() {
+    m_shard.mutex.unlock();
+  }
+
+private:
+  Shard& m_shard;
+};
+
+std::atomic<ObjectId> next_id(0);
+
+// The shards are never deleted, so objects destroyed after the exit
+// of main() (e.g. static objects) can still unregister themselves.
+Shard* shards()
+{
+  static Shard* shards = new Shard[kShards];
+  return shards;
+}
+
+Shard& shard_for(ObjectId id)
+{
+  return shards()[id & (kShards-1)];
+}
+
+void register_object(ObjectId id, Object* object)
+{
+  Shard& shard = shard_for(id);
+  ++shard.changes;
+  ShardLock lock(shard);
+  ASSERT(!shard.objects.find(id));
+  shard.objects.insert(id, object);
+}
+
+void unregister_object(ObjectId id, Object* object)
+{
+  Shard& shard = shard_for(id);
+  ++shard.changes;
+  ShardLock lock(shard);
+  ASSERT(shard.objects.find(id) == object);
+  shard.objects.erase(id);
+}
+
+} // anonymous namespace
 
 Object::Object(ObjectType type)
   : m_type(type)
@@ -50,34 +209,30 @@ int Object::getMemSize() const
 
 const ObjectId Object::id() const
 {
-  // The first time the ID is request, we store the object in the
-  // "objects" hash table.
-  if (!m_id) {
-    base::scoped_unlock hold(mutex);
-    m_id = ++newId;
-    objects.insert(std::make_pair(m_id, const_cast<Object*>(this)));
+  ObjectId id = m_id.load(std::memory_order_acquire);
+
+  // The first time the ID is requested, we store the object in the
+  // registry. The object is registered before the ID is published,
+  // so get_object() finds it as soon as other threads know the ID.
+  if (!id) {
+    const ObjectId newId = ++next_id;
+    register_object(newId, const_cast<Object*>(this));
+
+    if (m_id.compare_exchange_strong(id, newId, std::memory_order_acq_rel))
+      id = newId;
+    else
+      unregister_object(newId, const_cast<Object*>(this));
   }
-  return m_id;
+  return id;
 }
 
 void Object::setId(ObjectId id)
 {
-  base::scoped_unlock hold(mutex);
-
-  if (m_id) {
-    auto it = objects.find(m_id);
-    ASSERT(it != objects.end());
-    ASSERT(it->second == this);
-    if (it != objects.end())
-      objects.erase(it);
-  }
-
-  m_id = id;
-
-  if (m_id) {
-    ASSERT(objects.find(m_id) == objects.end());
-    objects.insert(std::make_pair(m_id, this));
-  }
+  const ObjectId oldId = m_id.exchange(id, std::memory_order_acq_rel);
+  if (oldId)
+    unregister_object(oldId, this);
+  if (id)
+    register_object(id, this);
 }
 
 void Object::setVersion(ObjectVersion version)
@@ -87,12 +242,26 @@ void Object::setVersion(ObjectVersion version)
 
 Object* get_object(ObjectId id)
 {
-  base::scoped_unlock hold(mutex);
-  auto it = objects.find(id);
-  if (it != objects.end())
-    return it->second;
-  else
-    return nullptr;
+  Shard& shard = shard_for(id);
+  ++shard.lookups;
+  ShardLock lock(shard);
+  return shard.objects.find(id);
+}
+
+ObjectRegistryStats get_object_registry_stats()
+{
+  ObjectRegistryStats stats;
+  Shard* all = shards();
+  for (ObjectId i=0; i<kShards; ++i) {
+    Shard& shard = all[i];
+    stats.lookups += shard.lookups;
+    stats.changes += shard.changes;
+    stats.contentions += shard.contentions;
+
+    ShardLock lock(shard);
+    stats.objects += shard.objects.size();
+  }
+  return stats;
 }
 
 } // namespace doc
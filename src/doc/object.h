@@ -9,6 +9,8 @@
 #include "doc/object_id.h"
 #include "doc/object_type.h"
 
+#include <atomic>
+
 namespace doc {
 
   typedef uint32_t ObjectVersion;
@@ -37,9 +39,9 @@ namespace doc {
   private:
     ObjectType m_type;
 
-    // Unique identifier for this object (it is assigned by
-    // Objects class).
-    mutable ObjectId m_id;
+    // Unique identifier for this object (it is assigned the first
+    // time it's requested, so it can be from any thread).
+    mutable std::atomic<ObjectId> m_id;
 
     ObjectVersion m_version;
 
@@ -49,6 +51,18 @@ namespace doc {
 
   Object* get_object(ObjectId id);
 
+  // Counters of the registry of objects. The registry is divided in
+  // shards (each one with its own lock), "contentions" is the number
+  // of times that a thread had to wait another one to access a shard.
+  struct ObjectRegistryStats {
+    uint64_t objects = 0;       // Objects with an ID
+    uint64_t lookups = 0;       // Calls to get_object()
+    uint64_t changes = 0;       // IDs added/removed
+    uint64_t contentions = 0;
+  };
+
+  ObjectRegistryStats get_object_registry_stats();
+
   template<typename T>
   inline T* get(ObjectId id) {
     return static_cast<T*>(get_object(id));
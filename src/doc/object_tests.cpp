@@ -0,0 +1,128 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/object.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace doc;
+
+namespace {
+
+  class TestObject : public Object {
+  public:
+    TestObject() : Object(ObjectType::Image) { }
+  };
+
+} // anonymous namespace
+
+TEST(Object, IdsAreRegistered)
+{
+  TestObject a, b;
+  EXPECT_NE(0, a.id());
+  EXPECT_NE(a.id(), b.id());
+  EXPECT_EQ(&a, get_object(a.id()));
+  EXPECT_EQ(&b, get_object(b.id()));
+
+  ObjectId id = a.id();
+  a.setId(0);
+  EXPECT_EQ(nullptr, get_object(id));
+
+  // Restore the old ID (like undo does)
+  a.setId(id);
+  EXPECT_EQ(id, a.id());
+  EXPECT_EQ(&a, get_object(id));
+}
+
+TEST(Object, DestroyedObjectsAreUnregistered)
+{
+  const uint64_t before = get_object_registry_stats().objects;
+  std::vector<ObjectId> ids;
+  {
+    std::vector<std::unique_ptr<TestObject>> objs;
+    for (int i=0; i<1000; ++i) {
+      objs.emplace_back(new TestObject);
+      ids.push_back(objs.back()->id());
+    }
+    EXPECT_EQ(before+1000, get_object_registry_stats().objects);
+  }
+  EXPECT_EQ(before, get_object_registry_stats().objects);
+  for (ObjectId id : ids)
+    EXPECT_EQ(nullptr, get_object(id));
+}
+
+TEST(Object, CreateFromManyThreads)
+{
+  const int nthreads = 8;
+  const int nobjs = 5000;
+  std::vector<std::vector<std::unique_ptr<TestObject>>> objs(nthreads);
+  std::vector<std::thread> threads;
+  int failed = 0;
+
+  for (int t=0; t<nthreads; ++t) {
+    threads.push_back(std::thread([&objs, t]{
+      for (int i=0; i<nobjs; ++i) {
+        objs[t].emplace_back(new TestObject);
+        objs[t].back()->id();
+      }
+      // Delete half of them to mix insertions and deletions
+      for (int i=0; i<nobjs; i+=2)
+        objs[t][i].reset();
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  std::vector<ObjectId> ids;
+  for (auto& v : objs)
+    for (auto& obj : v)
+      if (obj) {
+        ids.push_back(obj->id());
+        if (get_object(obj->id()) != obj.get())
+          ++failed;
+      }
+
+  EXPECT_EQ(0, failed);
+  std::sort(ids.begin(), ids.end());
+  EXPECT_TRUE(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+
+  ObjectRegistryStats stats = get_object_registry_stats();
+  EXPECT_LE(uint64_t(ids.size()), stats.objects);
+  EXPECT_LE(uint64_t(nthreads*nobjs*3/2), stats.changes);
+  EXPECT_LE(stats.contentions, stats.changes + stats.lookups);
+}
+
+TEST(Object, SameIdFromManyThreads)
+{
+  for (int k=0; k<100; ++k) {
+    TestObject obj;
+    ObjectId ids[4];
+    std::vector<std::thread> threads;
+    for (int t=0; t<4; ++t)
+      threads.push_back(std::thread([&obj, &ids, t]{ ids[t] = obj.id(); }));
+    for (auto& thread : threads)
+      thread.join();
+
+    for (int t=1; t<4; ++t)
+      EXPECT_EQ(ids[0], ids[t]);
+    EXPECT_EQ(&obj, get_object(ids[0]));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
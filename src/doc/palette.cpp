@@ -228,8 +228,11 @@ int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
   ASSERT(b >= 0 && b <= 255);
   ASSERT(a >= 0 && a <= 255);
 
-  if (col_diff.empty())
-    initBestfit();
+  // The tables are initialized only once, even if the first calls
+  // come from several threads at the same time (e.g. when frames are
+  // rendered in parallel).
+  static const bool initialized = (initBestfit(), true);
+  (void)initialized;
 
   r >>= 3;
   g >>= 3;
@@ -10,6 +10,7 @@
 
 #include "doc/primitives.h"
 
+#include "base/parallel_for.h"
 #include "doc/algo.h"
 #include "doc/brush.h"
 #include "doc/image_impl.h"
@@ -17,6 +18,7 @@
 #include "doc/remap.h"
 #include "doc/rgbmap.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace doc {
@@ -334,19 +336,75 @@ int count_diff_between_images(const Image* i1, const Image* i2)
   return -1;
 }
 
+namespace {
+
+// Minimum number of pixels to remap images in several threads
+const int64_t kMinParallelRemapPixels = 256*256;
+
+typedef uint8_t RemapTable[256];
+
+void create_remap_table(const Remap& remap, RemapTable& table)
+{
+  for (int i=0; i<256; ++i)
+    table[i] = uint8_t(remap[i]);
+}
+
+// Remaps a row of indexed pixels, eight pixels by iteration so the
+// compiler can keep the table lookups independent of each other.
+void remap_row(const RemapTable& table, uint8_t* p, int n)
+{
+  for (; n >= 8; n -= 8, p += 8) {
+    const uint8_t a = table[p[0]], b = table[p[1]];
+    const uint8_t c = table[p[2]], d = table[p[3]];
+    const uint8_t e = table[p[4]], f = table[p[5]];
+    const uint8_t g = table[p[6]], h = table[p[7]];
+    p[0] = a; p[1] = b; p[2] = c; p[3] = d;
+    p[4] = e; p[5] = f; p[6] = g; p[7] = h;
+  }
+  for (; n > 0; --n, ++p)
+    *p = table[*p];
+}
+
+void remap_image_with_table(Image* image, const RemapTable& table)
+{
+  const int w = image->width();
+  const int h = image->height();
+  for (int y=0; y<h; ++y)
+    remap_row(table, (uint8_t*)image->getPixelAddress(0, y), w);
+}
+
+} // anonymous namespace
+
 void remap_image(Image* image, const Remap& remap)
 {
   ASSERT(image->pixelFormat() == IMAGE_INDEXED);
   if (image->pixelFormat() != IMAGE_INDEXED)
     return;
 
-  LockImageBits<IndexedTraits> bits(image);
-  LockImageBits<IndexedTraits>::iterator
-    it = bits.begin(),
-    end = bits.end();
+  RemapTable table;
+  create_remap_table(remap, table);
+  remap_image_with_table(image, table);
+}
+
+void remap_images(const std::vector<Image*>& images, const Remap& remap)
+{
+  RemapTable table;
+  create_remap_table(remap, table);
+
+  int64_t pixels = 0;
+  for (const Image* image : images) {
+    ASSERT(image->pixelFormat() == IMAGE_INDEXED);
+    pixels += int64_t(image->width()) * image->height();
+  }
 
-  for (; it != end; ++it)
-    *it = remap[*it];
+  base::parallel_for(
+    int(images.size()),
+    [&](int i){
+      Image* image = images[i];
+      if (image->pixelFormat() == IMAGE_INDEXED)
+        remap_image_with_table(image, table);
+    },
+    (pixels < kMinParallelRemapPixels ? 1: 0));
 }
 
 } // namespace doc
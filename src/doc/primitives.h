@@ -10,6 +10,8 @@
 #include "doc/image_buffer.h"
 #include "gfx/fwd.h"
 
+#include <vector>
+
 namespace doc {
   class Brush;
   class Image;
@@ -41,4 +43,8 @@ namespace doc {
 
   void remap_image(Image* image, const Remap& remap);
 
+  // Remaps several indexed images in parallel. Each image must be
+  // included only once in the vector.
+  void remap_images(const std::vector<Image*>& images, const Remap& remap);
+
 } // namespace doc
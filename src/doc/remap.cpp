@@ -155,6 +155,19 @@ bool Remap::isFor8bit() const
   return true;
 }
 
+bool Remap::isPermutation() const
+{
+  std::vector<bool> used(size(), false);
+  for (int i=0; i<size(); ++i) {
+    const int j = m_map[i];
+    if (j < 0 || j >= size() || used[j])
+      return false;
+
+    used[j] = true;
+  }
+  return true;
+}
+
 bool Remap::isInvertible(const PalettePicks& usedEntries) const
 {
   PalettePicks picks(size());
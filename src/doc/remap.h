@@ -55,6 +55,11 @@ namespace doc {
     // undo data, without saving all images' pixels.
     bool isInvertible(const PalettePicks& usedEntries) const;
 
+    // Returns true if each entry is mapped to a different one (e.g. a
+    // reordering of palette entries). These remaps are invertible for
+    // any image, so used entries don't need to be calculated.
+    bool isPermutation() const;
+
   private:
     std::vector<int> m_map;
   };
@@ -11,8 +11,12 @@
 #include <gtest/gtest.h>
 
 #include "doc/remap.h"
+#include "doc/image.h"
 #include "doc/palette.h"
 #include "doc/palette_picks.h"
+#include "doc/primitives.h"
+
+#include <memory>
 
 using namespace doc;
 
@@ -215,6 +219,52 @@ TEST(Remap, BetweenPalettesNonInvertible)
   EXPECT_FALSE(map.isInvertible(all));
 }
 
+TEST(Remap, IsPermutation)
+{
+  PalettePicks entries(20);
+  std::fill(entries.begin(), entries.end(), false);
+  entries[6] = entries[14] = true;
+
+  EXPECT_TRUE(create_remap_to_move_picks(entries, 1).isPermutation());
+  EXPECT_TRUE(create_remap_to_move_picks(entries, 20).isPermutation());
+
+  Remap map(4);
+  map.map(0, 1);
+  map.map(1, 0);
+  map.map(2, 3);
+  map.map(3, 3);
+  EXPECT_FALSE(map.isPermutation());
+  map.map(3, 2);
+  EXPECT_TRUE(map.isPermutation());
+}
+
+TEST(Remap, RemapImages)
+{
+  Remap map(256);
+  for (int i=0; i<256; ++i)
+    map.map(i, 255-i);
+
+  std::vector<std::unique_ptr<Image> > owners;
+  std::vector<Image*> images;
+  for (int i=0; i<8; ++i) {
+    owners.emplace_back(Image::create(IMAGE_INDEXED, 61+i, 130));
+    Image* image = owners.back().get();
+    for (int y=0; y<image->height(); ++y)
+      for (int x=0; x<image->width(); ++x)
+        put_pixel(image, x, y, (x*7 + y*3 + i) & 255);
+    images.push_back(image);
+  }
+
+  remap_images(images, map);
+
+  for (int i=0; i<8; ++i) {
+    const Image* image = images[i];
+    for (int y=0; y<image->height(); ++y)
+      for (int x=0; x<image->width(); ++x)
+        ASSERT_EQ(255 - ((x*7 + y*3 + i) & 255), get_pixel(image, x, y));
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -14,6 +14,7 @@
 #include "doc/color.h"
 #include "doc/image.h"
 #include "doc/primitives.h"
+#include "gfx/size.h"
 
 using namespace std;
 using namespace doc;
@@ -81,6 +82,71 @@ TEST(ResizeImage, NearestNeighborInterp)
   ASSERT_EQ(0, count_diff_between_images(src, dst2));
 }
 
+TEST(ResizeImage, BilinearKeepsCorners)
+{
+  Image* src = create_image_from_data(IMAGE_RGB, test_image_base_3x3, 3, 3);
+  Image* dst = Image::create(IMAGE_RGB, 5, 5);
+  algorithm::resize_image(src, dst, algorithm::RESIZE_METHOD_BILINEAR, NULL, NULL, -1);
+
+  // First and last pixels are aligned, so even pixels are the source ones
+  for (int y=0; y<5; y+=2)
+    for (int x=0; x<5; x+=2)
+      EXPECT_EQ(get_pixel(src, x/2, y/2), get_pixel(dst, x, y));
+
+  EXPECT_EQ(rgba(128, 128, 128, 0), get_pixel(dst, 1, 0));
+
+  delete src;
+  delete dst;
+}
+
+TEST(ResizeImage, BoxAveragesArea)
+{
+  Image* src = Image::create(IMAGE_RGB, 4, 4);
+  for (int y=0; y<4; ++y)
+    for (int x=0; x<4; ++x)
+      put_pixel(src, x, y, ((x+y) & 1) ? rgba(255, 255, 255, 255): rgba(0, 0, 0, 255));
+
+  Image* dst = Image::create(IMAGE_RGB, 2, 2);
+  algorithm::resize_image(src, dst, algorithm::RESIZE_METHOD_BOX, NULL, NULL, -1);
+  for (int y=0; y<2; ++y)
+    for (int x=0; x<2; ++x)
+      EXPECT_EQ(rgba(128, 128, 128, 255), get_pixel(dst, x, y));
+
+  delete src;
+  delete dst;
+}
+
+TEST(ResizeImage, FiltersKeepFlatColors)
+{
+  for (auto method : { algorithm::RESIZE_METHOD_BILINEAR,
+                       algorithm::RESIZE_METHOD_BOX,
+                       algorithm::RESIZE_METHOD_LANCZOS }) {
+    Image* src = Image::create(IMAGE_RGB, 37, 23);
+    clear_image(src, rgba(10, 200, 255, 128));
+
+    for (auto size : { gfx::Size(100, 7), gfx::Size(5, 64), gfx::Size(1, 1) }) {
+      Image* dst = Image::create(IMAGE_RGB, size.w, size.h);
+      algorithm::resize_image(src, dst, method, NULL, NULL, -1);
+      for (int y=0; y<size.h; ++y)
+        for (int x=0; x<size.w; ++x)
+          ASSERT_EQ(rgba(10, 200, 255, 128), get_pixel(dst, x, y));
+      delete dst;
+    }
+
+    Image* gray = Image::create(IMAGE_GRAYSCALE, 9, 9);
+    Image* dst = Image::create(IMAGE_GRAYSCALE, 4, 13);
+    clear_image(gray, graya(77, 255));
+    algorithm::resize_image(gray, dst, method, NULL, NULL, -1);
+    for (int y=0; y<13; ++y)
+      for (int x=0; x<4; ++x)
+        ASSERT_EQ(graya(77, 255), get_pixel(dst, x, y));
+
+    delete gray;
+    delete dst;
+    delete src;
+  }
+}
+
 #if 0                           // TODO complete this test
 TEST(ResizeImage, BilinearInterpRGBType)
 {
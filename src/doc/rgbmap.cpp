@@ -43,18 +43,20 @@ void RgbMap::regenerate(const Palette* palette, int mask_index)
   m_maskIndex = mask_index;
 
   // Mark all entries as invalid (need to be regenerated)
-  for (uint16_t& entry : m_map)
-    entry |= INVALID;
+  for (auto& entry : m_map)
+    entry.fetch_or(INVALID, std::memory_order_relaxed);
 }
 
 int RgbMap::generateEntry(int i, int r, int g, int b, int a) const
 {
-  return m_map[i] =
+  int v =
     m_palette->findBestfit(
       scale_5bits_to_8bits(r>>3),
       scale_5bits_to_8bits(g>>3),
       scale_5bits_to_8bits(b>>3),
       scale_3bits_to_8bits(a>>5), m_maskIndex);
+  m_map[i].store(v, std::memory_order_relaxed);
+  return v;
 }
 
 } // namespace doc
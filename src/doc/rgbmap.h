@@ -10,6 +10,7 @@
 #include "base/disable_copying.h"
 #include "doc/object.h"
 
+#include <atomic>
 #include <vector>
 
 namespace doc {
@@ -17,6 +18,9 @@ namespace doc {
   class Palette;
 
   // It acts like a cache for Palette:findBestfit() calls.
+  //
+  // mapColor() can be called from several threads at the same time
+  // (entries are generated with the same value from any thread).
   class RgbMap : public Object {
     // Bit activated on m_map entries that aren't yet calculated.
     const int INVALID = 256;
@@ -34,7 +38,7 @@ namespace doc {
       ASSERT(a >= 0 && a < 256);
       // bits -> bbbbbgggggrrrrraaa
       int i = (a>>5) | ((b>>3) << 3) | ((g>>3) << 8) | ((r>>3) << 13);
-      int v = m_map[i];
+      int v = m_map[i].load(std::memory_order_relaxed);
       return (v & INVALID) ? generateEntry(i, r, g, b, a): v;
     }
 
@@ -43,7 +47,7 @@ namespace doc {
   private:
     int generateEntry(int i, int r, int g, int b, int a) const;
 
-    mutable std::vector<uint16_t> m_map;
+    mutable std::vector<std::atomic<uint16_t>> m_map;
     const Palette* m_palette;
     int m_modifications;
     int m_maskIndex;
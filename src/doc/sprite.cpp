@@ -24,6 +24,7 @@
 #include "doc/remap.h"
 #include "doc/rgbmap.h"
 
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include <memory>
@@ -473,13 +474,20 @@ void Sprite::remapImages(frame_t frameFrom, frame_t frameTo, const Remap& remap)
   ASSERT(m_format == IMAGE_INDEXED);
   //ASSERT(remap.size() == 256);
 
+  std::vector<Image*> images;
   for (const Cel* cel : uniqueCels()) {
     // Remap this Cel because is inside the specified range
     if (cel->frame() >= frameFrom &&
         cel->frame() <= frameTo) {
-      remap_image(cel->image(), remap);
+      images.push_back(cel->image());
     }
   }
+
+  // Different cels could share the same image
+  std::sort(images.begin(), images.end());
+  images.erase(std::unique(images.begin(), images.end()), images.end());
+
+  remap_images(images, remap);
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -0,0 +1,323 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/swap_file.h"
+
+#include "base/debug.h"
+#include "base/fs.h"
+#include "base/mutex.h"
+#include "base/path.h"
+#include "base/scoped_lock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__APPLE__))
+  #define DOC_HAVE_SWAP_FILE 1
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #ifndef MAP_ANONYMOUS
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+#endif
+
+namespace doc {
+
+struct SwapRegion::Tile {
+  std::size_t index;            // Position in the swap file (in tiles)
+  uint8_t* addr;                // Where the tile is mapped
+  bool resident;                // True if the tile is in the LRU list
+  std::list<Tile*>::iterator lru;
+};
+
+namespace {
+
+// The swap file grows in steps of this number of tiles
+const std::size_t kGrowTiles = 16;
+
+class SwapFile {
+public:
+  typedef SwapRegion::Tile Tile;
+
+  SwapFile() : threshold(0), m_fd(-1), m_fileTiles(0), m_tiles(0), m_resident(0) { }
+
+  base::mutex mutex;
+  SwapOptions options;
+
+  // Copy of options.threshold to check the size of new buffers
+  // without locking the mutex (the feature is usually disabled).
+  std::atomic<std::size_t> threshold;
+
+  SwapStats stats() const {
+    SwapStats stats;
+    stats.tiles = m_tiles;
+    stats.resident = m_resident;
+    stats.fileTiles = m_fileTiles;
+    return stats;
+  }
+
+#ifdef DOC_HAVE_SWAP_FILE
+
+  // Gets the index of a free (zeroed) tile of the swap file.
+  bool allocTile(std::size_t& index) {
+    if (!open())
+      return false;
+
+    if (m_freeTiles.empty()) {
+      const std::size_t n = m_fileTiles + kGrowTiles;
+      if (ftruncate(m_fd, off_t(n * SwapRegion::kTileSize)) != 0)
+        return false;
+
+      for (std::size_t i=n; i>m_fileTiles; --i)
+        m_freeTiles.push_back(i-1);
+      m_fileTiles = n;
+    }
+
+    index = m_freeTiles.back();
+    m_freeTiles.pop_back();
+    ++m_tiles;
+    return true;
+  }
+
+  bool mapTile(Tile* tile) {
+    void* addr = mmap(tile->addr, SwapRegion::kTileSize,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                      m_fd, off_t(tile->index * SwapRegion::kTileSize));
+    return (addr == tile->addr);
+  }
+
+  // Discards the content of the tile so it can be reused by other
+  // region. The tile must be unmapped after this.
+  void freeTile(Tile* tile) {
+    if (tile->resident)
+      removeFromLru(tile);
+
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+    if (fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  off_t(tile->index * SwapRegion::kTileSize),
+                  off_t(SwapRegion::kTileSize)) != 0)
+#endif
+    {
+      std::memset(tile->addr, 0, SwapRegion::kTileSize);
+    }
+
+    releaseTile(tile->index);
+  }
+
+  void releaseTile(std::size_t index) {
+    m_freeTiles.push_back(index);
+    --m_tiles;
+  }
+
+  void touch(Tile* tile) {
+    if (tile->resident) {
+      m_lru.splice(m_lru.begin(), m_lru, tile->lru);
+      return;
+    }
+
+    m_lru.push_front(tile);
+    tile->lru = m_lru.begin();
+    tile->resident = true;
+    ++m_resident;
+
+    const std::size_t maxResident =
+      std::max<std::size_t>(1, options.budget / SwapRegion::kTileSize);
+    while (m_resident > maxResident)
+      evict(m_lru.back());
+  }
+
+private:
+  bool open() {
+    if (m_fd >= 0)
+      return true;
+
+    std::string dir = options.dir;
+    if (dir.empty())
+      dir = base::get_temp_path();
+
+    std::string fn = base::join_path(dir, "libresprite-swap-XXXXXX");
+    std::vector<char> buf(fn.begin(), fn.end());
+    buf.push_back(0);
+
+    m_fd = mkstemp(&buf[0]);
+    if (m_fd < 0)
+      return false;
+
+    // The file is removed from the directory right now, so it's
+    // deleted automatically when the program finishes (or crashes).
+    unlink(&buf[0]);
+    return true;
+  }
+
+  // Writes the tile back to the file and releases its memory. The
+  // tile is still mapped, so it's loaded again if it's accessed.
+  void evict(Tile* tile) {
+    msync(tile->addr, SwapRegion::kTileSize, MS_SYNC);
+    madvise(tile->addr, SwapRegion::kTileSize, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(m_fd, off_t(tile->index * SwapRegion::kTileSize),
+                  off_t(SwapRegion::kTileSize), POSIX_FADV_DONTNEED);
+#endif
+    removeFromLru(tile);
+  }
+
+  void removeFromLru(Tile* tile) {
+    ASSERT(tile->resident);
+    m_lru.erase(tile->lru);
+    tile->resident = false;
+    --m_resident;
+  }
+
+#endif // DOC_HAVE_SWAP_FILE
+
+private:
+  int m_fd;
+  std::size_t m_fileTiles;
+  std::size_t m_tiles;
+  std::size_t m_resident;
+  std::vector<std::size_t> m_freeTiles;
+  std::list<Tile*> m_lru;       // Resident tiles, most recently used first
+};
+
+// Never deleted, so images destroyed after main() can free their tiles
+SwapFile& swap_file()
+{
+  static SwapFile* file = new SwapFile;
+  return *file;
+}
+
+} // anonymous namespace
+
+void set_swap_options(const SwapOptions& options)
+{
+  SwapFile& file = swap_file();
+  base::scoped_lock lock(file.mutex);
+  file.options = options;
+  file.threshold = options.threshold;
+}
+
+SwapOptions get_swap_options()
+{
+  SwapFile& file = swap_file();
+  base::scoped_lock lock(file.mutex);
+  return file.options;
+}
+
+SwapStats get_swap_stats()
+{
+  SwapFile& file = swap_file();
+  base::scoped_lock lock(file.mutex);
+  return file.stats();
+}
+
+// static
+SwapRegion* SwapRegion::create(std::size_t size)
+{
+#ifdef DOC_HAVE_SWAP_FILE
+  SwapFile& file = swap_file();
+  const std::size_t threshold = file.threshold.load(std::memory_order_relaxed);
+  if (threshold == 0 || size < threshold)
+    return nullptr;
+
+  SwapRegion* region = nullptr;
+  std::size_t ntiles = 0;
+  {
+    base::scoped_lock lock(file.mutex);
+
+    // The options could be changed before locking the mutex
+
+    if (file.options.threshold == 0 ||
+        size < file.options.threshold)
+      return nullptr;
+
+    // Reserve contiguous address space for all the tiles, then each
+    // tile is mapped from its position in the swap file.
+    ntiles = (size + kTileSize - 1) / kTileSize;
+    void* base = mmap(nullptr, ntiles * kTileSize, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+      return nullptr;
+
+    region = new SwapRegion((uint8_t*)base, size);
+    region->m_tiles.reserve(ntiles);
+
+    for (std::size_t i=0; i<ntiles; ++i) {
+      Tile* tile = new Tile;
+      tile->addr = region->m_data + i*kTileSize;
+      tile->resident = false;
+
+      if (!file.allocTile(tile->index)) {
+        delete tile;
+        break;
+      }
+      if (!file.mapTile(tile)) {
+        file.releaseTile(tile->index);
+        delete tile;
+        break;
+      }
+      region->m_tiles.push_back(tile);
+    }
+  }
+
+  // The file cannot be enlarged (e.g. no space left on disk)
+  if (region->m_tiles.size() < ntiles) {
+    delete region;
+    return nullptr;
+  }
+  return region;
+#else
+  return nullptr;
+#endif
+}
+
+SwapRegion::SwapRegion(uint8_t* data, std::size_t size)
+  : m_data(data)
+  , m_size(size)
+{
+}
+
+SwapRegion::~SwapRegion()
+{
+#ifdef DOC_HAVE_SWAP_FILE
+  SwapFile& file = swap_file();
+  {
+    base::scoped_lock lock(file.mutex);
+    for (Tile* tile : m_tiles) {
+      file.freeTile(tile);
+      delete tile;
+    }
+  }
+
+  const std::size_t ntiles = (m_size + kTileSize - 1) / kTileSize;
+  munmap(m_data, ntiles * kTileSize);
+#endif
+}
+
+void SwapRegion::touch(std::size_t offset, std::size_t size)
+{
+  if (size == 0 || offset >= m_size)
+    return;
+
+  const std::size_t end = std::min(offset + size, m_size);
+  const std::size_t i0 = offset / kTileSize;
+  const std::size_t i1 = (end - 1) / kTileSize;
+
+  SwapFile& file = swap_file();
+  base::scoped_lock lock(file.mutex);
+#ifdef DOC_HAVE_SWAP_FILE
+  for (std::size_t i=i0; i<=i1 && i<m_tiles.size(); ++i)
+    file.touch(m_tiles[i]);
+#endif
+}
+
+} // namespace doc
@@ -0,0 +1,73 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "base/disable_copying.h"
+#include "base/ints.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace doc {
+
+  // Out-of-core storage for big image buffers. Buffers bigger than
+  // the threshold are memory-mapped from a swap file in fixed-size
+  // tiles, so the OS can keep them on disk instead of RAM. Pixels are
+  // still contiguous in memory, so ImageImpl and LockImageBits work
+  // in the same way with these buffers.
+  //
+  // Tiles are marked as used when an image is locked (see
+  // Image::lockBits()), and the least recently used tiles are written
+  // back and released when the used tiles exceed the budget. A
+  // released tile that is accessed without a lock is loaded again by
+  // the OS, so the budget is approximate.
+  struct SwapOptions {
+    std::size_t threshold = 0;  // Minimum size of swapped buffers (0 = disabled)
+    std::size_t budget = std::size_t(1024)*1024*1024; // Max resident bytes
+    std::string dir;            // Directory of the swap file (empty = temp dir)
+  };
+
+  struct SwapStats {
+    std::size_t tiles = 0;      // Tiles used by buffers
+    std::size_t resident = 0;   // Tiles marked as used (in memory)
+    std::size_t fileTiles = 0;  // Size of the swap file (in tiles)
+  };
+
+  void set_swap_options(const SwapOptions& options);
+  SwapOptions get_swap_options();
+  SwapStats get_swap_stats();
+
+  class SwapRegion {
+  public:
+    static const std::size_t kTileSize = 1024*1024;
+
+    // Returns nullptr if the size is smaller than the threshold or the
+    // swap file cannot be used (so a buffer in RAM must be used).
+    static SwapRegion* create(std::size_t size);
+    ~SwapRegion();
+
+    uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    // Marks the given range of bytes as used.
+    void touch(std::size_t offset, std::size_t size);
+
+    // A part of the region mapped from the swap file
+    struct Tile;
+
+  private:
+    SwapRegion(uint8_t* data, std::size_t size);
+
+    uint8_t* m_data;
+    std::size_t m_size;
+    std::vector<Tile*> m_tiles;
+
+    DISABLE_COPYING(SwapRegion);
+  };
+
+} // namespace doc
@@ -0,0 +1,116 @@
+// Aseprite Document Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_impl.h"
+#include "doc/primitives.h"
+#include "doc/swap_file.h"
+
+#include <memory>
+
+using namespace doc;
+
+namespace {
+
+  class SwapFileTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+      SwapOptions options;
+      options.threshold = SwapRegion::kTileSize;
+      options.budget = 2*SwapRegion::kTileSize;
+      set_swap_options(options);
+    }
+
+    void TearDown() override {
+      set_swap_options(SwapOptions());
+    }
+  };
+
+} // anonymous namespace
+
+#if !defined(_WIN32)
+
+TEST_F(SwapFileTest, SmallImagesInRam)
+{
+  ImageBufferPtr buffer(new ImageBuffer);
+  std::unique_ptr<Image> img(Image::create(IMAGE_RGB, 32, 32, buffer));
+  EXPECT_FALSE(buffer->isSwapped());
+}
+
+TEST_F(SwapFileTest, PixelsAreKept)
+{
+  const int w = 1000, h = 1200;   // ~4.6 tiles
+  ImageBufferPtr buffer(new ImageBuffer);
+  std::unique_ptr<Image> img(Image::create(IMAGE_RGB, w, h, buffer));
+  ASSERT_TRUE(buffer->isSwapped());
+  EXPECT_EQ(5, get_swap_stats().tiles);
+
+  for (int y=0; y<h; ++y) {
+    LockImageBits<RgbTraits> bits(img.get(), gfx::Rect(0, y, w, 1));
+    int x = 0;
+    for (auto& c : bits) {
+      c = rgba(x & 255, y & 255, (x+y) & 255, 255);
+      ++x;
+    }
+
+    // Only the tiles locked recently are kept in memory
+    EXPECT_GE(2, get_swap_stats().resident);
+  }
+
+  for (int y=h-1; y>=0; --y)
+    for (int x=0; x<w; x+=7)
+      ASSERT_EQ(rgba(x & 255, y & 255, (x+y) & 255, 255),
+                get_pixel(img.get(), x, y));
+
+  std::unique_ptr<Image> copy(Image::createCopy(img.get()));
+  EXPECT_EQ(0, count_diff_between_images(img.get(), copy.get()));
+}
+
+TEST_F(SwapFileTest, TilesAreReused)
+{
+  std::size_t fileTiles;
+  {
+    std::unique_ptr<Image> img(Image::create(IMAGE_RGB, 1024, 1024));
+    clear_image(img.get(), rgba(255, 0, 0, 255));
+    fileTiles = get_swap_stats().fileTiles;
+  }
+  EXPECT_EQ(0, get_swap_stats().tiles);
+  EXPECT_EQ(0, get_swap_stats().resident);
+
+  // The new image uses the same tiles, which must be zeroed
+  ImageBuffer buffer(4*SwapRegion::kTileSize);
+  ASSERT_TRUE(buffer.isSwapped());
+  EXPECT_EQ(fileTiles, get_swap_stats().fileTiles);
+  for (std::size_t i=0; i<buffer.size(); i+=4096)
+    ASSERT_EQ(0, buffer.buffer()[i]);
+}
+
+TEST_F(SwapFileTest, ResizeBuffer)
+{
+  ImageBufferPtr buffer(new ImageBuffer(16));
+  EXPECT_FALSE(buffer->isSwapped());
+
+  std::unique_ptr<Image> img(Image::create(IMAGE_GRAYSCALE, 1024, 1024, buffer));
+  EXPECT_TRUE(buffer->isSwapped());
+
+  set_swap_options(SwapOptions());
+  buffer->resizeIfNecessary(2*buffer->size());
+  EXPECT_FALSE(buffer->isSwapped());
+  EXPECT_EQ(0, get_swap_stats().tiles);
+}
+
+#endif
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
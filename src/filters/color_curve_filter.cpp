@@ -49,6 +49,11 @@ const char* ColorCurveFilter::getName()
   return "Color Curve";
 }
 
+Filter* ColorCurveFilter::clone() const
+{
+  return new ColorCurveFilter(*this);
+}
+
 void ColorCurveFilter::applyToRgba(FilterManager* filterMgr)
 {
   const uint32_t* src_address = (uint32_t*)filterMgr->getSourceAddress();
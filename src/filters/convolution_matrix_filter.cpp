@@ -140,6 +140,11 @@ const char* ConvolutionMatrixFilter::getName()
   return "Convolution Matrix";
 }
 
+Filter* ConvolutionMatrixFilter::clone() const
+{
+  return new ConvolutionMatrixFilter(*this);
+}
+
 void ConvolutionMatrixFilter::applyToRgba(FilterManager* filterMgr)
 {
   if (!m_matrix)
@@ -33,6 +33,7 @@ namespace filters {
     void applyToRgba(FilterManager* filterMgr);
     void applyToGrayscale(FilterManager* filterMgr);
     void applyToIndexed(FilterManager* filterMgr);
+    Filter* clone() const;
 
   private:
     std::shared_ptr<ConvolutionMatrix> m_matrix;
@@ -36,6 +36,12 @@ namespace filters {
     // each pixel.
     virtual void applyToIndexed(FilterManager* filterMgr) = 0;
 
+    // Returns a copy of the filter with the same parameters, or
+    // nullptr if the filter cannot be copied. Copies are used to
+    // apply the filter from other threads (e.g. to refine the preview
+    // in the background), each thread uses its own copy.
+    virtual Filter* clone() const { return nullptr; }
+
   };
 
 } // namespace filters
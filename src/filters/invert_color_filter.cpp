@@ -26,6 +26,11 @@ const char* InvertColorFilter::getName()
   return "Invert Color";
 }
 
+Filter* InvertColorFilter::clone() const
+{
+  return new InvertColorFilter(*this);
+}
+
 void InvertColorFilter::applyToRgba(FilterManager* filterMgr)
 {
   const uint32_t* src_address = (uint32_t*)filterMgr->getSourceAddress();
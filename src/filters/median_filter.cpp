@@ -118,6 +118,11 @@ const char* MedianFilter::getName()
   return "Median Blur";
 }
 
+Filter* MedianFilter::clone() const
+{
+  return new MedianFilter(*this);
+}
+
 void MedianFilter::applyToRgba(FilterManager* filterMgr)
 {
   const Image* src = filterMgr->getSourceImage();
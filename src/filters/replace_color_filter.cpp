@@ -47,6 +47,11 @@ const char* ReplaceColorFilter::getName()
   return "Replace Color";
 }
 
+Filter* ReplaceColorFilter::clone() const
+{
+  return new ReplaceColorFilter(*this);
+}
+
 void ReplaceColorFilter::applyToRgba(FilterManager* filterMgr)
 {
   const uint32_t* src_address = (uint32_t*)filterMgr->getSourceAddress();
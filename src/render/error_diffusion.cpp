@@ -0,0 +1,280 @@
+// Aseprite Render Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/error_diffusion.h"
+
+#include "base/base.h"
+#include "base/parallel_for.h"
+#include "doc/image_impl.h"
+#include "doc/palette.h"
+#include "doc/rgbmap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace render {
+
+using namespace doc;
+
+namespace {
+
+// Pixels processed by a row before it tells the next row how far it
+// is. Small values reduce the time that rows wait each other, big
+// values reduce the synchronization between threads.
+const int kChunkSize = 64;
+
+// Images smaller than this are processed in one thread.
+const int kMinPixelsPerThread = 128*128;
+
+struct KernelCell {
+  int dx, dy, weight;
+};
+
+struct Kernel {
+  int divisor;
+  int rows;                     // Number of rows below that receive error
+  int ncells;
+  KernelCell cells[6];
+};
+
+//                 X   7
+//             3   5   1     (1/16)
+const Kernel kFloydSteinberg = {
+  16, 1, 4, { { 1, 0, 7 },
+              { -1, 1, 3 }, { 0, 1, 5 }, { 1, 1, 1 } }
+};
+
+//                 X   1   1
+//             1   1   1
+//                 1         (1/8)
+const Kernel kAtkinson = {
+  8, 2, 6, { { 1, 0, 1 }, { 2, 0, 1 },
+             { -1, 1, 1 }, { 0, 1, 1 }, { 1, 1, 1 },
+             { 0, 2, 1 } }
+};
+
+//                 X   2
+//             1   1         (1/4)
+const Kernel kSierraLite = {
+  4, 1, 3, { { 1, 0, 2 },
+             { -1, 1, 1 }, { 0, 1, 1 } }
+};
+
+const Kernel* get_kernel(DitheringMethod method)
+{
+  switch (method) {
+    case DitheringMethod::FLOYD_STEINBERG: return &kFloydSteinberg;
+    case DitheringMethod::ATKINSON: return &kAtkinson;
+    case DitheringMethod::SIERRA_LITE: return &kSierraLite;
+    default: return nullptr;
+  }
+}
+
+// Error of the R, G, B components.
+struct Error {
+  int r, g, b;
+};
+
+// Padding at both sides of each error row, so cells outside the
+// image bounds don't need to be checked.
+const int kPadding = 2;
+
+class Ditherer {
+public:
+  Ditherer(const Kernel& kernel,
+           const Image* srcImage,
+           Image* dstImage,
+           const RgbMap* rgbmap,
+           const Palette* palette,
+           int transparentIndex,
+           bool serpentine,
+           int threads)
+    : m_kernel(kernel)
+    , m_src(srcImage)
+    , m_dst(dstImage)
+    , m_rgbmap(rgbmap)
+    , m_palette(palette)
+    , m_transparentIndex(transparentIndex)
+    , m_serpentine(serpentine)
+    , m_threads(threads)
+    , m_width(srcImage->width())
+    , m_height(srcImage->height())
+    , m_rowSize(m_width + 2*kPadding)
+    // Each thread is working in one row, and each row needs the
+    // rows below it. So we need only a few rows of errors.
+    , m_nrows(threads + kernel.rows + 1)
+    , m_errors(m_rowSize * m_nrows, Error{ 0, 0, 0 })
+    , m_progress(m_height) {
+    for (auto& progress : m_progress)
+      progress.store(0, std::memory_order_relaxed);
+  }
+
+  void run() {
+    // Each item is the list of rows of one thread (all of them must
+    // run at the same time).
+    base::parallel_for_threads(
+      m_threads, m_threads,
+      [this](int t, int){ runThread(t); });
+  }
+
+private:
+  void runThread(int t) {
+    for (int y=t; y<m_height; y+=m_threads)
+      ditherRow(y);
+  }
+
+  Error* errorRow(int y) {
+    return &m_errors[(y % m_nrows) * m_rowSize + kPadding];
+  }
+
+  void ditherRow(int y) {
+    const int w = m_width;
+    const int div = m_kernel.divisor;
+    const int dir = (m_serpentine && (y & 1) ? -1: 1);
+
+    // Clear the last row that will receive error from this one, all
+    // rows that used the same buffer before are already finished.
+    if (y+m_kernel.rows < m_height) {
+      Error* row = errorRow(y+m_kernel.rows) - kPadding;
+      std::fill(row, row+m_rowSize, Error{ 0, 0, 0 });
+    }
+
+    Error* rows[3] = { errorRow(y), errorRow(y+1), errorRow(y+2) };
+
+    // Error for the next pixels in this same row (dx=1 and dx=2)
+    Error carry[3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+
+    const RgbTraits::address_t srcRow = (const RgbTraits::address_t)m_src->getPixelAddress(0, y);
+    IndexedTraits::address_t dstRow = (IndexedTraits::address_t)m_dst->getPixelAddress(0, y);
+
+    for (int x0=0; x0<w; x0+=kChunkSize) {
+      const int x1 = std::min(w, x0+kChunkSize);
+
+      // Wait the previous row, it must be (at least) one pixel ahead
+      // to distribute all its error to the pixels of this chunk.
+      if (y > 0 && !m_serpentine) {
+        const int needed = std::min(w, x1+1);
+        while (m_progress[y-1].load(std::memory_order_acquire) < needed)
+          std::this_thread::yield();
+      }
+
+      for (int i=x0; i<x1; ++i) {
+        const int x = (dir > 0 ? i: w-1-i);
+        const color_t c = srcRow[x];
+        const int a = rgba_geta(c);
+
+        carry[0].r += rows[0][x].r;
+        carry[0].g += rows[0][x].g;
+        carry[0].b += rows[0][x].b;
+
+        if (a == 0 && m_transparentIndex >= 0) {
+          dstRow[x] = m_transparentIndex;
+        }
+        else {
+          const int r = MID(0, rgba_getr(c) + carry[0].r / div, 255);
+          const int g = MID(0, rgba_getg(c) + carry[0].g / div, 255);
+          const int b = MID(0, rgba_getb(c) + carry[0].b / div, 255);
+
+          const int index =
+            (m_rgbmap ? m_rgbmap->mapColor(r, g, b, a):
+                        m_palette->findBestfit(r, g, b, a, m_transparentIndex));
+          dstRow[x] = index;
+
+          const color_t p = m_palette->getEntry(index);
+          const Error e = { r - int(rgba_getr(p)),
+                            g - int(rgba_getg(p)),
+                            b - int(rgba_getb(p)) };
+
+          for (int k=0; k<m_kernel.ncells; ++k) {
+            const KernelCell& cell = m_kernel.cells[k];
+            Error& dst = (cell.dy == 0 ? carry[cell.dx]:
+                                         rows[cell.dy][x + cell.dx*dir]);
+            dst.r += e.r * cell.weight;
+            dst.g += e.g * cell.weight;
+            dst.b += e.b * cell.weight;
+          }
+        }
+
+        carry[0] = carry[1];
+        carry[1] = carry[2];
+        carry[2] = Error{ 0, 0, 0 };
+      }
+
+      m_progress[y].store(x1, std::memory_order_release);
+    }
+  }
+
+  const Kernel& m_kernel;
+  const Image* m_src;
+  Image* m_dst;
+  const RgbMap* m_rgbmap;
+  const Palette* m_palette;
+  int m_transparentIndex;
+  bool m_serpentine;
+  int m_threads;
+  int m_width;
+  int m_height;
+  int m_rowSize;
+  int m_nrows;
+  std::vector<Error> m_errors;
+  std::vector<std::atomic<int>> m_progress;
+};
+
+} // anonymous namespace
+
+bool is_error_diffusion(DitheringMethod method)
+{
+  return (get_kernel(method) != nullptr);
+}
+
+ErrorDiffusionDither::ErrorDiffusionDither(DitheringMethod method,
+                                           int transparentIndex)
+  : m_method(method)
+  , m_transparentIndex(transparentIndex)
+  , m_serpentine(false)
+  , m_threads(0)
+{
+  ASSERT(is_error_diffusion(method));
+}
+
+void ErrorDiffusionDither::ditherRgbImageToIndexed(const Image* srcImage,
+                                                   Image* dstImage,
+                                                   const RgbMap* rgbmap,
+                                                   const Palette* palette)
+{
+  ASSERT(srcImage->pixelFormat() == IMAGE_RGB);
+  ASSERT(dstImage->pixelFormat() == IMAGE_INDEXED);
+  ASSERT(srcImage->width() == dstImage->width());
+  ASSERT(srcImage->height() == dstImage->height());
+
+  const Kernel* kernel = get_kernel(m_method);
+  if (!kernel || srcImage->width() <= 0 || srcImage->height() <= 0)
+    return;
+
+  int threads = 1;
+  if (!m_serpentine) {
+    const int pixels = srcImage->width() * srcImage->height();
+    const int maxThreads = std::min(srcImage->height(),
+                                    pixels / kMinPixelsPerThread);
+    if (m_threads > 0)
+      threads = MID(1, m_threads, maxThreads);
+    else
+      threads = base::parallel_threads(maxThreads);
+  }
+
+  Ditherer ditherer(*kernel, srcImage, dstImage,
+                    rgbmap, palette, m_transparentIndex,
+                    m_serpentine, threads);
+  ditherer.run();
+}
+
+} // namespace render
@@ -0,0 +1,54 @@
+// Aseprite Render Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "doc/color.h"
+#include "doc/dithering_method.h"
+
+namespace doc {
+  class Image;
+  class Palette;
+  class RgbMap;
+}
+
+namespace render {
+
+  // Converts RGB images to indexed distributing the quantization
+  // error of each pixel to its neighbors (Floyd-Steinberg, Atkinson
+  // or Sierra Lite).
+  //
+  // Rows can be processed in parallel using a wavefront schedule:
+  // each row starts when the previous one is a few pixels ahead, so
+  // all the error that a pixel receives is already there. All rows go
+  // from left to right in this case. With serpentine scanning (odd
+  // rows from right to left) each row depends on the whole previous
+  // row, so the image is processed in one thread.
+  class ErrorDiffusionDither {
+  public:
+    ErrorDiffusionDither(doc::DitheringMethod method,
+                         int transparentIndex = -1);
+
+    void setSerpentine(bool state) { m_serpentine = state; }
+
+    // Maximum number of threads to use (0 = one per core).
+    void setThreads(int threads) { m_threads = threads; }
+
+    void ditherRgbImageToIndexed(const doc::Image* srcImage,
+                                 doc::Image* dstImage,
+                                 const doc::RgbMap* rgbmap,
+                                 const doc::Palette* palette);
+
+  private:
+    doc::DitheringMethod m_method;
+    int m_transparentIndex;
+    bool m_serpentine;
+    int m_threads;
+  };
+
+  bool is_error_diffusion(doc::DitheringMethod method);
+
+} // namespace render
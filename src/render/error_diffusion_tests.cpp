@@ -0,0 +1,125 @@
+// Aseprite Render Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_impl.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/rgbmap.h"
+#include "render/error_diffusion.h"
+
+#include <memory>
+
+using namespace doc;
+using namespace render;
+
+namespace {
+
+  std::unique_ptr<Palette> create_gray_palette(int ncolors) {
+    std::unique_ptr<Palette> pal(new Palette(frame_t(0), ncolors));
+    for (int i=0; i<ncolors; ++i) {
+      int v = 255 * i / (ncolors-1);
+      pal->setEntry(i, rgba(v, v, v, 255));
+    }
+    return pal;
+  }
+
+  std::unique_ptr<Image> create_gradient(int w, int h) {
+    std::unique_ptr<Image> img(Image::create(IMAGE_RGB, w, h));
+    for (int y=0; y<h; ++y)
+      for (int x=0; x<w; ++x) {
+        int v = 255 * x / (w-1);
+        put_pixel(img.get(), x, y, rgba(v, (v+y) & 255, v, 255));
+      }
+    return img;
+  }
+
+} // anonymous namespace
+
+TEST(ErrorDiffusion, ExactColorsAreKept)
+{
+  std::unique_ptr<Palette> pal(create_gray_palette(2));
+  std::unique_ptr<Image> src(Image::create(IMAGE_RGB, 8, 8));
+  std::unique_ptr<Image> dst(Image::create(IMAGE_INDEXED, 8, 8));
+  clear_image(src.get(), rgba(255, 255, 255, 255));
+
+  for (auto method : { DitheringMethod::FLOYD_STEINBERG,
+                       DitheringMethod::ATKINSON,
+                       DitheringMethod::SIERRA_LITE }) {
+    ErrorDiffusionDither dither(method);
+    dither.ditherRgbImageToIndexed(src.get(), dst.get(), nullptr, pal.get());
+    for (int y=0; y<8; ++y)
+      for (int x=0; x<8; ++x)
+        EXPECT_EQ(1, get_pixel(dst.get(), x, y));
+  }
+}
+
+TEST(ErrorDiffusion, MidGrayIsHalfBlackHalfWhite)
+{
+  std::unique_ptr<Palette> pal(create_gray_palette(2));
+  std::unique_ptr<Image> src(Image::create(IMAGE_RGB, 32, 32));
+  std::unique_ptr<Image> dst(Image::create(IMAGE_INDEXED, 32, 32));
+  clear_image(src.get(), rgba(128, 128, 128, 255));
+
+  ErrorDiffusionDither dither(DitheringMethod::FLOYD_STEINBERG);
+  dither.ditherRgbImageToIndexed(src.get(), dst.get(), nullptr, pal.get());
+
+  int whites = 0;
+  for (int y=0; y<32; ++y)
+    for (int x=0; x<32; ++x)
+      whites += get_pixel(dst.get(), x, y);
+  EXPECT_NEAR(32*32/2, whites, 32);
+}
+
+TEST(ErrorDiffusion, TransparentPixels)
+{
+  std::unique_ptr<Palette> pal(create_gray_palette(4));
+  std::unique_ptr<Image> src(Image::create(IMAGE_RGB, 4, 4));
+  std::unique_ptr<Image> dst(Image::create(IMAGE_INDEXED, 4, 4));
+  clear_image(src.get(), rgba(0, 0, 0, 0));
+
+  ErrorDiffusionDither dither(DitheringMethod::ATKINSON, 3);
+  dither.ditherRgbImageToIndexed(src.get(), dst.get(), nullptr, pal.get());
+  for (int y=0; y<4; ++y)
+    for (int x=0; x<4; ++x)
+      EXPECT_EQ(3, get_pixel(dst.get(), x, y));
+}
+
+// The wavefront must give the same result with any number of threads.
+TEST(ErrorDiffusion, SameResultWithThreads)
+{
+  const int w = 311, h = 257;
+  std::unique_ptr<Palette> pal(create_gray_palette(5));
+  std::unique_ptr<Image> src(create_gradient(w, h));
+  RgbMap rgbmap;
+  rgbmap.regenerate(pal.get(), -1);
+
+  for (auto method : { DitheringMethod::FLOYD_STEINBERG,
+                       DitheringMethod::ATKINSON,
+                       DitheringMethod::SIERRA_LITE }) {
+    std::unique_ptr<Image> a(Image::create(IMAGE_INDEXED, w, h));
+    std::unique_ptr<Image> b(Image::create(IMAGE_INDEXED, w, h));
+
+    ErrorDiffusionDither dither(method);
+    dither.setThreads(1);
+    dither.ditherRgbImageToIndexed(src.get(), a.get(), &rgbmap, pal.get());
+    dither.setThreads(4);
+    dither.ditherRgbImageToIndexed(src.get(), b.get(), &rgbmap, pal.get());
+
+    EXPECT_EQ(0, count_diff_between_images(a.get(), b.get()));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -8,30 +8,123 @@
 #include "config.h"
 #endif
 
-#include "doc/doc.h"
-#include "gfx/clip.h"
-#include "render/render.h"
+#include "render/get_sprite_pixel.h"
 
-#include <memory>
+#include "doc/blend_funcs.h"
+#include "doc/blend_internals.h"
+#include "doc/doc.h"
 
 namespace render {
 
 using namespace doc;
 
-color_t get_sprite_pixel(const Sprite* sprite, int x, int y, frame_t frame)
+color_t PixelQuery::pixel(const Sprite* sprite, int x, int y, frame_t frame)
 {
-  color_t color = 0;
+  m_contributions.clear();
 
-  if ((x >= 0) && (y >= 0) && (x < sprite->width()) && (y < sprite->height())) {
-    std::unique_ptr<Image> image(Image::create(sprite->pixelFormat(), 1, 1));
+  if ((x < 0) || (y < 0) || (x >= sprite->width()) || (y >= sprite->height()))
+    return 0;
 
-    render::Render().renderSprite(image.get(), sprite, frame,
-      gfx::Clip(0, 0, x, y, 1, 1));
+  m_format = sprite->pixelFormat();
+  m_maskColor = sprite->transparentColor();
+  collect(sprite->folder(), x, y, frame);
 
-    color = get_pixel(image.get(), 0, 0);
+  // Same background as Render::renderSprite() with BgType::TRANSPARENT
+  color_t color = (m_format == IMAGE_INDEXED ? m_maskColor: 0);
+
+  // Composite from the bottom-most contribution to the top
+  for (auto it=m_contributions.rbegin(), end=m_contributions.rend(); it!=end; ++it) {
+    switch (m_format) {
+      case IMAGE_RGB:
+        color = get_rgba_blender(it->blendMode)(color, it->color, it->opacity);
+        break;
+      case IMAGE_GRAYSCALE:
+        color = get_graya_blender(it->blendMode)(color, it->color, it->opacity);
+        break;
+      case IMAGE_INDEXED:
+        color = it->color;
+        break;
+    }
   }
 
   return color;
 }
 
+// Adds the contributions of the given layer (and its children) from
+// top to bottom. Returns true if the pixel hides everything below.
+bool PixelQuery::collect(const Layer* layer, int x, int y, frame_t frame)
+{
+  if (!layer->isVisible())
+    return false;
+
+  switch (layer->type()) {
+
+    case ObjectType::LayerImage: {
+      const Cel* cel = layer->cel(frame);
+      if (!cel)
+        break;
+
+      const Image* image = cel->image();
+      if (!image)
+        break;
+
+      const int u = x - cel->x();
+      const int v = y - cel->y();
+      if ((u < 0) || (v < 0) || (u >= image->width()) || (v >= image->height()))
+        break;
+
+      const LayerImage* imgLayer = static_cast<const LayerImage*>(layer);
+      const BlendMode blendMode = imgLayer->blendMode();
+      const color_t color = get_pixel(image, u, v);
+
+      // Indexed images replace the pixel with any non-transparent
+      // index (or always with the SRC mode), other formats skip mask
+      // pixels (like BlenderHelper in render.cpp).
+      if (color == m_maskColor &&
+          (m_format != IMAGE_INDEXED || blendMode != BlendMode::SRC))
+        break;
+
+      int t;
+      int opacity = cel->opacity();
+      opacity = MUL_UN8(opacity, imgLayer->opacity(), t);
+
+      m_contributions.push_back(PixelContribution{ cel, color, opacity, blendMode });
+
+      switch (m_format) {
+        case IMAGE_RGB:
+          return (blendMode == BlendMode::SRC ||
+                  (blendMode == BlendMode::NORMAL && opacity == 255 &&
+                   rgba_geta(color) == 255));
+        case IMAGE_GRAYSCALE:
+          return (blendMode == BlendMode::SRC ||
+                  (blendMode == BlendMode::NORMAL && opacity == 255 &&
+                   graya_geta(color) == 255));
+        case IMAGE_INDEXED:
+          return true;
+      }
+      break;
+    }
+
+    case ObjectType::LayerFolder: {
+      const LayerFolder* folder = static_cast<const LayerFolder*>(layer);
+      LayerConstIterator begin = folder->getLayerBegin();
+      LayerConstIterator it = folder->getLayerEnd();
+
+      while (it != begin) {
+        if (collect(*--it, x, y, frame))
+          return true;
+      }
+      break;
+    }
+
+  }
+  return false;
+}
+
+color_t get_sprite_pixel(const Sprite* sprite, int x, int y, frame_t frame)
+{
+  static thread_local PixelQuery query;
+  return query.pixel(sprite, x, y, frame);
+}
+
 } // namespace render
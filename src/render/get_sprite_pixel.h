@@ -6,15 +6,57 @@
 
 #pragma once
 
+#include "doc/blend_mode.h"
+#include "doc/color.h"
 #include "doc/frame.h"
+#include "doc/pixel_format.h"
+
+#include <vector>
 
 namespace doc {
+  class Cel;
+  class Layer;
   class Sprite;
 }
 
 namespace render {
   using namespace doc;
 
+  // A cel with a visible pixel in a queried sprite position.
+  struct PixelContribution {
+    const Cel* cel;
+    color_t color;              // Pixel of the cel image
+    int opacity;                // Cel opacity * layer opacity
+    BlendMode blendMode;
+  };
+
+  // Calculates the color of individual pixels of a sprite without
+  // rendering it (e.g. for the eyedropper on mouse move). Layers are
+  // walked from top to bottom and the walk stops in the first pixel
+  // that hides all layers below it, so hidden layers don't cost
+  // anything. The pixels are composited directly (without temporary
+  // images) and the object can be reused between queries to avoid
+  // allocations.
+  class PixelQuery {
+  public:
+    // Returns the same color that Render::renderSprite() renders in
+    // the given position with the default (transparent) background.
+    color_t pixel(const Sprite* sprite, int x, int y, frame_t frame);
+
+    // Cels that contributed to the last queried pixel, from the
+    // top-most to the bottom-most one.
+    const std::vector<PixelContribution>& contributions() const {
+      return m_contributions;
+    }
+
+  private:
+    bool collect(const Layer* layer, int x, int y, frame_t frame);
+
+    PixelFormat m_format;
+    color_t m_maskColor;
+    std::vector<PixelContribution> m_contributions;
+  };
+
   // Gets a pixel from the sprite in the specified position. If in the
   // specified coordinates there're background this routine will
   // return the 0 color (the mask-color).
@@ -11,6 +11,8 @@
 #include "doc/palette.h"
 #include "doc/rgbmap.h"
 
+#include <vector>
+
 namespace render {
 
   // Creates a Bayer dither matrix.
@@ -82,6 +84,87 @@ namespace render {
       if (m_transparentIndex >= 0 && !doc::rgba_geta(color))
         return m_transparentIndex;
 
+      NearestPair pair;
+      findNearestPair(matrix, color, rgbmap, palette, pair);
+      return pair.dither(matrix, x, y);
+    }
+
+    template<typename Matrix>
+    void ditherRgbImageToIndexed(const Matrix& matrix,
+                                 const doc::Image* srcImage,
+                                 doc::Image* dstImage,
+                                 int u, int v,
+                                 const doc::RgbMap* rgbmap,
+                                 const doc::Palette* palette) {
+      const doc::LockImageBits<doc::RgbTraits> srcBits(srcImage);
+      doc::LockImageBits<doc::IndexedTraits> dstBits(dstImage);
+      auto srcIt = srcBits.begin();
+      auto dstIt = dstBits.begin();
+      int w = srcImage->width();
+      int h = srcImage->height();
+
+      // Images use to have a lot of pixels with the same color, so we
+      // cache the nearest pair of each color (the two lookups of
+      // findNearestPair() are the slowest part of the process).
+      std::vector<NearestPair> cache(kCacheSize);
+
+      for (int y=0; y<h; ++y) {
+        for (int x=0; x<w; ++x, ++srcIt, ++dstIt) {
+          ASSERT(srcIt != srcBits.end());
+          ASSERT(dstIt != dstBits.end());
+
+          doc::color_t color = *srcIt;
+          if (m_transparentIndex >= 0 && !doc::rgba_geta(color)) {
+            *dstIt = m_transparentIndex;
+            continue;
+          }
+
+          NearestPair& pair = cache[cacheIndex(color)];
+          if (!pair.valid || pair.color != color)
+            findNearestPair(matrix, color, rgbmap, palette, pair);
+
+          *dstIt = pair.dither(matrix, x+u, y+v);
+        }
+      }
+    }
+
+  private:
+    enum { kCacheBits = 12,
+           kCacheSize = 1 << kCacheBits };
+
+    // The two nearest palette entries of a color, and where the
+    // color is between them, in the range of the dither matrix.
+    struct NearestPair {
+      bool valid = false;
+      doc::color_t color;
+      doc::color_t nearest1idx;
+      doc::color_t nearest2idx;
+      int factor;
+
+      template<typename Matrix>
+      doc::color_t dither(const Matrix& matrix, int x, int y) const {
+        // If factor > threshold, it means that we're closer to
+        // 'nearest2rgb' than to 'nearest1rgb'.
+        return (factor > matrix(x, y) ? nearest2idx:
+                                        nearest1idx);
+      }
+    };
+
+    static int cacheIndex(doc::color_t color) {
+      return int((color * 2654435761u) >> (32 - kCacheBits));
+    }
+
+    template<typename Matrix>
+    void findNearestPair(
+      const Matrix& matrix,
+      doc::color_t color,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette,
+      NearestPair& pair) {
+      pair.valid = true;
+      pair.color = color;
+      pair.factor = 0;
+
       // Get the nearest color in the palette with the given RGB
       // values.
       int r = doc::rgba_getr(color);
@@ -91,6 +174,7 @@ namespace render {
       doc::color_t nearest1idx =
         (rgbmap ? rgbmap->mapColor(r, g, b, a):
                   palette->findBestfit(r, g, b, a, m_transparentIndex));
+      pair.nearest1idx = pair.nearest2idx = nearest1idx;
 
       doc::color_t nearest1rgb = palette->getEntry(nearest1idx);
       int r1 = doc::rgba_getr(nearest1rgb);
@@ -117,7 +201,7 @@ namespace render {
       // If both possible RGB colors use the same index, we cannot
       // make any dither with these two colors.
       if (nearest1idx == nearest2idx)
-        return nearest1idx;
+        return;
 
       doc::color_t nearest2rgb = palette->getEntry(nearest2idx);
       r2 = doc::rgba_getr(nearest2rgb);
@@ -131,42 +215,14 @@ namespace render {
       int d = colorDistance(r1, g1, b1, a1, r, g, b, a);
       int D = colorDistance(r1, g1, b1, a1, r2, g2, b2, a2);
       if (D == 0)
-        return nearest1idx;
+        return;
 
       // We convert the d/D factor to the matrix range to compare it
-      // with the threshold. If d > threshold, it means that we're
-      // closer to 'nearest2rgb' than to 'nearest1rgb'.
-      d = matrix.maxValue() * d / D;
-      int threshold = matrix(x, y);
-
-      return (d > threshold ? nearest2idx:
-                              nearest1idx);
+      // with the threshold.
+      pair.nearest2idx = nearest2idx;
+      pair.factor = matrix.maxValue() * d / D;
     }
 
-    template<typename Matrix>
-    void ditherRgbImageToIndexed(const Matrix& matrix,
-                                 const doc::Image* srcImage,
-                                 doc::Image* dstImage,
-                                 int u, int v,
-                                 const doc::RgbMap* rgbmap,
-                                 const doc::Palette* palette) {
-      const doc::LockImageBits<doc::RgbTraits> srcBits(srcImage);
-      doc::LockImageBits<doc::IndexedTraits> dstBits(dstImage);
-      auto srcIt = srcBits.begin();
-      auto dstIt = dstBits.begin();
-      int w = srcImage->width();
-      int h = srcImage->height();
-
-      for (int y=0; y<h; ++y) {
-        for (int x=0; x<w; ++x, ++srcIt, ++dstIt) {
-          ASSERT(srcIt != srcBits.end());
-          ASSERT(dstIt != dstBits.end());
-          *dstIt = ditherRgbPixelToIndex(matrix, *srcIt, x+u, y+v, rgbmap, palette);
-        }
-      }
-    }
-
-  private:
     int m_transparentIndex;
   };
 
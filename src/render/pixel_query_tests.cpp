@@ -0,0 +1,142 @@
+// Aseprite Render Library
+// Copyright (c) 2001-2016 David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "render/get_sprite_pixel.h"
+#include "render/render.h"
+
+#include "doc/cel.h"
+#include "doc/context.h"
+#include "doc/document.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <memory>
+
+using namespace doc;
+using namespace render;
+
+namespace {
+
+  // Adds a layer with one cel in the first frame
+  LayerImage* add_layer(LayerFolder* parent, PixelFormat format,
+                        int x, int y, int w, int h) {
+    LayerImage* layer = new LayerImage(parent->sprite());
+    parent->addLayer(layer);
+
+    std::shared_ptr<Image> image(Image::create(format, w, h));
+    clear_image(image.get(), 0);
+    Cel* cel = new Cel(frame_t(0), image);
+    cel->setPosition(x, y);
+    layer->addCel(cel);
+    return layer;
+  }
+
+}
+
+TEST(PixelQuery, SameColorAsRender)
+{
+  Context ctx;
+  Document* doc = ctx.documents().add(4, 4, ColorMode::RGB);
+  Sprite* sprite = doc->sprite();
+
+  Image* bottom = sprite->layer(0)->cel(0)->image();
+  for (int y=0; y<4; ++y)
+    for (int x=0; x<4; ++x)
+      put_pixel(bottom, x, y, (x+y == 0 ? 0: rgba(x*60, y*60, 100, 255)));
+
+  LayerImage* multiply = add_layer(sprite->folder(), IMAGE_RGB, 1, 0, 3, 3);
+  multiply->setBlendMode(BlendMode::MULTIPLY);
+  multiply->setOpacity(200);
+  for (int y=0; y<3; ++y)
+    for (int x=0; x<3; ++x)
+      put_pixel(multiply->cel(0)->image(), x, y, rgba(200, 100, 50, (x+y)*60));
+
+  LayerFolder* folder = new LayerFolder(sprite);
+  sprite->folder()->addLayer(folder);
+  LayerImage* normal = add_layer(folder, IMAGE_RGB, -1, 2, 3, 2);
+  normal->cel(0)->setOpacity(240);
+  for (int x=0; x<3; ++x) {
+    put_pixel(normal->cel(0)->image(), x, 0, rgba(10, 20, 30, 255));
+    put_pixel(normal->cel(0)->image(), x, 1, rgba(90, 80, 70, 128));
+  }
+
+  LayerImage* hidden = add_layer(sprite->folder(), IMAGE_RGB, 0, 0, 4, 4);
+  hidden->setVisible(false);
+  clear_image(hidden->cel(0)->image(), rgba(255, 255, 255, 255));
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 4, 4));
+  Render().renderSprite(dst.get(), sprite, frame_t(0));
+
+  PixelQuery query;
+  for (int y=0; y<4; ++y)
+    for (int x=0; x<4; ++x)
+      EXPECT_EQ(get_pixel(dst.get(), x, y), query.pixel(sprite, x, y, frame_t(0)))
+        << "Pixel " << x << "," << y;
+
+  EXPECT_EQ(0, query.pixel(sprite, -1, 0, frame_t(0)));
+  EXPECT_EQ(0, query.pixel(sprite, 4, 0, frame_t(0)));
+  EXPECT_TRUE(query.contributions().empty());
+}
+
+TEST(PixelQuery, StopsInOpaquePixels)
+{
+  Context ctx;
+  Document* doc = ctx.documents().add(2, 2, ColorMode::RGB);
+  Sprite* sprite = doc->sprite();
+  clear_image(sprite->layer(0)->cel(0)->image(), rgba(255, 0, 0, 255));
+
+  LayerImage* middle = add_layer(sprite->folder(), IMAGE_RGB, 0, 0, 2, 2);
+  clear_image(middle->cel(0)->image(), rgba(0, 255, 0, 128));
+
+  LayerImage* top = add_layer(sprite->folder(), IMAGE_RGB, 1, 1, 1, 1);
+  clear_image(top->cel(0)->image(), rgba(0, 0, 255, 255));
+
+  PixelQuery query;
+  EXPECT_EQ(rgba(0, 0, 255, 255), query.pixel(sprite, 1, 1, frame_t(0)));
+  ASSERT_EQ(1, query.contributions().size());
+  EXPECT_EQ(top->cel(0), query.contributions()[0].cel);
+
+  query.pixel(sprite, 0, 0, frame_t(0));
+  ASSERT_EQ(2, query.contributions().size());
+  EXPECT_EQ(middle->cel(0), query.contributions()[0].cel);
+  EXPECT_EQ(sprite->layer(0)->cel(0), query.contributions()[1].cel);
+}
+
+TEST(PixelQuery, Indexed)
+{
+  Context ctx;
+  Document* doc = ctx.documents().add(2, 2, ColorMode::INDEXED);
+  Sprite* sprite = doc->sprite();
+  sprite->setTransparentColor(2);
+  clear_image(sprite->layer(0)->cel(0)->image(), 2);
+  put_pixel(sprite->layer(0)->cel(0)->image(), 0, 0, 5);
+
+  LayerImage* top = add_layer(sprite->folder(), IMAGE_INDEXED, 0, 0, 2, 1);
+  top->cel(0)->image()->setMaskColor(2);
+  clear_image(top->cel(0)->image(), 2);
+  put_pixel(top->cel(0)->image(), 1, 0, 7);
+
+  PixelQuery query;
+  EXPECT_EQ(5, query.pixel(sprite, 0, 0, frame_t(0)));
+  EXPECT_EQ(7, query.pixel(sprite, 1, 0, frame_t(0)));
+  EXPECT_EQ(1, query.contributions().size());
+  EXPECT_EQ(2, query.pixel(sprite, 1, 1, frame_t(0)));
+  EXPECT_TRUE(query.contributions().empty());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -21,6 +21,7 @@
 #include "doc/sprite.h"
 #include "gfx/hsv.h"
 #include "gfx/rgb.h"
+#include "render/error_diffusion.h"
 #include "render/ordered_dither.h"
 #include "render/render.h"
 
@@ -34,6 +35,10 @@ namespace render {
 using namespace doc;
 using namespace gfx;
 
+// Error diffusion in images bigger than this is done with a
+// multi-threaded wavefront (without serpentine scanning).
+static const int kSerpentineMaxPixels = 512*512;
+
 Palette* create_palette_from_sprite(
   const Sprite* sprite,
   frame_t fromFrame,
@@ -101,6 +106,18 @@ Image* convert_pixel_format(
     return new_image;
   }
 
+  // RGB -> Indexed with error diffusion
+  if (image->pixelFormat() == IMAGE_RGB &&
+      pixelFormat == IMAGE_INDEXED &&
+      is_error_diffusion(ditheringMethod)) {
+    ErrorDiffusionDither dither(ditheringMethod, new_mask_color);
+    // Small images are processed in one thread, so we can use
+    // serpentine scanning (which gives better results).
+    dither.setSerpentine(image->width()*image->height() < kSerpentineMaxPixels);
+    dither.ditherRgbImageToIndexed(image, new_image, rgbmap, palette);
+    return new_image;
+  }
+
   color_t c;
   int r, g, b, a;
 
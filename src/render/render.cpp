@@ -11,6 +11,7 @@
 #include "render/render.h"
 
 #include "base/base.h"
+#include "base/phase_timer.h"
 #include "doc/blend_internals.h"
 #include "doc/blend_mode.h"
 #include "doc/doc.h"
@@ -583,6 +584,7 @@ void Render::renderSprite(
   const gfx::Clip& area,
   Zoom zoom)
 {
+  base::ScopedPhase phase("render");
   m_sprite = sprite;
 
   CompositeImageFunc compositeImage =
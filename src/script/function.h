@@ -94,7 +94,8 @@ namespace script {
     std::size_t argCount;
 
     static inline std::vector<Value>** getVarArgsPtr() {
-      static std::vector<Value>* ptr = nullptr;
+      // Each thread can run its own script engine
+      static thread_local std::vector<Value>* ptr = nullptr;
       return &ptr;
     }
 
@@ -53,7 +53,7 @@ static NumArray* checkarray(lua_State *L, bool opt = false) {
 }
 
 static int32_t& getelem(lua_State *L) {
-  static std::string errMessage;
+  static thread_local std::string errMessage;
   NumArray *a = checkarray(L);
   int index = luaL_checkinteger(L, 2);
   if (index < 1 || index > static_cast<int>(a->size)) {
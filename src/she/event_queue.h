@@ -16,6 +16,20 @@ namespace she {
     virtual void getEvent(Event& ev, bool canWait) = 0;
     virtual void queueEvent(const Event& ev) = 0;
 
+    // Returns true if the backend can block the main thread until a
+    // new event is available (see waitEvents()). Backends that can't
+    // wait are polled by the UI message loop.
+    virtual bool canWaitEvents() const { return false; }
+
+    // Blocks until a new event arrives, wakeUp() is called from other
+    // thread, or the given timeout (in milliseconds) expires. A
+    // negative timeout waits indefinitely.
+    virtual void waitEvents(int timeoutMsecs) { }
+
+    // Wakes up the thread blocked in waitEvents(). It can be called
+    // from any thread.
+    virtual void wakeUp() { }
+
     // On MacOS X we need the EventQueue before the creation of the
     // System. E.g. when we double-click a file an Event to open that
     // file is queued in application:openFile:, code which is executed
@@ -27,4 +41,8 @@ namespace she {
     EventQueue::instance()->queueEvent(ev);
   }
 
+  inline void wake_up_event_queue() {
+    EventQueue::instance()->wakeUp();
+  }
+
 } // namespace she
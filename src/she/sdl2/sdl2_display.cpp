@@ -150,7 +150,7 @@ namespace she {
       m_surface->blitTo(newSurface, 0, 0, 0, 0, width(), height());
       m_surface->dispose();
     }
-    m_dirty = true;
+    m_presenter.invalidateAll();
     m_surface = newSurface;
     she::sdl::screen = newSurface;
   }
@@ -161,20 +161,17 @@ namespace she {
   }
 
   void SDL2Display::present() {
-    if (!m_dirty)
-      return;
-    m_dirty = false;
-    SDL_UpdateWindowSurface(m_window);
+    m_presenter.present(m_window);
   }
 
   void SDL2Display::flip(const gfx::Rect& bounds)
   {
-    m_dirty = true;
-
     auto nativeSurface = SDL_GetWindowSurface(m_window);
-    SDL_Rect rect {bounds.x, bounds.y, bounds.w, bounds.h};
-    SDL_Rect dst  {bounds.x * m_scale, bounds.y * m_scale, bounds.w * m_scale, bounds.h * m_scale};
-    SDL_BlitScaled((SDL_Surface*)m_surface->nativeHandle(), &rect, nativeSurface, &dst);
+    if (!nativeSurface)
+      return;
+
+    m_presenter.blit((SDL_Surface*)m_surface->nativeHandle(),
+                     nativeSurface, bounds, m_scale);
   }
 
   void SDL2Display::maximize()
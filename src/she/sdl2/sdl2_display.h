@@ -8,6 +8,7 @@
 
 #include <SDL2/SDL_mouse.h>
 #include "she/display.h"
+#include "she/sdl2/sdl2_presenter.h"
 
 struct SDL_Window;
 struct SDL_Renderer;
@@ -50,6 +51,11 @@ namespace she {
         void* nativeHandle() override;
 
         void present();
+
+        // Bytes blitted/presented in the last presented frame.
+        const SDL2Presenter::Stats& presentStats() const {
+            return m_presenter.lastFrameStats();
+        }
     private:
         SDL_Window* m_window;
         SDL_Renderer* m_renderer;
@@ -61,7 +67,7 @@ namespace she {
         NativeCursor m_nativeCursor;
         int m_restoredWidth;
         int m_restoredHeight;
-        bool m_dirty = true;
+        SDL2Presenter m_presenter;
     };
 
     extern SDL2Display* unique_display;
@@ -0,0 +1,245 @@
+// SHE library
+// Copyright (C) 2021 LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "she/sdl2/sdl2_presenter.h"
+
+#include "gfx/point.h"
+#include "gfx/size.h"
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SHE_SDL2_SSE2 1
+#endif
+
+namespace she {
+
+namespace {
+
+  // With more rectangles than this, the whole window is presented
+  const std::size_t kMaxRects = 64;
+
+  enum class Swizzle { None, SwapRB };
+
+  template<Swizzle S>
+  inline uint32_t convert_pixel(uint32_t p)
+  {
+    if (S == Swizzle::SwapRB)
+      return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+    else
+      return p;
+  }
+
+#ifdef SHE_SDL2_SSE2
+  template<Swizzle S>
+  inline __m128i convert_pixels(__m128i v)
+  {
+    if (S == Swizzle::SwapRB) {
+      const __m128i ga = _mm_set1_epi32(0xff00ff00);
+      const __m128i ff = _mm_set1_epi32(0xff);
+      return _mm_or_si128(
+        _mm_and_si128(v, ga),
+        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), ff),
+                     _mm_slli_epi32(_mm_and_si128(v, ff), 16)));
+    }
+    else
+      return v;
+  }
+#endif
+
+  // Writes each pixel of "src" Scale times in "dst".
+  template<int Scale, Swizzle S>
+  void replicate_row(const uint32_t* src, uint32_t* dst, int w)
+  {
+#ifdef SHE_SDL2_SSE2
+    for (; w >= 4; w -= 4, src += 4, dst += 4*Scale) {
+      const __m128i v = convert_pixels<S>(
+        _mm_loadu_si128((const __m128i*)src));
+      __m128i* d = (__m128i*)dst;
+
+      switch (Scale) {
+        case 1:
+          _mm_storeu_si128(d, v);
+          break;
+        case 2:
+          _mm_storeu_si128(d,   _mm_unpacklo_epi32(v, v));
+          _mm_storeu_si128(d+1, _mm_unpackhi_epi32(v, v));
+          break;
+        case 3:
+          _mm_storeu_si128(d,   _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+          _mm_storeu_si128(d+1, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+          _mm_storeu_si128(d+2, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+          break;
+        case 4:
+          _mm_storeu_si128(d,   _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 0, 0, 0)));
+          _mm_storeu_si128(d+1, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 1, 1, 1)));
+          _mm_storeu_si128(d+2, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 2, 2)));
+          _mm_storeu_si128(d+3, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+          break;
+      }
+    }
+#endif
+
+    for (; w > 0; --w, ++src) {
+      const uint32_t p = convert_pixel<S>(*src);
+      for (int i=0; i<Scale; ++i)
+        *(dst++) = p;
+    }
+  }
+
+  template<int Scale, Swizzle S>
+  void replicate_rect(const SDL_Surface* src, const SDL_Rect& rc,
+                      SDL_Surface* dst)
+  {
+    const int dstRowBytes = rc.w * Scale * 4;
+
+    for (int y=0; y<rc.h; ++y) {
+      const uint32_t* s = (const uint32_t*)
+        ((const uint8_t*)src->pixels + (rc.y+y)*src->pitch) + rc.x;
+      uint8_t* d = (uint8_t*)dst->pixels
+        + (rc.y+y)*Scale*dst->pitch + rc.x*Scale*4;
+
+      replicate_row<Scale, S>(s, (uint32_t*)d, rc.w);
+
+      // Repeat the scaled row
+      for (int i=1; i<Scale; ++i)
+        std::memcpy(d + i*dst->pitch, d, dstRowBytes);
+    }
+  }
+
+  template<Swizzle S>
+  bool replicate_rect(const SDL_Surface* src, const SDL_Rect& rc,
+                      SDL_Surface* dst, int scale)
+  {
+    switch (scale) {
+      case 1: replicate_rect<1, S>(src, rc, dst); return true;
+      case 2: replicate_rect<2, S>(src, rc, dst); return true;
+      case 3: replicate_rect<3, S>(src, rc, dst); return true;
+      case 4: replicate_rect<4, S>(src, rc, dst); return true;
+    }
+    return false;
+  }
+
+  // Integer scale for 32-bit surfaces with the same format or with
+  // the red and blue channels swapped (the screen surface is ABGR and
+  // window surfaces are usually ARGB/XRGB).
+  bool fast_blit(SDL_Surface* src, const SDL_Rect& rc,
+                 SDL_Surface* dst, int scale)
+  {
+    const SDL_PixelFormat* sf = src->format;
+    const SDL_PixelFormat* df = dst->format;
+    if (scale < 1 || scale > 4 ||
+        sf->BytesPerPixel != 4 ||
+        df->BytesPerPixel != 4 ||
+        sf->Gmask != df->Gmask)
+      return false;
+
+    Swizzle swizzle;
+    if (sf->Rmask == df->Rmask && sf->Bmask == df->Bmask)
+      swizzle = Swizzle::None;
+    else if (sf->Rmask == df->Bmask && sf->Bmask == df->Rmask &&
+             (sf->Rmask == 0xff || sf->Rmask == 0xff0000))
+      swizzle = Swizzle::SwapRB;
+    else
+      return false;
+
+    if (SDL_MUSTLOCK(src) && SDL_LockSurface(src) != 0)
+      return false;
+    if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) != 0) {
+      if (SDL_MUSTLOCK(src))
+        SDL_UnlockSurface(src);
+      return false;
+    }
+
+    bool result;
+    if (swizzle == Swizzle::None)
+      result = replicate_rect<Swizzle::None>(src, rc, dst, scale);
+    else
+      result = replicate_rect<Swizzle::SwapRB>(src, rc, dst, scale);
+
+    if (SDL_MUSTLOCK(dst))
+      SDL_UnlockSurface(dst);
+    if (SDL_MUSTLOCK(src))
+      SDL_UnlockSurface(src);
+    return result;
+  }
+
+} // anonymous namespace
+
+SDL2Presenter::SDL2Presenter()
+  : m_all(true)
+{
+}
+
+void SDL2Presenter::blit(SDL_Surface* src, SDL_Surface* dst,
+                         const gfx::Rect& bounds, int scale)
+{
+  // Clip the area to both surfaces
+  gfx::Rect bounds2 = bounds & gfx::Rect(0, 0, src->w, src->h);
+  bounds2 &= gfx::Rect(0, 0, dst->w / scale, dst->h / scale);
+  if (bounds2.isEmpty())
+    return;
+
+  SDL_Rect rect { bounds2.x, bounds2.y, bounds2.w, bounds2.h };
+  SDL_Rect dstRect { bounds2.x * scale, bounds2.y * scale,
+                     bounds2.w * scale, bounds2.h * scale };
+
+  if (!fast_blit(src, rect, dst, scale))
+    SDL_BlitScaled(src, &rect, dst, &dstRect);
+
+  const std::size_t bytes =
+    std::size_t(dstRect.w) * dstRect.h * dst->format->BytesPerPixel;
+  m_stats.blittedBytes += bytes;
+
+  if (!m_all) {
+    if (m_rects.size() < kMaxRects)
+      m_rects.push_back(dstRect);
+    else
+      m_all = true;
+  }
+}
+
+void SDL2Presenter::invalidateAll()
+{
+  m_all = true;
+}
+
+void SDL2Presenter::present(SDL_Window* window)
+{
+  if (!m_all && m_rects.empty())
+    return;
+
+  SDL_Surface* surface = SDL_GetWindowSurface(window);
+  const int bpp = (surface ? surface->format->BytesPerPixel: 4);
+
+  if (m_all) {
+    if (surface)
+      m_stats.presentedBytes = std::size_t(surface->w) * surface->h * bpp;
+    m_stats.rects = 1;
+    SDL_UpdateWindowSurface(window);
+  }
+  else {
+    for (const SDL_Rect& rc : m_rects)
+      m_stats.presentedBytes += std::size_t(rc.w) * rc.h * bpp;
+    m_stats.rects = int(m_rects.size());
+    SDL_UpdateWindowSurfaceRects(window, m_rects.data(), int(m_rects.size()));
+  }
+
+  m_lastFrameStats = m_stats;
+  m_stats = Stats();
+  m_rects.clear();
+  m_all = false;
+}
+
+} // namespace she
@@ -0,0 +1,53 @@
+// SHE library
+// Copyright (C) 2021 LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include <SDL2/SDL_rect.h>
+#include "gfx/rect.h"
+
+#include <cstddef>
+#include <vector>
+
+struct SDL_Surface;
+struct SDL_Window;
+
+namespace she {
+
+    // Copies the flipped areas of the screen surface to the window
+    // surface and presents only those areas to the window.
+    class SDL2Presenter {
+    public:
+        struct Stats {
+            std::size_t blittedBytes = 0;   // Bytes written in the window surface
+            std::size_t presentedBytes = 0; // Bytes updated in the window
+            int rects = 0;                  // Number of presented rectangles
+        };
+
+        SDL2Presenter();
+
+        // Scales the given bounds of "src" to "dst" and accumulates
+        // the area to be presented.
+        void blit(SDL_Surface* src, SDL_Surface* dst,
+                  const gfx::Rect& bounds, int scale);
+
+        // The whole window will be presented in the next present().
+        void invalidateAll();
+
+        // Updates the window with the accumulated rectangles.
+        void present(SDL_Window* window);
+
+        // Counters of the last presented frame.
+        const Stats& lastFrameStats() const { return m_lastFrameStats; }
+
+    private:
+        std::vector<SDL_Rect> m_rects;
+        bool m_all;
+        Stats m_stats;
+        Stats m_lastFrameStats;
+    };
+
+} // namespace she
@@ -395,6 +395,10 @@ namespace sdl {
                 case SDL_KEYMAPCHANGED:
                   continue;
 
+                case SDL_USEREVENT:
+                  // Posted by wakeUp() to unblock waitEvents()
+                  continue;
+
                 default:
                     std::cout << "Unknown event: " << sdlEvent.type << std::endl;
                     continue;
@@ -413,6 +417,36 @@ namespace sdl {
 
         void queueEvent(const Event& event) override {
             m_events.push(event);
+            wakeUp();
+        }
+
+        bool canWaitEvents() const override {
+            return true;
+        }
+
+        void waitEvents(int timeoutMsecs) override {
+            if (!keybuffer.empty() || !m_events.empty())
+                return;
+
+            // Present pending flips before going to sleep
+            for (auto& entry : sdl::windowIdToDisplay) {
+                entry.second->present();
+            }
+
+            // A null event only waits, the event stays in the SDL
+            // queue to be processed by getEvent().
+            if (timeoutMsecs < 0)
+                SDL_WaitEvent(nullptr);
+            else
+                SDL_WaitEventTimeout(nullptr, timeoutMsecs);
+        }
+
+        void wakeUp() override {
+            // SDL_PushEvent() is thread-safe
+            SDL_Event sdlEvent;
+            SDL_zero(sdlEvent);
+            sdlEvent.type = SDL_USEREVENT;
+            SDL_PushEvent(&sdlEvent);
         }
 
     private:
@@ -0,0 +1,31 @@
+// Aseprite UI Library
+// Copyright (C) 2001-2016  David Capello
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "ui/listitem.h"
+
+namespace ui {
+
+  // Rows of a ListBox in virtual mode (see ListBox::setModel()). The
+  // ListBox only creates items for the visible rows, and reuses them
+  // to show other rows when the list is scrolled.
+  class ListModel {
+  public:
+    virtual ~ListModel() { }
+
+    virtual int rowsCount() const = 0;
+
+    // Creates a new item to show rows. All rows must have the same
+    // height.
+    virtual ListItem* createRowItem() { return new ListItem; }
+
+    // Setups the given item (which can be showing other row) to show
+    // the specified row.
+    virtual void updateRowItem(ListItem* item, int row) = 0;
+  };
+
+} // namespace ui
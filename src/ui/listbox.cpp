@@ -11,6 +11,7 @@
 #include "ui/listbox.h"
 #include "base/iterator.h"
 #include "base/path.h"
+#include "ui/list_model.h"
 #include "ui/listitem.h"
 #include "ui/message.h"
 #include "ui/size_hint_event.h"
@@ -19,19 +20,38 @@
 #include "ui/theme.h"
 #include "ui/view.h"
 
+#include <algorithm>
+
 namespace ui {
 
 using namespace gfx;
 
 ListBox::ListBox()
   : Widget(kListBoxWidget)
+  , m_model(nullptr)
+  , m_selectedRow(-1)
+  , m_firstRow(0)
+  , m_measureItem(nullptr)
 {
   setFocusStop(true);
   initTheme();
 }
 
+ListBox::~ListBox()
+{
+  delete m_measureItem;
+}
+
 Widget* ListBox::getSelectedChild()
 {
+  if (m_model) {
+    const int i = m_selectedRow - m_firstRow;
+    if (m_selectedRow >= 0 && i >= 0 && i < int(m_rowItems.size()))
+      return m_rowItems[i];
+    else
+      return nullptr;
+  }
+
   for (auto child : children())
     if (child->isSelected())
       return child;
@@ -41,6 +61,9 @@ Widget* ListBox::getSelectedChild()
 
 int ListBox::getSelectedIndex()
 {
+  if (m_model)
+    return m_selectedRow;
+
   int i = 0;
 
   for (auto child : children()) {
@@ -55,6 +78,18 @@ int ListBox::getSelectedIndex()
 
 void ListBox::selectChild(Widget* item)
 {
+  if (m_model) {
+    auto it = std::find(m_rowItems.begin(), m_rowItems.end(), item);
+    if (it != m_rowItems.end())
+      selectIndex(m_firstRow + int(it - m_rowItems.begin()));
+    else if (!item && m_selectedRow >= 0) {
+      m_selectedRow = -1;
+      updateRowItems(true);
+      onChange();
+    }
+    return;
+  }
+
   for (auto child : children()) {
     if (child->isSelected()) {
       if (item && child == item)
@@ -74,6 +109,20 @@ void ListBox::selectChild(Widget* item)
 
 void ListBox::selectIndex(int index)
 {
+  if (m_model) {
+    if (index < 0 || index >= m_model->rowsCount() ||
+        index == m_selectedRow)
+      return;
+
+    m_selectedRow = index;
+    for (std::size_t i=0; i<m_rowItems.size(); ++i)
+      m_rowItems[i]->setSelected(m_firstRow+int(i) == m_selectedRow);
+
+    makeRectVisible(rowBounds(index));
+    onChange();
+    return;
+  }
+
   const WidgetsList& children = this->children();
   if (index < 0 || index >= (int)children.size())
     return;
@@ -85,10 +134,18 @@ void ListBox::selectIndex(int index)
 
 std::size_t ListBox::getItemsCount() const
 {
+  if (m_model)
+    return m_model->rowsCount();
+
   return children().size();
 }
 
 void ListBox::makeChildVisible(Widget* child)
+{
+  makeRectVisible(child->bounds());
+}
+
+void ListBox::makeRectVisible(const gfx::Rect& rc)
 {
   View* view = View::getView(this);
   if (!view)
@@ -97,11 +154,11 @@ void ListBox::makeChildVisible(Widget* child)
   gfx::Point scroll = view->viewScroll();
   gfx::Rect vp = view->viewportBounds();
 
-  if (child->bounds().y < vp.y)
-    scroll.y = child->bounds().y - bounds().y;
-  else if (child->bounds().y > vp.y + vp.h - child->bounds().h)
-    scroll.y = (child->bounds().y - bounds().y
-                - vp.h + child->bounds().h);
+  if (rc.y < vp.y)
+    scroll.y = rc.y - bounds().y;
+  else if (rc.y > vp.y + vp.h - rc.h)
+    scroll.y = (rc.y - bounds().y
+                - vp.h + rc.h);
 
   view->setViewScroll(scroll);
 }
@@ -110,14 +167,21 @@ void ListBox::makeChildVisible(Widget* child)
 void ListBox::centerScroll()
 {
   View* view = View::getView(this);
-  Widget* item = getSelectedChild();
+  gfx::Rect rc;
+
+  if (m_model) {
+    if (m_selectedRow >= 0)
+      rc = rowBounds(m_selectedRow);
+  }
+  else if (Widget* item = getSelectedChild())
+    rc = item->bounds();
 
-  if (view && item) {
+  if (view && !rc.isEmpty()) {
     gfx::Rect vp = view->viewportBounds();
     gfx::Point scroll = view->viewScroll();
 
-    scroll.y = ((item->bounds().y - bounds().y)
-                - vp.h/2 + item->bounds().h/2);
+    scroll.y = ((rc.y - bounds().y)
+                - vp.h/2 + rc.h/2);
 
     view->setViewScroll(scroll);
   }
@@ -129,6 +193,8 @@ inline bool sort_by_text(Widget* a, Widget* b) {
 
 void ListBox::sortItems()
 {
+  ASSERT(!m_model);
+
   WidgetsList widgets = children();
   std::sort(widgets.begin(), widgets.end(), &sort_by_text);
 
@@ -138,6 +204,185 @@ void ListBox::sortItems()
     addChild(child);
 }
 
+void ListBox::setModel(ListModel* model)
+{
+  ASSERT(m_model || children().empty());
+
+  if (m_model) {
+    while (!children().empty())
+      delete children().front();
+    m_rowItems.clear();
+    m_spareItems.clear();
+  }
+
+  // The item to measure rows is created by the model
+  delete m_measureItem;
+  m_measureItem = nullptr;
+
+  m_model = model;
+  modelChanged();
+}
+
+void ListBox::modelChanged()
+{
+  m_rowSize = gfx::Size(0, 0);
+  if (m_model && m_selectedRow >= m_model->rowsCount())
+    m_selectedRow = -1;
+
+  relayoutRows();
+}
+
+void ListBox::rowsInserted(int first, int count)
+{
+  ASSERT(m_model);
+  ASSERT(first >= 0 && count >= 0);
+
+  if (m_selectedRow >= first)
+    m_selectedRow += count;
+
+  // If rows weren't measured yet, all of them are measured later
+  if (m_rowSize.h > 0)
+    measureRows(first, first+count);
+
+  relayoutRows();
+}
+
+void ListBox::relayoutRows()
+{
+  layout();
+  if (View* view = View::getView(this))
+    view->updateView();
+}
+
+// Size of all rows: the height of the first row and the width of the
+// widest row. Rows are measured only once (until modelChanged()).
+gfx::Size ListBox::rowSize()
+{
+  ASSERT(m_model);
+
+  if (m_rowSize.h == 0)
+    measureRows(0, m_model->rowsCount());
+  return m_rowSize;
+}
+
+// Updates the size of all rows with the rows in [first, last). They
+// are measured with only one hidden item (instead of one item for
+// each row), so items of visible rows are not modified.
+void ListBox::measureRows(int first, int last)
+{
+  if (first >= last)
+    return;
+
+  if (!m_measureItem) {
+    m_measureItem = m_model->createRowItem();
+    m_measureItem->setVisible(false);
+  }
+
+  for (int row=first; row<last; ++row) {
+    m_model->updateRowItem(m_measureItem, row);
+    const gfx::Size size = m_measureItem->sizeHint();
+    if (m_rowSize.h == 0)
+      m_rowSize.h = MAX(1, size.h);
+    m_rowSize.w = MAX(m_rowSize.w, size.w);
+  }
+}
+
+int ListBox::rowHeight()
+{
+  return rowSize().h;
+}
+
+gfx::Rect ListBox::rowBounds(int row)
+{
+  Rect rc = childrenBounds();
+  rc.y += row * (rowHeight() + childSpacing());
+  rc.h = rowHeight();
+  return rc;
+}
+
+int ListBox::rowAtY(int y)
+{
+  const int step = rowHeight() + childSpacing();
+  if (step <= 0)
+    return -1;
+
+  y -= childrenBounds().y;
+  if (y < 0)
+    return -1;
+
+  int row = y / step;
+  return (row < m_model->rowsCount() ? row: -1);
+}
+
+// Creates/reuses items for the rows that are inside the viewport. If
+// "updateAll" is false, items of rows that are still visible are kept
+// as they are (they were moved by the View when it was scrolled).
+void ListBox::updateRowItems(bool updateAll)
+{
+  ASSERT(m_model);
+
+  const int rows = m_model->rowsCount();
+  int first = 0, last = -1;
+
+  if (rows > 0) {
+    // Rows outside the view (or the parent) are not visible
+    gfx::Rect vp = bounds();
+    if (View* view = View::getView(this))
+      vp &= view->viewportBounds();
+    else if (parent())
+      vp &= parent()->childrenBounds();
+
+    if (!vp.isEmpty()) {
+      const int step = rowHeight() + childSpacing();
+      const Rect cpos = childrenBounds();
+      first = MID(0, (vp.y - cpos.y) / step, rows-1);
+      last = MID(first, (vp.y2() - 1 - cpos.y) / step, rows-1);
+    }
+  }
+
+  if (!updateAll &&
+      first == m_firstRow &&
+      last == m_firstRow + int(m_rowItems.size()) - 1)
+    return;
+
+  std::vector<ListItem*> items(last - first + 1, nullptr);
+  for (std::size_t i=0; i<m_rowItems.size(); ++i) {
+    const int row = m_firstRow + int(i);
+    if (!updateAll && row >= first && row <= last)
+      items[row - first] = m_rowItems[i];
+    else
+      m_spareItems.push_back(m_rowItems[i]);
+  }
+
+  for (std::size_t i=0; i<items.size(); ++i) {
+    if (items[i])
+      continue;
+
+    const int row = first + int(i);
+    ListItem* item;
+    if (!m_spareItems.empty()) {
+      item = m_spareItems.back();
+      m_spareItems.pop_back();
+    }
+    else {
+      item = m_model->createRowItem();
+      addChild(item);
+    }
+
+    m_model->updateRowItem(item, row);
+    item->setSelected(row == m_selectedRow);
+    item->setVisible(true);
+    item->setBounds(rowBounds(row));
+    items[i] = item;
+  }
+
+  for (ListItem* item : m_spareItems)
+    item->setVisible(false);
+
+  m_rowItems.swap(items);
+  m_firstRow = first;
+}
+
 bool ListBox::onProcessMessage(Message* msg)
 {
   switch (msg->type()) {
@@ -171,7 +416,12 @@ bool ListBox::onProcessMessage(Message* msg)
           }
         }
 
-        if (pick_item) {
+        if (pick_item && m_model) {
+          int row = rowAtY(mousePos.y);
+          if (row >= 0)
+            selectIndex(row);
+        }
+        else if (pick_item) {
           Widget* picked;
 
           if (view) {
@@ -207,10 +457,10 @@ bool ListBox::onProcessMessage(Message* msg)
     }
 
     case kKeyDownMessage:
-      if (hasFocus() && !children().empty()) {
+      if (hasFocus() && getItemsCount() > 0) {
         int select = getSelectedIndex();
         View* view = View::getView(this);
-        int bottom = MAX(0, children().size()-1);
+        int bottom = MAX(0, int(getItemsCount())-1);
         KeyMessage* keymsg = static_cast<KeyMessage*>(msg);
 
         switch (keymsg->scancode()) {
@@ -286,6 +536,11 @@ void ListBox::onResize(ResizeEvent& ev)
 {
   setBoundsQuietly(ev.bounds());
 
+  if (m_model) {
+    updateRowItems(true);
+    return;
+  }
+
   Rect cpos = childrenBounds();
 
   for (auto child : children()) {
@@ -299,11 +554,22 @@ void ListBox::onResize(ResizeEvent& ev)
 void ListBox::onSizeHint(SizeHintEvent& ev)
 {
   int w = 0, h = 0;
-  for (std::size_t i = 0, end = children().size(); i < end; ++i) {
-    Size reqSize = static_cast<ListItem*>(at(i))->sizeHint();
 
-    w = MAX(w, reqSize.w);
-    h += reqSize.h + (i+1 != end ? this->childSpacing(): 0);
+  if (m_model) {
+    const int rows = m_model->rowsCount();
+    if (rows > 0) {
+      const gfx::Size size = rowSize();
+      h = rows*size.h + (rows-1)*childSpacing();
+      w = size.w;
+    }
+  }
+  else {
+    for (std::size_t i = 0, end = children().size(); i < end; ++i) {
+      Size reqSize = static_cast<ListItem*>(at(i))->sizeHint();
+
+      w = MAX(w, reqSize.w);
+      h += reqSize.h + (i+1 != end ? this->childSpacing(): 0);
+    }
   }
 
   w += border().width();
@@ -312,6 +578,16 @@ void ListBox::onSizeHint(SizeHintEvent& ev)
   ev.setSizeHint(Size(w, h));
 }
 
+void ListBox::onInvalidateRegion(const gfx::Region& region)
+{
+  // The View moves the items when it's scrolled, so here we add items
+  // for the new visible rows before they are painted.
+  if (m_model && isVisible())
+    updateRowItems(false);
+
+  Widget::onInvalidateRegion(region);
+}
+
 void ListBox::onChange()
 {
   Change();
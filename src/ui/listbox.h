@@ -9,13 +9,17 @@
 #include "base/signal.h"
 #include "ui/widget.h"
 
+#include <vector>
+
 namespace ui {
 
   class ListItem;
+  class ListModel;
 
   class ListBox : public Widget {
   public:
     ListBox();
+    ~ListBox();
 
     Widget* getSelectedChild();
     int getSelectedIndex();
@@ -29,6 +33,20 @@ namespace ui {
     void centerScroll();
     void sortItems();
 
+    // Virtual mode: rows are taken from the given model and only the
+    // visible ones have a ListItem widget. Items must not be added as
+    // children in this mode. The model is not owned by the ListBox.
+    void setModel(ListModel* model);
+    ListModel* model() const { return m_model; }
+
+    // Must be called when rows are added/removed/modified in the
+    // model to relayout the list. All rows are measured again.
+    void modelChanged();
+
+    // Must be called when "count" rows were inserted in the model
+    // starting from "first". Only the new rows are measured.
+    void rowsInserted(int first, int count);
+
     base::Signal0<void> Change;
     base::Signal0<void> DoubleClickItem;
 
@@ -37,8 +55,28 @@ namespace ui {
     virtual void onPaint(PaintEvent& ev) override;
     virtual void onResize(ResizeEvent& ev) override;
     virtual void onSizeHint(SizeHintEvent& ev) override;
+    virtual void onInvalidateRegion(const gfx::Region& region) override;
     virtual void onChange();
     virtual void onDoubleClickItem();
+
+  private:
+    void makeRectVisible(const gfx::Rect& rc);
+    gfx::Size rowSize();
+    void measureRows(int first, int last);
+    void relayoutRows();
+    int rowHeight();
+    gfx::Rect rowBounds(int row);
+    int rowAtY(int y);
+    void updateRowItems(bool updateAll);
+
+    // Virtual mode
+    ListModel* m_model;
+    int m_selectedRow;
+    gfx::Size m_rowSize;              // Cached size of all rows
+    int m_firstRow;                   // Row of m_rowItems[0]
+    std::vector<ListItem*> m_rowItems; // Items of the visible rows
+    std::vector<ListItem*> m_spareItems; // Hidden items to be reused
+    ListItem* m_measureItem;          // Item to measure rows (not a child)
   };
 
 } // namespace ui
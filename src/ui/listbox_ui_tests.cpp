@@ -0,0 +1,173 @@
+// Aseprite
+// Copyright (C) 2001-2016  David Capello
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#define TEST_GUI
+#include "tests/test.h"
+#include "gfx/size.h"
+#include "ui/list_model.h"
+
+#include <string>
+#include <vector>
+
+using namespace gfx;
+using namespace ui;
+
+namespace {
+
+  class FixedItem : public ListItem {
+  protected:
+    void onSizeHint(SizeHintEvent& ev) override {
+      ev.setSizeHint(Size(50, 10));
+    }
+  };
+
+  // Item with a width that depends on its text
+  class TextItem : public ListItem {
+  protected:
+    void onSizeHint(SizeHintEvent& ev) override {
+      ev.setSizeHint(Size(5*int(text().size()), 10));
+    }
+  };
+
+  class TextModel : public ListModel {
+  public:
+    int rowsCount() const override { return 100; }
+    ListItem* createRowItem() override { return new TextItem; }
+    void updateRowItem(ListItem* item, int row) override {
+      item->setText(row == 50 ? "The longest row": std::to_string(row));
+    }
+  };
+
+  // Model where rows can be added, counting the updated items
+  class RowsModel : public ListModel {
+  public:
+    RowsModel() : updates(0) { }
+    int rowsCount() const override { return int(rows.size()); }
+    ListItem* createRowItem() override { return new TextItem; }
+    void updateRowItem(ListItem* item, int row) override {
+      item->setText(rows[row]);
+      ++updates;
+    }
+    std::vector<std::string> rows;
+    int updates;
+  };
+
+  class Model : public ListModel {
+  public:
+    Model(int rows) : m_rows(rows), m_created(0) { }
+    int rowsCount() const override { return m_rows; }
+    ListItem* createRowItem() override {
+      ++m_created;
+      return new FixedItem;
+    }
+    void updateRowItem(ListItem* item, int row) override {
+      item->setText(std::to_string(row));
+    }
+    int created() const { return m_created; }
+    void setRows(int rows) { m_rows = rows; }
+  private:
+    int m_rows;
+    int m_created;
+  };
+
+} // anonymous namespace
+
+TEST(ListBox, VirtualRows)
+{
+  Model model(10000);
+  Box* parent = new Box(VERTICAL);
+  ListBox* listbox = new ListBox;
+  parent->addChild(listbox);
+  parent->setBounds(Rect(0, 0, 50, 100));
+  listbox->setModel(&model);
+
+  EXPECT_EQ(10000, listbox->getItemsCount());
+  EXPECT_EQ(Size(50, 100000), listbox->sizeHint());
+
+  // Only the visible rows have items (plus one hidden item to
+  // measure rows)
+  listbox->setBounds(Rect(0, -200, 50, 100000));
+  EXPECT_EQ(-1, listbox->getSelectedIndex());
+  EXPECT_EQ(nullptr, listbox->getSelectedChild());
+  EXPECT_EQ(11, model.created());
+  EXPECT_EQ("20", listbox->firstChild()->text());
+
+  listbox->selectIndex(5000);
+  EXPECT_EQ(5000, listbox->getSelectedIndex());
+  EXPECT_EQ(nullptr, listbox->getSelectedChild());
+
+  // Rows shown in other position reuse the same items
+  listbox->setBounds(Rect(0, -50000, 50, 100000));
+  EXPECT_EQ(11, model.created());
+
+  Widget* item = listbox->getSelectedChild();
+  ASSERT_TRUE(item != nullptr);
+  EXPECT_EQ("5000", item->text());
+  EXPECT_TRUE(item->isSelected());
+  EXPECT_EQ(Rect(0, 0, 50, 10), item->bounds());
+
+  model.setRows(10);
+  listbox->modelChanged();
+  EXPECT_EQ(-1, listbox->getSelectedIndex());
+  EXPECT_EQ(Size(50, 100), listbox->sizeHint());
+
+  listbox->setModel(nullptr);
+  delete parent;
+}
+
+TEST(ListBox, VirtualRowsWidth)
+{
+  TextModel model;
+  Box* parent = new Box(VERTICAL);
+  ListBox* listbox = new ListBox;
+  parent->addChild(listbox);
+  parent->setBounds(Rect(0, 0, 100, 20));
+  listbox->setModel(&model);
+
+  // The width is the width of the widest row (not the first one)
+  EXPECT_EQ(Size(5*15, 1000), listbox->sizeHint());
+
+  // Items show their rows after the measurement
+  listbox->setBounds(Rect(0, 0, 100, 1000));
+  ASSERT_TRUE(listbox->firstChild() != nullptr);
+  EXPECT_EQ("0", listbox->firstChild()->text());
+
+  listbox->setModel(nullptr);
+  delete parent;
+}
+
+TEST(ListBox, VirtualRowsInserted)
+{
+  RowsModel model;
+  for (int i=0; i<1000; ++i)
+    model.rows.push_back(std::to_string(i));
+
+  Box* parent = new Box(VERTICAL);
+  ListBox* listbox = new ListBox;
+  parent->addChild(listbox);
+  parent->setBounds(Rect(0, 0, 100, 20));
+  listbox->setModel(&model);
+  EXPECT_EQ(Size(5*3, 10000), listbox->sizeHint());
+
+  listbox->setBounds(Rect(0, 0, 100, 20));
+  listbox->selectIndex(1);
+  ASSERT_TRUE(listbox->getSelectedChild() != nullptr);
+  EXPECT_EQ("1", listbox->getSelectedChild()->text());
+
+  // Only the new row (and the visible ones) are updated
+  const int updates = model.updates;
+  model.rows.insert(model.rows.begin(), "A longer row");
+  listbox->rowsInserted(0, 1);
+  EXPECT_EQ(Size(5*12, 10010), listbox->sizeHint());
+  EXPECT_GE(4, model.updates - updates);
+
+  // The selection is kept in the same row
+  EXPECT_EQ(2, listbox->getSelectedIndex());
+
+  listbox->setModel(nullptr);
+  delete parent;
+}
@@ -140,7 +140,10 @@ Manager::~Manager()
 void Manager::setDisplay(she::Display* display)
 {
   m_display = display;
-  m_eventQueue = she::instance()->eventQueue();
+
+  // Keep the queue if it was replaced with setEventQueue()
+  if (!m_eventQueue)
+    m_eventQueue = she::instance()->eventQueue();
 
   onNewDisplayConfiguration();
 }
@@ -228,6 +231,21 @@ bool Manager::generateMessages()
   return !msg_queue.empty();
 }
 
+bool Manager::canWaitEvents() const
+{
+  return (m_eventQueue && m_eventQueue->canWaitEvents());
+}
+
+void Manager::waitEvents(int timeoutMsecs)
+{
+  // Don't sleep if there are new windows to show
+  if (!new_windows.empty())
+    return;
+
+  if (m_eventQueue)
+    m_eventQueue->waitEvents(timeoutMsecs);
+}
+
 void Manager::generateSetCursorMessage(const gfx::Point& mousePos,
                                        KeyModifiers modifiers,
                                        PointerType pointerType)
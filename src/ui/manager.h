@@ -37,6 +37,11 @@ namespace ui {
 
     void setDisplay(she::Display* display);
 
+    // Queue from where the she events are taken. It can be replaced
+    // to record or replay the input of a session.
+    she::EventQueue* eventQueue() const { return m_eventQueue; }
+    void setEventQueue(she::EventQueue* queue) { m_eventQueue = queue; }
+
     // Executes the main message loop.
     void run();
 
@@ -49,6 +54,14 @@ namespace ui {
     void dispatchMessages();
     void enqueueMessage(std::shared_ptr<Message> msg);
 
+    // Returns true if the backend can block until new events arrive,
+    // so the message loop doesn't need to poll.
+    bool canWaitEvents() const;
+
+    // Blocks until a new event arrives, the timeout (in milliseconds)
+    // expires, or a background thread wakes up the event queue.
+    void waitEvents(int timeoutMsecs);
+
     void addToGarbage(Widget* widget);
     void collectGarbage();
 
@@ -13,9 +13,15 @@
 #include "base/chrono.h"
 #include "base/thread.h"
 #include "ui/manager.h"
+#include "ui/timer.h"
 
 namespace ui {
 
+// Maximum time to block waiting for events when there are no running
+// timers. It's just a safety net, events and wake ups from other
+// threads interrupt the wait anyway.
+static const int kMaxWaitMsecs = 500;
+
 MessageLoop::MessageLoop(Manager* manager)
   : m_manager(manager)
 {
@@ -23,13 +29,27 @@ MessageLoop::MessageLoop(Manager* manager)
 
 void MessageLoop::pumpMessages() {
   base::Chrono chrono;
-  if (m_manager->generateMessages()) {
+  bool idle = !m_manager->generateMessages();
+  if (!idle) {
     m_manager->dispatchMessages();
   }
   else {
     m_manager->collectGarbage();
   }
 
+  // If the backend can wait for events, we don't need to poll: we
+  // block only when there is nothing to do, until the next input
+  // event, the next timer tick, or a wake up from other thread.
+  if (m_manager->canWaitEvents()) {
+    if (idle) {
+      int timeout = Timer::nextTimeout();
+      if (timeout < 0 || timeout > kMaxWaitMsecs)
+        timeout = kMaxWaitMsecs;
+      m_manager->waitEvents(timeout);
+    }
+    return;
+  }
+
   // If the dispatching of messages was faster than 10 milliseconds,
   // it means that the process is not using a lot of CPU, so we can
   // wait the difference to cover those 10 milliseconds
@@ -77,4 +77,20 @@ namespace ui {
     }
   }
 
+  int Timer::nextTimeout() {
+    base::tick_t t = base::current_tick();
+    int timeout = -1;
+
+    for (auto timer : timers) {
+      if (timer->isRunning()) {
+        base::tick_t next = timer->m_lastTick + timer->m_interval;
+        int msecs = (next > t ? int(next - t): 0);
+        if (timeout < 0 || msecs < timeout)
+          timeout = msecs;
+      }
+    }
+
+    return timeout;
+  }
+
 } // namespace ui
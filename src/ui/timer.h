@@ -44,6 +44,10 @@ namespace ui {
 
     static void pollTimers();
 
+    // Returns the milliseconds until the next running timer must
+    // tick, or -1 if there are no running timers.
+    static int nextTimeout();
+
   protected:
     virtual void onTick();
 
@@ -13,6 +13,7 @@
 #include "ui/widget.h"
 
 #include "base/memory.h"
+#include "base/phase_timer.h"
 #include "base/string.h"
 #include "she/display.h"
 #include "she/font.h"
@@ -1336,6 +1337,7 @@ bool Widget::onProcessMessage(Message* msg)
       ASSERT(ptmsg->rect().w > 0);
       ASSERT(ptmsg->rect().h > 0);
 
+      base::ScopedPhase phase("paint");
       GraphicsPtr graphics = getGraphics(toClient(ptmsg->rect()));
       return paintEvent(graphics.get());
     }